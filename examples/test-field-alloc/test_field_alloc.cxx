@@ -0,0 +1,87 @@
+/*
+ * Field3D allocation test
+ *
+ * Counts the memory blocks allocated when evaluating chained
+ * expressions. With rvalue references each intermediate result is
+ * reused by the next operator, so a chain of N binary operations
+ * whose leaves are all named fields allocates only for the leaf
+ * products, not for every operator.
+ * 
+ */
+
+#include <bout.hxx>
+#include <boutmain.hxx>
+
+#include <derivs.hxx>
+#include <difops.hxx>
+
+#include <math.h>
+
+/// Evaluate expression into result, setting n to the number of
+/// blocks allocated while doing so
+#define COUNT_ALLOC(n, result, expr)                 \
+  {                                                  \
+    unsigned long start = Field3D::blockCount();     \
+    result = expr;                                   \
+    n = Field3D::blockCount() - start;               \
+  }
+
+int check(const char *name, unsigned long count, unsigned long expected) {
+  output.write("\t%-30s : %lu blocks (expected %lu) %s\n", 
+               name, count, expected, (count == expected) ? "PASS" : "FAIL");
+  return (count == expected) ? 0 : 1;
+}
+
+int physics_init(bool restarting) {
+  Field3D a, b, c, d, e, f, result;
+  
+  a = 1.0; b = 2.0; c = 3.0; d = 4.0; e = 5.0; f = 6.0;
+  for(int jx=0;jx<mesh->ngx;jx++)
+    for(int jy=0;jy<mesh->ngy;jy++)
+      for(int jz=0;jz<mesh->ngz;jz++) {
+        a[jx][jy][jz] = sin(0.1*jx + 0.2*jy + 0.3*jz);
+        b[jx][jy][jz] = cos(0.3*jx - 0.1*jy + 0.2*jz);
+      }
+  result = 0.0;
+  BoutReal mu = 0.1;
+  
+  output << "\nCounting Field3D allocations\n";
+  
+  int failures = 0;
+  unsigned long n, nd, nz;
+  
+  // a*b, c*d and e*2.0 each need a new block. The additions and
+  // the subtraction reuse a temporary operand when one is available
+#ifdef BOUT_HAS_RVALUE_REFS
+  const unsigned long chain_expected = 3;
+#else
+  const unsigned long chain_expected = 6;
+#endif
+  COUNT_ALLOC(n, result, a*b + c*d - e*2.0 + f);
+  failures += check("a*b + c*d - e*2.0 + f", n, chain_expected);
+  
+  // Differential operators return temporaries, so combining them
+  // should add nothing beyond the blocks the operators themselves use
+  COUNT_ALLOC(nd, result, Delp2(a));
+  COUNT_ALLOC(nz, result, DDZ(b));
+  COUNT_ALLOC(n, result, mu*Delp2(a) + DDZ(b));
+#ifdef BOUT_HAS_RVALUE_REFS
+  failures += check("mu*Delp2(a) + DDZ(b)", n, nd + nz);
+#else
+  failures += check("mu*Delp2(a) + DDZ(b)", n, nd + nz + 2);
+#endif
+  
+  if(failures == 0) {
+    output << "\nAll allocation checks passed\n";
+  }else
+    output.write("\n%d allocation checks FAILED\n", failures);
+  
+  output << "\nFinished running test. Triggering error to quit\n\n";
+  
+  return 1;
+}
+
+int physics_run(BoutReal t) {
+  // Doesn't do anything
+  return 1;
+}
@@ -0,0 +1,22 @@
+#!/bin/bash
+#
+# Run the same case with double and with float Field3D storage,
+# and report the difference between them.
+#
+# The library is rebuilt for each mode, and left in the default
+# (double) mode at the end. Both runs must use the same number of
+# processors, since each processor saves its own part of the result
+
+MPIEXEC=mpirun
+NP=2
+
+rm -f data/result.*
+
+for FLAGS in "-DBOUT_FIELD_FLOAT" ""; do
+    echo "Building with CFLAGS = \"$FLAGS\""
+    (cd ../.. && make clean > /dev/null && make CFLAGS="$FLAGS" > /dev/null)
+    make clean > /dev/null
+    make CFLAGS="$FLAGS" > /dev/null
+    
+    $MPIEXEC -np $NP ./test_field_float NXPE=$NP | grep -E "PASS|FAIL|difference"
+done
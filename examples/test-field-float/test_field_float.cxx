@@ -0,0 +1,146 @@
+/*
+ * Single precision Field3D test
+ *
+ * Field3D data is stored as float when the library is built with
+ * -DBOUT_FIELD_FLOAT, and guard cells are then exchanged as float.
+ * Checks that communicated guard cells match the values stored on the
+ * neighbouring processor, then saves the result of a few derivative
+ * operators. If the result from a build with the other precision has
+ * already been saved, reports the difference between the two.
+ *
+ */
+
+#include <bout.hxx>
+#include <boutmain.hxx>
+
+#include <derivs.hxx>
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+/// Test profile, in terms of global indices so that it is
+/// independent of the domain decomposition
+BoutReal profile(int jx, int jy, int jz)
+{
+  BoutReal x = mesh->XGLOBAL(jx);
+  BoutReal y = mesh->YGLOBAL(jy);
+  BoutReal z = TWOPI*jz/(mesh->ngz-1);
+  return 1. + 0.5*sin(0.3*x + 0.1*y + z) + 0.1*cos(0.2*x - 2.*z);
+}
+
+int check(const char *name, BoutReal diff, BoutReal tol)
+{
+  output.write("\t%-30s : relative difference %e %s\n",
+               name, diff, (diff <= tol) ? "PASS" : "FAIL");
+  return (diff <= tol) ? 0 : 1;
+}
+
+/// Name of the file saving this processor's result for a given precision
+string resultFile(bool single)
+{
+  int MYPE;
+  MPI_Comm_rank(BoutComm::get(), &MYPE);
+
+  char name[64];
+  sprintf(name, "data/result.%s.%d", single ? "float" : "double", MYPE);
+  return string(name);
+}
+
+int physics_init(bool restarting) {
+  bool single = (sizeof(FieldReal) == sizeof(float));
+
+  output.write("\nField3D storage is %s\n", single ? "float" : "double");
+
+  int failures = 0;
+
+  // Set the interior, and put a marker in the X guard cells
+  Field3D f;
+  f = -1.0;
+  for(int jx=mesh->xstart;jx<=mesh->xend;jx++)
+    for(int jy=0;jy<mesh->ngy;jy++)
+      for(int jz=0;jz<mesh->ngz;jz++)
+        f[jx][jy][jz] = profile(jx, jy, jz);
+
+  mesh->communicate(f);
+
+  // Guard cells received from a neighbour must equal the value stored
+  // there, i.e. the profile rounded once to FieldReal
+  BoutReal local = 0.0, diff;
+  for(int jx=0;jx<mesh->ngx;jx++) {
+    if((jx >= mesh->xstart) && (jx <= mesh->xend))
+      continue;
+    if((jx < mesh->xstart) && mesh->firstX())
+      continue;
+    if((jx > mesh->xend) && mesh->lastX())
+      continue;
+    for(int jy=mesh->ystart;jy<=mesh->yend;jy++)
+      for(int jz=0;jz<mesh->ngz-1;jz++) {
+        BoutReal d = fabs(f[jx][jy][jz] - ((FieldReal) profile(jx, jy, jz)));
+        if(d > local)
+          local = d;
+      }
+  }
+  MPI_Allreduce(&local, &diff, 1, MPI_DOUBLE, MPI_MAX, BoutComm::get());
+  failures += check("X guard cells", diff, 0.0);
+
+  // Result to compare between builds
+  Field3D result = DDX(f) + DDY(f) + DDZ(f) + Delp2(f);
+
+  std::vector<BoutReal> data;
+  for(int jx=mesh->xstart;jx<=mesh->xend;jx++)
+    for(int jy=mesh->ystart;jy<=mesh->yend;jy++)
+      for(int jz=0;jz<mesh->ngz-1;jz++)
+        data.push_back(result[jx][jy][jz]);
+
+  FILE *fp = fopen(resultFile(single).c_str(), "wb");
+  if(fp != NULL) {
+    fwrite(&data[0], sizeof(BoutReal), data.size(), fp);
+    fclose(fp);
+  }else
+    output.write("\tCould not save result to %s\n", resultFile(single).c_str());
+
+  // Compare against the other precision, if it has been run
+  int found = 1, allfound;
+  std::vector<BoutReal> other(data.size());
+  fp = fopen(resultFile(!single).c_str(), "rb");
+  if(fp != NULL) {
+    if(fread(&other[0], sizeof(BoutReal), other.size(), fp) != other.size())
+      found = 0;
+    fclose(fp);
+  }else
+    found = 0;
+  MPI_Allreduce(&found, &allfound, 1, MPI_INT, MPI_MIN, BoutComm::get());
+
+  if(allfound) {
+    BoutReal lmax[2] = {0.0, 0.0}, gmax[2];
+    for(size_t i=0;i<data.size();i++) {
+      BoutReal d = fabs(data[i] - other[i]);
+      if(d > lmax[0])
+        lmax[0] = d;
+      if(fabs(other[i]) > lmax[1])
+        lmax[1] = fabs(other[i]);
+    }
+    MPI_Allreduce(lmax, gmax, 2, MPI_DOUBLE, MPI_MAX, BoutComm::get());
+
+    // Each stored value is rounded once, so expect float rounding
+    // error amplified by the derivative stencils
+    output.write("\nComparing with %s storage\n", single ? "double" : "float");
+    failures += check("float - double", gmax[0] / gmax[1], 1e-4);
+  }else
+    output.write("\nNo result from %s storage to compare with\n", single ? "double" : "float");
+
+  if(failures == 0) {
+    output << "\nAll single precision checks passed\n";
+  }else
+    output.write("\n%d single precision checks FAILED\n", failures);
+
+  output << "\nFinished running test. Triggering error to quit\n\n";
+
+  return 1;
+}
+
+int physics_run(BoutReal t) {
+  // Doesn't do anything
+  return 1;
+}
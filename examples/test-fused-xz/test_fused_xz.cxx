@@ -0,0 +1,80 @@
+/*
+ * Fused X-Z derivative test
+ *
+ * D2DXDZ and Delp2_FD compute Z derivatives one X line at a time
+ * rather than forming intermediate fields. Checks that they agree
+ * with the chained operators to rounding error.
+ * 
+ */
+
+#include <bout.hxx>
+#include <boutmain.hxx>
+
+#include <derivs.hxx>
+
+#include <math.h>
+
+/// Largest difference between a and b in the region D2DXDZ and
+/// Delp2_FD calculate, relative to the largest value of b
+BoutReal maxDiff(const Field3D &a, const Field3D &b)
+{
+  BoutReal local[2] = {0.0, 0.0}, global[2];
+  for(int jx=mesh->xstart;jx<=mesh->xend;jx++)
+    for(int jy=mesh->ystart;jy<=mesh->yend;jy++)
+      for(int jz=0;jz<mesh->ngz-1;jz++) {
+        BoutReal d = fabs(a[jx][jy][jz] - b[jx][jy][jz]);
+        if(d > local[0])
+          local[0] = d;
+        if(fabs(b[jx][jy][jz]) > local[1])
+          local[1] = fabs(b[jx][jy][jz]);
+      }
+  MPI_Allreduce(local, global, 2, MPI_DOUBLE, MPI_MAX, BoutComm::get());
+  return global[0] / global[1];
+}
+
+int check(const char *name, BoutReal diff)
+{
+  const BoutReal tol = 1e-10;
+  output.write("\t%-30s : relative difference %e %s\n", 
+               name, diff, (diff < tol) ? "PASS" : "FAIL");
+  return (diff < tol) ? 0 : 1;
+}
+
+int physics_init(bool restarting) {
+  Field3D f;
+  
+  f = 0.0;
+  for(int jx=0;jx<mesh->ngx;jx++)
+    for(int jy=0;jy<mesh->ngy;jy++)
+      for(int jz=0;jz<mesh->ngz;jz++) {
+        BoutReal z = TWOPI*jz/(mesh->ngz-1);
+        f[jx][jy][jz] = sin(0.3*jx + 0.1*jy + z) + cos(0.2*jx - 2.*z)*jx;
+      }
+  
+  output << "\nComparing fused and chained X-Z derivatives\n";
+  
+  int failures = 0;
+  
+  Field3D fused = D2DXDZ(f);
+  Field3D chained = DDX(DDZ(f, true));
+  failures += check("D2DXDZ", maxDiff(fused, chained));
+  
+  fused = Delp2_FD(f);
+  chained = mesh->G1*DDX(f) + mesh->G3*DDZ(f) + mesh->g11*D2DX2(f) 
+    + mesh->g33*D2DZ2(f) + 2.0*mesh->g13*DDX(DDZ(f, true));
+  failures += check("Delp2_FD", maxDiff(fused, chained));
+  
+  if(failures == 0) {
+    output << "\nAll fused derivative checks passed\n";
+  }else
+    output.write("\n%d fused derivative checks FAILED\n", failures);
+  
+  output << "\nFinished running test. Triggering error to quit\n\n";
+  
+  return 1;
+}
+
+int physics_run(BoutReal t) {
+  // Doesn't do anything
+  return 1;
+}
@@ -0,0 +1,13 @@
+#!/bin/bash
+#
+# Run the batched Laplacian test with and without ShiftXderivs.
+# The batched solver is only used on one processor
+
+MPIEXEC=mpirun
+
+make
+
+for SHIFT in false true; do
+    echo "Running with ShiftXderivs = $SHIFT"
+    $MPIEXEC -np 1 ./test_laplace_batch ShiftXderivs=$SHIFT | grep -E "PASS|FAIL"
+done
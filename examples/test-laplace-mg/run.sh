@@ -0,0 +1,12 @@
+#!/bin/bash
+#
+# Run the multigrid test on one processor, then split in X
+
+MPIEXEC=mpirun
+
+make
+
+for NP in 1 2 4; do
+    echo "Running with NXPE = $NP"
+    $MPIEXEC -np $NP ./test_laplace_mg NXPE=$NP | grep -E "PASS|FAIL"
+done
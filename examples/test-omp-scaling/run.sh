@@ -0,0 +1,22 @@
+#!/bin/bash
+#
+# Run the derivative benchmark with increasing numbers of OpenMP threads
+# BOUT++ must be configured with OpenMP enabled (-fopenmp in BOUT_FLAGS)
+
+MPIEXEC=mpirun
+NCORES=`nproc`
+
+make
+
+echo "Running on up to $NCORES threads"
+
+rm -f scaling.log
+THREADS=1
+while [ $THREADS -le $NCORES ]; do
+    OMP_NUM_THREADS=$THREADS $MPIEXEC -np 1 ./test_omp_scaling | grep " threads " >> scaling.log
+    THREADS=$((THREADS*2))
+done
+
+# Speedup relative to one thread
+awk '{ if($2 == 1) t1[$1] = $4;
+       printf("%-6s %3d threads  %10.4e s  speedup %5.2f\n", $1, $2, $4, t1[$1]/$4) }' scaling.log
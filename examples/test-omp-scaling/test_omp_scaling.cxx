@@ -0,0 +1,87 @@
+/*
+ * OpenMP thread scaling benchmark
+ * 
+ * Times the stencil derivative operators (DDX, DDY, DDZ, the
+ * upwind and flux VDD*, FDD* operators and the Arakawa bracket) with
+ * the current number of OpenMP threads. Use run.sh to repeat for
+ * 1, 2, 4, ... threads and print the speedup.
+ *
+ * Options in [scaling]:
+ *   nrepeat  Number of calls to each operator
+ */
+
+#include <bout.hxx>
+#include <boutmain.hxx>
+#include <derivs.hxx>
+#include <difops.hxx>
+
+#include <math.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Time NREPEAT evaluations of EXPR, in seconds per call
+#define TIME_OP(name, expr) {                                   \
+    BoutReal t0 = MPI_Wtime();                                  \
+    for(int rep=0;rep<nrepeat;rep++)                            \
+      result = expr;                                            \
+    BoutReal t = (MPI_Wtime() - t0) / ((BoutReal) nrepeat);     \
+    output.write("%-6s %3d threads  %10.4e s\n", name, nthreads, t); \
+  }
+
+int physics_init(bool restarting)
+{
+  Options *options = Options::getRoot()->getSection("scaling");
+  int nrepeat;
+  OPTION(options, nrepeat, 100);
+  
+  int nthreads = 1;
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  
+  // Smooth periodic test functions
+  Field3D f, v, result;
+  f.allocate();
+  v.allocate();
+  FieldReal ***fd = f.getData();
+  FieldReal ***vd = v.getData();
+  int ncz = mesh->ngz-1;
+  for(int jx=0;jx<mesh->ngx;jx++)
+    for(int jy=0;jy<mesh->ngy;jy++)
+      for(int jz=0;jz<mesh->ngz;jz++) {
+        BoutReal z = 2.*PI*((BoutReal) jz) / ((BoutReal) ncz);
+        fd[jx][jy][jz] = sin(z + 0.1*jx) * cos(0.2*jy);
+        vd[jx][jy][jz] = cos(z) + 0.01*jx;
+      }
+  Field2D v2d;
+  v2d.allocate();
+  for(int jx=0;jx<mesh->ngx;jx++)
+    for(int jy=0;jy<mesh->ngy;jy++)
+      v2d[jx][jy] = 0.01*jx*jx;
+  
+  output.write("\nGrid %d x %d x %d, %d repeats\n\n", mesh->ngx, mesh->ngy, ncz, nrepeat);
+  
+  TIME_OP("DDX",  DDX(f));
+  TIME_OP("DDY",  DDY(f));
+  TIME_OP("DDZ",  DDZ(f, DIFF_C4));
+  TIME_OP("VDDX", VDDX(v, f));
+  TIME_OP("VDDY", VDDY(v, f));
+  TIME_OP("VDDZ", VDDZ(v, f));
+  TIME_OP("FDDX", FDDX(v, f));
+  TIME_OP("FDDY", FDDY(v, f));
+  TIME_OP("FDDZ", FDDZ(v, f));
+  TIME_OP("ARAK", bracket(v, f, BRACKET_ARAKAWA));
+  TIME_OP("ARAK2D", bracket(v2d, f, BRACKET_ARAKAWA));
+  
+  output << "\nFinished benchmark. Triggering error to quit\n\n";
+  
+  return 1;
+}
+
+int physics_run(BoutReal t)
+{
+  // Doesn't do anything
+  return 1;
+}
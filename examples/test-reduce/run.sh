@@ -0,0 +1,12 @@
+#!/bin/bash
+#
+# Run the reduction test on several processors
+
+MPIEXEC=mpirun
+
+make
+
+for NP in 1 2 4; do
+    echo "Running on $NP processors"
+    $MPIEXEC -np $NP ./test_reduce | grep -E "PASS|FAIL"
+done
@@ -0,0 +1,95 @@
+/*
+ * Fused reduction test
+ *
+ * A Reduction packs all its values into one buffer and combines them
+ * with a single collective. With enough values MPI may split the
+ * reduction of a buffer into pieces, so this adds many reductions and
+ * checks each against an MPI_Allreduce of the local values.
+ * 
+ */
+
+#include <bout.hxx>
+#include <boutmain.hxx>
+
+#include <reduce.hxx>
+
+#include <math.h>
+
+int physics_init(bool restarting) {
+  int nreduce;
+  Options *options = Options::getRoot()->getSection("reduce");
+  OPTION(options, nreduce, 100000);
+  
+  int MYPE;
+  MPI_Comm_rank(BoutComm::get(), &MYPE);
+  
+  // Fields with different values on each processor
+  const int nfields = 4;
+  Field3D f[nfields];
+  for(int i=0;i<nfields;i++) {
+    f[i] = 0.0;
+    for(int jx=0;jx<mesh->ngx;jx++)
+      for(int jy=0;jy<mesh->ngy;jy++)
+        for(int jz=0;jz<mesh->ngz;jz++)
+          f[i][jx][jy][jz] = sin(0.1*jx + 0.3*jy + jz + i + 1.7*MYPE);
+  }
+  
+  output << "\nTesting fused reductions\n";
+  output.write("\t%d reductions\n", nreduce);
+  
+  // Interleave the types, so max and sum values alternate in the buffer
+  Reduction global, local(false);
+  for(int i=0;i<nreduce;i++) {
+    const Field3D &fi = f[i % nfields];
+    switch((i / nfields) % 4) {
+    case 0: global.min(fi); local.min(fi); break;
+    case 1: global.max(fi); local.max(fi); break;
+    case 2: global.sum(fi); local.sum(fi); break;
+    case 3: global.norm(fi); local.norm(fi); break;
+    }
+  }
+  global.run();
+  local.run();
+  
+  // Reference values from plain collectives
+  vector<BoutReal> lmin, lmax, lsum;
+  for(int i=0;i<nreduce;i++) {
+    switch((i / nfields) % 4) {
+    case 0: lmin.push_back(local[i]); break;
+    case 1: lmax.push_back(local[i]); break;
+    case 2: lsum.push_back(local[i]); break;
+    case 3: lsum.push_back(local[i]*local[i]); break;
+    }
+  }
+  vector<BoutReal> gmin(lmin.size()), gmax(lmax.size()), gsum(lsum.size());
+  MPI_Allreduce(&lmin[0], &gmin[0], lmin.size(), MPI_DOUBLE, MPI_MIN, BoutComm::get());
+  MPI_Allreduce(&lmax[0], &gmax[0], lmax.size(), MPI_DOUBLE, MPI_MAX, BoutComm::get());
+  MPI_Allreduce(&lsum[0], &gsum[0], lsum.size(), MPI_DOUBLE, MPI_SUM, BoutComm::get());
+  
+  int nwrong = 0;
+  int imin = 0, imax = 0, isum = 0;
+  for(int i=0;i<nreduce;i++) {
+    BoutReal expect = 0.;
+    switch((i / nfields) % 4) {
+    case 0: expect = gmin[imin++]; break;
+    case 1: expect = gmax[imax++]; break;
+    case 2: expect = gsum[isum++]; break;
+    case 3: expect = sqrt(gsum[isum++]); break;
+    }
+    // Sums may be added in a different order
+    if(fabs(global[i] - expect) > 1e-10*(1. + fabs(expect)))
+      nwrong++;
+  }
+  
+  output.write("\t%-30s : %d of %d wrong %s\n", "Reduction vs MPI_Allreduce", 
+               nwrong, nreduce, (nwrong == 0) ? "PASS" : "FAIL");
+  
+  output << "\nFinished running test. Triggering error to quit\n\n";
+  
+  return 1;
+}
+
+int physics_run(BoutReal t) {
+  // Doesn't do anything
+  return 1;
+}
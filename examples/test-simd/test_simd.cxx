@@ -0,0 +1,150 @@
+/*
+ * Microbenchmark for the vectorised elementwise kernels
+ *
+ * Compares the simd_* kernels against the triple loops over
+ * BoutReal*** arrays which Field3D operators used previously,
+ * and checks that the results agree.
+ *
+ * Usage: ./test_simd [nx ny nz [repeats]]
+ *
+ * Doesn't need a grid or options file. Set OMP_NUM_THREADS to
+ * control the number of threads.
+ */
+
+#include <simd.hxx>
+#include <utils.hxx>
+
+#include "mpi.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+int nx = 68, ny = 64, nz = 65;
+int repeats = 50;
+
+BoutReal ***a, ***b, ***r, ***ref;
+
+/// Largest relative difference between r and ref
+BoutReal maxdiff() {
+  BoutReal m = 0.;
+  for(int i=0;i<nx*ny*nz;i++) {
+    BoutReal d = fabs(r[0][0][i] - ref[0][0][i]) / (fabs(ref[0][0][i]) + 1e-300);
+    if(d > m)
+      m = d;
+  }
+  return m;
+}
+
+/// Time a triple loop applying the expression to each element
+#define LOOP_TIME(time, expr) {                     \
+    time = MPI_Wtime();                             \
+    for(int rep=0;rep<repeats;rep++) {              \
+      _Pragma("omp parallel for")                   \
+      for(int jx=0;jx<nx;jx++)                      \
+        for(int jy=0;jy<ny;jy++)                    \
+          for(int jz=0;jz<nz;jz++)                  \
+            ref[jx][jy][jz] = expr;                 \
+    }                                               \
+    time = (MPI_Wtime() - time)/repeats; }
+
+/// Time a kernel call
+#define SIMD_TIME(time, call) {                     \
+    time = MPI_Wtime();                             \
+    for(int rep=0;rep<repeats;rep++)                \
+      call;                                         \
+    time = (MPI_Wtime() - time)/repeats; }
+
+void report(const char *name, BoutReal tloop, BoutReal tsimd) {
+  printf("%-10s %12.3e %12.3e %8.2f %12.3e\n", name, tloop, tsimd, tloop/tsimd, maxdiff());
+}
+
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+
+  if(argc >= 4) {
+    nx = atoi(argv[1]);
+    ny = atoi(argv[2]);
+    nz = atoi(argv[3]);
+  }
+  if(argc >= 5)
+    repeats = atoi(argv[4]);
+
+  int n = nx*ny*nz;
+  
+  a = r3tensor(nx, ny, nz);
+  b = r3tensor(nx, ny, nz);
+  ref = r3tensor(nx, ny, nz);
+  r = r3view(aligned_rvector(n), nx, ny, nz);
+  
+  BoutReal *ra = aligned_rvector(n);
+  BoutReal *rb = aligned_rvector(n);
+  BoutReal *rr = r[0][0];
+  
+  srand(1);
+  for(int i=0;i<n;i++) {
+    ra[i] = a[0][0][i] = 0.1 + 10.*((BoutReal) rand()) / RAND_MAX;
+    rb[i] = b[0][0][i] = -2. + 4.*((BoutReal) rand()) / RAND_MAX;
+  }
+  
+  printf("Grid %d x %d x %d, instruction set %s (%d doubles per vector)\n\n",
+         nx, ny, nz, simd_name(), simd_width());
+  printf("%-10s %12s %12s %8s %12s\n", "Operation", "Loop (s)", "SIMD (s)", "Speedup", "Max rel err");
+
+  BoutReal tl, ts;
+  
+  LOOP_TIME(tl, a[jx][jy][jz] + b[jx][jy][jz]);
+  SIMD_TIME(ts, simd_add(rr, ra, rb, n));
+  report("a + b", tl, ts);
+
+  LOOP_TIME(tl, a[jx][jy][jz] * b[jx][jy][jz]);
+  SIMD_TIME(ts, simd_mul(rr, ra, rb, n));
+  report("a * b", tl, ts);
+
+  LOOP_TIME(tl, a[jx][jy][jz] / b[jx][jy][jz]);
+  SIMD_TIME(ts, simd_div(rr, ra, rb, n));
+  report("a / b", tl, ts);
+
+  LOOP_TIME(tl, a[jx][jy][jz] * 3.0);
+  SIMD_TIME(ts, simd_mul(rr, ra, 3.0, n));
+  report("a * 3", tl, ts);
+
+  LOOP_TIME(tl, sqrt(a[jx][jy][jz]));
+  SIMD_TIME(ts, simd_sqrt(rr, ra, n));
+  report("sqrt(a)", tl, ts);
+
+  LOOP_TIME(tl, fabs(b[jx][jy][jz]));
+  SIMD_TIME(ts, simd_abs(rr, rb, n));
+  report("abs(b)", tl, ts);
+
+  LOOP_TIME(tl, exp(b[jx][jy][jz]));
+  SIMD_TIME(ts, simd_exp(rr, rb, n));
+  report("exp(b)", tl, ts);
+
+  LOOP_TIME(tl, log(a[jx][jy][jz]));
+  SIMD_TIME(ts, simd_log(rr, ra, n));
+  report("log(a)", tl, ts);
+
+  LOOP_TIME(tl, sin(b[jx][jy][jz]));
+  SIMD_TIME(ts, simd_sin(rr, rb, n));
+  report("sin(b)", tl, ts);
+
+  LOOP_TIME(tl, pow(a[jx][jy][jz], b[jx][jy][jz]));
+  SIMD_TIME(ts, simd_pow(rr, ra, rb, n));
+  report("a ^ b", tl, ts);
+
+  LOOP_TIME(tl, pow(a[jx][jy][jz], 1.5));
+  SIMD_TIME(ts, simd_pow(rr, ra, 1.5, n));
+  report("a ^ 1.5", tl, ts);
+  
+  free_r3tensor(a);
+  free_r3tensor(b);
+  free_r3tensor(ref);
+  free_r3view(r);
+  free_aligned_rvector(rr);
+  free_aligned_rvector(ra);
+  free_aligned_rvector(rb);
+
+  MPI_Finalize();
+  return 0;
+}
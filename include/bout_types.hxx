@@ -30,13 +30,31 @@ using std::vector;
 
 typedef double BoutReal;
 
+/// Storage type for Field3D data. With -DBOUT_FIELD_FLOAT fields are
+/// stored and communicated in single precision, but all arithmetic is
+/// done in BoutReal
+#ifdef BOUT_FIELD_FLOAT
+typedef float FieldReal;
+#else
+typedef BoutReal FieldReal;
+#endif
+
+#if __cplusplus >= 201103L
+/// Compiler supports rvalue references: enable move semantics
+#define BOUT_HAS_RVALUE_REFS
+/// Ref-qualifier for member operators which have an rvalue (&&) overload
+#define BOUT_LVALUE_THIS &
+#else
+#define BOUT_LVALUE_THIS
+#endif
+
 typedef vector<BoutReal> rvec;  // Vector of BoutReals
 
 /// 4 possible variable locations. Default is for passing to functions
 enum CELL_LOC {CELL_DEFAULT, CELL_CENTRE, CELL_XLOW, CELL_YLOW, CELL_ZLOW, CELL_VSHIFT};
 
 /// Differential methods. Both central and upwind
-enum DIFF_METHOD {DIFF_DEFAULT, DIFF_U1, DIFF_C2, DIFF_W2, DIFF_W3, DIFF_C4, DIFF_U4, DIFF_FFT, DIFF_SPLIT, DIFF_NND};
+enum DIFF_METHOD {DIFF_DEFAULT, DIFF_U1, DIFF_C2, DIFF_W2, DIFF_W3, DIFF_C4, DIFF_U4, DIFF_FFT, DIFF_SPLIT, DIFF_NND, DIFF_P4, DIFF_P6};
 
 /// Specify grid region for looping
 enum REGION {RGN_ALL, RGN_NOBNDRY, RGN_NOX, RGN_NOY, RGN_NOZ};
@@ -48,6 +48,7 @@ class BoutMesh : public Mesh {
   int sendXIn(BoutReal *buffer, int size, int tag);
   comm_handle irecvXOut(BoutReal *buffer, int size, int tag);
   comm_handle irecvXIn(BoutReal *buffer, int size, int tag);
+  MPI_Comm getXcomm() {return comm_x;}
   
   /////////////////////////////////////////////
   // Y-Z communications
@@ -138,9 +139,9 @@ class BoutMesh : public Mesh {
     MPI_Request request[6];
     /// Array of send requests (for non-blocking send)
     MPI_Request sendreq[6];
-    int xbufflen, ybufflen;  ///< Length of the buffers used to send/receive (in BoutReals)
-    BoutReal *umsg_sendbuff, *dmsg_sendbuff, *imsg_sendbuff, *omsg_sendbuff;
-    BoutReal *umsg_recvbuff, *dmsg_recvbuff, *imsg_recvbuff, *omsg_recvbuff;
+    int xbufflen, ybufflen;  ///< Length of the buffers used to send/receive (in bytes)
+    char *umsg_sendbuff, *dmsg_sendbuff, *imsg_sendbuff, *omsg_sendbuff;
+    char *umsg_recvbuff, *dmsg_recvbuff, *imsg_recvbuff, *omsg_recvbuff;
     bool in_progress;
     
     /// List of fields being communicated
@@ -155,6 +156,7 @@ class BoutMesh : public Mesh {
   // Surface communications
   
   MPI_Comm comm_inner, comm_middle, comm_outer;
+  MPI_Comm comm_x; ///< All processors with the same PE_YIND, ordered by PE_XIND
   
   //////////////////////////////////////////////////
   // Data reading
@@ -162,10 +164,10 @@ class BoutMesh : public Mesh {
   /// Read in a portion of the X-Y domain
   int readgrid_3dvar(GridDataSource *s, const char *name, 
 	             int yread, int ydest, int ysize, 
-                     int xge, int xlt, BoutReal ***var);
+                     int xge, int xlt, FieldReal ***var);
   
   /// Copy a section of a 3D variable
-  void cpy_3d_data(int yfrom, int yto, int xge, int xlt, BoutReal ***var);
+  void cpy_3d_data(int yfrom, int yto, int xge, int xlt, FieldReal ***var);
 
   int readgrid_2dvar(GridDataSource *s, const char *varname, 
                      int yread, int ydest, int ysize, 
@@ -177,11 +179,11 @@ class BoutMesh : public Mesh {
   
   void post_receive(CommHandle &ch);
 
-  /// Take data from objects and put into a buffer
-  int pack_data(vector<FieldData*> &var_list, int xge, int xlt, int yge, int ylt, BoutReal *buffer);
-  /// Copy data from a buffer back into the fields
-  int unpack_data(vector<FieldData*> &var_list, int xge, int xlt, int yge, int ylt, BoutReal *buffer);
-  /// Calculates the size of a message for a given x and y range
+  /// Take data from objects and put into a buffer. Returns the number of bytes packed
+  int pack_data(vector<FieldData*> &var_list, int xge, int xlt, int yge, int ylt, char *buffer);
+  /// Copy data from a buffer back into the fields. Returns the number of bytes used
+  int unpack_data(vector<FieldData*> &var_list, int xge, int xlt, int yge, int ylt, char *buffer);
+  /// Calculates the size of a message (in bytes) for a given x and y range
   int msg_len(vector<FieldData*> &var_list, int xge, int xlt, int yge, int ylt);
 };
 
@@ -0,0 +1,65 @@
+/*!************************************************************************
+ * Cache of derivative results within one RHS evaluation
+ *
+ * Physics modules often take the same derivative of an unchanged field
+ * several times in one RHS call. With the root option
+ *
+ *   deriv_cache = true
+ *
+ * DDX, DDY, DDZ, Grad_par and Delp2 of a Field3D remember their results,
+ * keyed on the input's version(), method and cell locations, and return
+ * the stored result when called again. The cache keeps a copy of each
+ * input, so modifying the input gives it a new version. The solver
+ * clears the cache before and after each RHS evaluation.
+ *
+ * Changes made through pointers obtained before a derivative was taken
+ * (getData(), getRaw(), operator[](bindex)) can't be detected, which is
+ * why the cache is off by default.
+ *
+ **************************************************************************
+ * Copyright 2010 B.D.Dudson, S.Farley, M.V.Umansky, X.Q.Xu
+ *
+ * Contact: Ben Dudson, bd512@york.ac.uk
+ *
+ * This file is part of BOUT++.
+ *
+ * BOUT++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BOUT++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BOUT++.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **************************************************************************/
+
+#ifndef __DERIV_CACHE_H__
+#define __DERIV_CACHE_H__
+
+#include "bout_types.hxx"
+#include "field3d.hxx"
+
+/// Operators which can be cached
+enum DerivCacheOp {DCACHE_DDX, DCACHE_DDY, DCACHE_DDZ, DCACHE_GRAD_PAR, DCACHE_DELP2};
+
+/// Read the deriv_cache option
+void deriv_cache_init();
+
+/// Look up a result. Returns false if not cached or the cache is disabled.
+/// method and param are any other arguments which change the result
+bool deriv_cache_get(DerivCacheOp op, const Field3D &f, CELL_LOC outloc,
+                     int method, BoutReal param, Field3D &result);
+
+/// Store a result
+void deriv_cache_put(DerivCacheOp op, const Field3D &f, CELL_LOC outloc,
+                     int method, BoutReal param, const Field3D &result);
+
+/// Remove all results. Must be called outside parallel regions
+void deriv_cache_clear();
+
+#endif // __DERIV_CACHE_H__
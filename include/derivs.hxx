@@ -37,20 +37,20 @@ int derivs_init();
 
 ////////// FIRST DERIVATIVES //////////
 
-const Field3D DDX(const Field3D &f, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
-const Field3D DDX(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc);
-const Field3D DDX(const Field3D &f, DIFF_METHOD method);
+Field3D DDX(const Field3D &f, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
+Field3D DDX(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc);
+Field3D DDX(const Field3D &f, DIFF_METHOD method);
 const Field2D DDX(const Field2D &f);
 
-const Field3D DDY(const Field3D &f, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
-const Field3D DDY(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc);
-const Field3D DDY(const Field3D &f, DIFF_METHOD method);
+Field3D DDY(const Field3D &f, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
+Field3D DDY(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc);
+Field3D DDY(const Field3D &f, DIFF_METHOD method);
 const Field2D DDY(const Field2D &f);
 
-const Field3D DDZ(const Field3D &f, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT, bool inc_xbndry = false);
-const Field3D DDZ(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc, bool inc_xbndry=false);
-const Field3D DDZ(const Field3D &f, DIFF_METHOD method, bool inc_xbndry = false);
-const Field3D DDZ(const Field3D &f, bool inc_xbndry);
+Field3D DDZ(const Field3D &f, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT, bool inc_xbndry = false);
+Field3D DDZ(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc, bool inc_xbndry=false);
+Field3D DDZ(const Field3D &f, DIFF_METHOD method, bool inc_xbndry = false);
+Field3D DDZ(const Field3D &f, bool inc_xbndry);
 const Field2D DDZ(const Field2D &f);
 
 const Vector3D DDZ(const Vector3D &v, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
@@ -59,21 +59,26 @@ const Vector2D DDZ(const Vector2D &v);
 
 ////////// SECOND DERIVATIVES //////////
 
-const Field3D D2DX2(const Field3D &f, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
-const Field3D D2DX2(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
+Field3D D2DX2(const Field3D &f, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
+Field3D D2DX2(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
 const Field2D D2DX2(const Field2D &f);
 
-const Field3D D2DY2(const Field3D &f, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
-const Field3D D2DY2(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
+Field3D D2DY2(const Field3D &f, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
+Field3D D2DY2(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
 const Field2D D2DY2(const Field2D &f);
 
-const Field3D D2DZ2(const Field3D &f, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
-const Field3D D2DZ2(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
+Field3D D2DZ2(const Field3D &f, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
+Field3D D2DZ2(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
 const Field2D D2DZ2(const Field2D &f);
 
 /////////// MIXED DERIVATIVES //////////
 
-const Field3D D2DXDZ(const Field3D &f);
+Field3D D2DXDZ(const Field3D &f);
+
+/// G1*DDX + G3*DDZ + g11*D2DX2 + g33*D2DZ2 + 2*g13*D2DXDZ with the default
+/// methods. Done in one sweep unless a method is FFT, X derivatives are
+/// shifted, or f is staggered
+Field3D Delp2_FD(const Field3D &f);
 
 ///////// UPWINDING METHODS /////////////
 // For terms of form v * grad(f)
@@ -81,22 +86,22 @@ const Field3D D2DXDZ(const Field3D &f);
 const Field2D VDDX(const Field2D &v, const Field2D &f, CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
 const Field2D VDDX(const Field2D &v, const Field2D &f, DIFF_METHOD method);
 
-const Field3D VDDX(const Field &v, const Field &f, 
+Field3D VDDX(const Field &v, const Field &f, 
 		   CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
-const Field3D VDDX(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
+Field3D VDDX(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
 
 const Field2D VDDY(const Field2D &v, const Field2D &f,
 		   CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
 const Field2D VDDY(const Field2D &v, const Field2D &f, DIFF_METHOD method);
-const Field3D VDDY(const Field &v, const Field &f, 
+Field3D VDDY(const Field &v, const Field &f, 
 		   CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
-const Field3D VDDY(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
+Field3D VDDY(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
 
 const Field2D VDDZ(const Field2D &v, const Field2D &f);
 const Field2D VDDZ(const Field3D &v, const Field2D &f);
-const Field3D VDDZ(const Field &v, const Field &f, 
+Field3D VDDZ(const Field &v, const Field &f, 
 		   CELL_LOC outloc = CELL_DEFAULT, DIFF_METHOD method = DIFF_DEFAULT);
-const Field3D VDDZ(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
+Field3D VDDZ(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
 
 ///////// FLUX METHODS /////////////
 // for terms of form div(v * f)
@@ -105,24 +110,24 @@ const Field2D FDDX(const Field2D &v, const Field2D &f);
 const Field2D FDDX(const Field2D &v, const Field2D &f, CELL_LOC outloc, DIFF_METHOD method = DIFF_DEFAULT);
 const Field2D FDDX(const Field2D &v, const Field2D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
 
-const Field3D FDDX(const Field3D &v, const Field3D &f);
-const Field3D FDDX(const Field3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method = DIFF_DEFAULT);
-const Field3D FDDX(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
+Field3D FDDX(const Field3D &v, const Field3D &f);
+Field3D FDDX(const Field3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method = DIFF_DEFAULT);
+Field3D FDDX(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
 
 const Field2D FDDY(const Field2D &v, const Field2D &f);
 const Field2D FDDY(const Field2D &v, const Field2D &f, CELL_LOC outloc, DIFF_METHOD method = DIFF_DEFAULT);
 const Field2D FDDY(const Field2D &v, const Field2D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
 
-const Field3D FDDY(const Field3D &v, const Field3D &f);
-const Field3D FDDY(const Field3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method = DIFF_DEFAULT);
-const Field3D FDDY(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
+Field3D FDDY(const Field3D &v, const Field3D &f);
+Field3D FDDY(const Field3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method = DIFF_DEFAULT);
+Field3D FDDY(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
 
 const Field2D FDDZ(const Field2D &v, const Field2D &f);
 const Field2D FDDZ(const Field2D &v, const Field2D &f, CELL_LOC outloc, DIFF_METHOD method = DIFF_DEFAULT);
 const Field2D FDDZ(const Field2D &v, const Field2D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
 
-const Field3D FDDZ(const Field3D &v, const Field3D &f);
-const Field3D FDDZ(const Field3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method = DIFF_DEFAULT);
-const Field3D FDDZ(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
+Field3D FDDZ(const Field3D &v, const Field3D &f);
+Field3D FDDZ(const Field3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method = DIFF_DEFAULT);
+Field3D FDDZ(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
 
 #endif // __DERIVS_H__
@@ -44,64 +44,65 @@
 const Field2D Grad_par(const Field2D &var, CELL_LOC outloc=CELL_DEFAULT, DIFF_METHOD method=DIFF_DEFAULT);
 const Field2D Grad_par(const Field2D &var, DIFF_METHOD method, CELL_LOC outloc=CELL_DEFAULT);
 
-const Field3D Grad_par(const Field3D &var, CELL_LOC outloc=CELL_DEFAULT, DIFF_METHOD method=DIFF_DEFAULT);
-const Field3D Grad_par(const Field3D &var, DIFF_METHOD method, CELL_LOC outloc=CELL_DEFAULT);
+Field3D Grad_par(const Field3D &var, CELL_LOC outloc=CELL_DEFAULT, DIFF_METHOD method=DIFF_DEFAULT);
+Field3D Grad_par(const Field3D &var, DIFF_METHOD method, CELL_LOC outloc=CELL_DEFAULT);
 
 // vpar times parallel derivative (upwinding)
 const Field2D Vpar_Grad_par(const Field2D &v, const Field2D &f);
-const Field3D Vpar_Grad_par(const Field &v, const Field &f, 
+Field3D Vpar_Grad_par(const Field &v, const Field &f, 
 			    CELL_LOC outloc=CELL_DEFAULT, DIFF_METHOD method=DIFF_DEFAULT);
-const Field3D Vpar_Grad_par(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc=CELL_DEFAULT);
+Field3D Vpar_Grad_par(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc=CELL_DEFAULT);
 
 
 // parallel divergence operator B \partial_{||} (F/B)
 const Field2D Div_par(const Field2D &f);
-const Field3D Div_par(const Field3D &f, 
+Field3D Div_par(const Field3D &f, 
 		      CELL_LOC outloc=CELL_DEFAULT, DIFF_METHOD method=DIFF_DEFAULT);
-const Field3D Div_par(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
+Field3D Div_par(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc = CELL_DEFAULT);
 
 // second parallel derivative
 const Field2D Grad2_par2(const Field2D &f);
-const Field3D Grad2_par2(const Field3D &f);
+Field3D Grad2_par2(const Field3D &f);
 
 // Parallel derivatives, converting between cell-centred and lower cell boundary
-const Field3D Grad_par_CtoL(const Field3D &var);
-const Field3D Vpar_Grad_par_LCtoC(const Field &v, const Field &f);
-const Field3D Grad_par_LtoC(const Field &var);
-const Field3D Div_par_LtoC(const Field2D &var);
-const Field3D Div_par_LtoC(const Field3D &var);
-const Field3D Div_par_CtoL(const Field2D &var);
-const Field3D Div_par_CtoL(const Field3D &var);
+Field3D Grad_par_CtoL(const Field3D &var);
+Field3D Vpar_Grad_par_LCtoC(const Field &v, const Field &f);
+Field3D Grad_par_LtoC(const Field &var);
+Field3D Div_par_LtoC(const Field2D &var);
+Field3D Div_par_LtoC(const Field3D &var);
+Field3D Div_par_CtoL(const Field2D &var);
+Field3D Div_par_CtoL(const Field3D &var);
 
 // Parallel divergence of diffusive flux, K*Grad_par
 const Field2D Div_par_K_Grad_par(Field2D &kY, Field2D &f);
-const Field3D Div_par_K_Grad_par(Field2D &kY, Field3D &f);
-const Field3D Div_par_K_Grad_par(Field3D &kY, Field2D &f);
-const Field3D Div_par_K_Grad_par(Field3D &kY, Field3D &f);
+Field3D Div_par_K_Grad_par(Field2D &kY, Field3D &f);
+Field3D Div_par_K_Grad_par(Field3D &kY, Field2D &f);
+Field3D Div_par_K_Grad_par(Field3D &kY, Field3D &f);
 
 // Divergence of perpendicular diffusive flux kperp*Grad_perp
-const Field3D Div_K_perp_Grad_perp(const Field2D &kperp, const Field3D &f);
+Field3D Div_K_perp_Grad_perp(const Field2D &kperp, const Field3D &f);
 
-// perpendicular Laplacian operator
+// perpendicular Laplacian operator. The Field3D version uses FFTs in Z
+// unless useFFT is false, when it uses finite differences (Delp2_FD)
 const Field2D Delp2(const Field2D &f);
-const Field3D Delp2(const Field3D &f, BoutReal zsmooth=0.4);
+Field3D Delp2(const Field3D &f, BoutReal zsmooth=0.4, bool useFFT=true);
 const FieldPerp Delp2(const FieldPerp &f, BoutReal zsmooth=0.4);
 
 // Full Laplacian operator
 const Field2D Laplacian(const Field2D &f);
-const Field3D Laplacian(const Field3D &f);
+Field3D Laplacian(const Field3D &f);
 
 // Terms of form b0 x Grad(phi) dot Grad(A)
 const Field2D b0xGrad_dot_Grad(const Field2D &phi, const Field2D &A);
-const Field3D b0xGrad_dot_Grad(const Field3D &phi, const Field2D &A, CELL_LOC outloc=CELL_DEFAULT);
-const Field3D b0xGrad_dot_Grad(const Field2D &phi, const Field3D &A);
-const Field3D b0xGrad_dot_Grad(const Field3D &phi, const Field3D &A, CELL_LOC outloc=CELL_DEFAULT);
+Field3D b0xGrad_dot_Grad(const Field3D &phi, const Field2D &A, CELL_LOC outloc=CELL_DEFAULT);
+Field3D b0xGrad_dot_Grad(const Field2D &phi, const Field3D &A);
+Field3D b0xGrad_dot_Grad(const Field3D &phi, const Field3D &A, CELL_LOC outloc=CELL_DEFAULT);
 
 // Poisson bracket methods
 enum BRACKET_METHOD {BRACKET_STD=0, BRACKET_SIMPLE=1, BRACKET_ARAKAWA=2};
 const Field2D bracket(const Field2D &f, const Field2D &g, BRACKET_METHOD method = BRACKET_STD);
-const Field3D bracket(const Field2D &f, const Field3D &g, BRACKET_METHOD method = BRACKET_STD);
-const Field3D bracket(const Field3D &f, const Field2D &g, BRACKET_METHOD method = BRACKET_STD);
-const Field3D bracket(const Field3D &f, const Field3D &g, BRACKET_METHOD method = BRACKET_STD);
+Field3D bracket(const Field2D &f, const Field3D &g, BRACKET_METHOD method = BRACKET_STD);
+Field3D bracket(const Field3D &f, const Field2D &g, BRACKET_METHOD method = BRACKET_STD);
+Field3D bracket(const Field3D &f, const Field3D &g, BRACKET_METHOD method = BRACKET_STD);
 
 #endif /* __DIFOPS_H__ */
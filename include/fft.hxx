@@ -28,6 +28,12 @@
 
 #include "dcomplex.hxx"
 
+/// Read the [fft] options, and import FFTW wisdom if wisdom_file is set.
+/// Collective: must be called on all processors
+void fft_init();
+/// Write FFTW wisdom from processor 0 if new plans were measured, and free plans
+void fft_cleanup();
+
 void cfft(dcomplex *cv, int length, int isign);
 void ZFFT(dcomplex *cv, BoutReal zoffset, int isign, bool shift = true);
 
@@ -39,4 +45,38 @@ void irfft(dcomplex *in, int length, BoutReal *out);
 void ZFFT(BoutReal *in, BoutReal zoffset, dcomplex *cv, bool shift = true);
 void ZFFT_rev(dcomplex *cv, BoutReal zoffset, BoutReal *out, bool shift = true);
 
+// As above, shifting by mesh->zShift[jx][jy] using the cached phases
+void ZFFT(BoutReal *in, int jx, int jy, dcomplex *cv, bool shift = true);
+void ZFFT_rev(dcomplex *cv, int jx, int jy, BoutReal *out, bool shift = true);
+
+// Phase factors exp(-i k zShift) for k = 0 .. (ngz-1)/2, which shift a
+// spectrum into BoutReal space (conjugate to shift back). Cached for each
+// (jx,jy), and only recomputed when the mesh size or zShift changes
+const dcomplex* zshift_phase(int jx, int jy);
+/// Phases for all points, starting at (jx*ngy + jy)*((ngz-1)/2 + 1).
+/// Checks every point, so call outside parallel regions
+const dcomplex* zshift_phases();
+
+// Batched transforms of howmany lines of the same length, with line i
+// starting at i*dist. The spectrum of each line is (length/2 + 1) values,
+// stored one line after another. Normalised the same as rfft/irfft.
+// Plans are cached. Outside a parallel region the lines are split between
+// OpenMP threads or, if there are too few of them and FFTW was built with
+// threads (-DFFTW_OMP, option fft/fft_threads), each transform is threaded
+
+void rfft_many(const BoutReal *in, int length, int howmany, int dist, dcomplex *out);
+void irfft_many(dcomplex *in, int length, int howmany, BoutReal *out, int dist); ///< Overwrites in
+
+#ifdef BOUT_FIELD_FLOAT
+// Single precision Field3D data
+void rfft(float *in, int length, dcomplex *out);
+void irfft(dcomplex *in, int length, float *out);
+void ZFFT(float *in, BoutReal zoffset, dcomplex *cv, bool shift = true);
+void ZFFT_rev(dcomplex *cv, BoutReal zoffset, float *out, bool shift = true);
+void ZFFT(float *in, int jx, int jy, dcomplex *cv, bool shift = true);
+void ZFFT_rev(dcomplex *cv, int jx, int jy, float *out, bool shift = true);
+void rfft_many(const float *in, int length, int howmany, int dist, dcomplex *out);
+void irfft_many(dcomplex *in, int length, int howmany, float *out, int dist);
+#endif
+
 #endif // __FFT_H__
@@ -25,6 +25,7 @@
  * 
  */
 class Field2D;
+template<typename E> class FieldExpr;
 
 #ifndef __FIELD2D_H__
 #define __FIELD2D_H__
@@ -63,6 +64,7 @@ class Field2D : public Field, public FieldData {
 
   Field2D & operator=(const Field2D &rhs);
   Field2D & operator=(const BoutReal rhs);
+  template<typename E> Field2D & operator=(const FieldExpr<E> &e); ///< See field_expr.hxx
 
   BoutReal* operator[](int jx) const;
 
@@ -93,11 +95,19 @@ class Field2D : public Field, public FieldData {
 
   // Left binary operators
 
-  const Field3D operator+(const Field3D &other) const;
-  const Field3D operator-(const Field3D &other) const;
-  const Field3D operator*(const Field3D &other) const;
-  const Field3D operator/(const Field3D &other) const;
-  const Field3D operator^(const Field3D &other) const;
+  Field3D operator+(const Field3D &other) const;
+  Field3D operator-(const Field3D &other) const;
+  Field3D operator*(const Field3D &other) const;
+  Field3D operator/(const Field3D &other) const;
+  Field3D operator^(const Field3D &other) const;
+#ifdef BOUT_HAS_RVALUE_REFS
+  // Temporary Field3D operands are reused for the result
+  Field3D operator+(Field3D &&other) const;
+  Field3D operator-(Field3D &&other) const;
+  Field3D operator*(Field3D &&other) const;
+  Field3D operator/(Field3D &&other) const;
+  Field3D operator^(Field3D &&other) const;
+#endif
 
   const FieldPerp operator+(const FieldPerp &other) const;
   const FieldPerp operator-(const FieldPerp &other) const;
@@ -169,6 +179,7 @@ class Field2D : public Field, public FieldData {
 #endif
   
   friend class Vector2D;
+  friend class FieldExprF2D;
   
   void applyBoundary();
   void applyBoundary(const string &condition);
@@ -183,6 +194,10 @@ class Field2D : public Field, public FieldData {
 
   void allocData();
   void freeData();
+
+  /// Sets result = this op f for op one of '-', '/' or '^', streaming
+  /// this field along Z. result may be f, and must be allocated
+  void bcastOp(Field3D &result, const Field3D &f, char op) const;
   
   Field2D *ddt; ///< Time-derivative, can be NULL
 };
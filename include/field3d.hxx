@@ -21,6 +21,7 @@
  **************************************************************************/
 
 class Field3D;
+template<typename E> class FieldExpr;
 
 #ifndef __FIELD3D_H__
 #define __FIELD3D_H__
@@ -32,20 +33,39 @@ class Field3D;
 #include "bout_types.hxx"
 
 /// Structure to store blocks of memory for Field3D class
+/*!
+  Data is stored in a single contiguous buffer, aligned to BOUT_ALIGNMENT
+  bytes, with Z varying fastest and X slowest. The data[x][y][z] pointer
+  table is a view into this buffer, kept for compatibility.
+  Values are FieldReal, which is float if compiled with -DBOUT_FIELD_FLOAT
+ */
 struct memblock3d {
-  /// memory block
-  BoutReal ***data;
+  /// Contiguous, aligned memory block
+  FieldReal *raw;
+  /// Pointer table into raw, so data[jx][jy][jz] == raw[Field3D::index(jx,jy,jz)]
+  FieldReal ***data;
 
   /// Number of references
   int refs;
+
+  /// Unique stamp, set each time the block is given out by newBlock
+  unsigned long version;
   
   /// Pointer to next block in linked-list structure
   memblock3d *next;
   
   /// Pointer in list of all blocks
   memblock3d *all_next;
+  memblock3d *all_prev;
 }; 
 
+/// Per-thread cache of free blocks, padded to avoid false sharing
+struct memcache3d {
+  memblock3d *head; ///< Linked list of free blocks
+  int n;            ///< Number of blocks in list
+  char pad[64 - sizeof(memblock3d*) - sizeof(int)];
+};
+
 
 /// Class for 3D X-Y-Z scalar fields
 /*!
@@ -65,6 +85,8 @@ class Field3D : public Field, public FieldData {
   Field3D(const Field2D& f);
   /// Constructor from value
   Field3D(const BoutReal val);
+  /// Evaluate an expression template (see field_expr.hxx)
+  template<typename E> Field3D(const FieldExpr<E> &e);
   /// Destructor
   ~Field3D();
 
@@ -73,9 +95,23 @@ class Field3D : public Field, public FieldData {
   /// Ensures that memory is allocated
   void allocate() const;
   /// Returns a pointer to internal data (REMOVE THIS)
-  BoutReal*** getData() const;
+  FieldReal*** getData() const;
   bool isAllocated() const { return block !=  NULL; } ///< Test if data is allocated
 
+  /// Returns a pointer to the contiguous data. Use with index()
+  FieldReal* getRaw() const;
+  /// Read-only pointer to the contiguous data. Unlike getRaw(), shared
+  /// data isn't copied, so the pointer is invalid once any field sharing it is changed
+  const FieldReal* readRaw() const { return (block != NULL) ? block->raw : NULL; }
+  /// Changes whenever the data may differ from any copy taken of this field.
+  /// Shared data is copy-on-write, so while a copy is held this stays
+  /// the same until the field is modified. 0 if no data
+  unsigned long version() const { return (block != NULL) ? block->version : 0; }
+  /// Offset of point (jx,jy,jz) in the contiguous data
+  static inline int index(int jx, int jy, int jz) {
+    return jx*stride_x + jy*stride_y + jz;
+  }
+
   /// Return a pointer to the time-derivative field
   Field3D* timeDeriv();
 
@@ -89,8 +125,8 @@ class Field3D : public Field, public FieldData {
   // Operators
   
   /// Allows access to internal data using square-brackets
-  BoutReal** operator[](int jx) const;
-  BoutReal& operator[](bindex &bx) const;
+  FieldReal** operator[](int jx) const;
+  FieldReal& operator[](bindex &bx) const;
 
   /// Assignment operators
   Field3D & operator=(const Field3D &rhs);
@@ -98,6 +134,7 @@ class Field3D : public Field, public FieldData {
   Field3D & operator=(const FieldPerp &rhs);
   const bvalue & operator=(const bvalue &val);
   BoutReal operator=(const BoutReal val);
+  template<typename E> Field3D & operator=(const FieldExpr<E> &e);
 
   /// Addition operators
   Field3D & operator+=(const Field3D &rhs);
@@ -126,32 +163,62 @@ class Field3D : public Field, public FieldData {
   
   // Binary operators
 
-  const Field3D operator+() const;
-  const Field3D operator+(const Field3D &other) const;
-  const Field3D operator+(const Field2D &other) const;
+  Field3D operator+() const BOUT_LVALUE_THIS;
+  Field3D operator+(const Field3D &other) const BOUT_LVALUE_THIS;
+  Field3D operator+(const Field2D &other) const BOUT_LVALUE_THIS;
   const FieldPerp operator+(const FieldPerp &other) const;
-  const Field3D operator+(const BoutReal &rhs) const;
+  Field3D operator+(const BoutReal &rhs) const BOUT_LVALUE_THIS;
 
-  const Field3D operator-() const;
-  const Field3D operator-(const Field3D &other) const;
-  const Field3D operator-(const Field2D &other) const;
+  Field3D operator-() const BOUT_LVALUE_THIS;
+  Field3D operator-(const Field3D &other) const BOUT_LVALUE_THIS;
+  Field3D operator-(const Field2D &other) const BOUT_LVALUE_THIS;
   const FieldPerp operator-(const FieldPerp &other) const;
-  const Field3D operator-(const BoutReal &rhs) const;
+  Field3D operator-(const BoutReal &rhs) const BOUT_LVALUE_THIS;
 
-  const Field3D operator*(const Field3D &other) const;
-  const Field3D operator*(const Field2D &other) const;
+  Field3D operator*(const Field3D &other) const BOUT_LVALUE_THIS;
+  Field3D operator*(const Field2D &other) const BOUT_LVALUE_THIS;
   const FieldPerp operator*(const FieldPerp &other) const;
-  const Field3D operator*(const BoutReal rhs) const;
+  Field3D operator*(const BoutReal rhs) const BOUT_LVALUE_THIS;
 
-  const Field3D operator/(const Field3D &other) const;
-  const Field3D operator/(const Field2D &other) const;
+  Field3D operator/(const Field3D &other) const BOUT_LVALUE_THIS;
+  Field3D operator/(const Field2D &other) const BOUT_LVALUE_THIS;
   const FieldPerp operator/(const FieldPerp &other) const;
-  const Field3D operator/(const BoutReal rhs) const;
+  Field3D operator/(const BoutReal rhs) const BOUT_LVALUE_THIS;
 
-  const Field3D operator^(const Field3D &other) const;
-  const Field3D operator^(const Field2D &other) const;
+  Field3D operator^(const Field3D &other) const BOUT_LVALUE_THIS;
+  Field3D operator^(const Field2D &other) const BOUT_LVALUE_THIS;
   const FieldPerp operator^(const FieldPerp &other) const;
-  const Field3D operator^(const BoutReal rhs) const;
+  Field3D operator^(const BoutReal rhs) const BOUT_LVALUE_THIS;
+
+#ifdef BOUT_HAS_RVALUE_REFS
+  /// Move constructor: takes the data block from f
+  Field3D(Field3D &&f);
+  /// Move assignment
+  Field3D & operator=(Field3D &&rhs);
+
+  // Binary operators on expiring (temporary) values reuse their data
+  Field3D operator+() &&;
+  Field3D operator+(const Field3D &other) &&;
+  Field3D operator+(const Field2D &other) &&;
+  Field3D operator+(const BoutReal &rhs) &&;
+  Field3D operator-() &&;
+  Field3D operator-(const Field3D &other) &&;
+  Field3D operator-(const Field2D &other) &&;
+  Field3D operator-(const BoutReal &rhs) &&;
+  Field3D operator*(const Field3D &other) &&;
+  Field3D operator*(const Field2D &other) &&;
+  Field3D operator*(const BoutReal rhs) &&;
+  Field3D operator/(const Field3D &other) &&;
+  Field3D operator/(const Field2D &other) &&;
+  Field3D operator/(const BoutReal rhs) &&;
+  Field3D operator^(const Field3D &other) &&;
+  Field3D operator^(const Field2D &other) &&;
+  Field3D operator^(const BoutReal rhs) &&;
+  Field3D operator+(Field3D &&other) const &;
+  Field3D operator+(Field3D &&other) &&;
+  Field3D operator*(Field3D &&other) const &;
+  Field3D operator*(Field3D &&other) &&;
+#endif
 
   // Stencils for differencing
 
@@ -168,10 +235,10 @@ class Field3D : public Field, public FieldData {
   /// Shifts specified points by angle
   void shiftZ(int jx, int jy, double zangle); 
   /// Shift all points in z by specified angle
-  const Field3D shiftZ(const Field2D zangle) const; 
-  const Field3D shiftZ(const BoutReal zangle) const;
+  Field3D shiftZ(const Field2D zangle) const; 
+  Field3D shiftZ(const BoutReal zangle) const;
   /// Shifts to/from BoutReal-space (using zShift global variable)
-  const Field3D shiftZ(bool toBoutReal) const; 
+  Field3D shiftZ(bool toBoutReal) const; 
   /// virtual function to shift between BoutReal and shifted space
   void shiftToReal(bool toBoutReal) {
     *this = shiftZ(toBoutReal);
@@ -193,31 +260,31 @@ class Field3D : public Field, public FieldData {
 
   // Functions
   
-  const Field3D sqrt() const;
-  const Field3D abs() const;
+  Field3D sqrt() const;
+  Field3D abs() const;
   BoutReal min(bool allpe=false) const;
   BoutReal max(bool allpe=false) const;
 
   // Friend operators
-  friend const Field3D operator-(const BoutReal &lhs, const Field3D &rhs);
-  friend const Field3D operator+(const BoutReal &lhs, const Field3D &rhs);
+  friend Field3D operator-(const BoutReal &lhs, const Field3D &rhs);
+  friend Field3D operator+(const BoutReal &lhs, const Field3D &rhs);
 
   // Friend functions
 
-  friend const Field3D exp(const Field3D &f);
-  friend const Field3D log(const Field3D &f);
+  friend Field3D exp(const Field3D &f);
+  friend Field3D log(const Field3D &f);
   
-  friend const Field3D sin(const Field3D &f);
-  friend const Field3D cos(const Field3D &f);
-  friend const Field3D tan(const Field3D &f);
+  friend Field3D sin(const Field3D &f);
+  friend Field3D cos(const Field3D &f);
+  friend Field3D tan(const Field3D &f);
 
-  friend const Field3D sinh(const Field3D &f);
-  friend const Field3D cosh(const Field3D &f);
-  friend const Field3D tanh(const Field3D &f);
+  friend Field3D sinh(const Field3D &f);
+  friend Field3D cosh(const Field3D &f);
+  friend Field3D tanh(const Field3D &f);
 
-  friend const Field3D filter(const Field3D &var, int N0);
-  friend const Field3D lowPass(const Field3D &var, int zmax);
-  friend const Field3D lowPass(const Field3D &var, int zmax, int zmin);
+  friend Field3D filter(const Field3D &var, int N0);
+  friend Field3D lowPass(const Field3D &var, int zmax);
+  friend Field3D lowPass(const Field3D &var, int zmax, int zmin);
 
   friend bool finite(const Field3D &var);
 
@@ -225,18 +292,20 @@ class Field3D : public Field, public FieldData {
   
   bool isReal() const   { return true; }         // Consists of BoutReal values
   bool is3D() const     { return true; }         // Field is 3D
-  int  byteSize() const { return sizeof(BoutReal); } // Just one BoutReal
+  int  byteSize() const { return sizeof(FieldReal); } // Stored precision
   int  BoutRealSize() const { return 1; }
   int  getData(int x, int y, int z, void *vptr) const;
   int  getData(int x, int y, int z, BoutReal *rptr) const;
   int  setData(int x, int y, int z, void *vptr);
   int  setData(int x, int y, int z, BoutReal *rptr);
 
+#ifndef BOUT_FIELD_FLOAT
   bool ioSupport() { return true; } ///< This class supports I/O operations
   BoutReal *getData(int component) { 
     BoutReal ***d = getData();
     return **d;
   }
+#endif
   void zeroComponent(int component){
     *this = 0.0;
   }
@@ -248,9 +317,20 @@ class Field3D : public Field, public FieldData {
 #endif
 
   friend class Vector3D;
+  friend class Field2D; ///< Field2D op Field3D streams directly from the block
   
   static void cleanup(); // Frees all memory
 
+  /// Read memory pool settings from the [field3d] options section
+  static void initPool();
+  /// Frees unused blocks. Must be called outside parallel regions
+  static void trimPool();
+  /// Memory pool statistics: Blocks in use, free blocks and most allocated
+  static void poolStats(int &live, int &nfree, int &peak);
+  /// Number of blocks handed out so far. The change across a statement
+  /// counts the Field3D allocations it made
+  static unsigned long blockCount() { return last_version; }
+
   void setBackground(const Field2D &f2d); // Boundary is applied to the total of this and f2d
   void applyBoundary();
   void applyBoundary(const string &condition);
@@ -271,10 +351,34 @@ class Field3D : public Field, public FieldData {
 
   /// Number of blocks allocated
   static int nblocks;
+  /// Set by cleanup(), after which blocks are no longer returned
+  static bool pool_cleared;
   /// Linked list of all memory blocks
   static memblock3d *blocklist;
   /// Linked list of free blocks
   static memblock3d *free_block;
+  /// Number of blocks in free_block list
+  static int nfree;
+  /// Largest value of nblocks
+  static int peak_blocks;
+  /// Maximum size of the free_block list (< 0 for no limit)
+  static int max_free;
+  /// Last version stamp given to a block
+  static unsigned long last_version;
+
+  /// Free lists for each OpenMP thread, used without locking
+  static memcache3d *thread_cache;
+  /// Number of thread caches, and maximum blocks in each
+  static int ncache, max_cache;
+
+  /// Strides of the contiguous data in X and Y (Z stride is 1)
+#if defined(BOUT_FIXED_NGY) && defined(BOUT_FIXED_NGZ)
+  // Grid sizes set at compile-time, so strides are constants
+  static const int stride_x = BOUT_FIXED_NGY*BOUT_FIXED_NGZ;
+  static const int stride_y = BOUT_FIXED_NGZ;
+#else
+  static int stride_x, stride_y;
+#endif
 
   /// Get a new block of data, either from free list or allocate
   memblock3d* newBlock() const;
@@ -282,21 +386,33 @@ class Field3D : public Field, public FieldData {
   void allocData() const;
   /// Releases the data array, putting onto global stack
   void freeData();
+  /// Removes a reference to a block, putting it on a free list if unused
+  static void unrefBlock(memblock3d *b);
+  /// Removes a block from the list of all blocks and frees memory
+  static void destroyBlock(memblock3d *b);
   
   CELL_LOC location; // Location of the variable in the cell
   
   Field3D *ddt; ///< Time derivative (may be NULL)
+
+  friend class FieldExprF3D;
+  friend class Reduction;
 };
 
 // Non-member overloaded operators
 
-const Field3D operator*(const BoutReal lhs, const Field3D &rhs);
-const Field3D operator/(const BoutReal lhs, const Field3D &rhs);
-const Field3D operator^(const BoutReal lhs, const Field3D &rhs);
+Field3D operator*(const BoutReal lhs, const Field3D &rhs);
+Field3D operator/(const BoutReal lhs, const Field3D &rhs);
+Field3D operator^(const BoutReal lhs, const Field3D &rhs);
+#ifdef BOUT_HAS_RVALUE_REFS
+Field3D operator+(const BoutReal lhs, Field3D &&rhs);
+Field3D operator-(const BoutReal lhs, Field3D &&rhs);
+Field3D operator*(const BoutReal lhs, Field3D &&rhs);
+#endif
 
 // Non-member functions
-const Field3D sqrt(const Field3D &f);
-const Field3D abs(const Field3D &f);
+Field3D sqrt(const Field3D &f);
+Field3D abs(const Field3D &f);
 BoutReal min(const Field3D &f, bool allpe=false);
 BoutReal max(const Field3D &f, bool allpe=false);
 
@@ -56,7 +56,7 @@ class FieldData {
   virtual int byteSize() const = 0; ///< Number of bytes for a single point
   virtual int BoutRealSize() const { return 0; } ///< Number of BoutReals (not implemented if not BoutReal)
 
-  virtual int getData(int x, int y, int z, void *vptr) const = 0; ///< Return number of bytes
+  virtual int getData(int x, int y, int z, void *vptr) const = 0; ///< Return number of bytes. Data is at the stored precision
   virtual int getData(int x, int y, int z, BoutReal *rptr) const = 0; ///< Return number of BoutReals
   
   virtual int setData(int x, int y, int z, void *vptr) = 0;
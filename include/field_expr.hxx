@@ -0,0 +1,309 @@
+/*!************************************************************************
+ * Expression templates for Field3D, Field2D and BoutReal arithmetic
+ *
+ * Normally every operator on a Field3D allocates a temporary and sweeps
+ * the whole grid. Wrapping an operand in expr() instead builds an
+ * expression object, which is evaluated in a single loop when assigned
+ * to a Field3D (or Field2D if no 3D terms are present):
+ *
+ *   #include <field_expr.hxx>
+ *
+ *   ddt(Ni) = -expr(b0xGrad_dot_Grad(phi,Ni)) + mu*expr(Delp2(Ni)) - expr(Ni)*Grad_par(Vi);
+ *
+ * Operators between an expression and a Field3D, Field2D or BoutReal
+ * produce expressions. Operators between plain fields do not, so each
+ * product or quotient must contain an expr() itself: in
+ *   expr(a) + b*c
+ * b*c is evaluated first, into a temporary Field3D.
+ *
+ * Field3D terms in an expression must all be at the same cell location,
+ * which the result takes.
+ *
+ * Expressions hold pointers to the data of their operands, so they must
+ * be assigned in the same statement they are created.
+ *
+ **************************************************************************
+ * Copyright 2010 B.D.Dudson, S.Farley, M.V.Umansky, X.Q.Xu
+ *
+ * Contact: Ben Dudson, bd512@york.ac.uk
+ *
+ * This file is part of BOUT++.
+ *
+ * BOUT++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BOUT++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BOUT++.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **************************************************************************/
+
+#ifndef __FIELD_EXPR_H__
+#define __FIELD_EXPR_H__
+
+#include "globals.hxx"
+#include "field2d.hxx"
+#include "field3d.hxx"
+#include "boutexception.hxx"
+
+#include <math.h>
+
+/// Base class for all expressions. E is the derived type
+/*!
+  Each expression type E provides
+    BoutReal operator()(int jxy, int i) const
+  which returns the value at point i = jxy*ngz + jz, where jxy = jx*ngy + jy.
+  Field2D terms use jxy, Field3D terms use i.
+  getLocation() is the location of the Field3D terms, or CELL_DEFAULT if none
+ */
+template<typename E>
+class FieldExpr {
+ public:
+  const E& self() const { return static_cast<const E&>(*this); }
+};
+
+/// Reference to a Field3D
+class FieldExprF3D : public FieldExpr<FieldExprF3D> {
+ public:
+  enum { is3D = 1 };
+
+  FieldExprF3D(const Field3D &f) : loc(f.getLocation()) {
+#ifdef CHECK
+    f.checkData();
+#endif
+    d = f.block->raw;
+  }
+  BoutReal operator()(int jxy, int i) const { return d[i]; }
+  CELL_LOC getLocation() const { return loc; }
+  bool checkLocation(CELL_LOC l) const { return l == loc; }
+ private:
+  const FieldReal *d;
+  CELL_LOC loc;
+};
+
+/// Reference to a Field2D, broadcast in Z
+class FieldExprF2D : public FieldExpr<FieldExprF2D> {
+ public:
+  enum { is3D = 0 };
+
+  FieldExprF2D(const Field2D &f) {
+#ifdef CHECK
+    f.checkData();
+#endif
+    d = f.data[0];
+  }
+  BoutReal operator()(int jxy, int i) const { return d[jxy]; }
+  CELL_LOC getLocation() const { return CELL_DEFAULT; }
+  bool checkLocation(CELL_LOC l) const { return true; }
+ private:
+  const BoutReal *d;
+};
+
+/// Constant value
+class FieldExprReal : public FieldExpr<FieldExprReal> {
+ public:
+  enum { is3D = 0 };
+
+  FieldExprReal(BoutReal v) : val(v) {}
+  BoutReal operator()(int jxy, int i) const { return val; }
+  CELL_LOC getLocation() const { return CELL_DEFAULT; }
+  bool checkLocation(CELL_LOC l) const { return true; }
+ private:
+  BoutReal val;
+};
+
+/// Binary operation. Op has a static apply(BoutReal, BoutReal)
+template<typename L, typename Op, typename R>
+class FieldExprBinary : public FieldExpr< FieldExprBinary<L,Op,R> > {
+ public:
+  enum { is3D = L::is3D || R::is3D };
+
+  FieldExprBinary(const L &left, const R &right) : l(left), r(right) {}
+  BoutReal operator()(int jxy, int i) const { return Op::apply(l(jxy, i), r(jxy, i)); }
+  CELL_LOC getLocation() const {
+    CELL_LOC loc = l.getLocation();
+    return (loc != CELL_DEFAULT) ? loc : r.getLocation();
+  }
+  bool checkLocation(CELL_LOC loc) const { return l.checkLocation(loc) && r.checkLocation(loc); }
+ private:
+  L l;
+  R r;
+};
+
+/// Unary operation. Op has a static apply(BoutReal)
+template<typename A, typename Op>
+class FieldExprUnary : public FieldExpr< FieldExprUnary<A,Op> > {
+ public:
+  enum { is3D = A::is3D };
+
+  FieldExprUnary(const A &arg) : a(arg) {}
+  BoutReal operator()(int jxy, int i) const { return Op::apply(a(jxy, i)); }
+  CELL_LOC getLocation() const { return a.getLocation(); }
+  bool checkLocation(CELL_LOC loc) const { return a.checkLocation(loc); }
+ private:
+  A a;
+};
+
+struct FieldExprAdd { static BoutReal apply(BoutReal a, BoutReal b) { return a + b; } };
+struct FieldExprSub { static BoutReal apply(BoutReal a, BoutReal b) { return a - b; } };
+struct FieldExprMul { static BoutReal apply(BoutReal a, BoutReal b) { return a * b; } };
+struct FieldExprDiv { static BoutReal apply(BoutReal a, BoutReal b) { return a / b; } };
+struct FieldExprPow { static BoutReal apply(BoutReal a, BoutReal b) { return pow(a, b); } };
+
+struct FieldExprNeg { static BoutReal apply(BoutReal a) { return -a; } };
+
+/// Start an expression from a field
+inline FieldExprF3D expr(const Field3D &f) { return FieldExprF3D(f); }
+inline FieldExprF2D expr(const Field2D &f) { return FieldExprF2D(f); }
+
+/////////////////////////////////////////////////////////////////
+// Operators. At least one side must already be an expression
+
+#define FIELD_EXPR_BINARY(op, Op)                                        \
+  template<typename L, typename R>                                      \
+  inline FieldExprBinary<L, Op, R>                                      \
+  operator op(const FieldExpr<L> &l, const FieldExpr<R> &r) {           \
+    return FieldExprBinary<L, Op, R>(l.self(), r.self());               \
+  }                                                                     \
+  template<typename L>                                                  \
+  inline FieldExprBinary<L, Op, FieldExprF3D>                           \
+  operator op(const FieldExpr<L> &l, const Field3D &r) {                \
+    return FieldExprBinary<L, Op, FieldExprF3D>(l.self(), FieldExprF3D(r)); \
+  }                                                                     \
+  template<typename R>                                                  \
+  inline FieldExprBinary<FieldExprF3D, Op, R>                           \
+  operator op(const Field3D &l, const FieldExpr<R> &r) {                \
+    return FieldExprBinary<FieldExprF3D, Op, R>(FieldExprF3D(l), r.self()); \
+  }                                                                     \
+  template<typename L>                                                  \
+  inline FieldExprBinary<L, Op, FieldExprF2D>                           \
+  operator op(const FieldExpr<L> &l, const Field2D &r) {                \
+    return FieldExprBinary<L, Op, FieldExprF2D>(l.self(), FieldExprF2D(r)); \
+  }                                                                     \
+  template<typename R>                                                  \
+  inline FieldExprBinary<FieldExprF2D, Op, R>                           \
+  operator op(const Field2D &l, const FieldExpr<R> &r) {                \
+    return FieldExprBinary<FieldExprF2D, Op, R>(FieldExprF2D(l), r.self()); \
+  }                                                                     \
+  template<typename L>                                                  \
+  inline FieldExprBinary<L, Op, FieldExprReal>                          \
+  operator op(const FieldExpr<L> &l, BoutReal r) {                      \
+    return FieldExprBinary<L, Op, FieldExprReal>(l.self(), FieldExprReal(r)); \
+  }                                                                     \
+  template<typename R>                                                  \
+  inline FieldExprBinary<FieldExprReal, Op, R>                          \
+  operator op(BoutReal l, const FieldExpr<R> &r) {                      \
+    return FieldExprBinary<FieldExprReal, Op, R>(FieldExprReal(l), r.self()); \
+  }
+
+FIELD_EXPR_BINARY(+, FieldExprAdd)
+FIELD_EXPR_BINARY(-, FieldExprSub)
+FIELD_EXPR_BINARY(*, FieldExprMul)
+FIELD_EXPR_BINARY(/, FieldExprDiv)
+FIELD_EXPR_BINARY(^, FieldExprPow)
+
+#undef FIELD_EXPR_BINARY
+
+template<typename A>
+inline FieldExprUnary<A, FieldExprNeg> operator-(const FieldExpr<A> &a) {
+  return FieldExprUnary<A, FieldExprNeg>(a.self());
+}
+
+/////////////////////////////////////////////////////////////////
+// Evaluation
+
+/// Only defined for expressions without Field3D terms, so that assigning
+/// a 3D expression to a Field2D fails to compile
+template<bool is3D> struct Field2DExprCheck;
+template<> struct Field2DExprCheck<false> {};
+
+template<typename E>
+Field3D::Field3D(const FieldExpr<E> &e) : background(NULL)
+{
+  block = NULL;
+  location = e.self().getLocation();
+  if(location == CELL_DEFAULT)
+    location = CELL_CENTRE;
+  ddt = NULL;
+  boundaryIsSet = false;
+
+  *this = e;
+}
+
+template<typename E>
+Field3D & Field3D::operator=(const FieldExpr<E> &e)
+{
+  const E &ex = e.self();
+
+  // Take the location of the Field3D terms, as assignment from a Field3D does
+  if(ex.getLocation() != CELL_DEFAULT)
+    location = ex.getLocation();
+
+#ifdef CHECK
+  msg_stack.push("Field3D: = FieldExpr");
+  if(!ex.checkLocation(location))
+    throw BoutException("Field3D: Expression terms at different cell locations\n");
+#endif
+
+#ifdef TRACK
+  name = "<expr>";
+#endif
+
+  if((block != NULL) && (block->refs > 1)) {
+    // Shared data will be overwritten, so no need to copy it
+    freeData();
+  }
+  allocData();
+
+  FieldReal *d = block->raw;
+  int nz = mesh->ngz;
+
+  #pragma omp parallel for
+  for(int jxy=0;jxy<mesh->ngx*mesh->ngy;jxy++)
+    for(int jz=0;jz<nz;jz++)
+      d[jxy*nz + jz] = ex(jxy, jxy*nz + jz);
+
+#ifdef CHECK
+  msg_stack.pop();
+#endif
+
+  return *this;
+}
+
+template<typename E>
+Field2D & Field2D::operator=(const FieldExpr<E> &e)
+{
+  // Compile error here if the expression contains Field3D terms
+  (void) sizeof(Field2DExprCheck<(E::is3D != 0)>);
+
+#ifdef CHECK
+  msg_stack.push("Field2D: = FieldExpr");
+#endif
+
+#ifdef TRACK
+  name = "<expr>";
+#endif
+
+  allocData();
+
+  const E &ex = e.self();
+  BoutReal *d = data[0];
+
+  #pragma omp parallel for
+  for(int jxy=0;jxy<mesh->ngx*mesh->ngy;jxy++)
+    d[jxy] = ex(jxy, jxy);
+
+#ifdef CHECK
+  msg_stack.pop();
+#endif
+
+  return *this;
+}
+
+#endif // __FIELD_EXPR_H__
@@ -35,27 +35,27 @@
 
 const int GYRO_FLAGS = INVERT_BNDRY_ONE | INVERT_IN_RHS | INVERT_OUT_RHS;
 
-const Field3D gyroTaylor0(const Field3D &f, const Field3D &rho);
+Field3D gyroTaylor0(const Field3D &f, const Field3D &rho);
 
-const Field3D gyroPade0(const Field3D &f, const Field3D &rho, 
+Field3D gyroPade0(const Field3D &f, const Field3D &rho, 
                         int flags=GYRO_FLAGS);
-const Field3D gyroPade1(const Field3D &f, const Field3D &rho, 
+Field3D gyroPade1(const Field3D &f, const Field3D &rho, 
                         int flags=GYRO_FLAGS);
-const Field3D gyroPade2(const Field3D &f, const Field3D &rho, 
+Field3D gyroPade2(const Field3D &f, const Field3D &rho, 
                         int flags=GYRO_FLAGS);
 
-const Field3D gyroPade0(const Field3D &f, const Field2D &rho, 
+Field3D gyroPade0(const Field3D &f, const Field2D &rho, 
                         int flags=GYRO_FLAGS);
-const Field3D gyroPade1(const Field3D &f, const Field2D &rho, 
+Field3D gyroPade1(const Field3D &f, const Field2D &rho, 
                         int flags=GYRO_FLAGS);
-const Field3D gyroPade2(const Field3D &f, const Field2D &rho, 
+Field3D gyroPade2(const Field3D &f, const Field2D &rho, 
                         int flags=GYRO_FLAGS);
 
-const Field3D gyroPade0(const Field3D &f, BoutReal rho, 
+Field3D gyroPade0(const Field3D &f, BoutReal rho, 
                         int flags=GYRO_FLAGS);
-const Field3D gyroPade1(const Field3D &f, BoutReal rho, 
+Field3D gyroPade1(const Field3D &f, BoutReal rho, 
                         int flags=GYRO_FLAGS);
-const Field3D gyroPade2(const Field3D &f, BoutReal rho, 
+Field3D gyroPade2(const Field3D &f, BoutReal rho, 
                         int flags=GYRO_FLAGS);
 
 #endif // __GYRO_AVERAGE_H__
@@ -70,7 +70,7 @@ int invert_laplace(const FieldPerp &b, FieldPerp &x, int flags, const Field2D *a
 int invert_laplace(const Field3D &b, Field3D &x, int flags, const Field2D *a, const Field2D *c=NULL, const Field2D *d=NULL);
 
 /// More readable API for calling Laplacian inversion. Returns x
-const Field3D invert_laplace(const Field3D &b, int flags, 
+Field3D invert_laplace(const Field3D &b, int flags, 
                              const Field2D *a = NULL, const Field2D *c=NULL, const Field2D *d=NULL);
 
 #endif // __LAPLACE_H__
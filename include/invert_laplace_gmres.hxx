@@ -9,7 +9,13 @@
  * i.e. this solver does not need to make the Boussinesq approximation for
  * vorticity equation inversion.
  *
- * Optionally uses invert_laplace method as a preconditioner
+ * Optionally uses invert_laplace method as a preconditioner, or
+ * geometric multigrid (invert_laplace_mg.hxx) if gmres_mg is set in [laplace]
+ *
+ * NOTE: function() is not yet implemented, and returns x. The result of
+ * invert() is therefore the preconditioner applied once to b: one
+ * multigrid V-cycle with gmres_mg, otherwise invert_laplace with the DC
+ * parts of a and c. Use LaplaceMultigrid::solve for a converged solution
  * 
  * Changelog: 
  *
@@ -42,11 +48,14 @@
 #define __INVERT_LAP_GMRES_H__
 
 #include "inverter.hxx"
+#include "invert_laplace_mg.hxx"
 
 class LaplaceGMRES : public Inverter {
  public:
+  LaplaceGMRES();
+  
   /// Main solver function. Pass NULL to omit terms
-  const Field3D invert(const Field3D &b, const Field3D &start, int inv_flags, bool precon=true, Field3D *a=NULL, Field3D *c=NULL);
+  Field3D invert(const Field3D &b, const Field3D &start, int inv_flags, bool precon=true, Field3D *a=NULL, Field3D *c=NULL);
   
   /// Implement the function to be inverted
   const FieldPerp function(const FieldPerp &x);
@@ -59,6 +68,10 @@ class LaplaceGMRES : public Inverter {
   bool use_precon;
   Field2D a2d, c2d;  // DC components (for preconditioner)
   Field2D *aptr, *cptr; // Pointers to the 2D variables (for passing to preconditioner)
+
+  bool use_mg; // Use multigrid preconditioner, keeping the 3D coefficients
+  LaplaceMultigrid mg;
+  bool mg_ready; // mg has been given the current flags, a3d and c3d
 };
 
 #endif // __INVERT_LAP_GMRES_H__
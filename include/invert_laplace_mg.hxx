@@ -0,0 +1,124 @@
+/**************************************************************************
+ * Geometric multigrid Laplacian inversion
+ *
+ * Equation solved is: d*\nabla^2_\perp x + (1/c)\nabla_perp c\cdot\nabla_\perp x + a x = b
+ *
+ * i.e. the same as invert_laplace.hxx, but a and c can be 3D variables,
+ * so no Boussinesq approximation is needed for vorticity inversion.
+ *
+ * The operator is discretised in real space with 2nd-order central
+ * differences in X and Z. Each X-Z slice is solved by V-cycles, coarsening
+ * by 2 in X (on each processor) and in Z. The smoother is zebra line
+ * Gauss-Seidel: alternate X points are relaxed in turn, solving the
+ * periodic Z lines exactly. All Y slices are relaxed together, so each
+ * exchange of X guard cells is one message in each direction.
+ *
+ * Boundary conditions are set by the INVERT_* flags, as for invert_laplace.
+ * INVERT_AC_*_LAP is treated as zero value; INVERT_4TH_ORDER, INVERT_*_SYM
+ * and INVERT_KX_ZERO are ignored. As for the parallel FFT methods, the
+ * domain is not periodic in X.
+ *
+ **************************************************************************
+ * Copyright 2010 B.D.Dudson, S.Farley, M.V.Umansky, X.Q.Xu
+ *
+ * Contact: Ben Dudson, bd512@york.ac.uk
+ *
+ * This file is part of BOUT++.
+ *
+ * BOUT++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BOUT++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BOUT++.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **************************************************************************/
+
+#ifndef __INVERT_LAP_MG_H__
+#define __INVERT_LAP_MG_H__
+
+#include "field3d.hxx"
+#include "field2d.hxx"
+
+#include <vector>
+
+class LaplaceMultigrid {
+ public:
+  LaplaceMultigrid();
+
+  /// Set the operator to be inverted. Pass NULL to omit terms
+  void setCoefs(int inv_flags, const Field3D *a = NULL, const Field3D *c = NULL, const Field2D *d = NULL);
+
+  /// Solve to tolerance, starting from x unless INVERT_START_NEW is set.
+  /// Returns non-zero if not converged
+  int solve(const Field3D &b, Field3D &x);
+  Field3D solve(const Field3D &b);
+
+  /// Apply ncycle V-cycles starting from zero with zero-value boundaries.
+  /// For use as a preconditioner
+  Field3D precon(const Field3D &b, int ncycle = 1);
+
+ private:
+  /// One grid level. All arrays are [jy][ix][kz] over the Y slices solved
+  struct Level {
+    int nx, nz;   ///< X points on this processor, and Z points
+    int xpar;     ///< Parity of the global index of the first X point
+    bool zcoarse; ///< True if Z was coarsened from the level above
+    BoutReal hz;  ///< Z grid spacing
+    std::vector<BoutReal> hx; ///< X cell widths, including guard cells
+
+    std::vector<BoutReal> cxx, czz, cxz, cx, cz, c0; ///< Operator coefficients
+    std::vector<BoutReal> sc, sxm, sxp, szm, szp, sxz; ///< 2nd-order stencil
+    std::vector<BoutReal> lgam, libet, lz; ///< Factorised Z lines
+    std::vector<BoutReal> lq, liden;       ///< Cyclic correction for each line [jy][ix]
+
+    std::vector<BoutReal> x; ///< Solution, with one guard cell each side in X
+    std::vector<BoutReal> b, r; ///< RHS and residual
+
+    /// Offset into interior arrays
+    int c(int jy, int ix, int kz) const { return (jy*nx + ix)*nz + kz; }
+    /// Offset into x, which has guard cells ix = -1 and ix = nx
+    int g(int jy, int ix, int kz) const { return (jy*(nx+2) + ix + 1)*nz + kz; }
+    /// Offset into hx
+    int h(int jy, int ix) const { return jy*(nx+2) + ix + 1; }
+  };
+  std::vector<Level> levels;
+
+  int flags;
+  int ys, ye, ny;  ///< Range of Y slices
+  int xs, xe;      ///< X range solved on this processor
+  bool shift;      ///< Shift into real space (ShiftXderivs)
+
+  std::vector<BoutReal> gin, gout; ///< Values in the X boundary cells (INVERT_*_SET, _RHS)
+  std::vector<BoutReal> sendin, sendout, recvin, recvout; ///< X guard cell exchange buffers
+
+  // Settings
+  int max_levels;
+  int npre, npost; ///< Smoothing sweeps before and after coarse correction
+  int ncoarse;     ///< Smoothing sweeps on the coarsest level
+  int maxits;      ///< Maximum number of V-cycles
+  BoutReal rtol, atol;
+
+  void stencil(Level &L, bool local);
+  void coarsen(const Level &F, Level &C, bool zcoarse);
+  int parity(int nx);
+
+  void loadField(const Field3D &f, std::vector<BoutReal> &v, bool guards);
+  void loadBoundary(const Field3D *fin, const Field3D *fout);
+  void storeField(Field3D &f, bool homogeneous);
+
+  void exchange(std::vector<BoutReal> &v, int nx, int nz);
+  void applyBoundary(Level &L, bool homogeneous);
+  void smooth(Level &L, int nsweep, bool homogeneous);
+  void residual(Level &L, bool homogeneous);
+  BoutReal norm(const Level &L, const std::vector<BoutReal> &v);
+  void vcycle(int l, bool homogeneous);
+};
+
+#endif // __INVERT_LAP_MG_H__
@@ -44,10 +44,10 @@
 #include "field2d.hxx"
 
 namespace invpar {
-  const Field3D invert_parderiv(const Field2D &A, const Field2D &B, const Field3D &r);
-  const Field3D invert_parderiv(BoutReal val, const Field2D &B, const Field3D &r);
-  const Field3D invert_parderiv(const Field2D &A, BoutReal val, const Field3D &r);
-  const Field3D invert_parderiv(BoutReal val, BoutReal val2, const Field3D &r);
+  Field3D invert_parderiv(const Field2D &A, const Field2D &B, const Field3D &r);
+  Field3D invert_parderiv(BoutReal val, const Field2D &B, const Field3D &r);
+  Field3D invert_parderiv(const Field2D &A, BoutReal val, const Field3D &r);
+  Field3D invert_parderiv(BoutReal val, BoutReal val2, const Field3D &r);
 }
 
 using invpar::invert_parderiv;
@@ -23,6 +23,8 @@
 #ifndef __LAPACK_ROUTINES_H__
 #define __LAPACK_ROUTINES_H__
 
+#include "dcomplex.hxx"
+
 /* Tridiagonal inversion
  *
  * a = Left of diagonal (so a[0] not used)
@@ -50,5 +52,39 @@ void cyclic_tridag(dcomplex *a, dcomplex *b, dcomplex *c, dcomplex *r, dcomplex
 /// Complex band matrix solver
 void cband_solve(dcomplex **a, int n, int m1, int m2, dcomplex *b);
 
+/// Many complex tridiagonal systems of the same size, solved together
+/*!
+ * Row i of system s is stored at [i*nsys + s], with separate real and
+ * imaginary parts, so the loops over systems vectorise. The matrices are
+ * factorised once with the Thomas algorithm (no pivoting), then solve()
+ * can be called for any number of right hand sides
+ */
+class TridagBatch {
+ public:
+  TridagBatch(int n, int nsys);
+  ~TridagBatch();
+  
+  int size() const { return n; }
+  int batch() const { return nsys; }
+  
+  /// Set row i of system s to a*x[i-1] + b*x[i] + c*x[i+1]
+  void setRow(int i, int s, const dcomplex &a, const dcomplex &b, const dcomplex &c);
+  
+  /// Eliminate. Returns false if any system has a zero pivot
+  bool factorise();
+  
+  /// Solve in place. re and im hold the RHS on input, the result on output
+  void solve(BoutReal *re, BoutReal *im) const;
+ private:
+  TridagBatch(const TridagBatch&);
+  TridagBatch& operator=(const TridagBatch&);
+  
+  int n, nsys;
+  BoutReal *data;
+  BoutReal *are, *aim; ///< Sub-diagonal
+  BoutReal *bre, *bim; ///< Diagonal. 1/pivot after factorise()
+  BoutReal *cre, *cim; ///< Super-diagonal. Divided by the pivot after factorise()
+};
+
 #endif // __LAPACK_ROUTINES_H__
 
@@ -38,6 +38,8 @@ class SurfaceIter;
 #ifndef __MESH_H__
 #define __MESH_H__
 
+#include "mpi.h"
+
 #include "field_data.hxx"
 #include "bout_types.hxx"
 #include "field2d.hxx"
@@ -150,6 +152,7 @@ class Mesh {
   virtual int sendXIn(BoutReal *buffer, int size, int tag) = 0;
   virtual comm_handle irecvXOut(BoutReal *buffer, int size, int tag) = 0;
   virtual comm_handle irecvXIn(BoutReal *buffer, int size, int tag) = 0;
+  virtual MPI_Comm getXcomm() = 0; ///< Communicator containing all processors in X
 
   int communicate(FieldPerp &f); // Communicate an X-Z field
 
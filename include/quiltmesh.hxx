@@ -37,6 +37,7 @@ class QuiltMesh : public Mesh {
   int sendXIn(BoutReal *buffer, int size, int tag);
   comm_handle irecvXOut(BoutReal *buffer, int size, int tag);
   comm_handle irecvXIn(BoutReal *buffer, int size, int tag);
+  MPI_Comm getXcomm();
 
   // Y-Z surface gather/scatter operations
   SurfaceIter* iterateSurfaces();
@@ -0,0 +1,120 @@
+/**************************************************************************
+ * Fused reductions over fields
+ *
+ * Several reductions over several fields are computed with one pass
+ * through each field and a single MPI_Allreduce:
+ *
+ *   Reduction r;
+ *   int nmax = r.max(Ni), pmin = r.min(P), pnorm = r.norm(P);
+ *   int ok = r.finite(Ni);
+ *   r.run();
+ *   output.write("%e %e %e %d\n", r[nmax], r[pmin], r[pnorm], r.isFinite(ok));
+ *
+ * run() can be split into start() and wait() to overlap the collective
+ * with other work; this needs MPI-3, otherwise start() blocks.
+ *
+ * min, max and finite use the same points as the Field3D and Field2D
+ * functions of the same name (finite skips the last Z point).
+ * sum and norm only use the domain interior (mesh->xstart..xend,
+ * ystart..yend, jz < ngz-1) so that guard cells aren't counted twice.
+ *
+ **************************************************************************
+ * Copyright 2010 B.D.Dudson, S.Farley, M.V.Umansky, X.Q.Xu
+ *
+ * Contact: Ben Dudson, bd512@york.ac.uk
+ *
+ * This file is part of BOUT++.
+ *
+ * BOUT++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BOUT++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BOUT++.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **************************************************************************/
+
+#ifndef __REDUCE_H__
+#define __REDUCE_H__
+
+#include "mpi.h"
+
+#include "bout_types.hxx"
+#include "field2d.hxx"
+#include "field3d.hxx"
+
+#include <vector>
+using std::vector;
+
+class Reduction {
+ public:
+  /// If allpe is false, results are local to this processor
+  Reduction(bool allpe = true);
+  ~Reduction();
+
+  // Add a reduction, returning its index into the results.
+  // Fields must not be changed or destroyed until wait() or run() returns
+  int min(const Field3D &f);
+  int max(const Field3D &f);
+  int sum(const Field3D &f);
+  int norm(const Field3D &f);   ///< sqrt(sum f^2)
+  int finite(const Field3D &f); ///< 1 if all values finite, 0 otherwise
+
+  int min(const Field2D &f);
+  int max(const Field2D &f);
+  int sum(const Field2D &f);
+  int norm(const Field2D &f);
+  int finite(const Field2D &f);
+
+  void run();   ///< Compute all reductions (start then wait)
+  void start(); ///< Compute local values and start the collective
+  void wait();  ///< Wait for the collective to finish
+
+  BoutReal operator[](int i) const; ///< Result of reduction i
+  bool isFinite(int i) const { return (*this)[i] > 0.5; }
+
+  void clear(); ///< Remove all reductions so the object can be reused
+
+ private:
+  enum ReduceType {REDUCE_MIN, REDUCE_MAX, REDUCE_SUM, REDUCE_NORM, REDUCE_FINITE};
+
+  struct Item {
+    ReduceType type;
+    const Field3D *f3d;
+    const Field2D *f2d;
+    int field; ///< Index into the list of fields
+    int slot;  ///< Index into the communication buffer
+  };
+
+  /// Local values for one field
+  struct FieldResult {
+    BoutReal min, max, sum, sumsq;
+    bool finite;
+  };
+
+  bool allpe;
+  vector<Item> items;
+
+  vector<BoutReal> sendbuf, recvbuf; ///< Communication buffers
+  vector<BoutReal> result;
+
+  MPI_Request request;
+  bool started, done;
+
+  int add(ReduceType type, const Field3D *f3d, const Field2D *f2d);
+
+  static void reduceField(const Field3D &f, FieldResult &r);
+  static void reduceField(const Field2D &f, FieldResult &r);
+
+  MPI_Op op;           ///< Combined max/sum operation
+  MPI_Datatype record; ///< The whole buffer as one element
+  static void reduceOp(void *invec, void *inoutvec, int *len, MPI_Datatype *type);
+};
+
+#endif // __REDUCE_H__
@@ -0,0 +1,97 @@
+/**************************************************************************
+ * Vectorised elementwise kernels on contiguous arrays
+ *
+ * Used by the Field3D operators. The instruction set is chosen
+ * at compile time from the compiler flags: AVX-512 (-mavx512f),
+ * AVX2 (-mavx2), SSE2 (default on x86-64), otherwise scalar.
+ * -mavx without -mavx2 uses SSE2.
+ *
+ * All kernels allow the result to be the same array as an input,
+ * and are OpenMP parallel over chunks of the array.
+ *
+ **************************************************************************
+ * Copyright 2010 B.D.Dudson, S.Farley, M.V.Umansky, X.Q.Xu
+ *
+ * Contact: Ben Dudson, bd512@york.ac.uk
+ *
+ * This file is part of BOUT++.
+ *
+ * BOUT++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BOUT++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BOUT++.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **************************************************************************/
+
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#include "bout_types.hxx"
+
+/// Name of the instruction set used ("avx512", "avx2", "sse2" or "scalar")
+const char* simd_name();
+/// Number of BoutReals per vector
+int simd_width();
+
+// r = a op b
+void simd_add(BoutReal *r, const BoutReal *a, const BoutReal *b, int n);
+void simd_sub(BoutReal *r, const BoutReal *a, const BoutReal *b, int n);
+void simd_mul(BoutReal *r, const BoutReal *a, const BoutReal *b, int n);
+void simd_div(BoutReal *r, const BoutReal *a, const BoutReal *b, int n);
+void simd_pow(BoutReal *r, const BoutReal *a, const BoutReal *b, int n);
+
+// r = a op b, with scalar b
+void simd_add(BoutReal *r, const BoutReal *a, BoutReal b, int n);
+void simd_sub(BoutReal *r, const BoutReal *a, BoutReal b, int n);
+void simd_mul(BoutReal *r, const BoutReal *a, BoutReal b, int n);
+void simd_div(BoutReal *r, const BoutReal *a, BoutReal b, int n);
+void simd_pow(BoutReal *r, const BoutReal *a, BoutReal b, int n);
+
+// r = f(a)
+void simd_sqrt(BoutReal *r, const BoutReal *a, int n);
+void simd_abs(BoutReal *r, const BoutReal *a, int n);
+void simd_exp(BoutReal *r, const BoutReal *a, int n);
+void simd_log(BoutReal *r, const BoutReal *a, int n);
+void simd_sin(BoutReal *r, const BoutReal *a, int n);
+void simd_cos(BoutReal *r, const BoutReal *a, int n);
+
+/// Arakawa Jacobian J(f,g), for use by bracket(). Not OpenMP parallel, so
+/// can be called from inside a parallel loop. Rows are Z lines at X index
+/// jx-1, jx and jx+1, each padded with the periodic neighbours so that
+/// point jz is at row[jz+1]. For i in [0,n), n a multiple of simd_width():
+///   r[i] = scale * J(f,g) at point i
+void simd_arakawa(BoutReal *r, const BoutReal *fm, const BoutReal *fc, const BoutReal *fp,
+                  const BoutReal *gm, const BoutReal *gc, const BoutReal *gp,
+                  int n, BoutReal scale);
+
+#ifdef BOUT_FIELD_FLOAT
+// Single precision storage, computed in BoutReal
+void simd_add(float *r, const float *a, const float *b, int n);
+void simd_sub(float *r, const float *a, const float *b, int n);
+void simd_mul(float *r, const float *a, const float *b, int n);
+void simd_div(float *r, const float *a, const float *b, int n);
+void simd_pow(float *r, const float *a, const float *b, int n);
+
+void simd_add(float *r, const float *a, BoutReal b, int n);
+void simd_sub(float *r, const float *a, BoutReal b, int n);
+void simd_mul(float *r, const float *a, BoutReal b, int n);
+void simd_div(float *r, const float *a, BoutReal b, int n);
+void simd_pow(float *r, const float *a, BoutReal b, int n);
+
+void simd_sqrt(float *r, const float *a, int n);
+void simd_abs(float *r, const float *a, int n);
+void simd_exp(float *r, const float *a, int n);
+void simd_log(float *r, const float *a, int n);
+void simd_sin(float *r, const float *a, int n);
+void simd_cos(float *r, const float *a, int n);
+#endif
+
+#endif // __SIMD_H__
@@ -196,4 +196,55 @@ int next_index3(bindex *bx);
 int next_index2(bindex *bx);
 int next_indexperp(bindex *bx);
 
+/// Precomputed list of indices in a region
+/*!
+  Covers the same points, in the same order, as start_index followed by
+  next_index2 (or next_index3), but with all neighbour indices computed
+  once. Can be looped over with a plain for loop, so the work can be split
+  statically between threads:
+
+    const Region &rgn = getRegion(RGN_NOBNDRY);
+    #pragma omp parallel for
+    for(int i=0;i<rgn.size3D();i++) {
+      bindex bx;
+      rgn.index3(i, bx);
+      ...
+    }
+
+  As with start_index, Y guard cells are never included; RGN_NOBNDRY
+  and RGN_NOX exclude the X guard cells, the other regions include them.
+ */
+class Region {
+ public:
+  Region(REGION rgn);
+
+  /// Number of (x,y) points
+  int size() const { return ind.size(); }
+  /// Number of (x,y,z) points
+  int size3D() const { return ind.size() * ncz; }
+
+  /// Index of (x,y) point i, with jz = 0
+  const bindex& operator[](int i) const { return ind[i]; }
+  /// Set jz and the Z neighbours
+  void setZ(bindex &bx, int jz) const {
+    bx.jz = jz; bx.jzp = zp[jz]; bx.jzm = zm[jz]; bx.jz2p = z2p[jz]; bx.jz2m = z2m[jz];
+  }
+  /// Index of (x,y,z) point i, with Z fastest
+  void index3(int i, bindex &bx) const {
+    bx = ind[i / ncz];
+    setZ(bx, i % ncz);
+  }
+  
+  REGION region;
+ private:
+  int ncz;
+  vector<bindex> ind;
+  vector<int> zp, zm, z2p, z2m;
+};
+
+/// Get the list of indices for a region, created on first use
+const Region& getRegion(REGION rgn);
+/// Delete all regions. Must be called if the mesh changes
+void free_regions();
+
 #endif /* __STENCILS_H__ */
@@ -43,6 +43,21 @@ void free_imatrix(int **m);
 BoutReal ***r3tensor(int nrow, int ncol, int ndep);
 void free_r3tensor(BoutReal ***m);
 
+/// Alignment (in bytes) of contiguous field storage. Suits AVX-512 and cache lines
+#define BOUT_ALIGNMENT 64
+
+BoutReal *aligned_rvector(int size);
+void free_aligned_rvector(BoutReal *v);
+/// Pointer table [nrow][ncol][ndep] over existing contiguous data (not copied)
+BoutReal ***r3view(BoutReal *data, int nrow, int ncol, int ndep);
+void free_r3view(BoutReal ***m);
+#ifdef BOUT_FIELD_FLOAT
+float *aligned_fvector(int size);
+void free_aligned_fvector(float *v);
+float ***r3view(float *data, int nrow, int ncol, int ndep);
+void free_r3view(float ***m);
+#endif
+
 dcomplex **cmatrix(int nrow, int ncol);
 void free_cmatrix(dcomplex** cm);
 
@@ -93,8 +93,8 @@ class Vector3D : public FieldData {
   const Vector3D operator/(const Field2D &rhs) const;
   const Vector3D operator/(const Field3D &rhs) const;
 
-  const Field3D operator*(const Vector3D &rhs) const; // Dot product
-  const Field3D operator*(const Vector2D &rhs) const;
+  Field3D operator*(const Vector3D &rhs) const; // Dot product
+  Field3D operator*(const Vector2D &rhs) const;
   
   const Vector3D operator^(const Vector3D &rhs) const; // Cross product
   const Vector3D operator^(const Vector2D &rhs) const;
@@ -110,20 +110,24 @@ class Vector3D : public FieldData {
   const Vector3D shiftZ(const BoutReal zangle) const;
 
   // Non-member functions
-  friend const Field3D abs(const Vector3D &v);
+  friend Field3D abs(const Vector3D &v);
 
   // FieldData virtual functions
   
   bool isReal() const   { return true; }
   bool is3D() const     { return true; }
-  int  byteSize() const { return 3*sizeof(BoutReal); }
+  int  byteSize() const { return 3*sizeof(FieldReal); }
   int  BoutRealSize() const { return 3; }
   int  getData(int jx, int jy, int jz, void *vptr) const;
   int  getData(int jx, int jy, int jz, BoutReal *rptr) const;
   int  setData(int jx, int jy, int jz, void *vptr);
   int  setData(int jx, int jy, int jz, BoutReal *rptr);
 
+#ifdef BOUT_FIELD_FLOAT
+  bool ioSupport() { return false; } // Component data is not BoutReal
+#else
   bool ioSupport() { return true; }
+#endif
   const string getSuffix(int component) const {
     if(covariant) {
       switch(component) {
@@ -159,6 +163,7 @@ class Vector3D : public FieldData {
       toContravariant();
   }
   BoutReal *getData(int component) {
+#ifndef BOUT_FIELD_FLOAT
     switch(component) {
     case 0:
       return **(x.getData());
@@ -167,6 +172,7 @@ class Vector3D : public FieldData {
     case 2:
       return **(z.getData());
     }
+#endif
     return NULL;
   }
   void zeroComponent(int component) {
@@ -29,11 +29,11 @@
 #include "field3d.hxx"
 #include "field2d.hxx"
 
-const Field3D where(const Field2D &test, const Field3D &gt0, const Field3D &le0);
-const Field3D where(const Field2D &test, const Field3D &gt0, BoutReal le0);
-const Field3D where(const Field2D &test, BoutReal gt0, const Field3D &le0);
-const Field3D where(const Field2D &test, const Field3D &gt0, const Field2D &le0);
-const Field3D where(const Field2D &test, const Field2D &gt0, const Field3D &le0);
+Field3D where(const Field2D &test, const Field3D &gt0, const Field3D &le0);
+Field3D where(const Field2D &test, const Field3D &gt0, BoutReal le0);
+Field3D where(const Field2D &test, BoutReal gt0, const Field3D &le0);
+Field3D where(const Field2D &test, const Field3D &gt0, const Field2D &le0);
+Field3D where(const Field2D &test, const Field2D &gt0, const Field3D &le0);
 
 #endif // __WHERE_H__
 
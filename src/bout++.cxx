@@ -56,6 +56,7 @@ static char help[] = "BOUT++: Uses finite difference methods to solve plasma flu
 #include <utils.hxx>
 #include <invert_laplace.hxx>
 #include <interpolation.hxx>
+#include <fft.hxx>
 #include <boutmesh.hxx>
 #include <boutexception.hxx>
 #include <optionsreader.hxx>
@@ -274,6 +275,12 @@ int bout_init(int argc, char **argv)
       output.write("Failed to initialise derivative methods. Aborting\n");
       return(1);
     }
+
+    /// Setup FFT planning, and read FFTW wisdom
+    fft_init();
+
+    /// Setup Field3D memory pool
+    Field3D::initPool();
   
     ////////////////////////////////////////////
 
@@ -430,12 +437,21 @@ int bout_finish()
   // Delete the mesh
   delete mesh;
 
-  // Delete 3D field memory
+  // Print memory usage, then delete 3D field memory
+  int live, nfree, peak;
+  Field3D::poolStats(live, nfree, peak);
+  output.write("Field3D blocks: %d in use, %d free, peak %d\n", live, nfree, peak);
   Field3D::cleanup();
+
+  // Delete precomputed index regions
+  free_regions();
   
   // Cleanup boundary factory
   BoundaryFactory::cleanup();
 
+  // Save FFTW wisdom and free plans
+  fft_cleanup();
+
   // close MPI
   //Dirty, dirty hack
 #ifdef BOUT_HAS_PETSC
@@ -474,6 +490,7 @@ int bout_monitor(BoutReal t, int iter, int NOUT)
   static bool first_time = true;
   static BoutReal wtime = 0.0;       ///< Wall-time since last output
   static BoutReal wall_limit, mpi_start_time; // Keep track of remaining wall time
+  static bool trim_on_output; // Free unused Field3D blocks after each output
 
 #ifdef CHECK
   int msg_point = msg_stack.push("bout_monitor(%e, %d, %d)", t, iter, NOUT);
@@ -505,6 +522,7 @@ int bout_monitor(BoutReal t, int iter, int NOUT)
     Options *options = Options::getRoot();
     OPTION(options, wall_limit, -1.0); // Wall time limit. By default, no limit
     wall_limit *= 60.0*60.0;  // Convert from hours to seconds
+    options->getSection("field3d")->get("trim_on_output", trim_on_output, false);
     
     /// Record the starting time
     mpi_start_time = MPI_Wtime(); // NB: Miss time for first step (can be big!)
@@ -552,6 +570,9 @@ int bout_monitor(BoutReal t, int iter, int NOUT)
     } 
   }
 
+  if(trim_on_output)
+    Field3D::trimPool();
+
   /// Reset clocks for next timestep
   
   mesh->wtime_comms = 0.0; // Reset communicator clock
@@ -39,6 +39,11 @@
 #include <cmath>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+
+#ifdef BOUT_HAS_RVALUE_REFS
+#include <utility>
+#endif
 
 Field2D::Field2D()
 {
@@ -464,98 +469,129 @@ const Field2D Field2D::operator^(const BoutReal rhs) const {
 
 ///////////// Left binary operators ////////////////
 
-const Field3D Field2D::operator+(const Field3D &other) const {
+Field3D Field2D::operator+(const Field3D &other) const {
   // just turn operator around
   return(other + (*this));
 }
 
-const Field3D Field2D::operator-(const Field3D &other) const {
-  Field3D result = other;
-  BoutReal ***d;
-
-  d = result.getData();
-
-#ifdef CHECK
-  if(d == (BoutReal***) NULL)
-    throw BoutException("Field2D: - operator has invalid Fiel3D argument");
-  if(data == (BoutReal**) NULL)
-    throw BoutException("Field2D: - operates on empty data");
-#endif
+Field3D Field2D::operator-(const Field3D &other) const {
+  Field3D result;
+  result.allocate(); // New block, so other is not copied
+  bcastOp(result, other, '-');
 
 #ifdef TRACK
   result.name = "(" + name + "-" + other.name + ")";
 #endif  
 
-  #pragma omp parallel for
-  for(int jx=0;jx<mesh->ngx;jx++)
-    for(int jy=0;jy<mesh->ngy;jy++)
-      for(int jz=0;jz<mesh->ngz;jz++)
-	d[jx][jy][jz] = data[jx][jy] - d[jx][jy][jz];
-
-  result.setLocation( other.getLocation() );
-
   return(result);
 }
 
-const Field3D Field2D::operator*(const Field3D &other) const {
+Field3D Field2D::operator*(const Field3D &other) const {
   // turn operator around
   return(other * (*this));
 }
 
-const Field3D Field2D::operator/(const Field3D &other) const {
-  Field3D result = other;
-  BoutReal ***d;
-
-  d = result.getData();
-
-#ifdef CHECK
-  if(d == (BoutReal***) NULL)
-    throw BoutException("Field2D: / operator has invalid Fiel3D argument");
-  if(data == (BoutReal**) NULL)
-    throw BoutException("Field2D: / operates on empty data");
-#endif  
+Field3D Field2D::operator/(const Field3D &other) const {
+  Field3D result;
+  result.allocate();
+  bcastOp(result, other, '/');
 
 #ifdef TRACK
   result.name = "(" + name + "/" + other.name + ")";
 #endif
 
-  #pragma omp parallel for
-  for(int jx=0;jx<mesh->ngx;jx++)
-    for(int jy=0;jy<mesh->ngy;jy++)
-      for(int jz=0;jz<mesh->ngz;jz++)
-	d[jx][jy][jz] = data[jx][jy] / d[jx][jy][jz];
+  return(result);
+}
 
-  result.setLocation( other.getLocation() );
+Field3D Field2D::operator^(const Field3D &other) const {
+  Field3D result;
+  result.allocate();
+  bcastOp(result, other, '^');
+
+#ifdef TRACK
+  result.name = "(" + name + "^" + other.name + ")";
+#endif  
 
   return(result);
 }
 
-const Field3D Field2D::operator^(const Field3D &other) const {
-  Field3D result = other;
-  BoutReal ***d;
+#ifdef BOUT_HAS_RVALUE_REFS
+Field3D Field2D::operator+(Field3D &&other) const {
+  return std::move(other) + (*this);
+}
 
-  d = result.getData();
+Field3D Field2D::operator-(Field3D &&other) const {
+  if((other.block == NULL) || (other.block->refs > 1))
+    return (*this) - static_cast<const Field3D&>(other);
+  bcastOp(other, other, '-');
+#ifdef TRACK
+  other.name = "(" + name + "-" + other.name + ")";
+#endif
+  return std::move(other);
+}
+
+Field3D Field2D::operator*(Field3D &&other) const {
+  return std::move(other) * (*this);
+}
+
+Field3D Field2D::operator/(Field3D &&other) const {
+  if((other.block == NULL) || (other.block->refs > 1))
+    return (*this) / static_cast<const Field3D&>(other);
+  bcastOp(other, other, '/');
+#ifdef TRACK
+  other.name = "(" + name + "/" + other.name + ")";
+#endif
+  return std::move(other);
+}
+
+Field3D Field2D::operator^(Field3D &&other) const {
+  if((other.block == NULL) || (other.block->refs > 1))
+    return (*this) ^ static_cast<const Field3D&>(other);
+  bcastOp(other, other, '^');
+#ifdef TRACK
+  other.name = "(" + name + "^" + other.name + ")";
+#endif
+  return std::move(other);
+}
+#endif
 
+void Field2D::bcastOp(Field3D &result, const Field3D &f, char op) const {
 #ifdef CHECK
-  if(d == (BoutReal***) NULL)
-    throw BoutException("Field2D: ^ operator has invalid Fiel3D argument");
+  if(f.block == NULL)
+    throw BoutException("Field2D: %c operator has invalid Field3D argument", op);
   if(data == (BoutReal**) NULL)
-    throw BoutException("Field2D: ^ operates on empty data");
+    throw BoutException("Field2D: %c operates on empty data", op);
 #endif
 
-#ifdef TRACK
-  result.name = "(" + name + "^" + other.name + ")";
-#endif  
-  
-  #pragma omp parallel for
-  for(int jx=0;jx<mesh->ngx;jx++)
-    for(int jy=0;jy<mesh->ngy;jy++)
-      for(int jz=0;jz<mesh->ngz;jz++)
-	d[jx][jy][jz] = pow(data[jx][jy], d[jx][jy][jz]);
+  const BoutReal *d2 = data[0];
+  const FieldReal *fd = f.block->raw;
+  FieldReal *r = result.block->raw;
+  int nz = mesh->ngz;
 
-  result.setLocation( other.getLocation() );
+  #pragma omp parallel for
+  for(int jxy=0;jxy<mesh->ngx*mesh->ngy;jxy++) {
+    BoutReal val = d2[jxy];
+    int i = jxy*nz;
+    switch(op) {
+    case '-': {
+      for(int jz=0;jz<nz;jz++)
+        r[i+jz] = val - fd[i+jz];
+      break;
+    }
+    case '/': {
+      for(int jz=0;jz<nz;jz++)
+        r[i+jz] = val / fd[i+jz];
+      break;
+    }
+    case '^': {
+      for(int jz=0;jz<nz;jz++)
+        r[i+jz] = pow(val, (BoutReal) fd[i+jz]);
+      break;
+    }
+    }
+  }
 
-  return(result);
+  result.setLocation( f.getLocation() );
 }
 
 const FieldPerp Field2D::operator+(const FieldPerp &other) const {
@@ -883,8 +919,7 @@ int Field2D::getData(int x, int y, int z, void *vptr) const {
     throw BoutException("Field2D: getData (%d,%d,%d) out of bounds\n", x, y, z);
   }
 #endif
-  BoutReal *ptr = (BoutReal*) vptr;
-  *ptr = data[x][y];
+  memcpy(vptr, &(data[x][y]), sizeof(BoutReal)); // Buffer may not be aligned
   
   return sizeof(BoutReal);
 }
@@ -914,8 +949,7 @@ int Field2D::setData(int x, int y, int z, void *vptr) {
     throw BoutException("Field2D: setData (%d,%d,%d) out of bounds\n", x, y, z);
   }
 #endif
-  BoutReal *ptr = (BoutReal*) vptr;
-  data[x][y] = *ptr;
+  memcpy(&(data[x][y]), vptr, sizeof(BoutReal));
   
   return sizeof(BoutReal);
 }
@@ -26,6 +26,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
 #include <field3d.hxx>
@@ -36,6 +37,34 @@
 #include <boundary_op.hxx>
 #include <boundary_factory.hxx>
 #include <boutexception.hxx>
+#include <simd.hxx>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef BOUT_HAS_RVALUE_REFS
+#include <utility>
+#endif
+
+/// Allocate contiguous storage for nelem FieldReals
+static FieldReal* alloc_raw(int nelem)
+{
+#ifdef BOUT_FIELD_FLOAT
+  return aligned_fvector(nelem);
+#else
+  return aligned_rvector(nelem);
+#endif
+}
+
+static void free_raw(FieldReal *raw)
+{
+#ifdef BOUT_FIELD_FLOAT
+  free_aligned_fvector(raw);
+#else
+  free_aligned_rvector(raw);
+#endif
+}
 
 /// Constructor
 Field3D::Field3D() : background(NULL)
@@ -72,6 +101,7 @@ Field3D::Field3D(const Field3D& f) : background(NULL)
   /// Copy a reference to the block
   block = f.block;
   /// Increase reference count
+  #pragma omp atomic
   block->refs++;
 
   location = f.location;
@@ -85,6 +115,25 @@ Field3D::Field3D(const Field3D& f) : background(NULL)
 #endif
 }
 
+#ifdef BOUT_HAS_RVALUE_REFS
+/// Takes the data from f, leaving it unallocated
+Field3D::Field3D(Field3D &&f) : background(NULL)
+{
+#ifdef TRACK
+  name = f.name;
+#endif
+
+  block = f.block;
+  f.block = NULL;
+  
+  location = f.location;
+  
+  ddt = NULL;
+  
+  boundaryIsSet = false;
+}
+#endif
+
 Field3D::Field3D(const Field2D& f) : background(NULL)
 {
 #ifdef CHECK
@@ -151,7 +200,7 @@ void Field3D::allocate() const
   allocData();
 }
 
-BoutReal*** Field3D::getData() const
+FieldReal*** Field3D::getData() const
 {
 #ifdef CHECK
   if(block ==  NULL)
@@ -167,6 +216,19 @@ BoutReal*** Field3D::getData() const
   return(block->data);
 }
 
+FieldReal* Field3D::getRaw() const
+{
+#ifdef CHECK
+  if(block ==  NULL)
+    throw BoutException("Field3D: getRaw() returning null pointer\n");
+#endif
+  
+  // User might alter data, so need to make unique
+  allocate();
+
+  return(block->raw);
+}
+
 Field3D* Field3D::timeDeriv()
 {
   if(ddt == NULL)
@@ -229,7 +291,7 @@ CELL_LOC Field3D::getLocation() const
  *                         OPERATORS 
  ***************************************************************/
 
-BoutReal** Field3D::operator[](int jx) const
+FieldReal** Field3D::operator[](int jx) const
 {
 #ifdef CHECK
   if(block == NULL)
@@ -245,7 +307,7 @@ BoutReal** Field3D::operator[](int jx) const
   return(block->data[jx]);
 }
 
-BoutReal& Field3D::operator[](bindex &bx) const
+FieldReal& Field3D::operator[](bindex &bx) const
 {
 #ifdef CHECK
   if(block == NULL) {
@@ -288,6 +350,7 @@ Field3D & Field3D::operator=(const Field3D &rhs) {
 
   /// Copy reference, don't copy data
   block = rhs.block;
+  #pragma omp atomic
   block->refs++;
   
   location = rhs.location;
@@ -299,6 +362,36 @@ Field3D & Field3D::operator=(const Field3D &rhs) {
   return(*this);
 }
 
+#ifdef BOUT_HAS_RVALUE_REFS
+Field3D & Field3D::operator=(Field3D &&rhs) {
+  if(this == &rhs)
+    return(*this);
+
+#ifdef CHECK
+  msg_stack.push("Field3D: Move assignment");
+  rhs.checkData(true);
+#endif
+
+#ifdef TRACK
+  name = rhs.name;
+#endif
+
+  freeData();
+
+  /// Take the block, no change in reference count
+  block = rhs.block;
+  rhs.block = NULL;
+  
+  location = rhs.location;
+
+#ifdef CHECK
+  msg_stack.pop();
+#endif
+
+  return(*this);
+}
+#endif
+
 Field3D & Field3D::operator=(const Field2D &rhs) {
   BoutReal **d;
 
@@ -313,15 +406,24 @@ Field3D & Field3D::operator=(const Field2D &rhs) {
   name = "F3D("+rhs.name+")";
 #endif
 
+  if((block != NULL) && (block->refs > 1)) {
+    // Shared data will be overwritten, so no need to copy it
+    freeData();
+  }
   allocate();
 
-  /// Copy data
+  /// Broadcast the 2D data in Z, reading each value once
+  
+  FieldReal *r = block->raw;
+  const BoutReal *d2 = d[0];
+  int nz = mesh->ngz;
 
   #pragma omp parallel for
-  for(int jx=0;jx<mesh->ngx;jx++)
-    for(int jy=0;jy<mesh->ngy;jy++)
-      for(int jz=0;jz<mesh->ngz;jz++)
-	block->data[jx][jy][jz] = d[jx][jy];
+  for(int jxy=0;jxy<mesh->ngx*mesh->ngy;jxy++) {
+    BoutReal val = d2[jxy];
+    for(int jz=0;jz<nz;jz++)
+      r[jxy*nz + jz] = val;
+  }
 
   /// Only 3D fields have locations
   //location = CELL_CENTRE;
@@ -402,10 +504,8 @@ BoutReal Field3D::operator=(const BoutReal val) {
 #endif
 
   #pragma omp parallel for
-  for(int jx=0;jx<mesh->ngx;jx++)
-    for(int jy=0;jy<mesh->ngy;jy++)
-      for(int jz=0;jz<mesh->ngz;jz++)
-	block->data[jx][jy][jz] = val;
+  for(int i=0;i<mesh->ngx*mesh->ngy*mesh->ngz;i++)
+    block->raw[i] = val;
 
   // Only 3D fields have locations
   //location = CELL_CENTRE;
@@ -438,19 +538,15 @@ Field3D & Field3D::operator+=(const Field3D &rhs) {
 
   if(block->refs == 1) {
     // This is the only reference to this data
-    #pragma omp parallel for
-    for(int i=0;i<mesh->ngx*mesh->ngy*mesh->ngz;i++)
-      block->data[0][0][i] += rhs.block->data[0][0][i];
+    simd_add(block->raw, block->raw, rhs.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
   }else {
     // Need to put result in a new block
 
     memblock3d *nb = newBlock();
 
-    #pragma omp parallel for
-    for(int i=0;i<mesh->ngx*mesh->ngy*mesh->ngz;i++)
-      nb->data[0][0][i] = block->data[0][0][i] + rhs.block->data[0][0][i];
+    simd_add(nb->raw, block->raw, rhs.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
 
-    block->refs--;
+    freeData();
     block = nb;
   }
 
@@ -492,7 +588,7 @@ Field3D & Field3D::operator+=(const Field2D &rhs) {
 	for(int jz=0;jz<mesh->ngz;jz++)
 	  nb->data[jx][jy][jz] = block->data[jx][jy][jz] + d[jx][jy];
 
-    block->refs--;
+    freeData();
     block = nb;
   }
 
@@ -518,21 +614,13 @@ Field3D & Field3D::operator+=(const BoutReal &rhs) {
 #endif
 
   if(block->refs == 1) {
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  block->data[jx][jy][jz] += rhs;
+    simd_add(block->raw, block->raw, rhs, mesh->ngx*mesh->ngy*mesh->ngz);
   }else {
     memblock3d *nb = newBlock();
     
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  nb->data[jx][jy][jz] = block->data[jx][jy][jz] + rhs;
+    simd_add(nb->raw, block->raw, rhs, mesh->ngx*mesh->ngy*mesh->ngz);
 
-    block->refs--;
+    freeData();
     block = nb;
   }
 
@@ -565,21 +653,13 @@ Field3D & Field3D::operator-=(const Field3D &rhs) {
 #endif
 
   if(block->refs == 1) {
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  block->data[jx][jy][jz] -= rhs.block->data[jx][jy][jz];
+    simd_sub(block->raw, block->raw, rhs.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
   }else {
     memblock3d *nb = newBlock();
     
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  nb->data[jx][jy][jz] = block->data[jx][jy][jz] - rhs.block->data[jx][jy][jz];
+    simd_sub(nb->raw, block->raw, rhs.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
 
-    block->refs--;
+    freeData();
     block = nb;
   }
   
@@ -621,7 +701,7 @@ Field3D & Field3D::operator-=(const Field2D &rhs) {
 	for(int jz=0;jz<mesh->ngz;jz++)
 	  nb->data[jx][jy][jz] = block->data[jx][jy][jz] - d[jx][jy];
 
-    block->refs--;
+    freeData();
     block = nb;
   }
 
@@ -646,21 +726,13 @@ Field3D & Field3D::operator-=(const BoutReal &rhs) {
 #endif
   
   if(block->refs == 1) {
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  block->data[jx][jy][jz] -= rhs;
+    simd_sub(block->raw, block->raw, rhs, mesh->ngx*mesh->ngy*mesh->ngz);
   }else {
     memblock3d *nb = newBlock();
     
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  nb->data[jx][jy][jz] = block->data[jx][jy][jz] - rhs;
+    simd_sub(nb->raw, block->raw, rhs, mesh->ngx*mesh->ngy*mesh->ngz);
 
-    block->refs--;
+    freeData();
     block = nb;
   }
   
@@ -694,21 +766,13 @@ Field3D & Field3D::operator*=(const Field3D &rhs) {
 #endif
 
   if(block->refs == 1) {
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  block->data[jx][jy][jz] *= rhs.block->data[jx][jy][jz];
+    simd_mul(block->raw, block->raw, rhs.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
   }else {
     memblock3d *nb = newBlock();
     
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  nb->data[jx][jy][jz] = block->data[jx][jy][jz] * rhs.block->data[jx][jy][jz];
+    simd_mul(nb->raw, block->raw, rhs.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
 
-    block->refs--;
+    freeData();
     block = nb;
   }
 
@@ -748,7 +812,7 @@ Field3D & Field3D::operator*=(const Field2D &rhs) {
       for(int jz=0;jz<mesh->ngz;jz++)
         nb->data[0][i][jz] = block->data[0][i][jz] * d[0][i];
 
-    block->refs--;
+    freeData();
     block = nb;
   }
 
@@ -774,22 +838,14 @@ Field3D & Field3D::operator*=(const BoutReal rhs) {
 #endif
 
   if(block->refs == 1) {
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  block->data[jx][jy][jz] *= rhs;
+    simd_mul(block->raw, block->raw, rhs, mesh->ngx*mesh->ngy*mesh->ngz);
 
   }else {
     memblock3d *nb = newBlock();
 
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  nb->data[jx][jy][jz] = block->data[jx][jy][jz] * rhs;
+    simd_mul(nb->raw, block->raw, rhs, mesh->ngx*mesh->ngy*mesh->ngz);
 
-    block->refs--;
+    freeData();
     block = nb;
   }
 
@@ -827,22 +883,14 @@ Field3D & Field3D::operator/=(const Field3D &rhs) {
 #endif
 
   if(block->refs == 1) {
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  block->data[jx][jy][jz] /= rhs.block->data[jx][jy][jz];
+    simd_div(block->raw, block->raw, rhs.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
     
   }else {
     memblock3d *nb = newBlock();
 
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  nb->data[jx][jy][jz] = block->data[jx][jy][jz] / rhs.block->data[jx][jy][jz];
+    simd_div(nb->raw, block->raw, rhs.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
 
-    block->refs--;
+    freeData();
     block = nb;
   }
 
@@ -893,7 +941,7 @@ Field3D & Field3D::operator/=(const Field2D &rhs) {
 	//nb->data[jx][jy][jz] = block->data[jx][jy][jz] / d[jx][jy];
       }
 
-    block->refs--;
+    freeData();
     block = nb;
   }
   
@@ -920,21 +968,13 @@ Field3D & Field3D::operator/=(const BoutReal rhs) {
   BoutReal val = 1.0 / rhs; // Because multiplication faster than division
   
   if(block->refs == 1) {
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  block->data[jx][jy][jz] *= val;
+    simd_mul(block->raw, block->raw, val, mesh->ngx*mesh->ngy*mesh->ngz);
   }else {
     memblock3d *nb = newBlock();
     
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  nb->data[jx][jy][jz] = block->data[jx][jy][jz] * val;
+    simd_mul(nb->raw, block->raw, val, mesh->ngx*mesh->ngy*mesh->ngz);
 
-    block->refs--;
+    freeData();
     block = nb;
   }
   
@@ -972,22 +1012,14 @@ Field3D & Field3D::operator^=(const Field3D &rhs) {
 #endif
 
   if(block->refs == 1) {
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  block->data[jx][jy][jz] = pow(block->data[jx][jy][jz], rhs.block->data[jx][jy][jz]);
+    simd_pow(block->raw, block->raw, rhs.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
 
   }else {
     memblock3d *nb = newBlock();
     
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  nb->data[jx][jy][jz] = pow(block->data[jx][jy][jz], rhs.block->data[jx][jy][jz]);
+    simd_pow(nb->raw, block->raw, rhs.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
     
-    block->refs--;
+    freeData();
     block = nb;
   }
 
@@ -1029,7 +1061,7 @@ Field3D & Field3D::operator^=(const Field2D &rhs) {
 	for(int jz=0;jz<mesh->ngz;jz++)
 	  nb->data[jx][jy][jz] = pow(block->data[jx][jy][jz], d[jx][jy]);
 
-    block->refs--;
+    freeData();
     block = nb;
   }
   
@@ -1054,22 +1086,14 @@ Field3D & Field3D::operator^=(const BoutReal rhs) {
 #endif
 
   if(block->refs == 1) {
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  block->data[jx][jy][jz] = pow(block->data[jx][jy][jz], rhs);
+    simd_pow(block->raw, block->raw, rhs, mesh->ngx*mesh->ngy*mesh->ngz);
 
   }else {
     memblock3d *nb = newBlock();
     
-    #pragma omp parallel for
-    for(int jx=0;jx<mesh->ngx;jx++)
-      for(int jy=0;jy<mesh->ngy;jy++)
-	for(int jz=0;jz<mesh->ngz;jz++)
-	  nb->data[jx][jy][jz] = pow(block->data[jx][jy][jz], rhs);
+    simd_pow(nb->raw, block->raw, rhs, mesh->ngx*mesh->ngy*mesh->ngz);
 
-    block->refs--;
+    freeData();
     block = nb;
   }
   
@@ -1087,7 +1111,7 @@ Field3D & Field3D::operator^=(const BoutReal rhs) {
 
 /////////////////// ADDITION ///////////////////
 
-const Field3D Field3D::operator+() const
+Field3D Field3D::operator+() const BOUT_LVALUE_THIS
 {
   Field3D result = *this;
 
@@ -1099,14 +1123,14 @@ const Field3D Field3D::operator+() const
 }
 
 
-const Field3D Field3D::operator+(const Field3D &other) const
+Field3D Field3D::operator+(const Field3D &other) const BOUT_LVALUE_THIS
 {
   Field3D result = *this;
   result += other;
   return(result);
 }
 
-const Field3D Field3D::operator+(const Field2D &other) const
+Field3D Field3D::operator+(const Field2D &other) const BOUT_LVALUE_THIS
 {
   Field3D result = *this;
   result += other;
@@ -1120,7 +1144,7 @@ const FieldPerp Field3D::operator+(const FieldPerp &other) const
   return(result);
 }
 
-const Field3D Field3D::operator+(const BoutReal &rhs) const
+Field3D Field3D::operator+(const BoutReal &rhs) const BOUT_LVALUE_THIS
 {
   Field3D result = *this;
   result += rhs;
@@ -1129,7 +1153,7 @@ const Field3D Field3D::operator+(const BoutReal &rhs) const
 
 /////////////////// SUBTRACTION ////////////////
 
-const Field3D Field3D::operator-() const
+Field3D Field3D::operator-() const BOUT_LVALUE_THIS
 {
   Field3D result = *this;
 
@@ -1142,14 +1166,14 @@ const Field3D Field3D::operator-() const
   return result;
 }
 
-const Field3D Field3D::operator-(const Field3D &other) const
+Field3D Field3D::operator-(const Field3D &other) const BOUT_LVALUE_THIS
 {
   Field3D result = *this;
   result -= other;
   return(result);
 }
 
-const Field3D Field3D::operator-(const Field2D &other) const
+Field3D Field3D::operator-(const Field2D &other) const BOUT_LVALUE_THIS
 {
   Field3D result = *this;
   result -= other;
@@ -1175,7 +1199,7 @@ const FieldPerp Field3D::operator-(const FieldPerp &other) const {
   return(result);
 }
 
-const Field3D Field3D::operator-(const BoutReal &rhs) const
+Field3D Field3D::operator-(const BoutReal &rhs) const BOUT_LVALUE_THIS
 {
   Field3D result = *this;
   result -= rhs;
@@ -1184,14 +1208,14 @@ const Field3D Field3D::operator-(const BoutReal &rhs) const
 
 ///////////////// MULTIPLICATION ///////////////
 
-const Field3D Field3D::operator*(const Field3D &other) const
+Field3D Field3D::operator*(const Field3D &other) const BOUT_LVALUE_THIS
 {
   Field3D result = *this;
   result *= other;
   return(result);
 }
 
-const Field3D Field3D::operator*(const Field2D &other) const
+Field3D Field3D::operator*(const Field2D &other) const BOUT_LVALUE_THIS
 {
   Field3D result = *this;
   result *= other;
@@ -1205,7 +1229,7 @@ const FieldPerp Field3D::operator*(const FieldPerp &other) const
   return(result);
 }
 
-const Field3D Field3D::operator*(const BoutReal rhs) const
+Field3D Field3D::operator*(const BoutReal rhs) const BOUT_LVALUE_THIS
 {
   Field3D result = *this;
   result *= rhs;
@@ -1214,14 +1238,14 @@ const Field3D Field3D::operator*(const BoutReal rhs) const
 
 //////////////////// DIVISION ////////////////////
 
-const Field3D Field3D::operator/(const Field3D &other) const
+Field3D Field3D::operator/(const Field3D &other) const BOUT_LVALUE_THIS
 {
   Field3D result = *this;
   result /= other;
   return(result);
 }
 
-const Field3D Field3D::operator/(const Field2D &other) const
+Field3D Field3D::operator/(const Field2D &other) const BOUT_LVALUE_THIS
 {
   Field3D result = *this;
   result /= other;
@@ -1251,7 +1275,7 @@ const FieldPerp Field3D::operator/(const FieldPerp &other) const {
   return(result);
 }
 
-const Field3D Field3D::operator/(const BoutReal rhs) const {
+Field3D Field3D::operator/(const BoutReal rhs) const BOUT_LVALUE_THIS {
   Field3D result = *this;
   result /= rhs;
   return(result);
@@ -1259,13 +1283,13 @@ const Field3D Field3D::operator/(const BoutReal rhs) const {
 
 ////////////// EXPONENTIATION /////////////////
 
-const Field3D Field3D::operator^(const Field3D &other) const {
+Field3D Field3D::operator^(const Field3D &other) const BOUT_LVALUE_THIS {
   Field3D result = *this;
   result ^= other;
   return(result);
 }
 
-const Field3D Field3D::operator^(const Field2D &other) const {
+Field3D Field3D::operator^(const Field2D &other) const BOUT_LVALUE_THIS {
   Field3D result = *this;
   result ^= other;
   return(result);
@@ -1294,12 +1318,157 @@ const FieldPerp Field3D::operator^(const FieldPerp &other) const {
   return(result);
 }
 
-const Field3D Field3D::operator^(const BoutReal rhs) const {
+Field3D Field3D::operator^(const BoutReal rhs) const BOUT_LVALUE_THIS {
   Field3D result = *this;
   result ^= rhs;
   return(result);
 }
 
+/***************************************************************
+ *              OPERATORS ON EXPIRING VALUES
+ *
+ * Temporaries are modified in place, so chained expressions such
+ * as a*b + c*d - e only allocate blocks for the first products
+ ***************************************************************/
+
+#ifdef BOUT_HAS_RVALUE_REFS
+
+Field3D Field3D::operator+() &&
+{
+  return std::move(*this);
+}
+
+Field3D Field3D::operator-() &&
+{
+  (*this) *= -1.0;
+#ifdef TRACK
+  name = "(-"+name+")";
+#endif
+  return std::move(*this);
+}
+
+Field3D Field3D::operator+(const Field3D &other) &&
+{
+  (*this) += other;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator+(const Field2D &other) &&
+{
+  (*this) += other;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator+(const BoutReal &rhs) &&
+{
+  (*this) += rhs;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator-(const Field3D &other) &&
+{
+  (*this) -= other;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator-(const Field2D &other) &&
+{
+  (*this) -= other;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator-(const BoutReal &rhs) &&
+{
+  (*this) -= rhs;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator*(const Field3D &other) &&
+{
+  (*this) *= other;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator*(const Field2D &other) &&
+{
+  (*this) *= other;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator*(const BoutReal rhs) &&
+{
+  (*this) *= rhs;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator/(const Field3D &other) &&
+{
+  (*this) /= other;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator/(const Field2D &other) &&
+{
+  (*this) /= other;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator/(const BoutReal rhs) &&
+{
+  (*this) /= rhs;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator^(const Field3D &other) &&
+{
+  (*this) ^= other;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator^(const Field2D &other) &&
+{
+  (*this) ^= other;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator^(const BoutReal rhs) &&
+{
+  (*this) ^= rhs;
+  return std::move(*this);
+}
+
+/// Commutative operators can reuse the right-hand side, if at the same location
+
+Field3D Field3D::operator+(Field3D &&other) const &
+{
+  if(other.location != location)
+    return (*this) + static_cast<const Field3D&>(other);
+  other += (*this);
+  return std::move(other);
+}
+
+Field3D Field3D::operator+(Field3D &&other) &&
+{
+  (*this) += other;
+  return std::move(*this);
+}
+
+Field3D Field3D::operator*(Field3D &&other) const &
+{
+  if(other.location != location)
+    return (*this) * static_cast<const Field3D&>(other);
+  other *= (*this);
+  return std::move(other);
+}
+
+Field3D Field3D::operator*(Field3D &&other) &&
+{
+  (*this) *= other;
+  return std::move(*this);
+}
+
+#endif // BOUT_HAS_RVALUE_REFS
+
 /***************************************************************
  *                         STENCILS
  ***************************************************************/
@@ -1605,7 +1774,53 @@ void Field3D::shiftZ(int jx, int jy, double zangle)
   block->data[jx][jy][ncz] = block->data[jx][jy][0];
 }
 
-const Field3D Field3D::shiftZ(const Field2D zangle) const {
+/// Shift all lines of in into out. The phases are either from table
+/// (conjugated if reverse), or computed for zangle (if not NULL) or angle
+static void shiftZLines(const FieldReal *in, FieldReal *out, const dcomplex *table, bool reverse,
+                        const Field2D *zangle, BoutReal angle)
+{
+  int ncz = mesh->ngz-1;
+  int nk = ncz/2 + 1;
+  int nlines = mesh->ngx*mesh->ngy;
+  
+  static dcomplex *v = (dcomplex*) NULL;
+  static int size = 0;
+  if(size != nlines*nk) {
+    if(v != (dcomplex*) NULL)
+      delete[] v;
+    size = nlines*nk;
+    v = new dcomplex[size];
+  }
+  
+  rfft_many(in, ncz, nlines, mesh->ngz, v); // Forward FFT
+  
+  // Apply phase shift
+  #pragma omp parallel for
+  for(int i=0;i<nlines;i++) {
+    if(table != NULL) {
+      const dcomplex *ph = table + i*nk;
+      if(reverse) {
+        for(int jz=1;jz<nk;jz++)
+          v[i*nk + jz] *= conj(ph[jz]);
+      }else
+        for(int jz=1;jz<nk;jz++)
+          v[i*nk + jz] *= ph[jz];
+      continue;
+    }
+    BoutReal zang = (zangle != NULL) ? (*zangle)[i / mesh->ngy][i % mesh->ngy] : angle;
+    for(int jz=1;jz<nk;jz++) {
+      BoutReal kwave=jz*2.0*PI/mesh->zlength; // wave number is 1/[rad]
+      v[i*nk + jz] *= dcomplex(cos(kwave*zang) , -sin(kwave*zang));
+    }
+  }
+  
+  irfft_many(v, ncz, nlines, out, mesh->ngz); // Reverse FFT
+  
+  for(int i=0;i<nlines;i++)
+    out[i*mesh->ngz + ncz] = out[i*mesh->ngz];
+}
+
+Field3D Field3D::shiftZ(const Field2D zangle) const {
   Field3D result;
 
 #ifdef CHECK
@@ -1613,13 +1828,13 @@ const Field3D Field3D::shiftZ(const Field2D zangle) const {
   checkData();
 #endif
 
-  result = *this;
-
-  #pragma omp parallel for
-  for(int jx=0;jx<mesh->ngx;jx++) {
-    for(int jy=0;jy<mesh->ngy;jy++) {
-      result.shiftZ(jx, jy, zangle[jx][jy]);
-    }
+  if(mesh->ngz-1 == 1) {
+    result = *this;
+  }else {
+    // Transform all lines at once
+    result.allocate();
+    result.location = location;
+    shiftZLines(block->raw, result.block->raw, NULL, false, &zangle, 0.);
   }
 
 #ifdef CHECK
@@ -1629,7 +1844,7 @@ const Field3D Field3D::shiftZ(const Field2D zangle) const {
   return result;
 }
 
-const Field3D Field3D::shiftZ(const BoutReal zangle) const {
+Field3D Field3D::shiftZ(const BoutReal zangle) const {
   Field3D result;
 
 #ifdef CHECK
@@ -1637,13 +1852,12 @@ const Field3D Field3D::shiftZ(const BoutReal zangle) const {
   checkData();
 #endif
 
-  result = *this;
-
-  #pragma omp parallel for
-  for(int jx=0;jx<mesh->ngx;jx++) {
-    for(int jy=0;jy<mesh->ngy;jy++) {
-      result.shiftZ(jx, jy, zangle);
-    }
+  if(mesh->ngz-1 == 1) {
+    result = *this;
+  }else {
+    result.allocate();
+    result.location = location;
+    shiftZLines(block->raw, result.block->raw, NULL, false, NULL, zangle);
   }
 
 #ifdef CHECK
@@ -1653,11 +1867,28 @@ const Field3D Field3D::shiftZ(const BoutReal zangle) const {
   return result;
 }
 
-const Field3D Field3D::shiftZ(bool toBoutReal) const {
-  if(toBoutReal) {
-    return shiftZ(mesh->zShift);
+Field3D Field3D::shiftZ(bool toBoutReal) const {
+  Field3D result;
+
+#ifdef CHECK
+  msg_stack.push("Field3D: shiftZ ( bool )");
+  checkData();
+#endif
+
+  if(mesh->ngz-1 == 1) {
+    result = *this;
+  }else {
+    // Phases for mesh->zShift are cached
+    result.allocate();
+    result.location = location;
+    shiftZLines(block->raw, result.block->raw, zshift_phases(), !toBoutReal, NULL, 0.);
   }
-  return shiftZ(-mesh->zShift);
+
+#ifdef CHECK
+  msg_stack.pop();
+#endif
+
+  return result;
 }
 
 
@@ -1765,7 +1996,7 @@ const FieldPerp Field3D::slice(int y) const
  *                      MATH FUNCTIONS
  ***************************************************************/
 
-const Field3D Field3D::sqrt() const {
+Field3D Field3D::sqrt() const {
   Field3D result;
 
 #ifdef CHECK
@@ -1791,11 +2022,7 @@ const Field3D Field3D::sqrt() const {
 
   result.allocate();
 
-  #pragma omp parallel for
-  for(int jx=0;jx<mesh->ngx;jx++)
-    for(int jy=0;jy<mesh->ngy;jy++) 
-      for(int jz=0;jz<mesh->ngz;jz++)
-	result.block->data[jx][jy][jz] = ::sqrt(block->data[jx][jy][jz]);
+  simd_sqrt(result.block->raw, block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
 
 #ifdef CHECK
   msg_stack.pop();
@@ -1806,7 +2033,7 @@ const Field3D Field3D::sqrt() const {
   return result;
 }
 
-const Field3D Field3D::abs() const {
+Field3D Field3D::abs() const {
   Field3D result;
 
 #ifdef CHECK
@@ -1821,11 +2048,7 @@ const Field3D Field3D::abs() const {
 
   result.allocate();
 
-  #pragma omp parallel for
-  for(int jx=0;jx<mesh->ngx;jx++)
-    for(int jy=0;jy<mesh->ngy;jy++) 
-      for(int jz=0;jz<mesh->ngz;jz++)
-	result.block->data[jx][jy][jz] = fabs(block->data[jx][jy][jz]);
+  simd_abs(result.block->raw, block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
 
   result.location = location;
 
@@ -1916,10 +2139,11 @@ int Field3D::getData(int x, int y, int z, void *vptr) const
   if((x < 0) || (x >= mesh->ngx) || (y < 0) || (y >= mesh->ngy) || (z < 0) || (z >= mesh->ngz))
     throw BoutException("Field3D: getData (%d,%d,%d) out of bounds\n", x, y, z);
 #endif
-  BoutReal *ptr = (BoutReal*) vptr;
-  *ptr = block->data[x][y][z];
+  // Copied at the stored precision. The buffer may hold a mixture of
+  // float and double values, so is not assumed to be aligned
+  memcpy(vptr, &(block->data[x][y][z]), sizeof(FieldReal));
   
-  return sizeof(BoutReal);
+  return sizeof(FieldReal);
 }
 
 int Field3D::getData(int x, int y, int z, BoutReal *rptr) const
@@ -1946,10 +2170,9 @@ int Field3D::setData(int x, int y, int z, void *vptr)
   if((x < 0) || (x >= mesh->ngx) || (y < 0) || (y >= mesh->ngy) || (z < 0) || (z >= mesh->ngz))
     throw BoutException("Field3D: fillArray (%d,%d,%d) out of bounds\n", x, y, z);
 #endif
-  BoutReal *ptr = (BoutReal*) vptr;
-  block->data[x][y][z] = *ptr;
+  memcpy(&(block->data[x][y][z]), vptr, sizeof(FieldReal));
   
-  return sizeof(BoutReal);
+  return sizeof(FieldReal);
 }
 
 int Field3D::setData(int x, int y, int z, BoutReal *rptr)
@@ -1996,7 +2219,8 @@ void Field3D::cleanup()
     memblock3d *nb = blocklist->all_next;
     
     // Free the 3D data
-    free_r3tensor(blocklist->data);
+    free_r3view(blocklist->data);
+    free_raw(blocklist->raw);
     // Delete the structure
     delete blocklist;
     // Move to the next one
@@ -2007,6 +2231,80 @@ void Field3D::cleanup()
   // Reset to starting
   nblocks = 0;
   free_block = NULL;
+  nfree = 0;
+  pool_cleared = true;
+  
+  if(thread_cache != NULL)
+    delete[] thread_cache;
+  thread_cache = NULL;
+  ncache = 0;
+}
+
+void Field3D::initPool()
+{
+  Options *options = Options::getRoot()->getSection("field3d");
+  
+  int thread_cache_size;
+  // Maximum number of blocks on the shared free list (< 0 for no limit)
+  OPTION(options, max_free, -1);
+  // Free blocks kept by each thread
+  OPTION(options, thread_cache_size, 4);
+  
+  // Return any cached blocks to the shared list, so calling again
+  // (e.g. to change the settings) doesn't lose them
+  for(int t=0;t<ncache;t++) {
+    while(thread_cache[t].head != NULL) {
+      memblock3d *b = thread_cache[t].head;
+      thread_cache[t].head = b->next;
+      b->next = free_block;
+      free_block = b;
+      nfree++;
+    }
+  }
+  if(thread_cache != NULL)
+    delete[] thread_cache;
+  thread_cache = NULL;
+  ncache = 0;
+  max_cache = thread_cache_size;
+
+#ifdef _OPENMP
+  if(max_cache > 0) {
+    ncache = omp_get_max_threads();
+    thread_cache = new memcache3d[ncache];
+    for(int i=0;i<ncache;i++) {
+      thread_cache[i].head = NULL;
+      thread_cache[i].n = 0;
+    }
+  }
+#endif
+}
+
+void Field3D::trimPool()
+{
+  for(int t=0;t<ncache;t++) {
+    while(thread_cache[t].head != NULL) {
+      memblock3d *b = thread_cache[t].head;
+      thread_cache[t].head = b->next;
+      destroyBlock(b);
+    }
+    thread_cache[t].n = 0;
+  }
+  
+  while(free_block != NULL) {
+    memblock3d *b = free_block;
+    free_block = b->next;
+    destroyBlock(b);
+  }
+  nfree = 0;
+}
+
+void Field3D::poolStats(int &live, int &freeblocks, int &peak)
+{
+  freeblocks = nfree;
+  for(int t=0;t<ncache;t++)
+    freeblocks += thread_cache[t].n;
+  live = nblocks - freeblocks;
+  peak = peak_blocks;
 }
 
 ///////////////////// BOUNDARY CONDITIONS //////////////////
@@ -2218,34 +2516,94 @@ void Field3D::setBoundaryTo(const Field3D &f3d)
 // GLOBAL VARS
 
 int Field3D::nblocks = 0;
+bool Field3D::pool_cleared = false;
 memblock3d* Field3D::blocklist = NULL;
 memblock3d* Field3D::free_block = NULL;
+int Field3D::nfree = 0;
+int Field3D::peak_blocks = 0;
+int Field3D::max_free = -1;
+unsigned long Field3D::last_version = 0;
+memcache3d* Field3D::thread_cache = NULL;
+int Field3D::ncache = 0;
+int Field3D::max_cache = 0;
+#if !(defined(BOUT_FIXED_NGY) && defined(BOUT_FIXED_NGZ))
+int Field3D::stride_x = 0;
+int Field3D::stride_y = 0;
+#endif
+
+/// Index of this thread's block cache, or -1 if none should be used
+static inline int pool_thread()
+{
+#ifdef _OPENMP
+  // Thread numbers are not unique in nested parallel regions
+  if(omp_get_level() > 1)
+    return -1;
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
 
 /// Get a new block of data, either from free list or allocate
 memblock3d *Field3D::newBlock() const
 {
-  memblock3d *nb;
+  memblock3d *nb = NULL;
 
-  if(free_block != NULL) {
-    // just pop off the top of the stack
-    nb = free_block;
-    free_block = nb->next;
-    nb->next = NULL;
-    nb->refs = 1;
+  int t = pool_thread();
+  if((t >= 0) && (t < ncache) && (thread_cache[t].head != NULL)) {
+    // Take from this thread's cache, no locking needed
+    nb = thread_cache[t].head;
+    thread_cache[t].head = nb->next;
+    thread_cache[t].n--;
   }else {
-    // No more blocks left - allocate a new block
-    nb = new memblock3d;
-
-    nb->data = r3tensor(mesh->ngx, mesh->ngy, mesh->ngz);
-    nb->refs = 1;
-    nb->next = NULL;
-    
-    // add to the global list
-    nb->all_next = blocklist;
-    blocklist = nb;
-    
-    nblocks++;
+    #pragma omp critical(field3d_pool)
+    {
+      if(free_block != NULL) {
+        // just pop off the top of the stack
+        nb = free_block;
+        free_block = nb->next;
+        nfree--;
+      }else {
+        // No more blocks left - allocate a new block
+        nb = new memblock3d;
+
+#if !(defined(BOUT_FIXED_NGY) && defined(BOUT_FIXED_NGZ))
+        stride_y = mesh->ngz;
+        stride_x = mesh->ngy*mesh->ngz;
+#endif
+        
+        nb->raw = alloc_raw(mesh->ngx*mesh->ngy*mesh->ngz);
+        nb->data = r3view(nb->raw, mesh->ngx, mesh->ngy, mesh->ngz);
+        
+        // add to the global list
+        nb->all_prev = NULL;
+        nb->all_next = blocklist;
+        if(blocklist != NULL)
+          blocklist->all_prev = nb;
+        blocklist = nb;
+        
+        nblocks++;
+        if(pool_cleared) // Only after cleanup(), so not in a parallel region
+          pool_cleared = false;
+        if(nblocks > peak_blocks)
+          peak_blocks = nblocks;
+      }
+    }
   }
+  
+#if defined(BOUT_FIXED_NGY) && defined(BOUT_FIXED_NGZ)
+  if((mesh->ngy != BOUT_FIXED_NGY) || (mesh->ngz != BOUT_FIXED_NGZ))
+    throw BoutException("Field3D: Compiled for ngy=%d, ngz=%d but mesh has ngy=%d, ngz=%d\n",
+                        BOUT_FIXED_NGY, BOUT_FIXED_NGZ, mesh->ngy, mesh->ngz);
+#endif
+
+  nb->next = NULL;
+  nb->refs = 1;
+
+  unsigned long v;
+  #pragma omp atomic capture
+  v = ++last_version;
+  nb->version = v;
 
   return nb;
 }
@@ -2260,18 +2618,19 @@ void Field3D::allocData() const
     
     /// Check if data shared with other objects
     if(block->refs > 1) {
-      // Need to get a new block and copy across
-
-      memblock3d* nb = newBlock();
-
-      #pragma omp parallel for
-      for(int jx=0;jx<mesh->ngx;jx++)
-	for(int jy=0;jy<mesh->ngy;jy++)
-	  for(int jz=0;jz<mesh->ngz;jz++)
-	    nb->data[jx][jy][jz] = block->data[jx][jy][jz];
-
-      block->refs--;
-      block = nb;
+      // Need to get a new block and copy across.
+      // If several threads write to a shared field only the first copies
+      #pragma omp critical(field3d_copy)
+      if(block->refs > 1) {
+        memblock3d* nb = newBlock();
+
+        #pragma omp parallel for
+        for(int i=0;i<mesh->ngx*mesh->ngy*mesh->ngz;i++)
+          nb->raw[i] = block->raw[i];
+
+        unrefBlock(block);
+        block = nb;
+      }
     }
   }else {
     // No data - get a new block
@@ -2285,33 +2644,77 @@ void Field3D::freeData()
 {
   // put data block onto stack
 
-  // Need to check for either no data, or all data has been cleared
-  if((block == NULL) || (nblocks == 0))
+  // Need to check for either no data, or all data has been cleared.
+  // nblocks changes under the pool lock so can't be read here, but
+  // pool_cleared is only set by cleanup() outside parallel regions
+  if((block == NULL) || pool_cleared)
     return;
 
-  block->refs--;
+  unrefBlock(block);
+
+  block = NULL;
+}
+
+void Field3D::unrefBlock(memblock3d *b)
+{
+  int refs;
+  #pragma omp atomic capture
+  refs = --(b->refs);
+
+  if(refs > 0)
+    return; // Still in use
 
-  if(block->refs == 0) {
-    // No more references to this data - put on free list
+  // No more references to this data - put on free list
 
 #ifdef DISABLE_FREELIST
-    // For debugging, free memory
-    free_r3tensor(block->data);
-    delete block;
+  // For debugging, free memory
+  #pragma omp critical(field3d_pool)
+  destroyBlock(b);
 #else
-    block->next = free_block;
-    free_block = block;
-#endif
+  int t = pool_thread();
+  if((t >= 0) && (t < ncache) && (thread_cache[t].n < max_cache)) {
+    b->next = thread_cache[t].head;
+    thread_cache[t].head = b;
+    thread_cache[t].n++;
+    return;
   }
+  
+  #pragma omp critical(field3d_pool)
+  {
+    if((max_free >= 0) && (nfree >= max_free)) {
+      // Free list full
+      destroyBlock(b);
+    }else {
+      b->next = free_block;
+      free_block = b;
+      nfree++;
+    }
+  }
+#endif
+}
 
-  block = NULL;
+/// Must be called inside critical(field3d_pool) or outside parallel regions
+void Field3D::destroyBlock(memblock3d *b)
+{
+  if(b->all_prev != NULL) {
+    b->all_prev->all_next = b->all_next;
+  }else
+    blocklist = b->all_next;
+  if(b->all_next != NULL)
+    b->all_next->all_prev = b->all_prev;
+  
+  free_r3view(b->data);
+  free_raw(b->raw);
+  delete b;
+  
+  nblocks--;
 }
 
 /***************************************************************
  *               NON-MEMBER OVERLOADED OPERATORS
  ***************************************************************/
 
-const Field3D operator-(const BoutReal &lhs, const Field3D &rhs) {
+Field3D operator-(const BoutReal &lhs, const Field3D &rhs) {
   Field3D result;
 
 #ifdef TRACK
@@ -2321,35 +2724,33 @@ const Field3D operator-(const BoutReal &lhs, const Field3D &rhs) {
   result.allocate();
   
   #pragma omp parallel for
-  for(int jx=0;jx<mesh->ngx;jx++)
-    for(int jy=0;jy<mesh->ngy;jy++)
-      for(int jz=0;jz<mesh->ngz;jz++)
-	result.block->data[jx][jy][jz] = lhs - rhs.block->data[jx][jy][jz];
+  for(int i=0;i<mesh->ngx*mesh->ngy*mesh->ngz;i++)
+    result.block->raw[i] = lhs - rhs.block->raw[i];
 
   result.location = rhs.location;
 
   return result;
 }
 
-const Field3D operator+(const BoutReal &lhs, const Field3D &rhs)
+Field3D operator+(const BoutReal &lhs, const Field3D &rhs)
 {
   return rhs+lhs;
 }
 
-const Field3D operator*(const BoutReal lhs, const Field3D &rhs)
+Field3D operator*(const BoutReal lhs, const Field3D &rhs)
 {
   return(rhs * lhs);
 }
 
-const Field3D operator/(const BoutReal lhs, const Field3D &rhs)
+Field3D operator/(const BoutReal lhs, const Field3D &rhs)
 {
   Field3D result = rhs;
   int jx, jy, jz;
-  BoutReal ***d;
+  FieldReal ***d;
 
   d = result.getData();
 #ifdef CHECK
-  if(d == (BoutReal***) NULL)
+  if(d == (FieldReal***) NULL)
     throw BoutException("Field3D: left / operator has invalid Field3D argument");
 #endif
 
@@ -2367,16 +2768,16 @@ const Field3D operator/(const BoutReal lhs, const Field3D &rhs)
   return(result);
 }
 
-const Field3D operator^(const BoutReal lhs, const Field3D &rhs)
+Field3D operator^(const BoutReal lhs, const Field3D &rhs)
 {
   Field3D result = rhs;
   int jx, jy, jz;
-  BoutReal ***d;
+  FieldReal ***d;
 
   d = result.getData();
 
 #ifdef CHECK
-  if(d == (BoutReal***) NULL)
+  if(d == (FieldReal***) NULL)
     throw BoutException("Field3D: left ^ operator has invalid Field3D argument");
 #endif
 
@@ -2394,14 +2795,33 @@ const Field3D operator^(const BoutReal lhs, const Field3D &rhs)
   return(result);
 }
 
+#ifdef BOUT_HAS_RVALUE_REFS
+Field3D operator+(const BoutReal lhs, Field3D &&rhs)
+{
+  return std::move(rhs) + lhs;
+}
+
+Field3D operator-(const BoutReal lhs, Field3D &&rhs)
+{
+  rhs *= -1.0;
+  rhs += lhs;
+  return std::move(rhs);
+}
+
+Field3D operator*(const BoutReal lhs, Field3D &&rhs)
+{
+  return std::move(rhs) * lhs;
+}
+#endif
+
 //////////////// NON-MEMBER FUNCTIONS //////////////////
 
-const Field3D sqrt(const Field3D &f)
+Field3D sqrt(const Field3D &f)
 {
   return f.sqrt();
 }
 
-const Field3D abs(const Field3D &f)
+Field3D abs(const Field3D &f)
 {
   return f.abs();
 }
@@ -2419,7 +2839,7 @@ BoutReal max(const Field3D &f, bool allpe)
 /////////////////////////////////////////////////////////////////////
 // Friend functions
 
-const Field3D exp(const Field3D &f)
+Field3D exp(const Field3D &f)
 {
 #ifdef CHECK
   msg_stack.push("exp(Field3D)");
@@ -2431,10 +2851,7 @@ const Field3D exp(const Field3D &f)
   Field3D result;
   result.allocate();
   
-  for(int jx=0;jx<mesh->ngx;jx++)
-    for(int jy=0;jy<mesh->ngy;jy++)
-      for(int jz=0;jz<mesh->ngz;jz++)
-        result.block->data[jx][jy][jz] = exp(f.block->data[jx][jy][jz]);
+  simd_exp(result.block->raw, f.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
   
 #ifdef CHECK
   msg_stack.pop();
@@ -2442,7 +2859,7 @@ const Field3D exp(const Field3D &f)
   return result;
 }
 
-const Field3D log(const Field3D &f)
+Field3D log(const Field3D &f)
 {
 #ifdef CHECK
   msg_stack.push("log(Field3D)");
@@ -2454,15 +2871,15 @@ const Field3D log(const Field3D &f)
   Field3D result;
   result.allocate();
   
+#ifdef CHECK
   for(int jx=0;jx<mesh->ngx;jx++)
     for(int jy=0;jy<mesh->ngy;jy++)
       for(int jz=0;jz<mesh->ngz;jz++) {
-#ifdef CHECK
         if(f.block->data[jx][jy][jz] < 0.)
           throw BoutException("log(Field3D) has negative argument at [%d][%d][%d]\n", jx, jy, jz);
-#endif
-        result.block->data[jx][jy][jz] = log(f.block->data[jx][jy][jz]);
       }
+#endif
+  simd_log(result.block->raw, f.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
   
 #ifdef CHECK
   msg_stack.pop();
@@ -2470,17 +2887,13 @@ const Field3D log(const Field3D &f)
   return result;
 }
 
-const Field3D sin(const Field3D &f)
+Field3D sin(const Field3D &f)
 {
   Field3D result;
-  int jx, jy, jz;
   
   result.allocate();
   
-  for(jx=0;jx<mesh->ngx;jx++)
-    for(jy=0;jy<mesh->ngy;jy++)
-      for(jz=0;jz<mesh->ngz;jz++)
-	result.block->data[jx][jy][jz] = sin(f.block->data[jx][jy][jz]);
+  simd_sin(result.block->raw, f.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
 
 #ifdef TRACK
   result.name = "sin("+f.name+")";
@@ -2491,17 +2904,13 @@ const Field3D sin(const Field3D &f)
   return result;
 }
 
-const Field3D cos(const Field3D &f)
+Field3D cos(const Field3D &f)
 {
   Field3D result;
-  int jx, jy, jz;
   
   result.allocate();
   
-  for(jx=0;jx<mesh->ngx;jx++)
-    for(jy=0;jy<mesh->ngy;jy++)
-      for(jz=0;jz<mesh->ngz;jz++)
-	result.block->data[jx][jy][jz] = cos(f.block->data[jx][jy][jz]);
+  simd_cos(result.block->raw, f.block->raw, mesh->ngx*mesh->ngy*mesh->ngz);
 
 #ifdef TRACK
   result.name = "cos("+f.name+")";
@@ -2512,7 +2921,7 @@ const Field3D cos(const Field3D &f)
   return result;
 }
 
-const Field3D tan(const Field3D &f)
+Field3D tan(const Field3D &f)
 {
   Field3D result;
   int jx, jy, jz;
@@ -2533,7 +2942,7 @@ const Field3D tan(const Field3D &f)
   return result;
 }
 
-const Field3D sinh(const Field3D &f)
+Field3D sinh(const Field3D &f)
 {
   Field3D result;
   int jx, jy, jz;
@@ -2554,7 +2963,7 @@ const Field3D sinh(const Field3D &f)
   return result;
 }
 
-const Field3D cosh(const Field3D &f)
+Field3D cosh(const Field3D &f)
 {
   Field3D result;
   int jx, jy, jz;
@@ -2575,7 +2984,7 @@ const Field3D cosh(const Field3D &f)
   return result;
 }
 
-const Field3D tanh(const Field3D &f)
+Field3D tanh(const Field3D &f)
 {
   Field3D result;
   int jx, jy, jz;
@@ -2596,7 +3005,7 @@ const Field3D tanh(const Field3D &f)
   return result;
 }
 
-const Field3D filter(const Field3D &var, int N0)
+Field3D filter(const Field3D &var, int N0)
 {
   Field3D result;
   static dcomplex *f = (dcomplex*) NULL;
@@ -2642,7 +3051,7 @@ const Field3D filter(const Field3D &var, int N0)
 // Smooths a field in Fourier space
 // DOESN'T WORK VERY WELL
 /*
-const Field3D smooth(const Field3D &var, BoutReal zmax, BoutReal xmax)
+Field3D smooth(const Field3D &var, BoutReal zmax, BoutReal xmax)
 {
   Field3D result;
   static dcomplex **f = NULL, *fx;
@@ -2726,7 +3135,7 @@ const Field3D smooth(const Field3D &var, BoutReal zmax, BoutReal xmax)
 */
 
 // Fourier filter in z
-const Field3D lowPass(const Field3D &var, int zmax)
+Field3D lowPass(const Field3D &var, int zmax)
 {
   Field3D result;
   static dcomplex *f = NULL;
@@ -2774,7 +3183,7 @@ const Field3D lowPass(const Field3D &var, int zmax)
   return result;
 }
 // Fourier filter in z with zmin
-const Field3D lowPass(const Field3D &var, int zmax, int zmin)
+Field3D lowPass(const Field3D &var, int zmax, int zmin)
 {
   Field3D result;
   static dcomplex *f = NULL;
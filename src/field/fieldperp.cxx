@@ -58,9 +58,9 @@ FieldPerp* FieldPerp::clone() const
 void FieldPerp::set(const Field3D &f, int y)
 {
   int jx, jz;
-  BoutReal ***d = f.getData();
+  FieldReal ***d = f.getData();
 
-  if(d == (BoutReal***) NULL) {
+  if(d == (FieldReal***) NULL) {
     error("FieldPerp: Setting from empty Field3D");
     return;
   }
@@ -164,11 +164,11 @@ FieldPerp & FieldPerp::operator+=(const FieldPerp &rhs)
 FieldPerp & FieldPerp::operator+=(const Field3D &rhs)
 {
   int jx, jz;
-  BoutReal ***d;
+  FieldReal ***d;
 
   d = rhs.getData();
   
-  if(d == (BoutReal***) NULL) {
+  if(d == (FieldReal***) NULL) {
     // No data
     error("FieldPerp: += operates on empty Field3D");
     return(*this);
@@ -254,11 +254,11 @@ FieldPerp & FieldPerp::operator-=(const FieldPerp &rhs)
 FieldPerp & FieldPerp::operator-=(const Field3D &rhs)
 {
   int jx, jz;
-  BoutReal ***d;
+  FieldReal ***d;
 
   d = rhs.getData();
   
-  if(d == (BoutReal***) NULL) {
+  if(d == (FieldReal***) NULL) {
     // No data
     error("FieldPerp: -= operates on empty Field3D");
     return(*this);
@@ -344,11 +344,11 @@ FieldPerp & FieldPerp::operator*=(const FieldPerp &rhs)
 FieldPerp & FieldPerp::operator*=(const Field3D &rhs)
 {
   int jx, jz;
-  BoutReal ***d;
+  FieldReal ***d;
 
   d = rhs.getData();
   
-  if(d == (BoutReal***) NULL) {
+  if(d == (FieldReal***) NULL) {
     // No data
     error("FieldPerp: *= operates on empty Field3D");
     return(*this);
@@ -434,11 +434,11 @@ FieldPerp & FieldPerp::operator/=(const FieldPerp &rhs)
 FieldPerp & FieldPerp::operator/=(const Field3D &rhs)
 {
   int jx, jz;
-  BoutReal ***d;
+  FieldReal ***d;
 
   d = rhs.getData();
   
-  if(d == (BoutReal***) NULL) {
+  if(d == (FieldReal***) NULL) {
     // No data
     error("FieldPerp: /= operates on empty Field3D");
     return(*this);
@@ -524,11 +524,11 @@ FieldPerp & FieldPerp::operator^=(const FieldPerp &rhs)
 FieldPerp & FieldPerp::operator^=(const Field3D &rhs)
 {
   int jx, jz;
-  BoutReal ***d;
+  FieldReal ***d;
 
   d = rhs.getData();
   
-  if(d == (BoutReal***) NULL) {
+  if(d == (FieldReal***) NULL) {
     // No data
     error("FieldPerp: ^= operates on empty Field3D");
     return(*this);
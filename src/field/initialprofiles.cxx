@@ -418,12 +418,12 @@ BoutReal Prof1D(BoutReal s, BoutReal s0, BoutReal sMin, BoutReal sMax, BoutReal
   @param[in] n      Mode number. Note that this is mode-number in the domain
   @param[in] phase  Phase shift in units of pi
 */
-const Field3D genZMode(int n, BoutReal phase)
+Field3D genZMode(int n, BoutReal phase)
 {
   Field3D result;
 
   result.allocate();
-  BoutReal ***d = result.getData();
+  FieldReal ***d = result.getData();
   
   for(int jz=0;jz<mesh->ngz;jz++) {
     BoutReal val = sin(phase*PI +  TWOPI * ((BoutReal) jz)/ ((BoutReal) mesh->ngz-1) );
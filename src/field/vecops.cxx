@@ -147,7 +147,7 @@ const Field2D Div(const Vector2D &v, CELL_LOC outloc)
   return result;
 }
 
-const Field3D Div(const Vector3D &v, CELL_LOC outloc)
+Field3D Div(const Vector3D &v, CELL_LOC outloc)
 {
   Field3D result;
 
@@ -202,7 +202,7 @@ const Field2D Div(const Vector2D &v, const Field2D &f)
   return result;
 }
 
-const Field3D Div(const Vector3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D Div(const Vector3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
 {
     Field3D result;
 
@@ -229,12 +229,12 @@ const Field3D Div(const Vector3D &v, const Field3D &f, DIFF_METHOD method, CELL_
   return result;
 }
 
-const Field3D Div(const Vector3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
+Field3D Div(const Vector3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
 {
   return Div(v, f, method, outloc);
 }
 
-const Field3D Div(const Vector3D &v, const Field3D &f)
+Field3D Div(const Vector3D &v, const Field3D &f)
 {
   return Div(v, f, DIFF_DEFAULT, CELL_DEFAULT);
 }
@@ -337,7 +337,7 @@ const Field2D V_dot_Grad(const Vector2D &v, const Field2D &f)
   return result;
 }
 
-const Field3D V_dot_Grad(const Vector2D &v, const Field3D &f)
+Field3D V_dot_Grad(const Vector2D &v, const Field3D &f)
 {
   Field3D result;
   
@@ -358,7 +358,7 @@ const Field3D V_dot_Grad(const Vector2D &v, const Field3D &f)
   return result;
 }
 
-const Field3D V_dot_Grad(const Vector3D &v, const Field2D &f)
+Field3D V_dot_Grad(const Vector3D &v, const Field2D &f)
 {
   Field3D result;
   
@@ -379,7 +379,7 @@ const Field3D V_dot_Grad(const Vector3D &v, const Field2D &f)
   return result;
 }
 
-const Field3D V_dot_Grad(const Vector3D &v, const Field3D &f)
+Field3D V_dot_Grad(const Vector3D &v, const Field3D &f)
 {
   Field3D result;
   
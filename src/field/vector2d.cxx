@@ -369,7 +369,7 @@ const Field2D Vector2D::operator*(const Vector2D &rhs) const
   return result;
 }
 
-const Field3D Vector2D::operator*(const Vector3D &rhs) const
+Field3D Vector2D::operator*(const Vector3D &rhs) const
 {
   return rhs*(*this);
 }
@@ -430,12 +430,11 @@ int Vector2D::getData(int jx, int jy, int jz, void *vptr) const
     exit(1);
   }
 #endif
-  BoutReal *ptr = (BoutReal*) vptr;
-  *ptr = x[jx][jy]; ptr++;
-  *ptr = y[jx][jy]; ptr++;
-  *ptr = z[jx][jy];
+  int len = x.getData(jx, jy, jz, vptr);
+  len += y.getData(jx, jy, jz, (void*) (((char*) vptr) + len));
+  len += z.getData(jx, jy, jz, (void*) (((char*) vptr) + len));
   
-  return 3*sizeof(BoutReal);
+  return len;
 }
 
 int Vector2D::getData(int jx, int jy, int jz, BoutReal *rptr) const
@@ -464,12 +463,11 @@ int Vector2D::setData(int jx, int jy, int jz, void *vptr)
     exit(1);
   }
 #endif
-  BoutReal *rptr = (BoutReal*) vptr;
-  x[jx][jy] = *rptr; rptr++;
-  y[jx][jy] = *rptr; rptr++;
-  z[jx][jy] = *rptr;
+  int len = x.setData(jx, jy, jz, vptr);
+  len += y.setData(jx, jy, jz, (void*) (((char*) vptr) + len));
+  len += z.setData(jx, jy, jz, (void*) (((char*) vptr) + len));
 
-  return 3*sizeof(BoutReal);
+  return len;
 }
 
 int Vector2D::setData(int jx, int jy, int jz, BoutReal *rptr)
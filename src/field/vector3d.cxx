@@ -421,7 +421,7 @@ const Vector3D Vector3D::operator/(const Field3D &rhs) const
 
 ////////////////// DOT PRODUCT ///////////////////
 
-const Field3D Vector3D::operator*(const Vector3D &rhs) const
+Field3D Vector3D::operator*(const Vector3D &rhs) const
 {
   Field3D result;
 
@@ -448,7 +448,7 @@ const Field3D Vector3D::operator*(const Vector3D &rhs) const
   return result;
 }
 
-const Field3D Vector3D::operator*(const Vector2D &rhs) const
+Field3D Vector3D::operator*(const Vector2D &rhs) const
 {
   Field3D result;
 
@@ -552,7 +552,7 @@ const Vector3D operator*(const Field3D &lhs, const Vector3D &rhs)
  ***************************************************************/
 
 // Return the magnitude of a vector
-const Field3D abs(const Vector3D &v)
+Field3D abs(const Vector3D &v)
 {
   return sqrt(v*v);
 }
@@ -570,12 +570,11 @@ int Vector3D::getData(int jx, int jy, int jz, void *vptr) const
     exit(1);
   }
 #endif
-  BoutReal *ptr = (BoutReal*) vptr;
-  *ptr = x[jx][jy][jz]; ptr++;
-  *ptr = y[jx][jy][jz]; ptr++;
-  *ptr = z[jx][jy][jz];
+  int len = x.getData(jx, jy, jz, vptr);
+  len += y.getData(jx, jy, jz, (void*) (((char*) vptr) + len));
+  len += z.getData(jx, jy, jz, (void*) (((char*) vptr) + len));
   
-  return 3*sizeof(BoutReal);
+  return len;
 }
 
 int Vector3D::getData(int jx, int jy, int jz, BoutReal *rptr) const
@@ -604,12 +603,11 @@ int Vector3D::setData(int jx, int jy, int jz, void *vptr)
     exit(1);
   }
 #endif
-  BoutReal *rptr = (BoutReal*) vptr;
-  x[jx][jy][jz] = *rptr; rptr++;
-  y[jx][jy][jz] = *rptr; rptr++;
-  z[jx][jy][jz] = *rptr;
+  int len = x.setData(jx, jy, jz, vptr);
+  len += y.setData(jx, jy, jz, (void*) (((char*) vptr) + len));
+  len += z.setData(jx, jy, jz, (void*) (((char*) vptr) + len));
 
-  return 3*sizeof(BoutReal);
+  return len;
 }
 
 int Vector3D::setData(int jx, int jy, int jz, BoutReal *rptr)
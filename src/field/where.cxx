@@ -26,12 +26,12 @@
 #include <globals.hxx>
 #include <where.hxx>
 
-const Field3D where(const Field2D &test, const Field3D &gt0, const Field3D &le0)
+Field3D where(const Field2D &test, const Field3D &gt0, const Field3D &le0)
 {
   Field3D result;
   
   result.allocate();
-  BoutReal ***d = result.getData();
+  FieldReal ***d = result.getData();
   
   for(int jx=0;jx<mesh->ngx;jx++)
     for(int jy=0;jy<mesh->ngy;jy++)
@@ -46,12 +46,12 @@ const Field3D where(const Field2D &test, const Field3D &gt0, const Field3D &le0)
   return result;
 }
 
-const Field3D where(const Field2D &test, const Field3D &gt0, BoutReal le0)
+Field3D where(const Field2D &test, const Field3D &gt0, BoutReal le0)
 {
   Field3D result;
 
   result.allocate();
-  BoutReal ***d = result.getData();
+  FieldReal ***d = result.getData();
   
   for(int jx=0;jx<mesh->ngx;jx++)
     for(int jy=0;jy<mesh->ngy;jy++)
@@ -66,12 +66,12 @@ const Field3D where(const Field2D &test, const Field3D &gt0, BoutReal le0)
   return result;
 }
 
-const Field3D where(const Field2D &test, BoutReal gt0, const Field3D &le0)
+Field3D where(const Field2D &test, BoutReal gt0, const Field3D &le0)
 {
   Field3D result;
 
   result.allocate();
-  BoutReal ***d = result.getData();
+  FieldReal ***d = result.getData();
   
   for(int jx=0;jx<mesh->ngx;jx++)
     for(int jy=0;jy<mesh->ngy;jy++)
@@ -86,12 +86,12 @@ const Field3D where(const Field2D &test, BoutReal gt0, const Field3D &le0)
   return result;
 }
 
-const Field3D where(const Field2D &test, const Field3D &gt0, const Field2D &le0)
+Field3D where(const Field2D &test, const Field3D &gt0, const Field2D &le0)
 {
   Field3D result;
 
   result.allocate();
-  BoutReal ***d = result.getData();
+  FieldReal ***d = result.getData();
   
   for(int jx=0;jx<mesh->ngx;jx++)
     for(int jy=0;jy<mesh->ngy;jy++)
@@ -106,12 +106,12 @@ const Field3D where(const Field2D &test, const Field3D &gt0, const Field2D &le0)
   return result;
 }
 
-const Field3D where(const Field2D &test, const Field2D &gt0, const Field3D &le0)
+Field3D where(const Field2D &test, const Field2D &gt0, const Field3D &le0)
 {
   Field3D result;
 
   result.allocate();
-  BoutReal ***d = result.getData();
+  FieldReal ***d = result.getData();
   
   for(int jx=0;jx<mesh->ngx;jx++)
     for(int jy=0;jy<mesh->ngy;jy++)
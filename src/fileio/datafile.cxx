@@ -528,19 +528,34 @@ bool Datafile::read_f3d(const string &name, Field3D *f, bool grow)
 {
   f->allocate();
   
+#ifdef BOUT_FIELD_FLOAT
+  // Files are double precision. Read into a buffer then convert
+  rvec buffer(mesh->ngx*mesh->ngy*mesh->ngz);
+  BoutReal *d = &buffer[0];
+#else
+  BoutReal *d = **(f->getData());
+#endif
+
   if(grow) {
-    if(!file->read_rec(**(f->getData()), name, mesh->ngx, mesh->ngy, mesh->ngz)) {
+    if(!file->read_rec(d, name, mesh->ngx, mesh->ngy, mesh->ngz)) {
       output.write("\tWARNING: Could not read 3D field %s. Setting to zero\n", name.c_str());
       *f = 0.0;
       return false;
     }
   }else {
-    if(!file->read(**(f->getData()), name, mesh->ngx, mesh->ngy, mesh->ngz)) {
+    if(!file->read(d, name, mesh->ngx, mesh->ngy, mesh->ngz)) {
       output.write("\tWARNING: Could not read 3D field %s. Setting to zero\n", name.c_str());
       *f = 0.0;
       return false;
     }
   }
+
+#ifdef BOUT_FIELD_FLOAT
+  FieldReal *fd = f->getRaw();
+  for(size_t i=0;i<buffer.size();i++)
+    fd[i] = (FieldReal) buffer[i];
+#endif
+
   return true;
 }
 
@@ -563,10 +578,19 @@ bool Datafile::write_f3d(const string &name, Field3D *f, bool grow)
     return false; // No data allocated
   }
   
+#ifdef BOUT_FIELD_FLOAT
+  // Always written in double precision
+  FieldReal *fd = f->getRaw();
+  rvec buffer(fd, fd + mesh->ngx*mesh->ngy*mesh->ngz);
+  BoutReal *d = &buffer[0];
+#else
+  BoutReal *d = **(f->getData());
+#endif
+
   if(grow) {
-    return file->write_rec(**(f->getData()), name, mesh->ngx, mesh->ngy, mesh->ngz);
+    return file->write_rec(d, name, mesh->ngx, mesh->ngy, mesh->ngz);
   }else {
-    return file->write(**(f->getData()), name, mesh->ngx, mesh->ngy, mesh->ngz);
+    return file->write(d, name, mesh->ngx, mesh->ngy, mesh->ngz);
   }
 }
 
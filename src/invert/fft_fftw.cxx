@@ -28,28 +28,126 @@
 #include <globals.hxx>
 #include <options.hxx>
 #include <fft.hxx>
+#include <boutcomm.hxx>
 
 #include <fftw3.h>
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
 
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 
+// Threaded FFTW (libfftw3_omp) needs OpenMP
+#if defined(FFTW_OMP) && !defined(_OPENMP)
+#undef FFTW_OMP
+#endif
+
 bool fft_options = false;
-bool fft_measure;
+bool fft_measure; ///< Use FFTW_MEASURE when planning
+bool fft_patient; ///< Use FFTW_PATIENT when planning
+bool fft_threads; ///< Allow FFTW's own threading for batched transforms
+string fft_wisdom_file; ///< File to read and write FFTW wisdom. Empty for none
+bool fft_new_wisdom = false; ///< Has planning produced wisdom worth saving?
 
-void fft_init()
+/// Read the [fft] options
+static void fft_read_options()
 {
   if(fft_options)
     return;
-  //#pragma omp critical
-  {
-    Options *opt = Options::getRoot();
-    opt = opt->getSection("fft");
-    opt->get("fft_measure", fft_measure, false);
-    fft_options = true;
+  
+  Options *opt = Options::getRoot();
+  opt = opt->getSection("fft");
+  opt->get("fft_measure", fft_measure, false);
+  opt->get("fft_patient", fft_patient, false);
+  opt->get("wisdom_file", fft_wisdom_file, "");
+  opt->get("fft_threads", fft_threads, true);
+#ifdef FFTW_OMP
+  if(fft_threads)
+    fftw_init_threads();
+#else
+  fft_threads = false;
+#endif
+  fft_options = true;
+}
+
+/// Planner flags. Measured plans are recorded as wisdom for fft_cleanup.
+/// The FFTW planner is not thread safe, so all planning and this call
+/// are inside the one critical section, critical(fftw_planner)
+static unsigned int fft_flags()
+{
+  fft_read_options();
+  
+  if(fft_patient) {
+    fft_new_wisdom = true;
+    return FFTW_PATIENT;
+  }
+  if(fft_measure) {
+    fft_new_wisdom = true;
+    return FFTW_MEASURE;
+  }
+  return FFTW_ESTIMATE;
+}
+
+void fft_init()
+{
+  fft_read_options();
+  
+  if(fft_wisdom_file.empty())
+    return;
+  
+  // Processor 0 reads the wisdom and sends it to the others, so
+  // every processor plans with the same wisdom
+  int rank;
+  MPI_Comm_rank(BoutComm::get(), &rank);
+  
+  string wisdom;
+  int len = 0;
+  if(rank == 0) {
+    FILE *fp = fopen(fft_wisdom_file.c_str(), "r");
+    if(fp != NULL) {
+      char buffer[4096];
+      size_t n;
+      while((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+        wisdom.append(buffer, n);
+      fclose(fp);
+    }
+    len = wisdom.size();
+  }
+  MPI_Bcast(&len, 1, MPI_INT, 0, BoutComm::get());
+  if(len == 0) {
+    output.write("\tNo FFTW wisdom read from '%s'\n", fft_wisdom_file.c_str());
+    return;
   }
+  
+  vector<char> buffer(len + 1);
+  if(rank == 0)
+    memcpy(&buffer[0], wisdom.c_str(), len);
+  MPI_Bcast(&buffer[0], len, MPI_CHAR, 0, BoutComm::get());
+  buffer[len] = 0;
+  
+  if(fftw_import_wisdom_from_string(&buffer[0])) {
+    output.write("\tRead FFTW wisdom from '%s'\n", fft_wisdom_file.c_str());
+  }else
+    output.write("\tWARNING: Couldn't import FFTW wisdom from '%s'\n", fft_wisdom_file.c_str());
+}
+
+static void fft_destroy_many();
+
+void fft_cleanup()
+{
+  if(fft_options && !fft_wisdom_file.empty() && fft_new_wisdom) {
+    int rank;
+    MPI_Comm_rank(BoutComm::get(), &rank);
+    if(rank == 0) {
+      if(!fftw_export_wisdom_to_filename(fft_wisdom_file.c_str()))
+        output.write("\tWARNING: Couldn't write FFTW wisdom to '%s'\n", fft_wisdom_file.c_str());
+    }
+  }
+  fft_destroy_many();
 }
 
 #ifndef _OPENMP
@@ -67,14 +165,11 @@ void cfft(dcomplex *cv, int length, int isign)
       fftw_free(in);
       fftw_free(out);
     } 
-    fft_init();
 
     in = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * length);
     out = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * length);
     
-    unsigned int flags = FFTW_ESTIMATE;
-    if(fft_measure)
-      flags = FFTW_MEASURE;
+    unsigned int flags = fft_flags();
 
     pf = fftw_plan_dft_1d(length, in, out, FFTW_FORWARD, flags);
     pb = fftw_plan_dft_1d(length, in, out, FFTW_BACKWARD, flags);
@@ -109,7 +204,7 @@ void cfft(dcomplex *cv, int length, int isign)
   static int size = 0, nthreads;
   
   int th_id = omp_get_thread_num();
-  #pragma omp critical
+  #pragma omp critical(fftw_planner)
   {
     // Sort out memory. Also, FFTW planning routines not thread safe
     int n_th = omp_get_num_threads(); // Number of threads
@@ -133,9 +228,7 @@ void cfft(dcomplex *cv, int length, int isign)
       pf = new fftw_plan[n_th];
       pb = new fftw_plan[n_th];
       
-      unsigned int flags = FFTW_ESTIMATE;
-      if(fft_measure)
-        flags = FFTW_MEASURE;
+      unsigned int flags = fft_flags();
       
       for(int i=0;i<n_th;i++) {
         pf[i] = fftw_plan_dft_1d(length, inall+i*length, outall+i*length, 
@@ -222,14 +315,11 @@ void rfft(BoutReal *in, int length, dcomplex *out) {
       fftw_free(fout);
     }
     
-    fft_init();
     
     fin = (double*) fftw_malloc(sizeof(double) * length);
     fout = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (length/2 + 1));
 
-    unsigned int flags = FFTW_ESTIMATE;
-    if(fft_measure)
-      flags = FFTW_MEASURE;
+    unsigned int flags = fft_flags();
     
     p = fftw_plan_dft_r2c_1d(length, fin, fout, flags);
     
@@ -259,14 +349,11 @@ void irfft(dcomplex *in, int length, BoutReal *out)
       fftw_free(fout);
     }
     
-    fft_init();
     
     fin = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (length/2 + 1));
     fout = (double*) fftw_malloc(sizeof(double) * length);
 
-    unsigned int flags = FFTW_ESTIMATE;
-    if(fft_measure)
-      flags = FFTW_MEASURE;
+    unsigned int flags = fft_flags();
     
     p = fftw_plan_dft_c2r_1d(length, fin, fout, flags);
     
@@ -293,7 +380,7 @@ void rfft(BoutReal *in, int length, dcomplex *out) {
   static int size = 0, nthreads;
   
   int th_id = omp_get_thread_num();
-#pragma omp critical(rfft)
+#pragma omp critical(fftw_planner)
   {
     // Sort out memory. Also, FFTW planning routines not thread safe
     int n_th = omp_get_num_threads(); // Number of threads
@@ -310,15 +397,12 @@ void rfft(BoutReal *in, int length, dcomplex *out) {
         fftw_free(foutall);
       }
     
-      fft_init();
       
       finall = (double*) fftw_malloc(sizeof(double) * length * n_th);
       foutall = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (length/2 + 1) * n_th);
       p = new fftw_plan[n_th];
       
-      unsigned int flags = FFTW_ESTIMATE;
-      if(fft_measure)
-        flags = FFTW_MEASURE;
+      unsigned int flags = fft_flags();
       
       for(int i=0;i<n_th;i++)
         p[i] = fftw_plan_dft_r2c_1d(length, finall+i*length, 
@@ -350,7 +434,7 @@ void irfft(dcomplex *in, int length, BoutReal *out)
   static int size = 0, nthreads;
   
   int th_id = omp_get_thread_num();
-#pragma omp critical(irfft)
+#pragma omp critical(fftw_planner)
   {
     // Sort out memory. Also, FFTW planning routines not thread safe
     int n_th = omp_get_num_threads(); // Number of threads
@@ -367,16 +451,13 @@ void irfft(dcomplex *in, int length, BoutReal *out)
         fftw_free(foutall);
       }
     
-      fft_init();
       
       finall = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * (length/2 + 1) * n_th);
       foutall = (double*) fftw_malloc(sizeof(double) * length * n_th);
       
       p = new fftw_plan[n_th];
       
-      unsigned int flags = FFTW_ESTIMATE;
-      if(fft_measure)
-        flags = FFTW_MEASURE;
+      unsigned int flags = fft_flags();
       
       for(int i=0;i<n_th;i++)
         p[i] = fftw_plan_dft_c2r_1d(length, finall+i*(length/2 + 1), 
@@ -441,3 +522,335 @@ void ZFFT_rev(dcomplex *cv, BoutReal zoffset, BoutReal *out, bool shift)
 
   irfft(cv, ncz, out);
 }
+
+/***********************************************************
+ * Cached zShift phase factors
+ ***********************************************************/
+
+static vector<dcomplex> zs_phase; ///< (ncz/2 + 1) phases per (jx,jy)
+static rvec zs_value;  ///< zShift the phases were computed for. NaN if not yet
+static int zs_ngx = 0, zs_ngy = 0, zs_ngz = 0;
+static BoutReal zs_zlength = 0.;
+
+/// Reset the table if the mesh has changed.
+/// The table is only read or changed inside critical(zshift_phase)
+static void zshift_check_mesh()
+{
+  if((zs_ngx != mesh->ngx) || (zs_ngy != mesh->ngy) || (zs_ngz != mesh->ngz) || (zs_zlength != mesh->zlength)) {
+    int npoints = mesh->ngx*mesh->ngy;
+    zs_phase.resize(npoints*((mesh->ngz-1)/2 + 1));
+    zs_value.assign(npoints, sqrt(-1.0));
+    
+    zs_ngx = mesh->ngx;
+    zs_ngy = mesh->ngy;
+    zs_ngz = mesh->ngz;
+    zs_zlength = mesh->zlength;
+  }
+}
+
+/// Compute the phases for point i
+static void zshift_calc(int i, BoutReal zoffset)
+{
+  int nk = (mesh->ngz-1)/2 + 1;
+  dcomplex *ph = &zs_phase[i*nk];
+  for(int jz=0;jz<nk;jz++) {
+    BoutReal kwave=jz*2.0*PI/mesh->zlength; // wave number is 1/[rad]
+    ph[jz] = dcomplex(cos(kwave*zoffset) , -sin(kwave*zoffset));
+  }
+  zs_value[i] = zoffset;
+}
+
+const dcomplex* zshift_phase(int jx, int jy)
+{
+  const dcomplex *ph;
+  BoutReal zoffset = mesh->zShift[jx][jy];
+  
+  // Checked and updated together, so no thread can see a
+  // value before its phases have been written
+  #pragma omp critical(zshift_phase)
+  {
+    zshift_check_mesh();
+    
+    int i = jx*mesh->ngy + jy;
+    if(zs_value[i] != zoffset) // Always true for NaN
+      zshift_calc(i, zoffset);
+    ph = &zs_phase[i*((mesh->ngz-1)/2 + 1)];
+  }
+  return ph;
+}
+
+const dcomplex* zshift_phases()
+{
+  const BoutReal *zs = mesh->zShift.getData()[0];
+  
+  #pragma omp critical(zshift_phase)
+  {
+    zshift_check_mesh();
+    
+    // Each point is only written by one thread
+    #pragma omp parallel for
+    for(int i=0;i<mesh->ngx*mesh->ngy;i++)
+      if(zs_value[i] != zs[i])
+        zshift_calc(i, zs[i]);
+  }
+  
+  return &zs_phase[0];
+}
+
+void ZFFT(BoutReal *in, int jx, int jy, dcomplex *cv, bool shift)
+{
+  int ncz = mesh->ngz-1;
+
+  rfft(in, ncz, cv);
+
+  if((mesh->ShiftXderivs) && shift) {
+    const dcomplex *ph = zshift_phase(jx, jy);
+    for(int jz=0;jz<=ncz/2;jz++)
+      cv[jz] *= ph[jz]; // Multiply by EXP(-ik*zoffset)
+  }
+}
+
+void ZFFT_rev(dcomplex *cv, int jx, int jy, BoutReal *out, bool shift)
+{
+  int ncz = mesh->ngz-1;
+  
+  if((mesh->ShiftXderivs) && shift) {
+    const dcomplex *ph = zshift_phase(jx, jy);
+    for(int jz=0;jz<=ncz/2;jz++)
+      cv[jz] *= conj(ph[jz]); // Multiply by EXP(ik*zoffset)
+  }
+
+  irfft(cv, ncz, out);
+}
+
+/***********************************************************
+ * Batched real FFTs
+ ***********************************************************/
+
+/// Plans for batched transforms, by size and direction
+struct FFTManyKey {
+  int length, howmany, dist, sign, nthreads;
+  
+  bool operator<(const FFTManyKey &k) const {
+    if(length != k.length) return length < k.length;
+    if(howmany != k.howmany) return howmany < k.howmany;
+    if(dist != k.dist) return dist < k.dist;
+    if(sign != k.sign) return sign < k.sign;
+    return nthreads < k.nthreads;
+  }
+};
+
+static std::map<FFTManyKey, fftw_plan> fft_many_plans;
+
+/// Get a plan for howmany lines, forward (sign < 0) or backward.
+/// nthreads > 1 makes a plan which uses FFTW's threads
+static fftw_plan fft_many_plan(int length, int howmany, int dist, int sign, int nthreads = 1)
+{
+  fftw_plan p;
+  
+  #pragma omp critical(fftw_planner)
+  {
+    FFTManyKey key = {length, howmany, dist, sign, nthreads};
+    std::map<FFTManyKey, fftw_plan>::iterator it = fft_many_plans.find(key);
+    if(it != fft_many_plans.end()) {
+      p = it->second;
+    }else {
+      
+      // Planning can overwrite the arrays, so plan on scratch arrays. 
+      // FFTW_UNALIGNED allows the plan to be executed on field data
+      int nk = length/2 + 1;
+      double *r = (double*) fftw_malloc(sizeof(double) * ((howmany-1)*dist + length));
+      fftw_complex *c = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * howmany * nk);
+      
+      unsigned int flags = fft_flags();
+      flags |= FFTW_UNALIGNED;
+      
+#ifdef FFTW_OMP
+      if(fft_threads)
+        fftw_plan_with_nthreads(nthreads);
+#endif
+      if(sign < 0) {
+        p = fftw_plan_many_dft_r2c(1, &length, howmany, r, NULL, 1, dist, 
+                                   c, NULL, 1, nk, flags);
+      }else
+        p = fftw_plan_many_dft_c2r(1, &length, howmany, c, NULL, 1, nk,
+                                   r, NULL, 1, dist, flags);
+      
+#ifdef FFTW_OMP
+      if(fft_threads)
+        fftw_plan_with_nthreads(1);
+#endif
+      fftw_free(r);
+      fftw_free(c);
+      fft_many_plans[key] = p;
+    }
+  }
+  return p;
+}
+
+static void fft_destroy_many()
+{
+  for(std::map<FFTManyKey, fftw_plan>::iterator it = fft_many_plans.begin(); it != fft_many_plans.end(); it++)
+    fftw_destroy_plan(it->second);
+  fft_many_plans.clear();
+}
+
+/// This thread's share of howmany lines
+static void fft_many_chunk(int howmany, int &start, int &n)
+{
+#ifdef _OPENMP
+  int n_th = omp_get_num_threads();
+  int th_id = omp_get_thread_num();
+  start = (howmany * th_id) / n_th;
+  n = (howmany * (th_id+1)) / n_th - start;
+#else
+  start = 0;
+  n = howmany;
+#endif
+}
+
+/// Number of FFTW threads to use for a batch of howmany lines.
+/// 1 means the lines are split between OpenMP threads instead
+static int fft_many_threads(int howmany)
+{
+#ifdef FFTW_OMP
+  fft_read_options();
+  if(!fft_threads || omp_in_parallel())
+    return 1;
+  
+  // Splitting the lines is cheapest if each thread gets enough of them.
+  // Otherwise (e.g. few X points and long Z lines) let FFTW share out
+  // the work inside the transforms
+  const int min_lines = 8;
+  int n_th = omp_get_max_threads();
+  if(howmany >= min_lines*n_th)
+    return 1;
+  return n_th;
+#else
+  return 1;
+#endif
+}
+
+void rfft_many(const BoutReal *in, int length, int howmany, int dist, dcomplex *out)
+{
+  int nk = length/2 + 1;
+  BoutReal norm = 1. / ((double) length);
+  
+  int nthreads = fft_many_threads(howmany);
+  if(nthreads > 1) {
+    // One transform, threaded by FFTW
+    fftw_plan p = fft_many_plan(length, howmany, dist, -1, nthreads);
+    double *o = (double*) out;
+    fftw_execute_dft_r2c(p, (double*) in, (fftw_complex*) o);
+    
+    #pragma omp parallel for
+    for(int i=0;i<2*howmany*nk;i++)
+      o[i] *= norm;
+    return;
+  }
+  
+  // Nested regions are serial, so inside a parallel region 
+  // this thread does all the lines
+  #pragma omp parallel
+  {
+    int start, n;
+    fft_many_chunk(howmany, start, n);
+    if(n > 0) {
+      fftw_plan p = fft_many_plan(length, n, dist, -1);
+      // dcomplex is stored as (real, imag), the same as fftw_complex
+      double *o = (double*) (out + start*nk);
+      fftw_execute_dft_r2c(p, (double*) (in + start*dist), (fftw_complex*) o);
+      
+      for(int i=0;i<2*n*nk;i++)
+        o[i] *= norm;
+    }
+  }
+}
+
+void irfft_many(dcomplex *in, int length, int howmany, BoutReal *out, int dist)
+{
+  int nk = length/2 + 1;
+  
+  int nthreads = fft_many_threads(howmany);
+  if(nthreads > 1) {
+    fftw_plan p = fft_many_plan(length, howmany, dist, 1, nthreads);
+    fftw_execute_dft_c2r(p, (fftw_complex*) in, out);
+    return;
+  }
+  
+  #pragma omp parallel
+  {
+    int start, n;
+    fft_many_chunk(howmany, start, n);
+    if(n > 0) {
+      fftw_plan p = fft_many_plan(length, n, dist, 1);
+      fftw_execute_dft_c2r(p, (fftw_complex*) (in + start*nk), out + start*dist);
+    }
+  }
+}
+
+#ifdef BOUT_FIELD_FLOAT
+// Single precision field data. Converted to BoutReal for the transform
+
+void rfft(float *in, int length, dcomplex *out)
+{
+  rvec tmp(in, in + length);
+  rfft(&tmp[0], length, out);
+}
+
+void irfft(dcomplex *in, int length, float *out)
+{
+  rvec tmp(length);
+  irfft(in, length, &tmp[0]);
+  for(int i=0;i<length;i++)
+    out[i] = (float) tmp[i];
+}
+
+void ZFFT(float *in, BoutReal zoffset, dcomplex *cv, bool shift)
+{
+  rvec tmp(in, in + mesh->ngz-1);
+  ZFFT(&tmp[0], zoffset, cv, shift);
+}
+
+void ZFFT_rev(dcomplex *cv, BoutReal zoffset, float *out, bool shift)
+{
+  int ncz = mesh->ngz-1;
+  rvec tmp(ncz);
+  ZFFT_rev(cv, zoffset, &tmp[0], shift);
+  for(int i=0;i<ncz;i++)
+    out[i] = (float) tmp[i];
+}
+
+void ZFFT(float *in, int jx, int jy, dcomplex *cv, bool shift)
+{
+  rvec tmp(in, in + mesh->ngz-1);
+  ZFFT(&tmp[0], jx, jy, cv, shift);
+}
+
+void ZFFT_rev(dcomplex *cv, int jx, int jy, float *out, bool shift)
+{
+  int ncz = mesh->ngz-1;
+  rvec tmp(ncz);
+  ZFFT_rev(cv, jx, jy, &tmp[0], shift);
+  for(int i=0;i<ncz;i++)
+    out[i] = (float) tmp[i];
+}
+
+void rfft_many(const float *in, int length, int howmany, int dist, dcomplex *out)
+{
+  rvec tmp(howmany*length);
+  for(int i=0;i<howmany;i++)
+    for(int j=0;j<length;j++)
+      tmp[i*length + j] = in[i*dist + j];
+  rfft_many(&tmp[0], length, howmany, length, out);
+}
+
+void irfft_many(dcomplex *in, int length, int howmany, float *out, int dist)
+{
+  rvec tmp(howmany*length);
+  irfft_many(in, length, howmany, &tmp[0], length);
+  for(int i=0;i<howmany;i++)
+    for(int j=0;j<length;j++)
+      out[i*dist + j] = (float) tmp[i*length + j];
+}
+#endif // BOUT_FIELD_FLOAT
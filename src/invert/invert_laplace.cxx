@@ -9,11 +9,14 @@
  * 
  * Flags control the boundary conditions (see header file)
  *
- * Parallel inversion done using two methods
+ * Parallel inversion done using three methods
  * - Either a simple parallelisation of the serial algorithm (same operations). Reasonably
  *   parallel as long as MYSUB > mesh->NXPE
  * - (EXPERIMENTAL) The Parallel Diagonally Dominant (PDD) algorithm. This doesn't seem
  *   to work properly for some simulations (works ok for some benchmarks).
+ * - A hybrid of local Thomas elimination and Parallel Cyclic Reduction of the
+ *   interface rows. Exact. The 2*mesh->NXPE interface rows are gathered onto
+ *   every processor in X, which each solve the reduced system
  *
  **************************************************************************
  * Copyright 2010 B.D.Dudson, S.Farley, M.V.Umansky, X.Q.Xu
@@ -53,6 +56,9 @@
 #include <lapack_routines.hxx> // Tridiagonal & band inversion routines
 #include <boutexception.hxx>
 
+#include <vector>
+#include <map>
+
 // This was defined in nvector.h
 #define PVEC_REAL_MPI_TYPE MPI_DOUBLE
 
@@ -63,9 +69,12 @@
 int laplace_maxmode; ///< The maximum Z mode to solve for
 bool invert_async_send; ///< If true, use asyncronous send in parallel algorithms
 bool invert_use_pdd; ///< If true, use PDD algorithm
+bool invert_use_pcr; ///< If true, use Thomas/PCR hybrid algorithm
 bool invert_low_mem;    ///< If true, reduce the amount of memory used
 bool laplace_all_terms; // applies to Delp2 operator and laplacian inversion
 bool laplace_nonuniform; // Non-uniform mesh correction
+bool laplace_factor_cache; ///< Keep the factorised matrices of the serial solver
+int laplace_max_factors;   ///< Maximum number of coefficient sets kept
 
 /// Laplacian inversion initialisation. Called once at the start to get settings
 int invert_init()
@@ -85,8 +94,11 @@ int invert_init()
   OPTION(lapOpts, filter, 0.2);
   lapOpts->get("low_mem", invert_low_mem, false);
   lapOpts->get("use_pdd", invert_use_pdd, false);
+  lapOpts->get("use_pcr", invert_use_pcr, false);
   lapOpts->get("all_terms", laplace_all_terms, false); 
   OPTION(lapOpts, laplace_nonuniform, false);
+  lapOpts->get("factor_cache", laplace_factor_cache, true);
+  lapOpts->get("max_factors", laplace_max_factors, 4);
 
   if(mesh->firstX() && mesh->lastX()) {
     // This processor is both the first and the last in X
@@ -95,7 +107,9 @@ int invert_init()
     
   }else {
     // Need to use a parallel algorithm
-    if(invert_use_pdd) {
+    if(invert_use_pcr) {
+      output.write("\tUsing Thomas/PCR hybrid algorithm\n");
+    }else if(invert_use_pdd) {
       output.write("\tUsing PDD algorithm\n");
     }else
       output.write("\tUsing parallel Thomas algorithm\n");
@@ -119,14 +133,17 @@ int invert_init()
   return 0;
 }
 
-/// Returns the coefficients for a tridiagonal matrix for laplace. Used by Delp2 too
-void laplace_tridag_coefs(int jx, int jy, int jz, dcomplex &a, dcomplex &b, dcomplex &c, 
-                          const Field2D *ccoef, const Field2D *d)
+/// The parts of the tridiagonal coefficients at (jx,jy) which don't depend on kz
+/*!
+ * For wave number kwave the coefficients are
+ *   a = (coef1 - coef4, -kwave*coef3)
+ *   b = (-2*coef1 - kwave^2*coef2, kwave*coef5)
+ *   c = (coef1 + coef4, kwave*coef3)
+ */
+static void laplace_tridag_xcoefs(int jx, int jy, BoutReal &coef1, BoutReal &coef2, BoutReal &coef3,
+                                  BoutReal &coef4, BoutReal &coef5,
+                                  const Field2D *ccoef, const Field2D *d)
 {
-  BoutReal coef1, coef2, coef3, coef4, coef5, kwave;
-  
-  kwave=jz*2.0*PI/mesh->zlength; // wave number is 1/[rad]
-  
   coef1=mesh->g11[jx][jy];     ///< X 2nd derivative coefficient
   coef2=mesh->g33[jx][jy];     ///< Z 2nd derivative coefficient
   coef3=2.*mesh->g13[jx][jy];  ///< X-Z mixed derivative coefficient
@@ -168,62 +185,393 @@ void laplace_tridag_coefs(int jx, int jy, int jz, dcomplex &a, dcomplex &b, dcom
     coef3 = 0.0; // This cancels out
   }
   
-  /*
-  if((jy == 4) && (jz == 1)  && (jx > 0) && (jx < (mesh->ngx-1))) {
-    output.write("Lap x=%d : %e, %e, %e, %e\n", jx, 
-                 coef1, coef2, coef4, kwave);
-  }
-  */
-  
   coef1 /= SQ(mesh->dx[jx][jy]);
   coef3 /= 2.*mesh->dx[jx][jy];
+}
+
+/// Returns the coefficients for a tridiagonal matrix for laplace. Used by Delp2 too
+void laplace_tridag_coefs(int jx, int jy, int jz, dcomplex &a, dcomplex &b, dcomplex &c, 
+                          const Field2D *ccoef, const Field2D *d)
+{
+  BoutReal coef1, coef2, coef3, coef4, coef5, kwave;
+  
+  kwave=jz*2.0*PI/mesh->zlength; // wave number is 1/[rad]
+  
+  laplace_tridag_xcoefs(jx, jy, coef1, coef2, coef3, coef4, coef5, ccoef, d);
   
   a = dcomplex(coef1 - coef4,-kwave*coef3);
   b = dcomplex(-2.0*coef1 - SQ(kwave)*coef2,kwave*coef5);
   c = dcomplex(coef1 + coef4,kwave*coef3);
 }
 
+/// Sets the boundary rows of the 2nd order matrix for mode iz
+/*!
+ * Only for non-periodic X. inset and outset are set to true if the RHS of
+ * the inner or outer boundary rows should be the values in the boundary
+ * (INVERT_IN_SET, INVERT_OUT_SET), and false otherwise
+ */
+static void laplace_tridag_bndry(int jy, int iz, int flags, int xbndry,
+                                 dcomplex *avec, dcomplex *bvec, dcomplex *cvec,
+                                 bool &inset, bool &outset)
+{
+  int ncx = mesh->ngx-1;
+  int ix;
+  
+  inset = outset = false;
+  
+  if(iz == 0) {
+    // DC
+
+    // Inner boundary
+    if(flags & INVERT_DC_IN_GRAD) {
+      // Zero gradient at inner boundary
+
+      if((flags & INVERT_IN_SYM) && (xbndry > 1) && mesh->BoundaryOnCell) {
+        // Use symmetric boundary to set zero-gradient
+
+        for (ix=0;ix<xbndry-1;ix++) {
+          avec[ix]=0.0; bvec[ix]=1.0; cvec[ix]= -1.0;
+        }
+        // Symmetric on last point
+        avec[xbndry-1] = 1.0; bvec[xbndry-1] = 0.0; cvec[xbndry-1] = -1.0;
+      }else {
+        for (ix=0;ix<xbndry;ix++){
+          avec[ix]=dcomplex(0.0,0.0);
+          bvec[ix]=dcomplex(1.,0.);
+          cvec[ix]=dcomplex(-1.,0.);
+        }
+      }
+    }else if(flags & INVERT_IN_SET) {
+      for(ix=0;ix<xbndry;ix++) {
+        avec[ix] = 0.0;
+        bvec[ix] = 1.0;
+        cvec[ix] = 0.0;
+      }
+      inset = true;
+    }else {
+      // Zero value at inner boundary
+      if(flags & INVERT_IN_SYM) {
+        // Use anti-symmetric boundary to set zero-value
+
+        // Zero-gradient for first point(s)
+        for(ix=0;ix<xbndry-1;ix++) {
+          avec[ix]=0.0; bvec[ix]=1.0; cvec[ix]= -1.0;
+        }
+
+        if(mesh->BoundaryOnCell) {
+          // Antisymmetric about boundary on cell
+          avec[xbndry-1]=1.0; bvec[xbndry-1]=0.0; cvec[xbndry-1]= 1.0;
+        }else { 
+          // Antisymmetric across boundary between cells
+          avec[xbndry-1]=0.0; bvec[xbndry-1]=1.0; cvec[xbndry-1]= 1.0;
+        }
+
+      }else {
+        for (ix=0;ix<xbndry;ix++){
+          avec[ix]=dcomplex(0.,0.);
+          bvec[ix]=dcomplex(1.,0.);
+          cvec[ix]=dcomplex(0.,0.);
+        }
+      }
+    }
+
+    // Outer boundary
+    if(flags & INVERT_DC_OUT_GRAD) {
+      // Zero gradient at outer boundary
+
+      if((flags & INVERT_OUT_SYM) && (xbndry > 1) && mesh->BoundaryOnCell) {
+        // Use symmetric boundary to set zero-gradient
+
+        for (ix=0;ix<xbndry-1;ix++) {
+          avec[ncx-ix]=-1.0; bvec[ncx-ix]=1.0; cvec[ncx-ix]= 0.0;
+        }
+        // Symmetric on last point
+        ix = xbndry-1;
+        avec[ncx-ix] = 1.0; bvec[ncx-ix] = 0.0; cvec[ncx-ix] = -1.0;
+
+      }else {
+        for (ix=0;ix<xbndry;ix++){
+          cvec[ncx-ix]=dcomplex(0.,0.);
+          bvec[ncx-ix]=dcomplex(1.,0.);
+          avec[ncx-ix]=dcomplex(-1.,0.);
+        }
+      }
+    }else if(flags & INVERT_OUT_SET) {
+      // Setting the values in the outer boundary
+      for(ix=0;ix<xbndry;ix++) {
+        avec[ncx-ix] = 0.0;
+        bvec[ncx-ix] = 1.0;
+        cvec[ncx-ix] = 0.0;
+      }
+      outset = true;
+    }else {
+      // Zero value at outer boundary
+      if(flags & INVERT_OUT_SYM) {
+        // Use anti-symmetric boundary to set zero-value
+
+        // Zero-gradient for first point(s)
+        for(ix=0;ix<xbndry-1;ix++) {
+          avec[ncx-ix]=-1.0; bvec[ncx-ix]=1.0; cvec[ncx-ix]= 0.0;
+        }
+        ix = xbndry-1;
+        if(mesh->BoundaryOnCell) {
+          // Antisymmetric about boundary on cell
+          avec[ncx-ix]=1.0; bvec[ncx-ix]=0.0; cvec[ncx-ix]= 1.0;
+        }else { 
+          // Antisymmetric across boundary between cells
+          avec[ncx-ix]=1.0; bvec[ncx-ix]=1.0; cvec[ncx-ix]= 0.0;
+        }
+      }else {
+        for (ix=0;ix<xbndry;ix++){
+          cvec[ncx-ix]=dcomplex(0.,0.);
+          bvec[ncx-ix]=dcomplex(1.,0.);
+          avec[ncx-ix]=dcomplex(0.,0.);
+        }
+      }
+    }
+  }else {
+    // AC
+
+    // Inner boundary
+    if(flags & INVERT_AC_IN_GRAD) {
+      // Zero gradient at inner boundary
+
+      if((flags & INVERT_IN_SYM) && (xbndry > 1) && mesh->BoundaryOnCell) {
+        // Use symmetric boundary to set zero-gradient
+
+        for (ix=0;ix<xbndry-1;ix++) {
+          avec[ix]=0.0; bvec[ix]=1.0; cvec[ix]= -1.0;
+        }
+        // Symmetric on last point
+        avec[xbndry-1] = 1.0; bvec[xbndry-1] = 0.0; cvec[xbndry-1] = -1.0;
+      }else {
+        for (ix=0;ix<xbndry;ix++){
+          avec[ix]=dcomplex(0.,0.);
+          bvec[ix]=dcomplex(1.,0.);
+          cvec[ix]=dcomplex(-1.,0.);
+        }
+      }
+    }else if(flags & INVERT_IN_SET) {
+      // Setting the values in the boundary
+      for(ix=0;ix<xbndry;ix++) {
+        avec[ix] = 0.0;
+        bvec[ix] = 1.0;
+        cvec[ix] = 0.0;
+      }
+      inset = true;
+    }else if(flags & INVERT_AC_IN_LAP) {
+      // Use decaying zero-Laplacian solution in the boundary
+      BoutReal kwave=iz*2.0*PI/mesh->zlength; // wave number is 1/[rad]
+      for (ix=0;ix<xbndry;ix++) {
+        avec[ix] = 0.0;
+        bvec[ix] = -1.0;
+        cvec[ix] = exp(-1.0*sqrt(mesh->g33[ix][jy]/mesh->g11[ix][jy])*kwave*mesh->dx[ix][jy]);
+      }
+    }else {
+      // Zero value at inner boundary
+
+      if(flags & INVERT_IN_SYM) {
+        // Use anti-symmetric boundary to set zero-value
+
+        // Zero-gradient for first point(s)
+        for(ix=0;ix<xbndry-1;ix++) {
+          avec[ix]=0.0; bvec[ix]=1.0; cvec[ix]= -1.0;
+        }
+
+        if(mesh->BoundaryOnCell) {
+          // Antisymmetric about boundary on cell
+          avec[xbndry-1]=1.0; bvec[xbndry-1]=0.0; cvec[xbndry-1]= 1.0;
+        }else { 
+          // Antisymmetric across boundary between cells
+          avec[xbndry-1]=0.0; bvec[xbndry-1]=1.0; cvec[xbndry-1]= 1.0;
+        }
+
+      }else {
+        for (ix=0;ix<xbndry;ix++){
+          avec[ix]=dcomplex(0.,0.);
+          bvec[ix]=dcomplex(1.,0.);
+          cvec[ix]=dcomplex(0.,0.);
+        }
+      }
+    }
+
+    // Outer boundary
+    if(flags & INVERT_AC_OUT_GRAD) {
+      // Zero gradient at outer boundary
+
+      if((flags & INVERT_OUT_SYM) && (xbndry > 1) && mesh->BoundaryOnCell) {
+        // Use symmetric boundary to set zero-gradient
+
+        for (ix=0;ix<xbndry-1;ix++) {
+          avec[ncx-ix]=-1.0; bvec[ncx-ix]=1.0; cvec[ncx-ix]= 0.0;
+        }
+        // Symmetric on last point
+        ix = xbndry-1;
+        avec[ncx-ix] = 1.0; bvec[ncx-ix] = 0.0; cvec[ncx-ix] = -1.0;
+
+      }else {
+        for (ix=0;ix<xbndry;ix++){
+          cvec[ncx-ix]=dcomplex(0.,0.);
+          bvec[ncx-ix]=dcomplex(1.,0.);
+          avec[ncx-ix]=dcomplex(-1.,0.);
+        }
+      }
+    }else if(flags & INVERT_AC_OUT_LAP) {
+      // Use decaying zero-Laplacian solution in the boundary
+      BoutReal kwave=iz*2.0*PI/mesh->zlength; // wave number is 1/[rad]
+      for (ix=0;ix<xbndry;ix++) {
+        avec[ncx-ix] = exp(-1.0*sqrt(mesh->g33[ncx-ix][jy]/mesh->g11[ncx-ix][jy])*kwave*mesh->dx[ncx-ix][jy]);;
+        bvec[ncx-ix] = -1.0;
+        cvec[ncx-ix] = 0.0;
+      }
+    }else if(flags & INVERT_OUT_SET) {
+      // Setting the values in the outer boundary
+      for(ix=0;ix<xbndry;ix++) {
+        avec[ncx-ix] = 0.0;
+        bvec[ncx-ix] = 1.0;
+        cvec[ncx-ix] = 0.0;
+      }
+      outset = true;
+    }else {
+      // Zero value at outer boundary
+
+      if(flags & INVERT_OUT_SYM) {
+        // Use anti-symmetric boundary to set zero-value
+
+        // Zero-gradient for first point(s)
+        for(ix=0;ix<xbndry-1;ix++) {
+          avec[ncx-ix]=-1.0; bvec[ncx-ix]=1.0; cvec[ncx-ix]= 0.0;
+        }
+        ix = xbndry-1;
+        if(mesh->BoundaryOnCell) {
+          // Antisymmetric about boundary on cell
+          avec[ncx-ix]=1.0; bvec[ncx-ix]=0.0; cvec[ncx-ix]= 1.0;
+        }else {
+          // Antisymmetric across boundary between cells
+          avec[ncx-ix]=1.0; bvec[ncx-ix]=1.0; cvec[ncx-ix]= 0.0;
+        }
+      }else {
+        for (ix=0;ix<xbndry;ix++){
+          cvec[ncx-ix]=dcomplex(0.,0.);
+          bvec[ncx-ix]=dcomplex(1.,0.);
+          avec[ncx-ix]=dcomplex(0.,0.);
+        }
+      }
+    }
+  }
+}
+
+/// Fills in the (anti-)symmetric boundary points of the solution xk[ix*stride] for mode iz
+static void laplace_tridag_sym(int iz, int flags, int xbndry, dcomplex *xk, int stride = 1)
+{
+  int ncx = mesh->ngx-1;
+  int ix;
+  
+  if((flags & INVERT_IN_SYM) && (xbndry > 1)) {
+    // (Anti-)symmetry on inner boundary. Nothing to do if only one boundary cell
+    int xloc = 2*xbndry;
+    if(!mesh->BoundaryOnCell)
+      xloc--;
+
+    if( ((iz == 0) && (flags & INVERT_DC_IN_GRAD)) || ((iz != 0) && (flags & INVERT_AC_IN_GRAD)) ) {
+      // Inner gradient zero - symmetric
+      for(ix=0;ix<xbndry-1;ix++)
+        xk[ix*stride] = xk[(xloc-ix)*stride];
+    }else {
+      // Inner value zero - antisymmetric
+      for(ix=0;ix<xbndry-1;ix++)
+        xk[ix*stride] = -xk[(xloc-ix)*stride];
+    }
+  }
+  if((flags & INVERT_OUT_SYM) && (xbndry > 1)) {
+    // (Anti-)symmetry on outer boundary. Nothing to do if only one boundary cell
+
+    int xloc =  mesh->ngx - 2*xbndry;
+    if(mesh->BoundaryOnCell)
+      xloc--;
+
+    if( ((iz == 0) && (flags & INVERT_DC_IN_GRAD)) || ((iz != 0) && (flags & INVERT_AC_IN_GRAD)) ) {
+      // Outer gradient zero - symmetric
+      for(ix=0;ix<xbndry-1;ix++)
+        xk[(ncx-ix)*stride] = xk[(xloc + ix)*stride];
+    }else {
+      // Outer value zero - antisymmetric
+      for(ix=0;ix<xbndry-1;ix++)
+        xk[(ncx-ix)*stride] = -xk[(xloc + ix)*stride];
+    }
+  }
+}
+
 /**********************************************************************************
  *                                 SERIAL CODE
  **********************************************************************************/
 
-/// Perpendicular laplacian inversion (serial)
+/// Work arrays for the serial inversion
+struct LaplaceSerWork {
+  int ngx, nk;
+  dcomplex **bk, **xk;        ///< Spectra [ix][kz]
+  dcomplex *bk1d, *xk1d;
+  dcomplex **A;               ///< Band matrix (4th order)
+  dcomplex *avec, *bvec, *cvec; ///< Tridiagonal matrix (2nd order)
+  
+  LaplaceSerWork(int ngx, int nk) : ngx(ngx), nk(nk) {
+    bk = cmatrix(ngx, nk);
+    xk = cmatrix(ngx, nk);
+    bk1d = new dcomplex[ngx];
+    xk1d = new dcomplex[ngx];
+    A = cmatrix(ngx, 5);
+    avec = new dcomplex[ngx];
+    bvec = new dcomplex[ngx];
+    cvec = new dcomplex[ngx];
+  }
+  ~LaplaceSerWork() {
+    free_cmatrix(bk);
+    free_cmatrix(xk);
+    delete[] bk1d;
+    delete[] xk1d;
+    free_cmatrix(A);
+    delete[] avec;
+    delete[] bvec;
+    delete[] cvec;
+  }
+};
+
+/// Each OpenMP thread has its own work arrays, so slices can be inverted concurrently
+static LaplaceSerWork *laplace_ser_work = NULL;
+#pragma omp threadprivate(laplace_ser_work)
+
+static LaplaceSerWork* laplace_get_ser_work()
+{
+  int nk = (mesh->ngz-1)/2 + 1;
+  if((laplace_ser_work == NULL) || (laplace_ser_work->ngx != mesh->ngx) || (laplace_ser_work->nk != nk)) {
+    if(laplace_ser_work != NULL)
+      delete laplace_ser_work;
+    laplace_ser_work = new LaplaceSerWork(mesh->ngx, nk);
+  }
+  return laplace_ser_work;
+}
+
+/// Inverts X-Z slice jy using band-diagonal solvers
 /*!
- * Inverts an X-Z slice (FieldPerp) using band-diagonal solvers
- * This code is only for serial i.e. mesh->NXPE == 1
+ * Row ix of the slice starts at bd + ix*bstride in b, and xd + ix*xstride in x,
+ * so this can work on FieldPerp or directly on Field3D data.
+ * Thread safe: uses no Field objects, and the work arrays of the calling thread
  */
-int invert_laplace_ser(const FieldPerp &b, FieldPerp &x, int flags, const Field2D *a,
-                       const Field2D *ccoef=NULL, const Field2D *d=NULL)
+template<typename T>
+static int laplace_ser_slice(int jy, const T *bd, int bstride, T *xd, int xstride, int flags,
+                             const Field2D *a, const Field2D *ccoef, const Field2D *d)
 {
   int ncx = mesh->ngx-1;
   int ncz = mesh->ngz-1;
 
-  int ix, jy, iz;
-  static dcomplex **bk = NULL, *bk1d;
-  static dcomplex **xk, *xk1d;
+  int ix, iz;
   int xbndry; // Width of the x boundary
   
   BoutReal coef1=0.0, coef2=0.0, coef3=0.0, coef4=0.0, coef5=0.0, coef6=0.0, kwave, flt;
 
-  if(!mesh->firstX() || !mesh->lastX()) {
-    output.write("Error: invert_laplace only works for mesh->NXPE = 1\n");
-    return 1;
-  }
-  
-  x.allocate();
-
-  jy = b.getIndex();
-  x.setIndex(jy);
-
-  if(bk == NULL) {
-    // Allocate memory
-
-    bk = cmatrix(mesh->ngx, ncz/2 + 1);
-    bk1d = new dcomplex[mesh->ngx];
-    
-    xk = cmatrix(mesh->ngx, ncz/2 + 1);
-    xk1d = new dcomplex[mesh->ngx];
-  }
+  LaplaceSerWork *work = laplace_get_ser_work();
+  dcomplex **bk = work->bk, *bk1d = work->bk1d;
+  dcomplex **xk = work->xk, *xk1d = work->xk1d;
 
   xbndry = 2;
   if(flags & INVERT_BNDRY_ONE)
@@ -232,7 +580,7 @@ int invert_laplace_ser(const FieldPerp &b, FieldPerp &x, int flags, const Field2
   for(ix=0;ix<mesh->ngx;ix++) {
     // for fixed ix,jy set a complex vector rho(z)
     
-    ZFFT(b[ix], mesh->zShift[ix][jy], bk[ix]);
+    ZFFT(const_cast<T*>(bd + ix*bstride), ix, jy, bk[ix]);
   }
   
   if(!mesh->periodicX) {
@@ -240,25 +588,22 @@ int invert_laplace_ser(const FieldPerp &b, FieldPerp &x, int flags, const Field2
       // Setting the inner boundary from x
       
       for(ix=0;ix<xbndry;ix++)
-	ZFFT(x[ix], mesh->zShift[ix][jy], xk[ix]);
+	ZFFT(xd + ix*xstride, ix, jy, xk[ix]);
     }
     
     if(flags & INVERT_OUT_SET) {
       // Setting the outer boundary from x
       
       for(ix=0;ix<xbndry;ix++)
-	ZFFT(x[ncx-ix], mesh->zShift[ncx-ix][jy], xk[ncx-ix]);
+	ZFFT(xd + (ncx-ix)*xstride, ncx-ix, jy, xk[ncx-ix]);
     }
   }
   
   if((flags & INVERT_4TH_ORDER) && (!mesh->periodicX)) { // Not implemented for parallel calculations or periodic X
     // Use band solver - 4th order
 
-    static dcomplex **A = (dcomplex**) NULL;
+    dcomplex **A = work->A;
     int xstart, xend;
-
-    if(A == (dcomplex**) NULL)
-      A = cmatrix(mesh->ngx, 5);
     
     // Get range for 4th order: Need at least 2 each side
     if(xbndry > 1) {
@@ -527,13 +872,7 @@ int invert_laplace_ser(const FieldPerp &b, FieldPerp &x, int flags, const Field2
   }else {
     // Use tridiagonal system in x - 2nd order
     
-    static dcomplex *avec = (dcomplex*) NULL, *bvec, *cvec;
-    
-    if(avec == (dcomplex*) NULL) {
-      avec = new dcomplex[mesh->ngx];
-      bvec = new dcomplex[mesh->ngx];
-      cvec = new dcomplex[mesh->ngx];
-    }
+    dcomplex *avec = work->avec, *bvec = work->bvec, *cvec = work->cvec;
 
     for(iz=0;iz<=ncz/2;iz++) {
       // solve differential equation in x
@@ -567,284 +906,21 @@ int invert_laplace_ser(const FieldPerp &b, FieldPerp &x, int flags, const Field2
 	}
 	
 	// Set boundary conditions
-	
-	if(iz == 0) {
-	  // DC
-	  
-	  // Inner boundary
-	  if(flags & INVERT_DC_IN_GRAD) {
-	    // Zero gradient at inner boundary
-	    
-	    if((flags & INVERT_IN_SYM) && (xbndry > 1) && mesh->BoundaryOnCell) {
-	      // Use symmetric boundary to set zero-gradient
-	      
-	      for (ix=0;ix<xbndry-1;ix++) {
-		avec[ix]=0.0; bvec[ix]=1.0; cvec[ix]= -1.0;
-	      }
-	      // Symmetric on last point
-	      avec[xbndry-1] = 1.0; bvec[xbndry-1] = 0.0; cvec[xbndry-1] = -1.0;
-	    }else {
-	      for (ix=0;ix<xbndry;ix++){
-		avec[ix]=dcomplex(0.0,0.0);
-		bvec[ix]=dcomplex(1.,0.);
-		cvec[ix]=dcomplex(-1.,0.);
-	      }
-	    }
-	  }else if(flags & INVERT_IN_SET) {
-	    for(ix=0;ix<xbndry;ix++) {
-	      avec[ix] = 0.0;
-	      bvec[ix] = 1.0;
-	      cvec[ix] = 0.0;
-	      bk1d[ix] = xk[ix][iz];
-	    }
-	  }else {
-	    // Zero value at inner boundary
-	    if(flags & INVERT_IN_SYM) {
-	      // Use anti-symmetric boundary to set zero-value
-	    
-	      // Zero-gradient for first point(s)
-	      for(ix=0;ix<xbndry-1;ix++) {
-		avec[ix]=0.0; bvec[ix]=1.0; cvec[ix]= -1.0;
-	      }
-
-	      if(mesh->BoundaryOnCell) {
-		// Antisymmetric about boundary on cell
-		avec[xbndry-1]=1.0; bvec[xbndry-1]=0.0; cvec[xbndry-1]= 1.0;
-	      }else { 
-		// Antisymmetric across boundary between cells
-		avec[xbndry-1]=0.0; bvec[xbndry-1]=1.0; cvec[xbndry-1]= 1.0;
-	      }
-	    
-	    }else {
-	      for (ix=0;ix<xbndry;ix++){
-		avec[ix]=dcomplex(0.,0.);
-		bvec[ix]=dcomplex(1.,0.);
-		cvec[ix]=dcomplex(0.,0.);
-	      }
-	    }
-	  }
-	
-	  // Outer boundary
-	  if(flags & INVERT_DC_OUT_GRAD) {
-	    // Zero gradient at outer boundary
-
-	    if((flags & INVERT_OUT_SYM) && (xbndry > 1) && mesh->BoundaryOnCell) {
-	      // Use symmetric boundary to set zero-gradient
-	    
-	      for (ix=0;ix<xbndry-1;ix++) {
-		avec[ncx-ix]=-1.0; bvec[ncx-ix]=1.0; cvec[ncx-ix]= 0.0;
-	      }
-	      // Symmetric on last point
-	      ix = xbndry-1;
-	      avec[ncx-ix] = 1.0; bvec[ncx-ix] = 0.0; cvec[ncx-ix] = -1.0;
-	    
-	    }else {
-	      for (ix=0;ix<xbndry;ix++){
-		cvec[ncx-ix]=dcomplex(0.,0.);
-		bvec[ncx-ix]=dcomplex(1.,0.);
-		avec[ncx-ix]=dcomplex(-1.,0.);
-	      }
-	    }
-	  }else if(flags & INVERT_OUT_SET) {
-	    // Setting the values in the outer boundary
-	    for(ix=0;ix<xbndry;ix++) {
-	      avec[ncx-ix] = 0.0;
-	      bvec[ncx-ix] = 1.0;
-	      cvec[ncx-ix] = 0.0;
-	      bk1d[ncx-ix] = xk[ncx-ix][iz];
-	    }
-	  }else {
-	    // Zero value at outer boundary
-	    if(flags & INVERT_OUT_SYM) {
-	      // Use anti-symmetric boundary to set zero-value
-	    
-	      // Zero-gradient for first point(s)
-	      for(ix=0;ix<xbndry-1;ix++) {
-		avec[ncx-ix]=-1.0; bvec[ncx-ix]=1.0; cvec[ncx-ix]= 0.0;
-	      }
-	      ix = xbndry-1;
-	      if(mesh->BoundaryOnCell) {
-		// Antisymmetric about boundary on cell
-		avec[ncx-ix]=1.0; bvec[ncx-ix]=0.0; cvec[ncx-ix]= 1.0;
-	      }else { 
-		// Antisymmetric across boundary between cells
-		avec[ncx-ix]=1.0; bvec[ncx-ix]=1.0; cvec[ncx-ix]= 0.0;
-	      }
-	    }else {
-	      for (ix=0;ix<xbndry;ix++){
-		cvec[ncx-ix]=dcomplex(0.,0.);
-		bvec[ncx-ix]=dcomplex(1.,0.);
-		avec[ncx-ix]=dcomplex(0.,0.);
-	      }
-	    }
-	  }
-	}else {
-	  // AC
-	
-	  // Inner boundary
-	  if(flags & INVERT_AC_IN_GRAD) {
-	    // Zero gradient at inner boundary
-	  
-	    if((flags & INVERT_IN_SYM) && (xbndry > 1) && mesh->BoundaryOnCell) {
-	      // Use symmetric boundary to set zero-gradient
-	    
-	      for (ix=0;ix<xbndry-1;ix++) {
-		avec[ix]=0.0; bvec[ix]=1.0; cvec[ix]= -1.0;
-	      }
-	      // Symmetric on last point
-	      avec[xbndry-1] = 1.0; bvec[xbndry-1] = 0.0; cvec[xbndry-1] = -1.0;
-	    }else {
-	      for (ix=0;ix<xbndry;ix++){
-		avec[ix]=dcomplex(0.,0.);
-		bvec[ix]=dcomplex(1.,0.);
-		cvec[ix]=dcomplex(-1.,0.);
-	      }
-	    }
-	  }else if(flags & INVERT_IN_SET) {
-	    // Setting the values in the boundary
-	    for(ix=0;ix<xbndry;ix++) {
-	      avec[ix] = 0.0;
-	      bvec[ix] = 1.0;
-	      cvec[ix] = 0.0;
-	      bk1d[ix] = xk[ix][iz];
-	    }
-	  }else if(flags & INVERT_AC_IN_LAP) {
-	    // Use decaying zero-Laplacian solution in the boundary
-	    BoutReal kwave=iz*2.0*PI/mesh->zlength; // wave number is 1/[rad]
-	    for (ix=0;ix<xbndry;ix++) {
-	      avec[ix] = 0.0;
-	      bvec[ix] = -1.0;
-	      cvec[ix] = exp(-1.0*sqrt(mesh->g33[ix][jy]/mesh->g11[ix][jy])*kwave*mesh->dx[ix][jy]);
-	    }
-	  }else {
-	    // Zero value at inner boundary
-
-	    if(flags & INVERT_IN_SYM) {
-	      // Use anti-symmetric boundary to set zero-value
-	    
-	      // Zero-gradient for first point(s)
-	      for(ix=0;ix<xbndry-1;ix++) {
-		avec[ix]=0.0; bvec[ix]=1.0; cvec[ix]= -1.0;
-	      }
-
-	      if(mesh->BoundaryOnCell) {
-		// Antisymmetric about boundary on cell
-		avec[xbndry-1]=1.0; bvec[xbndry-1]=0.0; cvec[xbndry-1]= 1.0;
-	      }else { 
-		// Antisymmetric across boundary between cells
-		avec[xbndry-1]=0.0; bvec[xbndry-1]=1.0; cvec[xbndry-1]= 1.0;
-	      }
-	    
-	    }else {
-	      for (ix=0;ix<xbndry;ix++){
-		avec[ix]=dcomplex(0.,0.);
-		bvec[ix]=dcomplex(1.,0.);
-		cvec[ix]=dcomplex(0.,0.);
-	      }
-	    }
-	  }
-	
-	  // Outer boundary
-	  if(flags & INVERT_AC_OUT_GRAD) {
-	    // Zero gradient at outer boundary
-	  
-	    if((flags & INVERT_OUT_SYM) && (xbndry > 1) && mesh->BoundaryOnCell) {
-	      // Use symmetric boundary to set zero-gradient
-	    
-	      for (ix=0;ix<xbndry-1;ix++) {
-		avec[ncx-ix]=-1.0; bvec[ncx-ix]=1.0; cvec[ncx-ix]= 0.0;
-	      }
-	      // Symmetric on last point
-	      ix = xbndry-1;
-	      avec[ncx-ix] = 1.0; bvec[ncx-ix] = 0.0; cvec[ncx-ix] = -1.0;
-	    
-	    }else {
-	      for (ix=0;ix<xbndry;ix++){
-		cvec[ncx-ix]=dcomplex(0.,0.);
-		bvec[ncx-ix]=dcomplex(1.,0.);
-		avec[ncx-ix]=dcomplex(-1.,0.);
-	      }
-	    }
-	  }else if(flags & INVERT_AC_OUT_LAP) {
-	    // Use decaying zero-Laplacian solution in the boundary
-	    BoutReal kwave=iz*2.0*PI/mesh->zlength; // wave number is 1/[rad]
-	    for (ix=0;ix<xbndry;ix++) {
-	      avec[ncx-ix] = exp(-1.0*sqrt(mesh->g33[ncx-ix][jy]/mesh->g11[ncx-ix][jy])*kwave*mesh->dx[ncx-ix][jy]);;
-	      bvec[ncx-ix] = -1.0;
-	      cvec[ncx-ix] = 0.0;
-	    }
-	  }else if(flags & INVERT_OUT_SET) {
-	    // Setting the values in the outer boundary
-	    for(ix=0;ix<xbndry;ix++) {
-	      avec[ncx-ix] = 0.0;
-	      bvec[ncx-ix] = 1.0;
-	      cvec[ncx-ix] = 0.0;
-	      bk1d[ncx-ix] = xk[ncx-ix][iz];
-	    }
-	  }else {
-	    // Zero value at outer boundary
-
-	    if(flags & INVERT_OUT_SYM) {
-	      // Use anti-symmetric boundary to set zero-value
-	    
-	      // Zero-gradient for first point(s)
-	      for(ix=0;ix<xbndry-1;ix++) {
-		avec[ncx-ix]=-1.0; bvec[ncx-ix]=1.0; cvec[ncx-ix]= 0.0;
-	      }
-	      ix = xbndry-1;
-	      if(mesh->BoundaryOnCell) {
-		// Antisymmetric about boundary on cell
-		avec[ncx-ix]=1.0; bvec[ncx-ix]=0.0; cvec[ncx-ix]= 1.0;
-	      }else {
-		// Antisymmetric across boundary between cells
-		avec[ncx-ix]=1.0; bvec[ncx-ix]=1.0; cvec[ncx-ix]= 0.0;
-	      }
-	    }else {
-	      for (ix=0;ix<xbndry;ix++){
-		cvec[ncx-ix]=dcomplex(0.,0.);
-		bvec[ncx-ix]=dcomplex(1.,0.);
-		avec[ncx-ix]=dcomplex(0.,0.);
-	      }
-	    }
-	  }
+	bool inset, outset;
+	laplace_tridag_bndry(jy, iz, flags, xbndry, avec, bvec, cvec, inset, outset);
+	if(inset) {
+	  for(ix=0;ix<xbndry;ix++)
+	    bk1d[ix] = xk[ix][iz];
+	}
+	if(outset) {
+	  for(ix=0;ix<xbndry;ix++)
+	    bk1d[ncx-ix] = xk[ncx-ix][iz];
 	}
         
 	// Call tridiagonal solver
 	tridag(avec, bvec, cvec, bk1d, xk1d, mesh->ngx);
 
-	if((flags & INVERT_IN_SYM) && (xbndry > 1)) {
-	  // (Anti-)symmetry on inner boundary. Nothing to do if only one boundary cell
-	  int xloc = 2*xbndry;
-	  if(!mesh->BoundaryOnCell)
-	    xloc--;
-	  
-	  if( ((iz == 0) && (flags & INVERT_DC_IN_GRAD)) || ((iz != 0) && (flags & INVERT_AC_IN_GRAD)) ) {
-	    // Inner gradient zero - symmetric
-	    for(ix=0;ix<xbndry-1;ix++)
-	      xk1d[ix] = xk1d[xloc-ix];
-	  }else {
-	    // Inner value zero - antisymmetric
-	    for(ix=0;ix<xbndry-1;ix++)
-	      xk1d[ix] = -xk1d[xloc-ix];
-	  }
-	}
-	if((flags & INVERT_OUT_SYM) && (xbndry > 1)) {
-	  // (Anti-)symmetry on outer boundary. Nothing to do if only one boundary cell
-	  
-	  int xloc =  mesh->ngx - 2*xbndry;
-	  if(mesh->BoundaryOnCell)
-	    xloc--;
-	
-	  if( ((iz == 0) && (flags & INVERT_DC_IN_GRAD)) || ((iz != 0) && (flags & INVERT_AC_IN_GRAD)) ) {
-	    // Outer gradient zero - symmetric
-	    for(ix=0;ix<xbndry-1;ix++)
-	      xk1d[ncx-ix] = xk1d[xloc + ix];
-	  }else {
-	    // Outer value zero - antisymmetric
-	    for(ix=0;ix<xbndry-1;ix++)
-	      xk1d[ncx-ix] = -xk1d[xloc + ix];
-	  }
-	}
+	laplace_tridag_sym(iz, flags, xbndry, xk1d);
       } else {
 	// Periodic in X, so no boundaries
 	cyclic_tridag(avec+2, bvec+2, cvec+2, bk1d+2, xk1d+2, mesh->ngx-4);
@@ -880,14 +956,312 @@ int invert_laplace_ser(const FieldPerp &b, FieldPerp &x, int flags, const Field2
     if(flags & INVERT_ZERO_DC)
       xk[ix][0] = 0.0;
 
-    ZFFT_rev(xk[ix], mesh->zShift[ix][jy], x[ix]);
+    T *xrow = xd + ix*xstride;
+    ZFFT_rev(xk[ix], ix, jy, xrow);
     
-    x[ix][mesh->ngz-1] = x[ix][0]; // enforce periodicity
+    xrow[mesh->ngz-1] = xrow[0]; // enforce periodicity
   }
 
   return 0;
 }
 
+/// Perpendicular laplacian inversion (serial)
+/*!
+ * Inverts an X-Z slice (FieldPerp) using band-diagonal solvers
+ * This code is only for serial i.e. mesh->NXPE == 1
+ */
+int invert_laplace_ser(const FieldPerp &b, FieldPerp &x, int flags, const Field2D *a,
+                       const Field2D *ccoef=NULL, const Field2D *d=NULL)
+{
+  if(!mesh->firstX() || !mesh->lastX()) {
+    output.write("Error: invert_laplace only works for mesh->NXPE = 1\n");
+    return 1;
+  }
+  
+  x.allocate();
+
+  int jy = b.getIndex();
+  x.setIndex(jy);
+
+  // FieldPerp data is a single block [ix][iz]
+  return laplace_ser_slice(jy, b[0], mesh->ngz, x[0], mesh->ngz, flags, a, ccoef, d);
+}
+
+/**********************************************************************************
+ *                           SERIAL CODE - ALL Y AT ONCE
+ **********************************************************************************/
+
+/// Factorised matrices for one set of coefficients, for each Y slice
+struct LaplaceFactors {
+  std::vector<TridagBatch*> mat; ///< NULL if not yet factorised
+  std::vector<rvec> coefs;       ///< Coefficients each matrix was made from
+  std::vector<int> ok;           ///< Elimination succeeded
+  unsigned long lastuse;
+  
+  LaplaceFactors() : mat(mesh->ngy, (TridagBatch*) NULL), coefs(mesh->ngy), ok(mesh->ngy, 0), lastuse(0) {}
+  ~LaplaceFactors() {
+    for(size_t i=0;i<mat.size();i++)
+      if(mat[i] != NULL)
+        delete mat[i];
+  }
+};
+
+/// Identifies the caller's coefficients. Only used as a key, never dereferenced
+struct LaplaceFactorKey {
+  int flags;
+  const Field2D *a, *c, *d;
+  
+  bool operator<(const LaplaceFactorKey &k) const {
+    if(flags != k.flags) return flags < k.flags;
+    if(a != k.a) return a < k.a;
+    if(c != k.c) return c < k.c;
+    return d < k.d;
+  }
+};
+
+static std::map<LaplaceFactorKey, LaplaceFactors*> laplace_factors;
+static unsigned long laplace_factor_count = 0;
+
+/// Get the cached factors for these coefficients, making space if needed
+static LaplaceFactors* laplace_get_factors(int flags, const Field2D *a, const Field2D *c, const Field2D *d)
+{
+  LaplaceFactorKey key = {flags, a, c, d};
+  LaplaceFactors* &f = laplace_factors[key];
+  if(f == NULL) {
+    // Remove least recently used
+    while((int) laplace_factors.size() > laplace_max_factors) {
+      std::map<LaplaceFactorKey, LaplaceFactors*>::iterator old = laplace_factors.end();
+      for(std::map<LaplaceFactorKey, LaplaceFactors*>::iterator it = laplace_factors.begin(); it != laplace_factors.end(); it++) {
+        if((it->second != NULL) && ((old == laplace_factors.end()) || (it->second->lastuse < old->second->lastuse)))
+          old = it;
+      }
+      if(old == laplace_factors.end())
+        break;
+      delete old->second;
+      laplace_factors.erase(old);
+    }
+    f = new LaplaceFactors();
+  }
+  f->lastuse = ++laplace_factor_count;
+  return f;
+}
+
+/// Serial inversion of Y slices ys to ye of a 3D field
+/*!
+ * All Z modes of a Y slice are solved together by a TridagBatch, so the
+ * loops over modes vectorise, and the Y slices are shared between OpenMP
+ * threads. The kz-independent coefficients are only calculated once for
+ * each point. Gives the same result as invert_laplace_ser for the 2nd order
+ * tridiagonal system in non-periodic X; slices for which the elimination
+ * needs pivoting are passed to invert_laplace_ser.
+ *
+ * If laplace_factor_cache is set, the factorised matrices are kept for each
+ * combination of flags and a, c, d pointers. Field2D has no version stamp,
+ * so each slice also keeps the coefficients it was made from, and is only
+ * reused if they are unchanged. This also catches changes to the metric.
+ */
+static int invert_laplace_batch(const Field3D &b, Field3D &x, int flags, const Field2D *a,
+                                const Field2D *ccoef, const Field2D *d, int ys, int ye)
+{
+  int ncx = mesh->ngx-1;
+  int ncz = mesh->ngz-1;
+  int nk = ncz/2 + 1;
+  int xdist = Field3D::index(1, 0, 0); // Between Z lines at neighbouring X
+  
+  int xbndry = 2;
+  if(flags & INVERT_BNDRY_ONE)
+    xbndry = 1;
+  
+  bool setbndry = (flags & INVERT_IN_SET) || (flags & INVERT_OUT_SET);
+  
+  // Get x first, since it may be copied
+  FieldReal *xd = x.getRaw();
+  const FieldReal *bd = b.readRaw();
+  if(bd == NULL)
+    throw BoutException("invert_laplace: Empty Field3D\n");
+  
+  std::vector<int> failed(mesh->ngy, 0); // Slices to do with invert_laplace_ser
+  
+  LaplaceFactors *cache = NULL;
+  if(laplace_factor_cache)
+    cache = laplace_get_factors(flags, a, ccoef, d);
+  
+  #pragma omp parallel
+  {
+    TridagBatch *tmpmat = (cache == NULL) ? new TridagBatch(mesh->ngx, nk) : NULL;
+    rvec coefs(6*mesh->ngx + 1); // Everything the matrix depends on, apart from flags
+    dcomplex *bk = new dcomplex[mesh->ngx*nk]; // Spectra [ix*nk + iz], then the result
+    dcomplex *xk = setbndry ? new dcomplex[mesh->ngx*nk] : NULL;
+    BoutReal *re = new BoutReal[mesh->ngx*nk];
+    BoutReal *im = new BoutReal[mesh->ngx*nk];
+    dcomplex *avec = new dcomplex[mesh->ngx];
+    dcomplex *bvec = new dcomplex[mesh->ngx];
+    dcomplex *cvec = new dcomplex[mesh->ngx];
+    
+    #pragma omp for schedule(static)
+    for(int jy=ys;jy<=ye;jy++) {
+      // Inside a parallel region this thread does all the transforms
+      rfft_many(bd + Field3D::index(0, jy, 0), ncz, mesh->ngx, xdist, bk);
+      if(setbndry)
+        rfft_many(xd + Field3D::index(0, jy, 0), ncz, mesh->ngx, xdist, xk);
+      if(mesh->ShiftXderivs) {
+        for(int ix=0;ix<=ncx;ix++) {
+          const dcomplex *ph = zshift_phase(ix, jy);
+          for(int iz=0;iz<nk;iz++)
+            bk[ix*nk + iz] *= ph[iz];
+          if(setbndry)
+            for(int iz=0;iz<nk;iz++)
+              xk[ix*nk + iz] *= ph[iz];
+        }
+      }
+      
+      // Interior coefficients, and the metric used by the boundary rows
+      for(int ix=0;ix<=ncx;ix++) {
+        BoutReal *cf = &coefs[6*ix];
+        if((ix < xbndry) || (ix > ncx-xbndry)) {
+          cf[0] = mesh->g11[ix][jy];
+          cf[1] = mesh->g33[ix][jy];
+          cf[2] = mesh->dx[ix][jy];
+          cf[3] = cf[4] = cf[5] = 0.0;
+        }else {
+          laplace_tridag_xcoefs(ix, jy, cf[0], cf[1], cf[2], cf[3], cf[4], ccoef, d);
+          cf[5] = (a != (Field2D*) NULL) ? (*a)[ix][jy] : 0.0;
+        }
+      }
+      coefs[6*mesh->ngx] = mesh->zlength;
+      
+      TridagBatch *mat = tmpmat;
+      bool rebuild = true;
+      if(cache != NULL) {
+        mat = cache->mat[jy];
+        if((mat != NULL) && (mat->size() == mesh->ngx) && (mat->batch() == nk)) {
+          rebuild = (cache->coefs[jy] != coefs);
+        }else {
+          if(mat != NULL)
+            delete mat;
+          mat = cache->mat[jy] = new TridagBatch(mesh->ngx, nk);
+        }
+      }
+      
+      if(rebuild) {
+        // Interior rows
+        for(int ix=xbndry;ix<=ncx-xbndry;ix++) {
+          const BoutReal *cf = &coefs[6*ix];
+          for(int iz=0;iz<nk;iz++) {
+            BoutReal kwave=iz*2.0*PI/mesh->zlength; // wave number is 1/[rad]
+            mat->setRow(ix, iz, 
+                        dcomplex(cf[0] - cf[3], -kwave*cf[2]),
+                        dcomplex(-2.0*cf[0] - SQ(kwave)*cf[1] + cf[5], kwave*cf[4]),
+                        dcomplex(cf[0] + cf[3], kwave*cf[2]));
+          }
+        }
+      }
+      
+      // RHS, zeroing filtered modes
+      for(int ix=0;ix<=ncx;ix++)
+        for(int iz=0;iz<nk;iz++) {
+          BoutReal flt = (iz > laplace_maxmode) ? 0.0 : 1.0;
+          re[ix*nk + iz] = bk[ix*nk + iz].Real() * flt;
+          im[ix*nk + iz] = bk[ix*nk + iz].Imag() * flt;
+        }
+      
+      // Boundary rows. By default the RHS is zero, unless INVERT_*_RHS set
+      for(int iz=0;iz<nk;iz++) {
+        bool inset, outset;
+        laplace_tridag_bndry(jy, iz, flags, xbndry, avec, bvec, cvec, inset, outset);
+        
+        for(int ix=0;ix<xbndry;ix++) {
+          if(rebuild) {
+            mat->setRow(ix, iz, avec[ix], bvec[ix], cvec[ix]);
+            mat->setRow(ncx-ix, iz, avec[ncx-ix], bvec[ncx-ix], cvec[ncx-ix]);
+          }
+          
+          if(inset) {
+            re[ix*nk + iz] = xk[ix*nk + iz].Real();
+            im[ix*nk + iz] = xk[ix*nk + iz].Imag();
+          }else if(!(flags & INVERT_IN_RHS))
+            re[ix*nk + iz] = im[ix*nk + iz] = 0.0;
+          
+          int io = (ncx-ix)*nk + iz;
+          if(outset) {
+            re[io] = xk[io].Real();
+            im[io] = xk[io].Imag();
+          }else if(!(flags & INVERT_OUT_RHS))
+            re[io] = im[io] = 0.0;
+        }
+      }
+      
+      bool ok;
+      if(rebuild) {
+        ok = mat->factorise();
+        if(cache != NULL) {
+          cache->coefs[jy] = coefs;
+          cache->ok[jy] = ok;
+        }
+      }else
+        ok = cache->ok[jy];
+      
+      if(!ok) {
+        failed[jy] = 1;
+        continue;
+      }
+      mat->solve(re, im);
+      
+      for(int i=0;i<mesh->ngx*nk;i++)
+        bk[i] = dcomplex(re[i], im[i]);
+      
+      for(int iz=0;iz<nk;iz++)
+        laplace_tridag_sym(iz, flags, xbndry, bk + iz, nk);
+      
+      if(flags & INVERT_ZERO_DC) {
+        for(int ix=0;ix<=ncx;ix++)
+          bk[ix*nk] = 0.0;
+      }
+      
+      // Transform back
+      if(mesh->ShiftXderivs) {
+        for(int ix=0;ix<=ncx;ix++) {
+          const dcomplex *ph = zshift_phase(ix, jy);
+          for(int iz=0;iz<nk;iz++)
+            bk[ix*nk + iz] *= conj(ph[iz]);
+        }
+      }
+      FieldReal *xl = xd + Field3D::index(0, jy, 0);
+      irfft_many(bk, ncz, mesh->ngx, xl, xdist);
+      for(int ix=0;ix<=ncx;ix++)
+        xl[ix*xdist + ncz] = xl[ix*xdist]; // enforce periodicity
+    }
+    
+    if(tmpmat != NULL)
+      delete tmpmat;
+    delete[] bk;
+    if(xk != NULL)
+      delete[] xk;
+    delete[] re;
+    delete[] im;
+    delete[] avec;
+    delete[] bvec;
+    delete[] cvec;
+  }
+  
+  // Slices which need pivoting
+  for(int jy=ys;jy<=ye;jy++) {
+    if(!failed[jy])
+      continue;
+    
+    FieldPerp xperp;
+    if(setbndry)
+      xperp = x.slice(jy); // Using boundary values
+    
+    int ret;
+    if((ret = invert_laplace_ser(b.slice(jy), xperp, flags, a, ccoef, d)))
+      return ret;
+    x = xperp;
+  }
+  
+  return 0;
+}
+
 /**********************************************************************************
  *                           PARALLEL CODE - COMMON
  **********************************************************************************/
@@ -1190,7 +1564,7 @@ int invert_spt_start(const FieldPerp &b, int flags, const Field2D *a, SPT_data &
     bk1d = new dcomplex[ncz/2 + 1];
 
   for(ix=0; ix < mesh->ngx; ix++) {
-    ZFFT(b[ix], mesh->zShift[ix][data.jy], bk1d);
+    ZFFT(b[ix], ix, data.jy, bk1d);
     for(kz = 0; kz <= laplace_maxmode; kz++)
       data.bk[kz][ix] = bk1d[kz];
   }
@@ -1394,7 +1768,7 @@ void invert_spt_finish(SPT_data &data, int flags, FieldPerp &x)
     if(flags & INVERT_ZERO_DC)
       xk1d[0] = 0.0;
 
-    ZFFT_rev(xk1d, mesh->zShift[ix][data.jy], xdata[ix]);
+    ZFFT_rev(xk1d, ix, data.jy, xdata[ix]);
     
     xdata[ix][ncz] = xdata[ix][0]; // enforce periodicity
   }
@@ -1506,7 +1880,7 @@ int invert_pdd_start(const FieldPerp &b, int flags, const Field2D *a, PDD_data &
     bk1d = new dcomplex[ncz/2 + 1];
 
   for(ix=0; ix < mesh->ngx; ix++) {
-    ZFFT(b[ix], mesh->zShift[ix][data.jy], bk1d);
+    ZFFT(b[ix], ix, data.jy, bk1d);
     for(kz = 0; kz <= laplace_maxmode; kz++)
       data.bk[kz][ix] = bk1d[kz];
   }
@@ -1710,7 +2084,7 @@ int invert_pdd_finish(PDD_data &data, int flags, FieldPerp &x)
     if(flags & INVERT_ZERO_DC)
       xk1d[0] = 0.0;
 
-    ZFFT_rev(xk1d, mesh->zShift[ix][data.jy], x[ix]);
+    ZFFT_rev(xk1d, ix, data.jy, x[ix]);
     
     x[ix][ncz] = x[ix][0]; // enforce periodicity
   }
@@ -1718,6 +2092,277 @@ int invert_pdd_finish(PDD_data &data, int flags, FieldPerp &x)
   return 0;
 }
 
+/**********************************************************************************
+ *                           PARALLEL CODE - THOMAS/PCR HYBRID
+ * 
+ * Each processor eliminates the interior of its own rows with a modified Thomas
+ * algorithm, which leaves two rows per processor coupling the first and last
+ * points of neighbouring processors. These 2*NXPE rows form a tridiagonal system
+ * which is gathered onto every X processor, and solved using Parallel Cyclic
+ * Reduction in log2(2*NXPE) steps. The remaining points then follow locally.
+ *
+ * Unlike PDD no terms are neglected, so this gives the same result as the serial
+ * code (to rounding). Unlike SPT there is no pipeline of NXPE messages in each
+ * direction: all slices and Z modes are gathered with a single collective.
+ **********************************************************************************/
+
+/// Modified Thomas elimination of the rows on one processor
+/*!
+ * Reduces the m rows  a[i]*x[i-1] + b[i]*x[i] + c[i]*x[i+1] = r[i]  to
+ *
+ *   x[i] + ap[i]*x[0] + cp[i]*x[m-1] = dp[i]       for 0 < i < m-1
+ *
+ * and two rows which couple to the neighbouring processors' x[-1] and x[m]
+ *
+ *   ap[0]*x[-1] + x[0] + cp[0]*x[m-1] = dp[0]
+ *   ap[m-1]*x[0] + x[m-1] + cp[m-1]*x[m] = dp[m-1]
+ *
+ * Needs m >= 2
+ */
+static void pcr_reduce_local(const dcomplex *a, const dcomplex *b, const dcomplex *c, const dcomplex *r, 
+                             int m, dcomplex *ap, dcomplex *cp, dcomplex *dp)
+{
+  // Forward elimination, keeping the coupling to x[0]
+  for(int i=0;i<2;i++) {
+    dcomplex rb = 1.0 / b[i];
+    ap[i] = a[i]*rb;
+    cp[i] = c[i]*rb;
+    dp[i] = r[i]*rb;
+  }
+  for(int i=2;i<m;i++) {
+    dcomplex rb = 1.0 / (b[i] - a[i]*cp[i-1]);
+    dp[i] = rb*(r[i] - a[i]*dp[i-1]);
+    ap[i] = -rb*a[i]*ap[i-1];
+    cp[i] = rb*c[i];
+  }
+  
+  if(m > 2) {
+    // Backward elimination, replacing x[i+1] by x[m-1]
+    for(int i=m-3;i>0;i--) {
+      dp[i] -= cp[i]*dp[i+1];
+      ap[i] -= cp[i]*ap[i+1];
+      cp[i] = -cp[i]*cp[i+1];
+    }
+    dcomplex rb = 1.0 / (1.0 - cp[0]*ap[1]);
+    dp[0] = rb*(dp[0] - cp[0]*dp[1]);
+    ap[0] = rb*ap[0];
+    cp[0] = -rb*cp[0]*cp[1];
+  }
+}
+
+/// Parallel Cyclic Reduction of nsys independent tridiagonal systems of size n
+/*!
+ * Coefficients are stored as [row][system], so the inner loops are over systems.
+ * On return x = d / b
+ *
+ * @param[inout] a, b, c, d  The matrix bands and RHS. Overwritten
+ * @param[out]   x           The result
+ */
+static void pcr_solve(std::vector<dcomplex> &a, std::vector<dcomplex> &b, 
+                      std::vector<dcomplex> &c, std::vector<dcomplex> &d,
+                      int n, int nsys, dcomplex *x)
+{
+  std::vector<dcomplex> a2(n*nsys), b2(n*nsys), c2(n*nsys), d2(n*nsys);
+  
+  for(int s=1; s<n; s*=2) {
+    // Eliminate coupling to rows r-s and r+s
+    for(int r=0;r<n;r++) {
+      for(int i=0;i<nsys;i++) {
+        int k = r*nsys + i;
+        dcomplex an = 0.0, cn = 0.0, bn = b[k], dn = d[k];
+        if(r - s >= 0) {
+          int km = k - s*nsys;
+          dcomplex alpha = -a[k] / b[km];
+          an = alpha*a[km];
+          bn += alpha*c[km];
+          dn += alpha*d[km];
+        }
+        if(r + s < n) {
+          int kp = k + s*nsys;
+          dcomplex gamma = -c[k] / b[kp];
+          cn = gamma*c[kp];
+          bn += gamma*a[kp];
+          dn += gamma*d[kp];
+        }
+        a2[k] = an; b2[k] = bn; c2[k] = cn; d2[k] = dn;
+      }
+    }
+    a.swap(a2); b.swap(b2); c.swap(c2); d.swap(d2);
+  }
+  
+  for(int k=0;k<n*nsys;k++)
+    x[k] = d[k] / b[k];
+}
+
+/// Inverts nslice X-Z slices using the Thomas/PCR hybrid
+/*!
+ * Must be called by all processors in X, with the same number of slices
+ *
+ * @param[in]  nslice  Number of slices
+ * @param[in]  b       Array of RHS slices
+ * @param[out] x       Array of results
+ * @param[in]  flags   Inversion settings (see boundary.h for values)
+ * @param[in]  a       This is a 2D matrix which allows solution of A = Delp2 + a
+ * @param[in]  ccoef   Optional coefficient for first-order derivative
+ * @param[in]  d       Optional factor to multiply the Delp2 operator
+ */
+static int invert_pcr(int nslice, const FieldPerp *b, FieldPerp *x, int flags, 
+                      const Field2D *a, const Field2D *ccoef = NULL, const Field2D *d = NULL)
+{
+  if(mesh->NXPE == 1)
+    throw BoutException("Error: Thomas/PCR method only works for mesh->NXPE > 1\n");
+
+  int ix, kz;
+  
+  int ncz = mesh->ngz-1;
+  int ngx = mesh->ngx;
+  int nmode = laplace_maxmode + 1;
+  int nsys = nslice*nmode; // Number of independent systems
+  
+  // Rows solved on this processor
+  int lo = mesh->firstX() ? 0 : mesh->xstart;
+  int hi = mesh->lastX() ? ngx-1 : mesh->xend;
+  int m = hi - lo + 1;
+  if(m < 2)
+    throw BoutException("Error: Thomas/PCR method needs at least 2 X points on each processor\n");
+  
+  static dcomplex **avec = NULL, **bvec, **cvec, **bk;
+  static dcomplex *bk1d, *xk1d;
+  static int alloc_nmode = 0, alloc_ngx = 0, alloc_ncz = 0;
+  
+  if((avec != NULL) && ((alloc_nmode != nmode) || (alloc_ngx != ngx) || (alloc_ncz != ncz))) {
+    // Sizes changed (e.g. laplace_maxmode or the mesh)
+    free_cmatrix(avec);
+    free_cmatrix(bvec);
+    free_cmatrix(cvec);
+    free_cmatrix(bk);
+    delete[] bk1d;
+    delete[] xk1d;
+    avec = NULL;
+  }
+  
+  if(avec == NULL) {
+    alloc_nmode = nmode;
+    alloc_ngx = ngx;
+    alloc_ncz = ncz;
+    
+    avec = cmatrix(nmode, ngx);
+    bvec = cmatrix(nmode, ngx);
+    cvec = cmatrix(nmode, ngx);
+    bk   = cmatrix(nmode, ngx);
+    
+    bk1d = new dcomplex[ncz/2 + 1];
+    xk1d = new dcomplex[ncz/2 + 1];
+    for(kz=0;kz<=ncz/2;kz++)
+      xk1d[kz] = 0.0;
+  }
+  
+  // Reduced rows for every system [slice][kz][ix]
+  std::vector<dcomplex> ap(nsys*ngx), cp(nsys*ngx), dp(nsys*ngx);
+
+  // Two interface rows per system, each (a, c, d)
+  std::vector<BoutReal> sendbuf(12*nsys), recvbuf(12*nsys*mesh->NXPE);
+  
+  for(int s=0;s<nslice;s++) {
+    int jy = b[s].getIndex();
+    
+    for(ix=0; ix < ngx; ix++) {
+      ZFFT(b[s][ix], ix, jy, bk1d);
+      for(kz = 0; kz <= laplace_maxmode; kz++)
+	bk[kz][ix] = bk1d[kz];
+    }
+    
+    par_tridag_matrix(avec, bvec, cvec, bk, jy, flags, a, ccoef, d);
+    
+    for(kz = 0; kz <= laplace_maxmode; kz++) {
+      int i = s*nmode + kz;
+      int k = i*ngx;
+      pcr_reduce_local(avec[kz]+lo, bvec[kz]+lo, cvec[kz]+lo, bk[kz]+lo, m,
+                       &ap[k+lo], &cp[k+lo], &dp[k+lo]);
+      
+      BoutReal *buf = &sendbuf[12*i];
+      for(int h=0;h<2;h++) {
+        int j = k + ((h == 0) ? lo : hi);
+        buf[6*h]     = ap[j].Real();
+        buf[6*h + 1] = ap[j].Imag();
+        buf[6*h + 2] = cp[j].Real();
+        buf[6*h + 3] = cp[j].Imag();
+        buf[6*h + 4] = dp[j].Real();
+        buf[6*h + 5] = dp[j].Imag();
+      }
+    }
+  }
+  
+  MPI_Allgather(&sendbuf[0], 12*nsys, PVEC_REAL_MPI_TYPE, 
+                &recvbuf[0], 12*nsys, PVEC_REAL_MPI_TYPE, mesh->getXcomm());
+  
+  // Reduced system, ordered (lo, hi) on processor 0, (lo, hi) on 1, ...
+  int n = 2*mesh->NXPE;
+  std::vector<dcomplex> ra(n*nsys), rb(n*nsys, 1.0), rc(n*nsys), rd(n*nsys), rx(n*nsys);
+  for(int p=0;p<mesh->NXPE;p++) {
+    for(int i=0;i<nsys;i++) {
+      BoutReal *buf = &recvbuf[12*(p*nsys + i)];
+      for(int h=0;h<2;h++) {
+        int k = (2*p + h)*nsys + i;
+        ra[k] = dcomplex(buf[6*h],     buf[6*h + 1]);
+        rc[k] = dcomplex(buf[6*h + 2], buf[6*h + 3]);
+        rd[k] = dcomplex(buf[6*h + 4], buf[6*h + 5]);
+      }
+    }
+  }
+  // Not periodic in X, as for SPT
+  for(int i=0;i<nsys;i++) {
+    ra[i] = 0.0;
+    rc[(n-1)*nsys + i] = 0.0;
+  }
+  
+  pcr_solve(ra, rb, rc, rd, n, nsys, &rx[0]);
+  
+  // Back-substitute on this processor, and transform back
+  int p = mesh->PE_XIND;
+  for(int s=0;s<nslice;s++) {
+    int jy = b[s].getIndex();
+    
+    x[s].allocate();
+    x[s].setIndex(jy);
+    BoutReal **xdata = x[s].getData();
+    
+    for(kz = 0; kz <= laplace_maxmode; kz++) {
+      int i = s*nmode + kz;
+      int k = i*ngx;
+      dcomplex xlo = rx[2*p*nsys + i];
+      dcomplex xhi = rx[(2*p + 1)*nsys + i];
+      
+      bk[kz][lo] = xlo;
+      bk[kz][hi] = xhi;
+      for(ix=lo+1;ix<hi;ix++)
+        bk[kz][ix] = dp[k+ix] - ap[k+ix]*xlo - cp[k+ix]*xhi;
+    }
+    
+    for(ix=lo; ix<=hi; ix++){
+      for(kz = 0; kz <= laplace_maxmode; kz++)
+	xk1d[kz] = bk[kz][ix];
+      
+      if(flags & INVERT_ZERO_DC)
+	xk1d[0] = 0.0;
+      
+      ZFFT_rev(xk1d, ix, jy, xdata[ix]);
+      
+      xdata[ix][ncz] = xdata[ix][0]; // enforce periodicity
+    }
+    
+    // Set the other processors' points to zero (Prevent unassigned values in corners)
+    for(ix=0; ix<lo; ix++)
+      for(kz=0;kz<mesh->ngz;kz++)
+	xdata[ix][kz] = 0.0;
+    for(ix=hi+1; ix<ngx; ix++)
+      for(kz=0;kz<mesh->ngz;kz++)
+	xdata[ix][kz] = 0.0;
+  }
+  
+  return 0;
+}
+
 /**********************************************************************************
  *                              EXTERNAL INTERFACE
  **********************************************************************************/
@@ -1729,9 +2374,11 @@ int invert_laplace(const FieldPerp &b, FieldPerp &x, int flags, const Field2D *a
     // Just use the serial code
     return invert_laplace_ser(b, x, flags, a, c, d);
   }else {
-    // Parallel inversion using PDD
+    // Parallel inversion
 
-    if(invert_use_pdd) {
+    if(invert_use_pcr) {
+      return invert_pcr(1, &b, &x, flags, a, c, d);
+    }else if(invert_use_pdd) {
       static PDD_data data;
       static bool allocated = false;
       if(!allocated) {
@@ -1761,6 +2408,8 @@ int invert_laplace(const FieldPerp &b, FieldPerp &x, int flags, const Field2D *a
 
 /// Extracts perpendicular slices from 3D fields and inverts separately
 /*!
+ * In serial (mesh->NXPE == 1) slices which are not solved together
+ * (4th order, or periodic in X) are divided between OpenMP threads.
  * In parallel (mesh->NXPE > 1) this tries to overlap computation and communication.
  * This is done at the expense of more memory useage. Setting low_mem
  * in the config file uses less memory, and less communication overlap
@@ -1784,7 +2433,34 @@ int invert_laplace(const Field3D &b, Field3D &x, int flags, const Field2D *a, co
     ye = mesh->ngy-1;
   }
   
-  if((mesh->NXPE == 1) || invert_low_mem) {
+  if((mesh->NXPE == 1) && !(flags & INVERT_4TH_ORDER) && !mesh->periodicX) {
+    // Solve all slices together
+    if((ret = invert_laplace_batch(b, x, flags, a, c, d, ys, ye)))
+      return(ret);
+    
+  }else if(mesh->NXPE == 1) {
+    // Slices are independent, so are shared between threads. FieldPerp
+    // is not thread safe, so the field data are used directly
+    const FieldReal *bd = b.readRaw();
+    if(bd == NULL)
+      throw BoutException("invert_laplace: b has no data\n");
+    FieldReal *xd = x.getRaw();
+    int xstride = Field3D::index(1, 0, 0);
+    
+    int status = 0;
+    #pragma omp parallel for schedule(dynamic)
+    for(jy=ys; jy <= ye; jy++) {
+      int r = laplace_ser_slice(jy, bd + Field3D::index(0, jy, 0), xstride,
+                                xd + Field3D::index(0, jy, 0), xstride, flags, a, c, d);
+      if(r) {
+        #pragma omp critical(invert_laplace)
+        status = r;
+      }
+    }
+    if(status)
+      return(status);
+    
+  }else if(invert_low_mem) {
     
     for(jy=ys; jy <= ye; jy++) {
       if((flags & INVERT_IN_SET) || (flags & INVERT_OUT_SET))
@@ -1797,7 +2473,20 @@ int invert_laplace(const Field3D &b, Field3D &x, int flags, const Field2D *a, co
   }else {
     // Use more memory to overlap calculation and communication
     
-    if(invert_use_pdd) {
+    if(invert_use_pcr) {
+      // All slices solved together, with a single collective
+      int ny = ye - ys + 1;
+      std::vector<FieldPerp> bperp(ny), xperps(ny);
+      for(jy=ys; jy <= ye; jy++)
+	bperp[jy-ys] = b.slice(jy);
+      
+      if((ret = invert_pcr(ny, &bperp[0], &xperps[0], flags, a, c, d)))
+	return(ret);
+      
+      for(jy=ys; jy <= ye; jy++)
+	x = xperps[jy-ys];
+      
+    }else if(invert_use_pdd) {
       
       static PDD_data *data = NULL;
     
@@ -1862,7 +2551,7 @@ int invert_laplace(const Field3D &b, Field3D &x, int flags, const Field2D *a, co
 
   return 0;
 }
-const Field3D invert_laplace(const Field3D &b, int flags, const Field2D *a, const Field2D *c, const Field2D *d)
+Field3D invert_laplace(const Field3D &b, int flags, const Field2D *a, const Field2D *c, const Field2D *d)
 {
   Field3D x;
   
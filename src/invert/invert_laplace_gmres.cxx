@@ -4,8 +4,23 @@
 #include <invert_laplace.hxx>
 #include <difops.hxx>
 
-const Field3D LaplaceGMRES::invert(const Field3D &b, const Field3D &start, int inv_flags, bool precon, Field3D *a, Field3D *c)
+LaplaceGMRES::LaplaceGMRES()
 {
+  Options *opt = Options::getRoot()->getSection("laplace");
+  opt->get("gmres_mg", use_mg, false);
+  
+  mg_ready = false;
+}
+
+Field3D LaplaceGMRES::invert(const Field3D &b, const Field3D &start, int inv_flags, bool precon, Field3D *a, Field3D *c)
+{
+  // a3d and c3d hold copies, so their versions only match the inputs
+  // while the inputs are unchanged
+  bool newcoefs = !mg_ready || (inv_flags != flags) 
+    || (enable_a != (a != NULL)) || (enable_c != (c != NULL))
+    || ((a != NULL) && (a->version() != a3d.version()))
+    || ((c != NULL) && (c->version() != c3d.version()));
+  
   flags = inv_flags;
 
   enable_a = (a != NULL);
@@ -17,7 +32,15 @@ const Field3D LaplaceGMRES::invert(const Field3D &b, const Field3D &start, int i
  
   Field3D rhs;
 
-  if(precon) {
+  if(precon && use_mg) {
+    // Multigrid includes the Z variation of a and c. Setting them
+    // rebuilds all the levels, so only done when they change
+    if(newcoefs) {
+      mg.setCoefs(flags, a, c);
+      mg_ready = true;
+    }
+    rhs = mg.precon(b);
+  }else if(precon) {
     /// Get DC components for preconditioner
     aptr = cptr = NULL;
     if(enable_a) {
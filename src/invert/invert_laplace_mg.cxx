@@ -0,0 +1,890 @@
+/**************************************************************************
+ * Geometric multigrid Laplacian inversion
+ *
+ * Equation solved is: d*\nabla^2_\perp x + (1/c)\nabla_perp c\cdot\nabla_\perp x + a x = b
+ * with a and c 3D fields (see invert_laplace_mg.hxx)
+ *
+ **************************************************************************
+ * Copyright 2010 B.D.Dudson, S.Farley, M.V.Umansky, X.Q.Xu
+ *
+ * Contact: Ben Dudson, bd512@york.ac.uk
+ *
+ * This file is part of BOUT++.
+ *
+ * BOUT++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BOUT++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BOUT++.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **************************************************************************/
+
+#include "mpi.h"
+
+#include <globals.hxx>
+#include <invert_laplace_mg.hxx>
+#include <invert_laplace.hxx>
+#include <options.hxx>
+#include <utils.hxx>
+#include <boutexception.hxx>
+
+#include <math.h>
+#include <algorithm>
+
+// Settings shared with the FFT solver (invert_laplace.cxx)
+extern bool laplace_all_terms;
+extern bool laplace_nonuniform;
+
+const int MG_COMM_IN  = 789; ///< Tag for guard cells sent to the inner processor
+const int MG_COMM_OUT = 790; ///< Tag for guard cells sent to the outer processor
+
+/// Sets the values xg next to x0 from the boundary condition
+/*!
+ * The Z average (DC) and the rest (AC) have either zero value or zero gradient.
+ * g is added if not NULL (INVERT_*_SET, INVERT_*_RHS).
+ */
+static void mg_bndry(BoutReal *xg, const BoutReal *x0, int nz, bool dcgrad, bool acgrad, const BoutReal *g)
+{
+  BoutReal mean = 0.0;
+  if(dcgrad != acgrad) {
+    for(int k=0;k<nz;k++)
+      mean += x0[k];
+    mean /= (BoutReal) nz;
+  }
+
+  for(int k=0;k<nz;k++) {
+    BoutReal val = 0.0;
+    if(acgrad)
+      val = x0[k] - mean;
+    if(dcgrad)
+      val += mean;
+    if(g != NULL)
+      val += g[k];
+    xg[k] = val;
+  }
+}
+
+/**************************************************************************
+ * Constructor
+ **************************************************************************/
+
+LaplaceMultigrid::LaplaceMultigrid()
+{
+  Options *opt = Options::getRoot()->getSection("laplace");
+  opt->get("mg_levels", max_levels, 8);
+  opt->get("mg_presmooth", npre, 2);
+  opt->get("mg_postsmooth", npost, 2);
+  opt->get("mg_coarse", ncoarse, 20);
+  opt->get("mg_maxits", maxits, 50);
+  opt->get("mg_rtol", rtol, 1.e-8);
+  opt->get("mg_atol", atol, 1.e-12);
+
+  if(max_levels < 1)
+    max_levels = 1;
+}
+
+/**************************************************************************
+ * Setting the operator
+ **************************************************************************/
+
+void LaplaceMultigrid::setCoefs(int inv_flags, const Field3D *a, const Field3D *c, const Field2D *d)
+{
+  flags = inv_flags;
+  shift = mesh->ShiftXderivs;
+
+  ys = mesh->ystart;
+  ye = mesh->yend;
+  if(MYPE_IN_CORE == 0) {
+    // NOTE: REFINE THIS TO ONLY SOLVE IN BOUNDARY Y CELLS
+    ys = 0;
+    ye = mesh->ngy-1;
+  }
+  ny = ye - ys + 1;
+
+  int xbndry = 2;
+  if(flags & INVERT_BNDRY_ONE)
+    xbndry = 1;
+
+  xs = mesh->firstX() ? xbndry : mesh->xstart;
+  xe = mesh->lastX() ? mesh->ngx-1-xbndry : mesh->xend;
+  if(xe < xs)
+    throw BoutException("LaplaceMultigrid: No X points to solve on this processor\n");
+
+  // Coefficients in real space
+  Field3D as, cs;
+  const FieldReal *araw = NULL, *craw = NULL;
+  if(a != NULL) {
+    as = shift ? a->shiftZ(true) : *a;
+    araw = as.readRaw();
+  }
+  if(c != NULL) {
+    cs = shift ? c->shiftZ(true) : *c;
+    craw = cs.readRaw();
+  }
+
+  levels.clear();
+  levels.resize(1);
+
+  Level &L = levels[0];
+  L.nx = xe - xs + 1;
+  L.xpar = parity(L.nx);
+  L.nz = mesh->ngz-1;
+  L.zcoarse = false;
+  L.hz = mesh->dz;
+
+  int nx = L.nx, nz = L.nz;
+  int np = ny*nx*nz;
+  L.hx.resize(ny*(nx+2));
+  L.cxx.resize(np); L.czz.resize(np); L.cxz.resize(np);
+  L.cx.resize(np);  L.cz.resize(np);  L.c0.resize(np);
+
+  for(int jy=0;jy<ny;jy++) {
+    int y = ys + jy;
+    for(int i=-1;i<=nx;i++)
+      L.hx[L.h(jy, i)] = mesh->dx[xs+i][y];
+    
+    for(int i=0;i<nx;i++) {
+      int ix = xs + i;
+      BoutReal dx = mesh->dx[ix][y];
+
+      BoutReal dval = (d != NULL) ? (*d)[ix][y] : 1.0;
+      BoutReal cxx = mesh->g11[ix][y]*dval;    // X 2nd derivative
+      BoutReal czz = mesh->g33[ix][y]*dval;    // Z 2nd derivative
+      BoutReal cxz = 2.*mesh->g13[ix][y]*dval; // Mixed derivative
+
+      // First derivatives. coef4 multiplies (x[ix+1] - x[ix-1]), as in the FFT solver
+      BoutReal coef4 = 0.0, cz = 0.0;
+      if(laplace_all_terms) {
+        coef4 = mesh->G1[ix][y] / (2.0*dx);
+        cz = mesh->G3[ix][y];
+      }
+      if(laplace_nonuniform)
+        coef4 -= 0.25*((mesh->dx[ix+1][y] - mesh->dx[ix-1][y])/dx)*cxx; // BOUT-06 term
+
+      if(mesh->ShiftXderivs && mesh->IncIntShear) {
+        czz += mesh->g11[ix][y] * SQ(mesh->IntShiftTorsion[ix][y]);
+        cxz = 0.0; // This cancels out
+      }
+
+      for(int k=0;k<nz;k++) {
+        int o = L.c(jy, i, k);
+        L.cxx[o] = cxx;
+        L.czz[o] = czz;
+        L.cxz[o] = cxz;
+        L.cx[o] = 2.*dx*coef4;
+        L.cz[o] = cz;
+        L.c0[o] = (araw != NULL) ? araw[Field3D::index(ix, y, k)] : 0.0;
+
+        if(craw != NULL) {
+          // (1/c) Grad_perp c . Grad_perp x
+          BoutReal cv = craw[Field3D::index(ix, y, k)];
+          int km = (k == 0) ? nz-1 : k-1;
+          int kp = (k == nz-1) ? 0 : k+1;
+          L.cx[o] += mesh->g11[ix][y] * (craw[Field3D::index(ix+1, y, k)] - craw[Field3D::index(ix-1, y, k)])
+            / (2.*dx*cv);
+          L.cz[o] += mesh->g33[ix][y] * (craw[Field3D::index(ix, y, kp)] - craw[Field3D::index(ix, y, km)])
+            / (2.*L.hz*cv);
+        }
+      }
+    }
+  }
+  stencil(L, true);
+
+  // Coarse levels. X is always coarsened: the Z line smoother handles strong
+  // coupling in Z, and point-like relaxation in X is fine with X coarsening.
+  // Z is only coarsened where Z coupling is not much weaker than X, otherwise
+  // high Z wavenumbers would not be smoothed. All X processors must agree
+  while((int) levels.size() < max_levels) {
+    const Level &F = levels.back();
+
+    BoutReal ratio = 1.e10; // Minimum of Z to X coupling
+    for(int jy=0;jy<ny;jy++)
+      for(int i=0;i<F.nx;i++) {
+        BoutReal hx = F.hx[F.h(jy, i)];
+        for(int k=0;k<F.nz;k++) {
+          int j = F.c(jy, i, k);
+          BoutReal r = (F.czz[j]*hx*hx) / (F.cxx[j]*F.hz*F.hz);
+          if(r < ratio)
+            ratio = r;
+        }
+      }
+
+    BoutReal val[2], res[2];
+    val[0] = (F.nx > 1) ? 1.0 : 0.0;
+    val[1] = -ratio;
+    res[0] = val[0]; res[1] = val[1];
+    if(!(mesh->firstX() && mesh->lastX()))
+      MPI_Allreduce(val, res, 2, MPI_DOUBLE, MPI_MAX, mesh->getXcomm());
+    
+    bool zcoarse = (F.nz % 2 == 0) && (F.nz >= 8) && (-res[1] >= 0.5);
+    if((res[0] == 0.0) && !zcoarse)
+      break; // Can't coarsen any more
+
+    levels.resize(levels.size() + 1);
+    Level &C = levels.back();
+    coarsen(levels[levels.size()-2], C, zcoarse);
+    stencil(C, false);
+  }
+
+  // Operator coefficients no longer needed
+  for(size_t l=0;l<levels.size();l++) {
+    Level &M = levels[l];
+    std::vector<BoutReal>().swap(M.cxx);
+    std::vector<BoutReal>().swap(M.czz);
+    std::vector<BoutReal>().swap(M.cxz);
+    std::vector<BoutReal>().swap(M.cx);
+    std::vector<BoutReal>().swap(M.cz);
+    std::vector<BoutReal>().swap(M.c0);
+  }
+}
+
+/// Calculate the stencil and factorise the Z lines of a level
+/*!
+ * If local is true the X derivatives use the width of each cell only, as
+ * in the FFT solver. Otherwise the distances between cell centres are used,
+ * since coarse cells can differ in width.
+ */
+void LaplaceMultigrid::stencil(Level &L, bool local)
+{
+  int nx = L.nx, nz = L.nz;
+  int np = ny*nx*nz;
+
+  L.sc.resize(np); L.sxm.resize(np); L.sxp.resize(np);
+  L.szm.resize(np); L.szp.resize(np); L.sxz.resize(np);
+  L.lgam.resize(np); L.libet.resize(np); L.lz.resize(np);
+  L.lq.resize(ny*nx); L.liden.resize(ny*nx);
+
+  L.x.assign(ny*(nx+2)*nz, 0.0);
+  L.b.assign(np, 0.0);
+  L.r.assign(np, 0.0);
+
+  BoutReal hz = L.hz;
+
+  #pragma omp parallel for
+  for(int line=0;line<ny*nx;line++) {
+    int jy = line / nx;
+    int i = line % nx;
+    int o = line*nz;
+
+    // Distances to the neighbouring points
+    BoutReal h0 = L.hx[L.h(jy, i)];
+    BoutReal dm = h0, dp = h0;
+    if(!local) {
+      dm = 0.5*(L.hx[L.h(jy, i-1)] + h0);
+      dp = 0.5*(h0 + L.hx[L.h(jy, i+1)]);
+    }
+    BoutReal ds = dm + dp;
+
+    for(int k=0;k<nz;k++) {
+      int j = o + k;
+      BoutReal fxm = 2.*L.cxx[j]/(ds*dm), fxp = 2.*L.cxx[j]/(ds*dp);
+      BoutReal fzz = L.czz[j]/(hz*hz);
+      BoutReal fx = L.cx[j]/ds, fz = L.cz[j]/(2.*hz);
+
+      L.sc[j]  = -fxm - fxp - 2.*fzz + L.c0[j];
+      L.sxm[j] = fxm - fx;
+      L.sxp[j] = fxp + fx;
+      L.szm[j] = fzz - fz;
+      L.szp[j] = fzz + fz;
+      L.sxz[j] = L.cxz[j] / (2.*ds*hz);
+    }
+
+    if(nz < 3)
+      continue; // Solved directly
+
+    // Factorise the cyclic tridiagonal Z line using the Sherman-Morrison formula
+    // (as in cyclic_tridag)
+    const BoutReal *a = &L.szm[o], *b = &L.sc[o], *c = &L.szp[o];
+    BoutReal *gam = &L.lgam[o], *ibet = &L.libet[o], *z = &L.lz[o];
+
+    BoutReal gamma = -b[0];
+    gam[0] = 0.0;
+    ibet[0] = 1.0 / (b[0] - gamma);
+    for(int k=1;k<nz;k++) {
+      BoutReal bk = b[k];
+      if(k == nz-1)
+        bk -= c[nz-1]*a[0]/gamma;
+      gam[k] = c[k-1]*ibet[k-1];
+      ibet[k] = 1.0 / (bk - a[k]*gam[k]);
+    }
+
+    z[0] = gamma*ibet[0];
+    for(int k=1;k<nz;k++)
+      z[k] = (((k == nz-1) ? c[nz-1] : 0.0) - a[k]*z[k-1])*ibet[k];
+    for(int k=nz-2;k>=0;k--)
+      z[k] -= gam[k+1]*z[k+1];
+
+    L.lq[line] = a[0] / gamma;
+    L.liden[line] = 1.0 / (1.0 + z[0] + L.lq[line]*z[nz-1]);
+  }
+}
+
+/// Parity of the global X index of the first of nx points on this processor
+int LaplaceMultigrid::parity(int nx)
+{
+  if(mesh->firstX() && mesh->lastX())
+    return 0;
+
+  int offset = 0;
+  MPI_Exscan(&nx, &offset, 1, MPI_INT, MPI_SUM, mesh->getXcomm());
+  if(mesh->firstX())
+    offset = 0; // Not set by MPI_Exscan on the first processor
+  return offset % 2;
+}
+
+/// Number of fine X cells merged into coarse cell ic. Cells are merged in
+/// pairs, with the last coarse cell taking three if nxf is odd
+static int mg_nchild(int nxf, int nxc, int ic)
+{
+  return (ic == nxc-1) ? nxf - 2*ic : 2;
+}
+
+/// Set the operator coefficients on level C by averaging level F
+/*!
+ * Averages are weighted by cell width
+ */
+void LaplaceMultigrid::coarsen(const Level &F, Level &C, bool zcoarse)
+{
+  C.nx = (F.nx > 1) ? F.nx/2 : 1;
+  C.xpar = parity(C.nx);
+  C.zcoarse = zcoarse;
+  C.nz = C.zcoarse ? F.nz/2 : F.nz;
+  C.hz = C.zcoarse ? 2.*F.hz : F.hz;
+
+  int zf = C.zcoarse ? 2 : 1;
+  int np = ny*C.nx*C.nz;
+
+  C.hx.assign(ny*(C.nx+2), 0.0);
+  C.cxx.assign(np, 0.0); C.czz.assign(np, 0.0); C.cxz.assign(np, 0.0);
+  C.cx.assign(np, 0.0);  C.cz.assign(np, 0.0);  C.c0.assign(np, 0.0);
+
+  for(int jy=0;jy<ny;jy++) {
+    for(int ic=0;ic<C.nx;ic++) {
+      int nchild = mg_nchild(F.nx, C.nx, ic);
+      for(int ii=0;ii<nchild;ii++)
+        C.hx[C.h(jy, ic)] += F.hx[F.h(jy, 2*ic + ii)];
+
+      for(int ii=0;ii<nchild;ii++) {
+        int i = 2*ic + ii;
+        BoutReal w = F.hx[F.h(jy, i)] / (C.hx[C.h(jy, ic)] * zf);
+
+        for(int k=0;k<F.nz;k++) {
+          int f = F.c(jy, i, k);
+          int o = C.c(jy, ic, k/zf);
+          C.cxx[o] += w*F.cxx[f];
+          C.czz[o] += w*F.czz[f];
+          C.cxz[o] += w*F.cxz[f];
+          C.cx[o]  += w*F.cx[f];
+          C.cz[o]  += w*F.cz[f];
+          C.c0[o]  += w*F.c0[f];
+        }
+      }
+    }
+  }
+
+  // Width of the guard cells. At the X boundaries the fine width is kept,
+  // so boundary values are at the same place on all levels
+  exchange(C.hx, C.nx, 1);
+  for(int jy=0;jy<ny;jy++) {
+    if(mesh->firstX())
+      C.hx[C.h(jy, -1)] = F.hx[F.h(jy, -1)];
+    if(mesh->lastX())
+      C.hx[C.h(jy, C.nx)] = F.hx[F.h(jy, F.nx)];
+  }
+}
+
+/**************************************************************************
+ * Solving
+ **************************************************************************/
+
+int LaplaceMultigrid::solve(const Field3D &b, Field3D &x)
+{
+  if(levels.empty())
+    throw BoutException("LaplaceMultigrid: setCoefs must be called before solve\n");
+
+  BoutReal t = MPI_Wtime();
+
+  Field3D bs = shift ? b.shiftZ(true) : b;
+  Field3D xr;
+  if(x.isAllocated())
+    xr = shift ? x.shiftZ(true) : x;
+
+  Level &L = levels[0];
+  loadField(bs, L.b, false);
+  if(xr.isAllocated() && !(flags & INVERT_START_NEW)) {
+    loadField(xr, L.x, true);
+  }else
+    std::fill(L.x.begin(), L.x.end(), 0.0);
+
+  // Boundary values
+  const Field3D *fin = NULL, *fout = NULL;
+  if(flags & INVERT_IN_SET) {
+    if(xr.isAllocated())
+      fin = &xr;
+  }else if(flags & INVERT_IN_RHS)
+    fin = &bs;
+  if(flags & INVERT_OUT_SET) {
+    if(xr.isAllocated())
+      fout = &xr;
+  }else if(flags & INVERT_OUT_RHS)
+    fout = &bs;
+  loadBoundary(fin, fout);
+
+  BoutReal bnorm = norm(L, L.b);
+  residual(L, false);
+  BoutReal rnorm = norm(L, L.r);
+
+  int it = 0;
+  while((rnorm > rtol*bnorm) && (rnorm > atol) && (it < maxits)) {
+    vcycle(0, false);
+    residual(L, false);
+    rnorm = norm(L, L.r);
+    it++;
+  }
+
+  // Guard cells were set by residual()
+  storeField(xr, false);
+  x = shift ? xr.shiftZ(false) : xr;
+  x.setLocation(b.getLocation());
+
+  wtime_invert += MPI_Wtime() - t;
+
+  if((rnorm > rtol*bnorm) && (rnorm > atol)) {
+    output.write("\tWARNING: LaplaceMultigrid not converged after %d V-cycles. Residual %e\n",
+                 it, (bnorm > 0.0) ? rnorm/bnorm : rnorm);
+    return 1;
+  }
+  return 0;
+}
+
+Field3D LaplaceMultigrid::solve(const Field3D &b)
+{
+  Field3D x;
+  solve(b, x);
+  return x;
+}
+
+Field3D LaplaceMultigrid::precon(const Field3D &b, int ncycle)
+{
+  if(levels.empty())
+    throw BoutException("LaplaceMultigrid: setCoefs must be called before precon\n");
+
+  Field3D bs = shift ? b.shiftZ(true) : b;
+
+  Level &L = levels[0];
+  loadField(bs, L.b, false);
+  std::fill(L.x.begin(), L.x.end(), 0.0);
+
+  for(int n=0;n<ncycle;n++)
+    vcycle(0, true);
+  exchange(L.x, L.nx, L.nz);
+  applyBoundary(L, true);
+
+  Field3D result;
+  result = 0.0;
+  storeField(result, true);
+  if(shift)
+    result = result.shiftZ(false);
+  result.setLocation(b.getLocation());
+
+  return result;
+}
+
+/// One V-cycle on level l. Coarse levels always have zero-value boundaries
+void LaplaceMultigrid::vcycle(int l, bool homogeneous)
+{
+  Level &L = levels[l];
+
+  if(l == (int) levels.size()-1) {
+    // Coarsest level
+    smooth(L, ncoarse, homogeneous);
+    return;
+  }
+
+  smooth(L, npre, homogeneous);
+  residual(L, homogeneous);
+
+  Level &C = levels[l+1];
+  int zf = C.zcoarse ? 2 : 1;
+
+  // Restrict the residual by averaging over the children
+  #pragma omp parallel for
+  for(int jy=0;jy<ny;jy++) {
+    for(int ic=0;ic<C.nx;ic++) {
+      int nchild = mg_nchild(L.nx, C.nx, ic);
+      BoutReal w = 1.0 / (C.hx[C.h(jy, ic)] * zf);
+      for(int kc=0;kc<C.nz;kc++) {
+        BoutReal sum = 0.0;
+        for(int ii=0;ii<nchild;ii++) {
+          int i = 2*ic + ii;
+          for(int kk=0;kk<zf;kk++)
+            sum += L.hx[L.h(jy, i)] * L.r[L.c(jy, i, zf*kc+kk)];
+        }
+        C.b[C.c(jy, ic, kc)] = w*sum;
+      }
+    }
+  }
+
+  std::fill(C.x.begin(), C.x.end(), 0.0);
+  vcycle(l+1, true);
+
+  // Add the correction, interpolating linearly between coarse cell centres
+  exchange(C.x, C.nx, C.nz);
+  applyBoundary(C, true);
+
+  #pragma omp parallel for
+  for(int jy=0;jy<ny;jy++) {
+    for(int i=0;i<L.nx;i++) {
+      int ic = i/2;
+      if(ic >= C.nx)
+        ic = C.nx-1;
+
+      // Offset of the fine cell centre from the coarse cell centre
+      BoutReal hc = C.hx[C.h(jy, ic)];
+      BoutReal off = 0.5*L.hx[L.h(jy, i)] - 0.5*hc;
+      for(int ii=2*ic;ii<i;ii++)
+        off += L.hx[L.h(jy, ii)];
+
+      int sx = 0;
+      BoutReal wx = 1.0;
+      if(off < 0.0) {
+        sx = -1;
+        wx = 1.0 + off / (0.5*(C.hx[C.h(jy, ic-1)] + hc));
+      }else if(off > 0.0) {
+        sx = 1;
+        wx = 1.0 - off / (0.5*(hc + C.hx[C.h(jy, ic+1)]));
+      }
+      for(int k=0;k<L.nz;k++) {
+        int kc = k, sz = 0;
+        BoutReal wz = 1.0;
+        if(C.zcoarse) {
+          kc = k/2;
+          sz = (k % 2 == 0) ? -1 : 1;
+          wz = 0.75;
+        }
+        int kc2 = (kc + sz + C.nz) % C.nz;
+
+        L.x[L.g(jy, i, k)] +=
+          wx*wz*C.x[C.g(jy, ic, kc)] + (1.-wx)*wz*C.x[C.g(jy, ic+sx, kc)]
+          + wx*(1.-wz)*C.x[C.g(jy, ic, kc2)] + (1.-wx)*(1.-wz)*C.x[C.g(jy, ic+sx, kc2)];
+      }
+    }
+  }
+
+  smooth(L, npost, homogeneous);
+}
+
+/// Zebra line Gauss-Seidel: even then odd X points, solving each Z line exactly
+void LaplaceMultigrid::smooth(Level &L, int nsweep, bool homogeneous)
+{
+  int nx = L.nx, nz = L.nz;
+
+  for(int sweep=0;sweep<nsweep;sweep++) {
+    for(int colour=0;colour<2;colour++) {
+      exchange(L.x, L.nx, L.nz);
+      applyBoundary(L, homogeneous);
+
+      // Colour by global index, so neighbours on other processors alternate
+      int first = (colour + L.xpar) % 2;
+      int nline = (nx - first + 1)/2;
+      if(nline <= 0)
+        continue;
+
+      #pragma omp parallel
+      {
+        std::vector<BoutReal> rhs(nz);
+
+        #pragma omp for
+        for(int n=0;n<ny*nline;n++) {
+          int jy = n / nline;
+          int i = first + 2*(n % nline);
+
+          const BoutReal *xm = &L.x[L.g(jy, i-1, 0)];
+          const BoutReal *xp = &L.x[L.g(jy, i+1, 0)];
+          BoutReal *x0 = &L.x[L.g(jy, i, 0)];
+          int o = L.c(jy, i, 0);
+
+          for(int k=0;k<nz;k++) {
+            int km = (k == 0) ? nz-1 : k-1;
+            int kp = (k == nz-1) ? 0 : k+1;
+            rhs[k] = L.b[o+k] - L.sxm[o+k]*xm[k] - L.sxp[o+k]*xp[k]
+              - L.sxz[o+k]*(xp[kp] - xp[km] - xm[kp] + xm[km]);
+          }
+
+          if(nz >= 3) {
+            const BoutReal *a = &L.szm[o], *gam = &L.lgam[o], *ibet = &L.libet[o], *z = &L.lz[o];
+            x0[0] = rhs[0]*ibet[0];
+            for(int k=1;k<nz;k++)
+              x0[k] = (rhs[k] - a[k]*x0[k-1])*ibet[k];
+            for(int k=nz-2;k>=0;k--)
+              x0[k] -= gam[k+1]*x0[k+1];
+
+            int line = jy*nx + i;
+            BoutReal fact = (x0[0] + L.lq[line]*x0[nz-1])*L.liden[line];
+            for(int k=0;k<nz;k++)
+              x0[k] -= fact*z[k];
+          }else if(nz == 2) {
+            BoutReal a00 = L.sc[o], a01 = L.szm[o] + L.szp[o];
+            BoutReal a10 = L.szm[o+1] + L.szp[o+1], a11 = L.sc[o+1];
+            BoutReal idet = 1.0 / (a00*a11 - a01*a10);
+            x0[0] = (a11*rhs[0] - a01*rhs[1])*idet;
+            x0[1] = (a00*rhs[1] - a10*rhs[0])*idet;
+          }else
+            x0[0] = rhs[0] / (L.sc[o] + L.szm[o] + L.szp[o]);
+        }
+      }
+    }
+  }
+}
+
+/// Calculates r = b - Ax on a level
+void LaplaceMultigrid::residual(Level &L, bool homogeneous)
+{
+  int nx = L.nx, nz = L.nz;
+
+  exchange(L.x, L.nx, L.nz);
+  applyBoundary(L, homogeneous);
+
+  #pragma omp parallel for
+  for(int line=0;line<ny*nx;line++) {
+    int jy = line / nx;
+    int i = line % nx;
+
+    const BoutReal *xm = &L.x[L.g(jy, i-1, 0)];
+    const BoutReal *x0 = &L.x[L.g(jy, i, 0)];
+    const BoutReal *xp = &L.x[L.g(jy, i+1, 0)];
+    int o = L.c(jy, i, 0);
+
+    for(int k=0;k<nz;k++) {
+      int km = (k == 0) ? nz-1 : k-1;
+      int kp = (k == nz-1) ? 0 : k+1;
+      L.r[o+k] = L.b[o+k]
+        - L.sc[o+k]*x0[k] - L.szm[o+k]*x0[km] - L.szp[o+k]*x0[kp]
+        - L.sxm[o+k]*xm[k] - L.sxp[o+k]*xp[k]
+        - L.sxz[o+k]*(xp[kp] - xp[km] - xm[kp] + xm[km]);
+    }
+  }
+}
+
+/// 2-norm over all X processors
+BoutReal LaplaceMultigrid::norm(const Level &L, const std::vector<BoutReal> &v)
+{
+  BoutReal local = 0.0;
+  int n = ny*L.nx*L.nz;
+
+  #pragma omp parallel for reduction(+:local)
+  for(int i=0;i<n;i++)
+    local += v[i]*v[i];
+
+  BoutReal total = local;
+  if(!(mesh->firstX() && mesh->lastX()))
+    MPI_Allreduce(&local, &total, 1, MPI_DOUBLE, MPI_SUM, mesh->getXcomm());
+
+  return sqrt(total);
+}
+
+/**************************************************************************
+ * Guard cells and boundaries
+ **************************************************************************/
+
+/// Exchange X guard cells of v, which is [jy][ix+1][kz], with neighbouring processors
+void LaplaceMultigrid::exchange(std::vector<BoutReal> &v, int nx, int nz)
+{
+  if(mesh->firstX() && mesh->lastX())
+    return;
+
+  int n = ny*nz;
+
+  // Buffers are kept between calls. The finest level is the largest
+  if((int) sendin.size() < n) {
+    sendin.resize(n);
+    sendout.resize(n);
+    recvin.resize(n);
+    recvout.resize(n);
+  }
+
+  comm_handle hin = NULL, hout = NULL;
+  if(!mesh->firstX())
+    hin = mesh->irecvXIn(&recvin[0], n, MG_COMM_IN);
+  if(!mesh->lastX())
+    hout = mesh->irecvXOut(&recvout[0], n, MG_COMM_OUT);
+
+  for(int jy=0;jy<ny;jy++)
+    for(int k=0;k<nz;k++) {
+      sendin[jy*nz + k]  = v[(jy*(nx+2) + 1)*nz + k];
+      sendout[jy*nz + k] = v[(jy*(nx+2) + nx)*nz + k];
+    }
+
+  if(!mesh->firstX())
+    mesh->sendXIn(&sendin[0], n, MG_COMM_OUT);
+  if(!mesh->lastX())
+    mesh->sendXOut(&sendout[0], n, MG_COMM_IN);
+
+  if(hin != NULL) {
+    mesh->wait(hin);
+    for(int jy=0;jy<ny;jy++)
+      for(int k=0;k<nz;k++)
+        v[(jy*(nx+2))*nz + k] = recvin[jy*nz + k];
+  }
+  if(hout != NULL) {
+    mesh->wait(hout);
+    for(int jy=0;jy<ny;jy++)
+      for(int k=0;k<nz;k++)
+        v[(jy*(nx+2) + nx + 1)*nz + k] = recvout[jy*nz + k];
+  }
+}
+
+/// Set the guard cells at the X boundaries from the INVERT_* flags
+void LaplaceMultigrid::applyBoundary(Level &L, bool homogeneous)
+{
+  int nx = L.nx, nz = L.nz;
+
+  if(mesh->firstX()) {
+    bool dcgrad = flags & INVERT_DC_IN_GRAD;
+    bool acgrad = flags & INVERT_AC_IN_GRAD;
+    for(int jy=0;jy<ny;jy++) {
+      const BoutReal *g = NULL;
+      if(!homogeneous && !gin.empty())
+        g = &gin[((xs-1)*ny + jy)*nz];
+      mg_bndry(&L.x[L.g(jy, -1, 0)], &L.x[L.g(jy, 0, 0)], nz, dcgrad, acgrad, g);
+    }
+  }
+
+  if(mesh->lastX()) {
+    bool dcgrad = flags & INVERT_DC_OUT_GRAD;
+    bool acgrad = flags & INVERT_AC_OUT_GRAD;
+    for(int jy=0;jy<ny;jy++) {
+      const BoutReal *g = NULL;
+      if(!homogeneous && !gout.empty())
+        g = &gout[jy*nz];
+      mg_bndry(&L.x[L.g(jy, nx, 0)], &L.x[L.g(jy, nx-1, 0)], nz, dcgrad, acgrad, g);
+    }
+  }
+}
+
+/**************************************************************************
+ * Copying to and from fields
+ **************************************************************************/
+
+/// Copy the points solved on this processor into v (on the finest level)
+void LaplaceMultigrid::loadField(const Field3D &f, std::vector<BoutReal> &v, bool guards)
+{
+  Level &L = levels[0];
+  const FieldReal *raw = f.readRaw();
+
+  std::fill(v.begin(), v.end(), 0.0);
+  if(raw == NULL)
+    return;
+
+  for(int jy=0;jy<ny;jy++)
+    for(int i=0;i<L.nx;i++)
+      for(int k=0;k<L.nz;k++)
+        v[guards ? L.g(jy, i, k) : L.c(jy, i, k)] = raw[Field3D::index(xs+i, ys+jy, k)];
+}
+
+/// Values in the boundary cells, used as the RHS of the boundary conditions
+void LaplaceMultigrid::loadBoundary(const Field3D *fin, const Field3D *fout)
+{
+  int nz = levels[0].nz;
+
+  gin.clear();
+  gout.clear();
+
+  if((fin != NULL) && mesh->firstX()) {
+    const FieldReal *raw = fin->readRaw();
+    gin.resize(xs*ny*nz);
+    for(int ix=0;ix<xs;ix++)
+      for(int jy=0;jy<ny;jy++)
+        for(int k=0;k<nz;k++)
+          gin[(ix*ny + jy)*nz + k] = raw[Field3D::index(ix, ys+jy, k)];
+  }
+
+  if((fout != NULL) && mesh->lastX()) {
+    const FieldReal *raw = fout->readRaw();
+    int nb = mesh->ngx-1-xe;
+    gout.resize(nb*ny*nz);
+    for(int ib=0;ib<nb;ib++)
+      for(int jy=0;jy<ny;jy++)
+        for(int k=0;k<nz;k++)
+          gout[(ib*ny + jy)*nz + k] = raw[Field3D::index(xe+1+ib, ys+jy, k)];
+  }
+}
+
+/// Copy the finest level into f, and set the boundary cells
+/*!
+ * The guard cells of the finest level must be set. X guard cells between
+ * processors are set to zero, as in the parallel FFT solvers.
+ */
+void LaplaceMultigrid::storeField(Field3D &f, bool homogeneous)
+{
+  Level &L = levels[0];
+  int nx = L.nx, nz = L.nz;
+  int ngx = mesh->ngx;
+  int ncz = mesh->ngz-1;
+
+  f.allocate();
+  FieldReal *raw = f.getRaw();
+
+  #pragma omp parallel
+  {
+    std::vector<BoutReal> row(ngx*nz);
+
+    #pragma omp for
+    for(int jy=0;jy<ny;jy++) {
+      int y = ys + jy;
+
+      std::fill(row.begin(), row.end(), 0.0);
+
+      int is = mesh->firstX() ? -1 : 0;
+      int ie = mesh->lastX() ? nx : nx-1;
+      for(int i=is;i<=ie;i++)
+        for(int k=0;k<nz;k++)
+          row[(xs+i)*nz + k] = L.x[L.g(jy, i, k)];
+
+      if(mesh->firstX()) {
+        bool dcgrad = flags & INVERT_DC_IN_GRAD;
+        bool acgrad = flags & INVERT_AC_IN_GRAD;
+        for(int ix=xs-2;ix>=0;ix--) {
+          const BoutReal *g = NULL;
+          if(!homogeneous && !gin.empty())
+            g = &gin[(ix*ny + jy)*nz];
+          mg_bndry(&row[ix*nz], &row[(ix+1)*nz], nz, dcgrad, acgrad, g);
+        }
+      }
+      if(mesh->lastX()) {
+        bool dcgrad = flags & INVERT_DC_OUT_GRAD;
+        bool acgrad = flags & INVERT_AC_OUT_GRAD;
+        for(int ix=xe+2;ix<ngx;ix++) {
+          const BoutReal *g = NULL;
+          if(!homogeneous && !gout.empty())
+            g = &gout[((ix-xe-1)*ny + jy)*nz];
+          mg_bndry(&row[ix*nz], &row[(ix-1)*nz], nz, dcgrad, acgrad, g);
+        }
+      }
+
+      if(flags & INVERT_ZERO_DC) {
+        for(int ix=0;ix<ngx;ix++) {
+          BoutReal mean = 0.0;
+          for(int k=0;k<nz;k++)
+            mean += row[ix*nz + k];
+          mean /= (BoutReal) nz;
+          for(int k=0;k<nz;k++)
+            row[ix*nz + k] -= mean;
+        }
+      }
+
+      for(int ix=0;ix<ngx;ix++) {
+        for(int k=0;k<nz;k++)
+          raw[Field3D::index(ix, y, k)] = row[ix*nz + k];
+        raw[Field3D::index(ix, y, ncz)] = row[ix*nz]; // enforce periodicity
+      }
+    }
+  }
+}
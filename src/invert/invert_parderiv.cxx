@@ -203,7 +203,7 @@ namespace invpar {
    ***********************************************************************/
   
   /// Parallel inversion routine
-  const Field3D invert_parderiv(const Field2D &Ac, const Field2D &Bc, const Field3D &rc)
+  Field3D invert_parderiv(const Field2D &Ac, const Field2D &Bc, const Field3D &rc)
   {
     static BoutReal *senddata;
     static BoutReal *recvdata;
@@ -323,21 +323,21 @@ namespace invpar {
     return result;
   }
 
-  const Field3D invert_parderiv(BoutReal val, const Field2D &B, const Field3D &r)
+  Field3D invert_parderiv(BoutReal val, const Field2D &B, const Field3D &r)
   {
     Field2D A;
     A = val;
     return invert_parderiv(A, B, r);
   }
   
-  const Field3D invert_parderiv(const Field2D &A, BoutReal val, const Field3D &r)
+  Field3D invert_parderiv(const Field2D &A, BoutReal val, const Field3D &r)
   {
     Field2D B;
     B = val;
     return invert_parderiv(A, B, r);
   }
   
-  const Field3D invert_parderiv(BoutReal val, BoutReal val2, const Field3D &r)
+  Field3D invert_parderiv(BoutReal val, BoutReal val2, const Field3D &r)
   {
     Field2D A, B;
     A = val;
@@ -141,8 +141,8 @@ void Inverter::applyBoundary(FieldPerp &f, int flags)
   //////////////////////////////////////
   // Inner boundary
   
-  ZFFT(f[nin+1], mesh->zShift[nin+1][jy], cdata[0]);
-  ZFFT(f[nin], mesh->zShift[nin][jy], cdata[1]);
+  ZFFT(f[nin+1], nin+1, jy, cdata[0]);
+  ZFFT(f[nin], nin, jy, cdata[1]);
   for(int i=0;i<=nin+1;i++)
     h[i] = mesh->dx[nin+1-i][jy];
   
@@ -150,14 +150,14 @@ void Inverter::applyBoundary(FieldPerp &f, int flags)
   calcBoundary(cdata, nin, h, flags & mask);
   
   for(int i=0;i<nin;i++)
-    ZFFT_rev(cdata[2+i], mesh->zShift[nin-1-i][jy], f[nin-1-i]);
+    ZFFT_rev(cdata[2+i], nin-1-i, jy, f[nin-1-i]);
   
   //////////////////////////////////////
   // Outer boundary
   
   int xe = mesh->xend;
-  ZFFT(f[xe-1], mesh->zShift[xe-1][jy], cdata[0]);
-  ZFFT(f[xe], mesh->zShift[xe][jy], cdata[1]);
+  ZFFT(f[xe-1], xe-1, jy, cdata[0]);
+  ZFFT(f[xe], xe, jy, cdata[1]);
   for(int i=0;i<=nout+1;i++)
     h[i] = mesh->dx[xe-1+i][jy];
   
@@ -165,7 +165,7 @@ void Inverter::applyBoundary(FieldPerp &f, int flags)
   calcBoundary(cdata, nout, h, flags & mask);
   
   for(int i=0;i<nout;i++)
-    ZFFT_rev(cdata[2+i], mesh->zShift[xe+1+i][jy], f[xe+1+i]);
+    ZFFT_rev(cdata[2+i], xe+1+i, jy, f[xe+1+i]);
 }
 
 void Inverter::calcBoundary(dcomplex **cdata, int n, BoutReal *h, int flags)
@@ -12,6 +12,9 @@
  * 
  * a is overwritten, and b is replaced by the solution
  *
+ * Work arrays are static, but private to each OpenMP thread,
+ * so these routines can be called from parallel regions
+ *
  **************************************************************************
  * Copyright 2010 B.D.Dudson, S.Farley, M.V.Umansky, X.Q.Xu
  *
@@ -37,6 +40,7 @@
 #include <globals.hxx>
 #include <dcomplex.hxx>
 #include <boutexception.hxx>
+#include <lapack_routines.hxx>
 
 #ifdef LAPACK
 
@@ -64,6 +68,7 @@ int tridag(const dcomplex *a, const dcomplex *b, const dcomplex *c, const dcompl
   // Lapack routines overwrite their inputs, so need to copy
   static int len = 0;
   static fcmplx *dl, *d, *du, *x;
+  #pragma omp threadprivate(len, dl, d, du, x)
 
   if(n > len) {
     //.allocate more memory (as a single block)
@@ -135,6 +140,7 @@ bool tridag(const BoutReal *a, const BoutReal *b, const BoutReal *c, const BoutR
   // Lapack routines overwrite their inputs, so need to copy
   static int len = 0;
   static BoutReal *dl, *d, *du, *x;
+  #pragma omp threadprivate(len, dl, d, du, x)
 
   if(n > len) {
     // Allocate more memory (as a single block)
@@ -201,6 +207,7 @@ void cyclic_tridag(BoutReal *a, BoutReal *b, BoutReal *c, BoutReal *r, BoutReal
   
   static int len = 0;
   static BoutReal *u, *z;
+  #pragma omp threadprivate(len, u, z)
   
   if(n > len) {
     if(len > 0) {
@@ -277,6 +284,7 @@ void cband_solve(dcomplex **a, int n, int m1, int m2, dcomplex *b)
   static int *ipiv;
   static int len = 0, alen = 0;
   static fcmplx *x, *AB; 
+  #pragma omp threadprivate(ipiv, len, alen, x, AB)
 
   if(alen < ldab*n) {
     if(alen > 0)
@@ -339,6 +347,7 @@ int tridag(const dcomplex *a, const dcomplex *b, const dcomplex *c, const dcompl
   dcomplex bet;
   static dcomplex *gam;
   static int len = 0;
+  #pragma omp threadprivate(gam, len)
 
   if(n > len) {
     if(len > 0)
@@ -380,6 +389,7 @@ bool tridag(const BoutReal *a, const BoutReal *b, const BoutReal *c, const BoutR
   BoutReal bet;
   static BoutReal *gam;
   static int len = 0;
+  #pragma omp threadprivate(gam, len)
   
   if(n > len) {
     if(len > 0)
@@ -421,6 +431,7 @@ void cyclic_tridag(BoutReal *a, BoutReal *b, BoutReal *c, BoutReal *r, BoutReal
   
   static int len = 0;
   static BoutReal *u, *z;
+  #pragma omp threadprivate(len, u, z)
   
   if(n > len) {
     if(len > 0) {
@@ -540,6 +551,7 @@ void cband_solve(dcomplex **a, int n, int m1, int m2, dcomplex *b)
   static dcomplex **al;
   static unsigned long *indx;
   static int an = 0, am1 = 0; //.allocated sizes
+  #pragma omp threadprivate(al, indx, an, am1)
   dcomplex d;
   
   if(an < n) {
@@ -579,6 +591,7 @@ void cyclic_tridag(dcomplex *a, dcomplex *b, dcomplex *c, dcomplex *r, dcomplex
   
   static int len = 0;
   static dcomplex *u, *z;
+  #pragma omp threadprivate(len, u, z)
   
   if(n > len) {
     if(len > 0) {
@@ -623,3 +636,106 @@ void cyclic_tridag(dcomplex *a, dcomplex *b, dcomplex *c, dcomplex *r, dcomplex
   b[0] = b0;
   b[n-1] = bn;
 }
+
+/**************************************************************************
+ * Batched tridiagonal solver
+ **************************************************************************/
+
+TridagBatch::TridagBatch(int n, int nsys) : n(n), nsys(nsys)
+{
+  int len = n*nsys;
+  data = new BoutReal[6*len];
+  for(int i=0;i<6*len;i++)
+    data[i] = 0.0;
+  
+  are = data;       aim = are + len;
+  bre = aim + len;  bim = bre + len;
+  cre = bim + len;  cim = cre + len;
+}
+
+TridagBatch::~TridagBatch()
+{
+  delete[] data;
+}
+
+void TridagBatch::setRow(int i, int s, const dcomplex &a, const dcomplex &b, const dcomplex &c)
+{
+  int k = i*nsys + s;
+  are[k] = a.Real(); aim[k] = a.Imag();
+  bre[k] = b.Real(); bim[k] = b.Imag();
+  cre[k] = c.Real(); cim[k] = c.Imag();
+}
+
+bool TridagBatch::factorise()
+{
+  int nzero = 0;
+  
+  for(int i=0;i<n;i++) {
+    BoutReal *ar = are + i*nsys, *ai = aim + i*nsys;
+    BoutReal *br = bre + i*nsys, *bi = bim + i*nsys;
+    BoutReal *cr = cre + i*nsys, *ci = cim + i*nsys;
+    
+    if(i > 0) {
+      // Pivot bet[i] = b[i] - a[i]*c[i-1]/bet[i-1]
+      const BoutReal *gr = cr - nsys, *gi = ci - nsys;
+      for(int s=0;s<nsys;s++) {
+        br[s] -= ar[s]*gr[s] - ai[s]*gi[s];
+        bi[s] -= ar[s]*gi[s] + ai[s]*gr[s];
+      }
+    }
+    
+    for(int s=0;s<nsys;s++) {
+      BoutReal mag = br[s]*br[s] + bi[s]*bi[s];
+      nzero += (mag == 0.0);
+      
+      // Store 1/bet and c/bet
+      BoutReal ir = br[s] / mag, ii = -bi[s] / mag;
+      br[s] = ir;
+      bi[s] = ii;
+      
+      BoutReal tr = cr[s]*ir - ci[s]*ii;
+      ci[s] = cr[s]*ii + ci[s]*ir;
+      cr[s] = tr;
+    }
+  }
+  
+  return nzero == 0;
+}
+
+void TridagBatch::solve(BoutReal *re, BoutReal *im) const
+{
+  // Forward substitution u[i] = (r[i] - a[i]*u[i-1]) / bet[i]
+  for(int i=0;i<n;i++) {
+    const BoutReal *ar = are + i*nsys, *ai = aim + i*nsys;
+    const BoutReal *br = bre + i*nsys, *bi = bim + i*nsys;
+    BoutReal *ur = re + i*nsys, *ui = im + i*nsys;
+    
+    if(i > 0) {
+      const BoutReal *umr = ur - nsys, *umi = ui - nsys;
+      for(int s=0;s<nsys;s++) {
+        ur[s] -= ar[s]*umr[s] - ai[s]*umi[s];
+        ui[s] -= ar[s]*umi[s] + ai[s]*umr[s];
+      }
+    }
+    
+    for(int s=0;s<nsys;s++) {
+      BoutReal rr = ur[s], ri = ui[s];
+      ur[s] = rr*br[s] - ri*bi[s];
+      ui[s] = rr*bi[s] + ri*br[s];
+    }
+  }
+  
+  // Back substitution u[i] -= (c[i]/bet[i])*u[i+1]
+  for(int i=n-2;i>=0;i--) {
+    const BoutReal *gr = cre + i*nsys, *gi = cim + i*nsys;
+    BoutReal *ur = re + i*nsys, *ui = im + i*nsys;
+    const BoutReal *upr = ur + nsys, *upi = ui + nsys;
+    
+    for(int s=0;s<nsys;s++) {
+      BoutReal tr = gr[s]*upr[s] - gi[s]*upi[s];
+      BoutReal ti = gr[s]*upi[s] + gi[s]*upr[s];
+      ur[s] -= tr;
+      ui[s] -= ti;
+    }
+  }
+}
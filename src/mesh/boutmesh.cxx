@@ -42,6 +42,9 @@
 #include <boutexception.hxx>
 
 #define PVEC_REAL_MPI_TYPE MPI_DOUBLE
+/// Guard cell messages are packed as bytes, so that 3D fields can be
+/// sent at their stored precision (FieldReal) and 2D fields as BoutReal
+#define PVEC_COMM_MPI_TYPE MPI_BYTE
 
 BoutMesh::~BoutMesh() {
   // Delete the communication handles
@@ -546,6 +549,11 @@ int BoutMesh::load() {
   }
   // Now have communicators for all regions.
 
+  //////////////////////////////////////////////////////
+  /// Communicator for the X processors with the same PE_YIND
+  
+  MPI_Comm_split(BoutComm::get(), PE_YIND, PE_XIND, &comm_x);
+
   //////////////////////////////////////////////////////
   /// Calculate Christoffel symbols. Needs communication
   if(geometry()) {
@@ -923,7 +931,7 @@ int BoutMesh::get(Field3D &var, const char *name) {
     return 2;
   }
 
-  BoutReal ***data;
+  FieldReal ***data;
   int jy;
 
   var = 0.0; // Makes sure the memory is allocated
@@ -1071,7 +1079,7 @@ int BoutMesh::communicate(FieldGroup &g)
 
 void BoutMesh::post_receive(CommHandle &ch)
 {
-  BoutReal *inbuff;
+  char *inbuff;
   int len;
   
   /// Post receive data from above (y+1)
@@ -1081,7 +1089,7 @@ void BoutMesh::post_receive(CommHandle &ch)
     len = msg_len(ch.var_list, 0, UDATA_XSPLIT, 0, MYG);
     MPI_Irecv(ch.umsg_recvbuff,
 	      len,
-	      PVEC_REAL_MPI_TYPE,
+	      PVEC_COMM_MPI_TYPE,
 	      UDATA_INDEST,
 	      IN_SENT_DOWN,
 	      BoutComm::get(),
@@ -1091,7 +1099,7 @@ void BoutMesh::post_receive(CommHandle &ch)
     inbuff = &ch.umsg_recvbuff[len]; // pointer to second half of the buffer
     MPI_Irecv(inbuff,
 	      msg_len(ch.var_list, UDATA_XSPLIT, ngx, 0, MYG),
-	      PVEC_REAL_MPI_TYPE,
+	      PVEC_COMM_MPI_TYPE,
 	      UDATA_OUTDEST,
 	      OUT_SENT_DOWN,
 	      BoutComm::get(),
@@ -1106,7 +1114,7 @@ void BoutMesh::post_receive(CommHandle &ch)
     len = msg_len(ch.var_list, 0, DDATA_XSPLIT, 0, MYG);
     MPI_Irecv(ch.dmsg_recvbuff, 
 	      len,
-	      PVEC_REAL_MPI_TYPE,
+	      PVEC_COMM_MPI_TYPE,
 	      DDATA_INDEST,
 	      IN_SENT_UP,
 	      BoutComm::get(),
@@ -1116,7 +1124,7 @@ void BoutMesh::post_receive(CommHandle &ch)
     inbuff = &ch.dmsg_recvbuff[len];
     MPI_Irecv(inbuff,
 	      msg_len(ch.var_list, DDATA_XSPLIT, ngx, 0, MYG),
-	      PVEC_REAL_MPI_TYPE,
+	      PVEC_COMM_MPI_TYPE,
 	      DDATA_OUTDEST,
 	      OUT_SENT_UP,
 	      BoutComm::get(),
@@ -1128,7 +1136,7 @@ void BoutMesh::post_receive(CommHandle &ch)
   if(IDATA_DEST != -1) {
     MPI_Irecv(ch.imsg_recvbuff,
 	      msg_len(ch.var_list, 0, MXG, 0, MYSUB),
-	      PVEC_REAL_MPI_TYPE,
+	      PVEC_COMM_MPI_TYPE,
 	      IDATA_DEST,
 	      OUT_SENT_IN,
 	      BoutComm::get(),
@@ -1140,7 +1148,7 @@ void BoutMesh::post_receive(CommHandle &ch)
   if(ODATA_DEST != -1) {
     MPI_Irecv(ch.omsg_recvbuff,
 	      msg_len(ch.var_list, 0, MXG, 0, MYSUB),
-	      PVEC_REAL_MPI_TYPE,
+	      PVEC_COMM_MPI_TYPE,
 	      ODATA_DEST,
 	      IN_SENT_OUT,
 	      BoutComm::get(),
@@ -1172,7 +1180,7 @@ comm_handle BoutMesh::send(FieldGroup &g)
   /// Send data going up (y+1)
   
   int len = 0;
-  BoutReal *outbuff;
+  char *outbuff;
   
   if(UDATA_INDEST != -1) { // If there is a destination for inner x data
     len = pack_data(var_list, 0, UDATA_XSPLIT, MYSUB, MYSUB+MYG, ch->umsg_sendbuff);
@@ -1180,8 +1188,8 @@ comm_handle BoutMesh::send(FieldGroup &g)
 
     if(async_send) {
       MPI_Isend(ch->umsg_sendbuff,   // Buffer to send
-		len,             // Length of buffer in BoutReals
-		PVEC_REAL_MPI_TYPE,  // Real variable type
+		len,             // Length of buffer in bytes
+		PVEC_COMM_MPI_TYPE,  // Packed bytes
 		UDATA_INDEST,        // Destination processor
 		IN_SENT_UP,          // Label (tag) for the message
 		BoutComm::get(),
@@ -1189,7 +1197,7 @@ comm_handle BoutMesh::send(FieldGroup &g)
     }else
       MPI_Send(ch->umsg_sendbuff,
 	       len,
-	       PVEC_REAL_MPI_TYPE,
+	       PVEC_COMM_MPI_TYPE,
 	       UDATA_INDEST,
 	       IN_SENT_UP,
 	       BoutComm::get());
@@ -1202,7 +1210,7 @@ comm_handle BoutMesh::send(FieldGroup &g)
     if(async_send) {
       MPI_Isend(outbuff, 
 		len, 
-		PVEC_REAL_MPI_TYPE,
+		PVEC_COMM_MPI_TYPE,
 		UDATA_OUTDEST,
 		OUT_SENT_UP,
 		BoutComm::get(),
@@ -1210,7 +1218,7 @@ comm_handle BoutMesh::send(FieldGroup &g)
     }else
       MPI_Send(outbuff, 
 	       len, 
-	       PVEC_REAL_MPI_TYPE,
+	       PVEC_COMM_MPI_TYPE,
 	       UDATA_OUTDEST,
 	       OUT_SENT_UP,
 	       BoutComm::get());
@@ -1225,7 +1233,7 @@ comm_handle BoutMesh::send(FieldGroup &g)
     if(async_send) {
       MPI_Isend(ch->dmsg_sendbuff, 
 		len,
-		PVEC_REAL_MPI_TYPE,
+		PVEC_COMM_MPI_TYPE,
 		DDATA_INDEST,
 		IN_SENT_DOWN,
 		BoutComm::get(),
@@ -1233,7 +1241,7 @@ comm_handle BoutMesh::send(FieldGroup &g)
     }else
       MPI_Send(ch->dmsg_sendbuff, 
 	       len,
-	       PVEC_REAL_MPI_TYPE,
+	       PVEC_COMM_MPI_TYPE,
 	       DDATA_INDEST,
 	       IN_SENT_DOWN,
 	       BoutComm::get());
@@ -1247,7 +1255,7 @@ comm_handle BoutMesh::send(FieldGroup &g)
     if(async_send) {
       MPI_Isend(outbuff,
 		len,
-		PVEC_REAL_MPI_TYPE,
+		PVEC_COMM_MPI_TYPE,
 		DDATA_OUTDEST,
 		OUT_SENT_DOWN,
 		BoutComm::get(),
@@ -1255,7 +1263,7 @@ comm_handle BoutMesh::send(FieldGroup &g)
     }else
       MPI_Send(outbuff,
 	       len,
-	       PVEC_REAL_MPI_TYPE,
+	       PVEC_COMM_MPI_TYPE,
 	       DDATA_OUTDEST,
 	       OUT_SENT_DOWN,
 	       BoutComm::get());
@@ -1268,7 +1276,7 @@ comm_handle BoutMesh::send(FieldGroup &g)
     if(async_send) {
       MPI_Isend(ch->imsg_sendbuff,
 		len,
-		PVEC_REAL_MPI_TYPE,
+		PVEC_COMM_MPI_TYPE,
 		IDATA_DEST,
 		IN_SENT_OUT,
 		BoutComm::get(),
@@ -1276,7 +1284,7 @@ comm_handle BoutMesh::send(FieldGroup &g)
     }else
       MPI_Send(ch->imsg_sendbuff,
 	       len,
-	       PVEC_REAL_MPI_TYPE,
+	       PVEC_COMM_MPI_TYPE,
 	       IDATA_DEST,
 	       IN_SENT_OUT,
 	       BoutComm::get());
@@ -1289,7 +1297,7 @@ comm_handle BoutMesh::send(FieldGroup &g)
     if(async_send) {
       MPI_Isend(ch->omsg_sendbuff,
 		len,
-		PVEC_REAL_MPI_TYPE,
+		PVEC_COMM_MPI_TYPE,
 		ODATA_DEST,
 		OUT_SENT_IN,
 		BoutComm::get(),
@@ -1297,7 +1305,7 @@ comm_handle BoutMesh::send(FieldGroup &g)
     }else
       MPI_Send(ch->omsg_sendbuff,
 	       len,
-	       PVEC_REAL_MPI_TYPE,
+	       PVEC_COMM_MPI_TYPE,
 	       ODATA_DEST,
 	       OUT_SENT_IN,
 	       BoutComm::get());
@@ -1882,17 +1890,17 @@ BoutMesh::CommHandle* BoutMesh::get_handle(int xlen, int ylen)
       ch->request[i] = MPI_REQUEST_NULL;
     
     if(ylen > 0) {
-      ch->umsg_sendbuff = new BoutReal[ylen];
-      ch->dmsg_sendbuff = new BoutReal[ylen];
-      ch->umsg_recvbuff = new BoutReal[ylen];
-      ch->dmsg_recvbuff = new BoutReal[ylen];
+      ch->umsg_sendbuff = new char[ylen];
+      ch->dmsg_sendbuff = new char[ylen];
+      ch->umsg_recvbuff = new char[ylen];
+      ch->dmsg_recvbuff = new char[ylen];
     }
     
     if(xlen > 0) {
-      ch->imsg_sendbuff = new BoutReal[xlen];
-      ch->omsg_sendbuff = new BoutReal[xlen];
-      ch->imsg_recvbuff = new BoutReal[xlen];
-      ch->omsg_recvbuff = new BoutReal[xlen];
+      ch->imsg_sendbuff = new char[xlen];
+      ch->omsg_sendbuff = new char[xlen];
+      ch->imsg_recvbuff = new char[xlen];
+      ch->omsg_recvbuff = new char[xlen];
     }
     
     ch->xbufflen = xlen;
@@ -1916,10 +1924,10 @@ BoutMesh::CommHandle* BoutMesh::get_handle(int xlen, int ylen)
       delete[] ch->dmsg_recvbuff;
     }
     
-    ch->umsg_sendbuff = new BoutReal[ylen];
-    ch->dmsg_sendbuff = new BoutReal[ylen];
-    ch->umsg_recvbuff = new BoutReal[ylen];
-    ch->dmsg_recvbuff = new BoutReal[ylen];
+    ch->umsg_sendbuff = new char[ylen];
+    ch->dmsg_sendbuff = new char[ylen];
+    ch->umsg_recvbuff = new char[ylen];
+    ch->dmsg_recvbuff = new char[ylen];
     
     ch->ybufflen = ylen;
   }
@@ -1931,10 +1939,10 @@ BoutMesh::CommHandle* BoutMesh::get_handle(int xlen, int ylen)
       delete[] ch->omsg_recvbuff;
     }
     
-    ch->imsg_sendbuff = new BoutReal[xlen];
-    ch->omsg_sendbuff = new BoutReal[xlen];
-    ch->imsg_recvbuff = new BoutReal[xlen];
-    ch->omsg_recvbuff = new BoutReal[xlen];
+    ch->imsg_sendbuff = new char[xlen];
+    ch->omsg_sendbuff = new char[xlen];
+    ch->imsg_recvbuff = new char[xlen];
+    ch->omsg_recvbuff = new char[xlen];
     
     ch->xbufflen = xlen;
   }
@@ -1976,7 +1984,7 @@ void BoutMesh::clear_handles()
  *                   Communication utilities
  ****************************************************************/
 
-int BoutMesh::pack_data(vector<FieldData*> &var_list, int xge, int xlt, int yge, int ylt, BoutReal *buffer)
+int BoutMesh::pack_data(vector<FieldData*> &var_list, int xge, int xlt, int yge, int ylt, char *buffer)
 {
   int jx, jy, jz;
   int len = 0;
@@ -1991,12 +1999,12 @@ int BoutMesh::pack_data(vector<FieldData*> &var_list, int xge, int xlt, int yge,
 	
 	for(jy=yge;jy < ylt;jy++)
 	  for(jz=0;jz < mesh->ngz-1;jz++)
-	    len += (*it)->getData(jx,jy,jz,buffer+len);
+	    len += (*it)->getData(jx,jy,jz,(void*) (buffer+len));
 	
       }else {
 	// 2D variable
 	for(jy=yge;jy < ylt;jy++)
-	  len += (*it)->getData(jx,jy,0,buffer+len);
+	  len += (*it)->getData(jx,jy,0,(void*) (buffer+len));
       }
     }
     
@@ -2005,7 +2013,7 @@ int BoutMesh::pack_data(vector<FieldData*> &var_list, int xge, int xlt, int yge,
   return(len);
 }
 
-int BoutMesh::unpack_data(vector<FieldData*> &var_list, int xge, int xlt, int yge, int ylt, BoutReal *buffer)
+int BoutMesh::unpack_data(vector<FieldData*> &var_list, int xge, int xlt, int yge, int ylt, char *buffer)
 {
   int jx, jy, jz;
   int len = 0;
@@ -2020,13 +2028,13 @@ int BoutMesh::unpack_data(vector<FieldData*> &var_list, int xge, int xlt, int yg
    
 	for(jy=yge;jy < ylt;jy++)
 	  for(jz=0;jz < mesh->ngz-1;jz++) {
-	    len += (*it)->setData(jx,jy,jz,buffer+len);
+	    len += (*it)->setData(jx,jy,jz,(void*) (buffer+len));
 	  }
 	
       }else {
 	// 2D variable
 	for(jy=yge;jy < ylt;jy++)
-	  len += (*it)->setData(jx,jy,0,buffer+len);
+	  len += (*it)->setData(jx,jy,0,(void*) (buffer+len));
       }
     }
     
@@ -2042,9 +2050,9 @@ int BoutMesh::msg_len(vector<FieldData*> &var_list, int xge, int xlt, int yge, i
   /// Loop over variables
   for(std::vector<FieldData*>::iterator it = var_list.begin(); it != var_list.end(); it++) {
     if((*it)->is3D()) {
-      len += (xlt - xge) * (ylt - yge) * (mesh->ngz-1) * (*it)->BoutRealSize();
+      len += (xlt - xge) * (ylt - yge) * (mesh->ngz-1) * (*it)->byteSize();
     }else
-      len += (xlt - xge) * (ylt - yge) * (*it)->BoutRealSize();
+      len += (xlt - xge) * (ylt - yge) * (*it)->byteSize();
   }
   
   return len;
@@ -2057,7 +2065,7 @@ int BoutMesh::msg_len(vector<FieldData*> &var_list, int xge, int xlt, int yge, i
 /// Reads in a portion of the X-Y domain
 int BoutMesh::readgrid_3dvar(GridDataSource *s, const char *name, 
 	                     int yread, int ydest, int ysize, 
-                             int xge, int xlt, BoutReal ***var)
+                             int xge, int xlt, FieldReal ***var)
 {
   /// Check the arguments make sense
   if((yread < 0) || (ydest < 0) || (ysize < 0) || (xge < 0) || (xlt < 0))
@@ -2156,7 +2164,7 @@ int BoutMesh::readgrid_3dvar(GridDataSource *s, const char *name,
 }
 
 /// Copies a section of a 3D variable
-void BoutMesh::cpy_3d_data(int yfrom, int yto, int xge, int xlt, BoutReal ***var)
+void BoutMesh::cpy_3d_data(int yfrom, int yto, int xge, int xlt, FieldReal ***var)
 {
   int i, k;
   for(i=xge;i!=xlt;i++)
@@ -29,6 +29,9 @@
 #include <utils.hxx>
 #include <derivs.hxx>
 #include <fft.hxx>
+#include <deriv_cache.hxx>
+#include <simd.hxx>
+#include <boutexception.hxx>
 
 #include <invert_laplace.hxx> // Delp2 uses same coefficients as inversion code
 
@@ -67,7 +70,7 @@ const Field2D Grad_par(const Field2D &var, DIFF_METHOD method, CELL_LOC outloc)
   return Grad_par(var, outloc, method);
 }
 
-const Field3D Grad_par(const Field3D &var, CELL_LOC outloc, DIFF_METHOD method)
+Field3D Grad_par(const Field3D &var, CELL_LOC outloc, DIFF_METHOD method)
 {
 #ifdef CHECK
   int msg_pos = msg_stack.push("Grad_par( Field3D )");
@@ -75,7 +78,10 @@ const Field3D Grad_par(const Field3D &var, CELL_LOC outloc, DIFF_METHOD method)
 
   Field3D result;
 
-  result = DDY(var, outloc, method)/sqrt(mesh->g_22);
+  if(!deriv_cache_get(DCACHE_GRAD_PAR, var, outloc, method, 0., result)) {
+    result = DDY(var, outloc, method)/sqrt(mesh->g_22);
+    deriv_cache_put(DCACHE_GRAD_PAR, var, outloc, method, 0., result);
+  }
 
 #ifdef TRACK
   result.name = "Grad_par("+var.name+")";
@@ -87,7 +93,7 @@ const Field3D Grad_par(const Field3D &var, CELL_LOC outloc, DIFF_METHOD method)
   return result;
 }
 
-const Field3D Grad_par(const Field3D &var, DIFF_METHOD method, CELL_LOC outloc)
+Field3D Grad_par(const Field3D &var, DIFF_METHOD method, CELL_LOC outloc)
 {
   return Grad_par(var, outloc, method);
 }
@@ -102,12 +108,12 @@ const Field2D Vpar_Grad_par(const Field2D &v, const Field2D &f)
   return VDDY(v, f)/sqrt(mesh->g_22);
 }
 
-const Field3D Vpar_Grad_par(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD method)
+Field3D Vpar_Grad_par(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD method)
 {
   return VDDY(v, f, outloc, method)/sqrt(mesh->g_22);
 }
 
-const Field3D Vpar_Grad_par(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D Vpar_Grad_par(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc)
 {
   return Vpar_Grad_par(v, f, outloc, method);
 }
@@ -136,7 +142,7 @@ const Field2D Div_par(const Field2D &f)
   return result;
 }
 
-const Field3D Div_par(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
+Field3D Div_par(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
 {
 #ifdef CHECK
   int msg_pos = msg_stack.push("Div_par( Field3D )");
@@ -155,7 +161,7 @@ const Field3D Div_par(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
   return result;
 }
 
-const Field3D Div_par(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D Div_par(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
 {
   return Div_par(f, outloc, method);
 }
@@ -166,11 +172,11 @@ const Field3D Div_par(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
  *       thing needs to be thought through.
  *******************************************************************************/
 
-const Field3D Grad_par_CtoL(const Field3D &var)
+Field3D Grad_par_CtoL(const Field3D &var)
 {
   Field3D result;
   result.allocate();
-  BoutReal ***d = result.getData();
+  FieldReal ***d = result.getData();
 
   /*
   bindex bx;
@@ -195,17 +201,18 @@ const Field3D Grad_par_CtoL(const Field3D &var)
   return result;
 }
 
-const Field3D Vpar_Grad_par_LCtoC(const Field &v, const Field &f)
+Field3D Vpar_Grad_par_LCtoC(const Field &v, const Field &f)
 {
   bindex bx;
   bstencil fval, vval;
   Field3D result;
   
   result.allocate();
-  BoutReal ***d = result.getData();
+  FieldReal ***d = result.getData();
 
-  start_index(&bx);
-  do {
+  const Region &rgn = getRegion(RGN_NOBNDRY);
+  for(int i=0;i<rgn.size3D();i++) {
+    rgn.index3(i, bx);
     f.setStencil(&fval, &bx);
     v.setStencil(&vval, &bx);
     
@@ -214,49 +221,50 @@ const Field3D Vpar_Grad_par_LCtoC(const Field &v, const Field &f)
     // Right side
     d[bx.jx][bx.jy][bx.jz] -= (vval.yp >= 0.0) ? vval.yp * fval.cc : vval.yp * fval.yp;
     
-  }while(next_index3(&bx));
+  }
 
   return result;
 }
 
-const Field3D Grad_par_LtoC(const Field &var)
+Field3D Grad_par_LtoC(const Field &var)
 {
   bindex bx;
   bstencil f;
   Field3D result;
   
   result.allocate();
-  BoutReal ***d = result.getData();
+  FieldReal ***d = result.getData();
 
-  start_index(&bx);
-  do {
+  const Region &rgn = getRegion(RGN_NOBNDRY);
+  for(int i=0;i<rgn.size3D();i++) {
+    rgn.index3(i, bx);
     var.setStencil(&f, &bx);
     
     d[bx.jx][bx.jy][bx.jz] = (f.yp - f.cc) / (mesh->dy[bx.jx][bx.jy] * sqrt(mesh->g_22[bx.jx][bx.jy]));
-  }while(next_index3(&bx));
+  }
 
   return result;
 }
 
-const Field3D Div_par_LtoC(const Field2D &var)
+Field3D Div_par_LtoC(const Field2D &var)
 {
   Field3D result = mesh->Bxy*Grad_par_LtoC(var/mesh->Bxy);
   return result;
 }
 
-const Field3D Div_par_LtoC(const Field3D &var)
+Field3D Div_par_LtoC(const Field3D &var)
 {
   Field3D result = mesh->Bxy*Grad_par_LtoC(var/mesh->Bxy);
   return result;
 }
 
-const Field3D Div_par_CtoL(const Field2D &var)
+Field3D Div_par_CtoL(const Field2D &var)
 {
   Field3D result = mesh->Bxy*Grad_par_CtoL(var/mesh->Bxy);
   return result;
 }
 
-const Field3D Div_par_CtoL(const Field3D &var)
+Field3D Div_par_CtoL(const Field3D &var)
 {
   Field3D result = mesh->Bxy*Grad_par_CtoL(var/mesh->Bxy);
   return result;
@@ -287,7 +295,7 @@ const Field2D Grad2_par2(const Field2D &f)
   return result;
 }
 
-const Field3D Grad2_par2(const Field3D &f)
+Field3D Grad2_par2(const Field3D &f)
 {
 #ifdef CHECK
   int msg_pos = msg_stack.push("Grad2_par2( Field3D )");
@@ -316,17 +324,17 @@ const Field2D Div_par_K_Grad_par(Field2D &kY, Field2D &f)
   return kY*Grad2_par2(f) + Div_par(kY)*Grad_par(f);
 }
 
-const Field3D Div_par_K_Grad_par(Field2D &kY, Field3D &f)
+Field3D Div_par_K_Grad_par(Field2D &kY, Field3D &f)
 {
   return kY*Grad2_par2(f) + Div_par(kY)*Grad_par(f);
 }
 
-const Field3D Div_par_K_Grad_par(Field3D &kY, Field2D &f)
+Field3D Div_par_K_Grad_par(Field3D &kY, Field2D &f)
 {
   return kY*Grad2_par2(f) + Div_par(kY)*Grad_par(f);
 }
 
-const Field3D Div_par_K_Grad_par(Field3D &kY, Field3D &f) {
+Field3D Div_par_K_Grad_par(Field3D &kY, Field3D &f) {
   return kY*Grad2_par2(f) + Div_par(kY)*Grad_par(f);
 }
 
@@ -335,7 +343,7 @@ const Field3D Div_par_K_Grad_par(Field3D &kY, Field3D &f) {
  * Divergence of perpendicular diffusive flux kperp*Grad_perp
  *******************************************************************************/
 
-const Field3D Div_K_perp_Grad_perp(const Field2D &kperp, const Field3D &f) {
+Field3D Div_K_perp_Grad_perp(const Field2D &kperp, const Field3D &f) {
   
 }
 
@@ -359,10 +367,12 @@ const Field2D Delp2(const Field2D &f)
   return result;
 }
 
-const Field3D Delp2(const Field3D &f, BoutReal zsmooth)
+static Field3D calcDelp2(const Field3D &f, BoutReal zsmooth, bool useFFT)
 {
   Field3D result;
-  BoutReal ***fd, ***rd;
+
+  if(!useFFT)
+    return Delp2_FD(f);
 
 #ifdef CHECK
   int msg_pos = msg_stack.push("Delp2( Field3D )");
@@ -372,70 +382,79 @@ const Field3D Delp2(const Field3D &f, BoutReal zsmooth)
 
   // NEW: SOLVE USING FFT
 
-  static dcomplex **ft = (dcomplex**) NULL, **delft;
-  int jx, jy, jz;
-  BoutReal filter;
-  dcomplex a, b, c;
-
   result.allocate();
 
-  fd = f.getData();
-  rd = result.getData();
-
   int ncz = mesh->ngz-1;
+  int nk = ncz/2 + 1;
+  int nlines = mesh->ngx*mesh->ngy;
   
-  if(ft == (dcomplex**) NULL) {
-    //.allocate memory
-    ft = cmatrix(mesh->ngx, ncz/2 + 1);
-    delft = cmatrix(mesh->ngx, ncz/2 + 1);
+  // Spectra of all lines, indexed by (jx*ngy + jy)*nk + jz
+  static dcomplex *ft = (dcomplex*) NULL, *delft;
+  static int size = 0;
+  if(size != nlines*nk) {
+    if(ft != (dcomplex*) NULL) {
+      delete[] ft;
+      delete[] delft;
+    }
+    size = nlines*nk;
+    ft = new dcomplex[size];
+    delft = new dcomplex[size];
   }
   
-  // Loop over all y indices
-  for(jy=0;jy<mesh->ngy;jy++) {
-
-    // Take forward FFT
+  // Take forward FFT of all lines at once
+  rfft_many(f.readRaw(), ncz, nlines, mesh->ngz, ft);
+  
+  const dcomplex *phase = (dcomplex*) NULL;
+  if(mesh->ShiftXderivs) {
+    // Shift into real space, as ZFFT
+    phase = zshift_phases();
+    #pragma omp parallel for
+    for(int i=0;i<nlines*nk;i++)
+      ft[i] *= phase[i];
+  }
+  
+  #pragma omp parallel for
+  for(int i=0;i<nlines;i++) {
+    int jx = i / mesh->ngy;
+    int jy = i % mesh->ngy;
+    dcomplex *d = delft + i*nk;
+    
+    if((jx < 2) || (jx >= mesh->ngx-2)) {
+      // No X derivative here
+      for(int jz=0;jz<nk;jz++)
+        d[jz] = 0.0;
+      continue;
+    }
+    
+    const dcomplex *fm = ft + (i - mesh->ngy)*nk;
+    const dcomplex *fc = ft + i*nk;
+    const dcomplex *fp = ft + (i + mesh->ngy)*nk;
     
-    for(jx=0;jx<mesh->ngx;jx++)
-      ZFFT(fd[jx][jy], mesh->zShift[jx][jy], ft[jx]);
-
     // Loop over kz
-    for(jz=0;jz<=ncz/2;jz++) {
-
+    for(int jz=0;jz<nk;jz++) {
+      BoutReal filter;
       if ((zsmooth > 0.0) && (jz > (int) (zsmooth*((BoutReal) ncz)))) filter=0.0; else filter=1.0;
 
       // No smoothing in the x direction
-      for(jx=2;jx<(mesh->ngx-2);jx++) {
-	// Perform x derivative
-	
-	laplace_tridag_coefs(jx, jy, jz, a, b, c);
-
-	delft[jx][jz] = a*ft[jx-1][jz] + b*ft[jx][jz] + c*ft[jx+1][jz];
-	delft[jx][jz] *= filter;
-	
-	//Savitzky-Golay 2nd order, 2nd degree in x
-        /*
-	delft[jx][jz] = coef1*(  0.285714 * (ft[jx-2][jz] + ft[jx+2][jz])
-				 - 0.142857 * (ft[jx-1][jz] + ft[jx+1][jz])
-				 - 0.285714 * ft[jx][jz] );
-	
-	delft[jx][jz] -= SQ(kwave)*coef2*ft[jx][jz];
-	*/
-      }
-    }
-  
-    // Reverse FFT
-    for(jx=1;jx<(mesh->ngx-1);jx++) {
+      dcomplex a, b, c;
+      laplace_tridag_coefs(jx, jy, jz, a, b, c);
 
-      ZFFT_rev(delft[jx], mesh->zShift[jx][jy], rd[jx][jy]);
-      rd[jx][jy][ncz] = rd[jx][jy][0];
+      d[jz] = a*fm[jz] + b*fc[jz] + c*fp[jz];
+      d[jz] *= filter;
     }
 
-    // Boundaries
-    for(jz=0;jz<ncz;jz++) {
-      rd[0][jy][jz] = 0.0;
-      rd[mesh->ngx-1][jy][jz] = 0.0;
+    if(mesh->ShiftXderivs) {
+      // Shift back, as ZFFT_rev
+      for(int jz=0;jz<nk;jz++)
+        d[jz] *= conj(phase[i*nk + jz]);
     }
   }
+  
+  // Reverse FFT
+  FieldReal *rd = result.getRaw();
+  irfft_many(delft, ncz, nlines, rd, mesh->ngz);
+  for(int i=0;i<nlines;i++)
+    rd[i*mesh->ngz + ncz] = rd[i*mesh->ngz];
 
 #ifdef CHECK
   msg_stack.pop(msg_pos);
@@ -447,6 +466,16 @@ const Field3D Delp2(const Field3D &f, BoutReal zsmooth)
   return result;
 }
 
+Field3D Delp2(const Field3D &f, BoutReal zsmooth, bool useFFT)
+{
+  Field3D result;
+  if(!deriv_cache_get(DCACHE_DELP2, f, CELL_DEFAULT, useFFT ? 1 : 0, zsmooth, result)) {
+    result = calcDelp2(f, zsmooth, useFFT);
+    deriv_cache_put(DCACHE_DELP2, f, CELL_DEFAULT, useFFT ? 1 : 0, zsmooth, result);
+  }
+  return result;
+}
+
 const FieldPerp Delp2(const FieldPerp &f, BoutReal zsmooth)
 {
   FieldPerp result;
@@ -475,7 +504,7 @@ const FieldPerp Delp2(const FieldPerp &f, BoutReal zsmooth)
   
   // Take forward FFT
   for(int jx=0;jx<mesh->ngx;jx++)
-    ZFFT(fd[jx], mesh->zShift[jx][jy], ft[jx]);
+    ZFFT(fd[jx], jx, jy, ft[jx]);
 
   // Loop over kz
   for(int jz=0;jz<=ncz/2;jz++) {
@@ -496,7 +525,7 @@ const FieldPerp Delp2(const FieldPerp &f, BoutReal zsmooth)
   
   // Reverse FFT
   for(int jx=1;jx<(mesh->ngx-1);jx++) {
-    ZFFT_rev(delft[jx], mesh->zShift[jx][jy], rd[jx]);
+    ZFFT_rev(delft[jx], jx, jy, rd[jx]);
     rd[jx][ncz] = rd[jx][0];
   }
 
@@ -535,7 +564,7 @@ const Field2D Laplacian(const Field2D &f)
   return result;
 }
 
-const Field3D Laplacian(const Field3D &f)
+Field3D Laplacian(const Field3D &f)
 {
 #ifdef CHECK
   int msg_pos = msg_stack.push("Laplacian( Field3D )");
@@ -596,7 +625,7 @@ const Field2D b0xGrad_dot_Grad(const Field2D &phi, const Field2D &A)
   return result;
 }
 
-const Field3D b0xGrad_dot_Grad(const Field2D &phi, const Field3D &A)
+Field3D b0xGrad_dot_Grad(const Field2D &phi, const Field3D &A)
 {
   Field2D dpdx, dpdy, dpdz;
   Field2D vx, vy, vz;
@@ -634,7 +663,7 @@ const Field3D b0xGrad_dot_Grad(const Field2D &phi, const Field3D &A)
   return result;
 }
 
-const Field3D b0xGrad_dot_Grad(const Field3D &p, const Field2D &A, CELL_LOC outloc)
+Field3D b0xGrad_dot_Grad(const Field3D &p, const Field2D &A, CELL_LOC outloc)
 {
   Field3D dpdx, dpdy, dpdz;
   Field3D vx, vy, vz;
@@ -674,7 +703,7 @@ const Field3D b0xGrad_dot_Grad(const Field3D &p, const Field2D &A, CELL_LOC outl
   return result;
 }
 
-const Field3D b0xGrad_dot_Grad(const Field3D &phi, const Field3D &A, CELL_LOC outloc)
+Field3D b0xGrad_dot_Grad(const Field3D &phi, const Field3D &A, CELL_LOC outloc)
 {
   Field3D dpdx, dpdy, dpdz;
   Field3D vx, vy, vz;
@@ -717,6 +746,108 @@ const Field3D b0xGrad_dot_Grad(const Field3D &phi, const Field3D &A, CELL_LOC ou
  * Terms of form b0 x Grad(f) dot Grad(g) / B = [f, g]
  *******************************************************************************/
 
+/// Number of X points handled by each work item in bracketArakawa
+#define ARAKAWA_XBLOCK 16
+
+/// Copy the Z line at (jx,jy) into row, with the periodic neighbours at each end
+static void arakawaRow(BoutReal *row, const FieldReal *f3d, const Field2D *f2d, int jx, int jy, int ncz)
+{
+  if(f3d != NULL) {
+    const FieldReal *f = f3d + Field3D::index(jx, jy, 0);
+    for(int jz=0;jz<ncz;jz++)
+      row[jz+1] = f[jz];
+    row[0] = f[ncz-1];
+    row[ncz+1] = f[0];
+  }else {
+    BoutReal val = (*f2d)[jx][jy];
+    for(int jz=0;jz<ncz+2;jz++)
+      row[jz] = val;
+  }
+}
+
+/// Arakawa bracket [f, g]. Each operand is either a Field3D or a Field2D (the other NULL)
+/*!
+  Work is split over Y and blocks of X points. Along each block the rows of
+  f and g at jx-1, jx and jx+1 are kept, so each row is only loaded once,
+  and the Jacobian is computed a whole Z line at a time by simd_arakawa.
+ */
+static Field3D bracketArakawa(const Field3D *f3d, const Field2D *f2d,
+                                    const Field3D *g3d, const Field2D *g2d)
+{
+#ifdef CHECK
+  int msg_pos = msg_stack.push("bracket( ARAKAWA )");
+#endif
+
+  int ncz = mesh->ngz - 1;
+  int w = simd_width();
+  int npad = ((ncz + w - 1) / w) * w; // Multiple of the vector width
+  int len = npad + 2;                 // Row length including neighbours
+  
+  const FieldReal *fd = (f3d != NULL) ? f3d->readRaw() : NULL;
+  const FieldReal *gd = (g3d != NULL) ? g3d->readRaw() : NULL;
+#ifdef CHECK
+  if(((f3d != NULL) && (fd == NULL)) || ((g3d != NULL) && (gd == NULL)))
+    throw BoutException("bracket: Empty Field3D\n");
+#endif
+  
+  Field3D result;
+  result.allocate();
+  FieldReal *r = result.getRaw();
+  
+  int nx = mesh->xend - mesh->xstart + 1;
+  int ny = mesh->yend - mesh->ystart + 1;
+  int nblocks = (nx + ARAKAWA_XBLOCK - 1) / ARAKAWA_XBLOCK;
+  BoutReal dz = mesh->dz;
+  
+  #pragma omp parallel
+  {
+    // Three rows each of f and g, and the result
+    BoutReal *buf = new BoutReal[7*len];
+    for(int i=0;i<7*len;i++)
+      buf[i] = 0.0;
+    BoutReal *out = buf + 6*len;
+    
+    #pragma omp for schedule(static)
+    for(int item=0;item<ny*nblocks;item++) {
+      int jy = mesh->ystart + item / nblocks;
+      int xs = mesh->xstart + (item % nblocks)*ARAKAWA_XBLOCK;
+      int xe = (xs + ARAKAWA_XBLOCK - 1 < mesh->xend) ? xs + ARAKAWA_XBLOCK - 1 : mesh->xend;
+      
+      BoutReal *frow[3] = {buf, buf + len, buf + 2*len};
+      BoutReal *grow[3] = {buf + 3*len, buf + 4*len, buf + 5*len};
+      for(int i=0;i<2;i++) {
+        arakawaRow(frow[i+1], fd, f2d, xs-1+i, jy, ncz);
+        arakawaRow(grow[i+1], gd, g2d, xs-1+i, jy, ncz);
+      }
+      
+      for(int jx=xs;jx<=xe;jx++) {
+        // Shift rows down and load jx+1
+        BoutReal *tmp = frow[0]; frow[0] = frow[1]; frow[1] = frow[2]; frow[2] = tmp;
+        tmp = grow[0]; grow[0] = grow[1]; grow[1] = grow[2]; grow[2] = tmp;
+        arakawaRow(frow[2], fd, f2d, jx+1, jy, ncz);
+        arakawaRow(grow[2], gd, g2d, jx+1, jy, ncz);
+        
+        simd_arakawa(out, frow[0], frow[1], frow[2], grow[0], grow[1], grow[2],
+                     npad, 1.0 / (12.0 * mesh->dx[jx][jy] * dz));
+        
+        FieldReal *rl = r + Field3D::index(jx, jy, 0);
+        for(int jz=0;jz<ncz;jz++)
+          rl[jz] = out[jz];
+        rl[ncz] = rl[0];
+      }
+    }
+    
+    delete[] buf;
+  }
+  
+#ifdef CHECK
+  result.bndry_xin = result.bndry_xout = result.bndry_yup = result.bndry_ydown = false;
+  msg_stack.pop(msg_pos);
+#endif
+  
+  return result;
+}
+
 const Field2D bracket(const Field2D &f, const Field2D &g, BRACKET_METHOD method)
 {
   Field2D result;
@@ -730,43 +861,13 @@ const Field2D bracket(const Field2D &f, const Field2D &g, BRACKET_METHOD method)
   return result;
 }
 
-const Field3D bracket(const Field3D &f, const Field2D &g, BRACKET_METHOD method)
+Field3D bracket(const Field3D &f, const Field2D &g, BRACKET_METHOD method)
 {
   Field3D result;
   switch(method) {
   case BRACKET_ARAKAWA: {
     // Arakawa scheme for perpendicular flow. Here as a test
-    
-    result.allocate();
-    int ncz = mesh->ngz - 1;
-    for(int jx=mesh->xstart;jx<=mesh->xend;jx++)
-      for(int jy=mesh->ystart;jy<=mesh->yend;jy++)
-        for(int jz=0;jz<ncz;jz++) {
-          int jzp = (jz + 1) % ncz;
-          int jzm = (jz - 1 + ncz) % ncz;
-          
-          // J++ = DDZ(f)*DDX(g) - DDX(f)*DDZ(g)
-          BoutReal Jpp = 0.25*( (f[jx][jy][jzp] - f[jx][jy][jzm])*
-                                (g[jx+1][jy] - g[jx-1][jy]) -
-                                (f[jx+1][jy][jz] - f[jx-1][jy][jz])*
-                                (g[jx][jy] - g[jx][jy]) )
-            / (mesh->dx[jx][jy] * mesh->dz);
-
-          // J+x
-          BoutReal Jpx = 0.25*( g[jx+1][jy]*(f[jx+1][jy][jzp]-f[jx+1][jy][jzm]) -
-                                g[jx-1][jy]*(f[jx-1][jy][jzp]-f[jx-1][jy][jzm]) -
-                                g[jx][jy]*(f[jx+1][jy][jzp]-f[jx-1][jy][jzp]) +
-                                g[jx][jy]*(f[jx+1][jy][jzm]-f[jx-1][jy][jzm]))
-            / (mesh->dx[jx][jy] * mesh->dz);
-          // Jx+
-          BoutReal Jxp = 0.25*( g[jx+1][jy]*(f[jx][jy][jzp]-f[jx+1][jy][jz]) -
-                                g[jx-1][jy]*(f[jx-1][jy][jz]-f[jx][jy][jzm]) -
-                                g[jx-1][jy]*(f[jx][jy][jzp]-f[jx-1][jy][jz]) +
-                                g[jx+1][jy]*(f[jx+1][jy][jz]-f[jx][jy][jzm]))
-            / (mesh->dx[jx][jy] * mesh->dz);
-          
-          result[jx][jy][jz] = (Jpp + Jpx + Jxp) / 3.;
-        }
+    result = bracketArakawa(&f, NULL, NULL, &g);
     break;
   }
   case BRACKET_SIMPLE: {
@@ -782,11 +883,14 @@ const Field3D bracket(const Field3D &f, const Field2D &g, BRACKET_METHOD method)
   return result;
 }
 
-const Field3D bracket(const Field2D &f, const Field3D &g, BRACKET_METHOD method)
+Field3D bracket(const Field2D &f, const Field3D &g, BRACKET_METHOD method)
 {
   Field3D result;
   switch(method) {
-  case BRACKET_ARAKAWA: 
+  case BRACKET_ARAKAWA: {
+    result = bracketArakawa(NULL, &f, &g, NULL);
+    break;
+  }
   case BRACKET_SIMPLE: {
     // Use a subset of terms for comparison to BOUT-06
     result = VDDZ(-DDX(f), g);
@@ -800,44 +904,13 @@ const Field3D bracket(const Field2D &f, const Field3D &g, BRACKET_METHOD method)
   return result;
 }
 
-const Field3D bracket(const Field3D &f, const Field3D &g, BRACKET_METHOD method)
+Field3D bracket(const Field3D &f, const Field3D &g, BRACKET_METHOD method)
 {
   Field3D result;
   switch(method) {
   case BRACKET_ARAKAWA: {
     // Arakawa scheme for perpendicular flow. Here as a test
-    
-    result.allocate();
-    
-    int ncz = mesh->ngz - 1;
-    for(int jx=mesh->xstart;jx<=mesh->xend;jx++)
-      for(int jy=mesh->ystart;jy<=mesh->yend;jy++)
-        for(int jz=0;jz<ncz;jz++) {
-          int jzp = (jz + 1) % ncz;
-          int jzm = (jz - 1 + ncz) % ncz;
-          
-          // J++ = DDZ(f)*DDX(g) - DDX(f)*DDZ(g)
-          BoutReal Jpp = 0.25*( (f[jx][jy][jzp] - f[jx][jy][jzm])*
-                                (g[jx+1][jy][jz] - g[jx-1][jy][jz]) -
-                                (f[jx+1][jy][jz] - f[jx-1][jy][jz])*
-                                (g[jx][jy][jzp] - g[jx][jy][jzm]) )
-            / (mesh->dx[jx][jy] * mesh->dz);
-
-          // J+x
-          BoutReal Jpx = 0.25*( g[jx+1][jy][jz]*(f[jx+1][jy][jzp]-f[jx+1][jy][jzm]) -
-                                g[jx-1][jy][jz]*(f[jx-1][jy][jzp]-f[jx-1][jy][jzm]) -
-                                g[jx][jy][jzp]*(f[jx+1][jy][jzp]-f[jx-1][jy][jzp]) +
-                                g[jx][jy][jzm]*(f[jx+1][jy][jzm]-f[jx-1][jy][jzm]))
-            / (mesh->dx[jx][jy] * mesh->dz);
-          // Jx+
-          BoutReal Jxp = 0.25*( g[jx+1][jy][jzp]*(f[jx][jy][jzp]-f[jx+1][jy][jz]) -
-                                g[jx-1][jy][jzm]*(f[jx-1][jy][jz]-f[jx][jy][jzm]) -
-                                g[jx-1][jy][jzp]*(f[jx][jy][jzp]-f[jx-1][jy][jz]) +
-                                g[jx+1][jy][jzm]*(f[jx+1][jy][jz]-f[jx][jy][jzm]))
-            / (mesh->dx[jx][jy] * mesh->dz);
-          
-          result[jx][jy][jz] = (Jpp + Jpx + Jxp) / 3.;
-        }
+    result = bracketArakawa(&f, NULL, &g, NULL);
     break;
   }
   case BRACKET_SIMPLE: {
@@ -46,7 +46,7 @@ BoutReal interp(const stencil &s)
   @param[in]   var  Input variable
   @param[in]   loc  Location of output values
 */
-const Field3D interp_to(const Field3D &var, CELL_LOC loc)
+Field3D interp_to(const Field3D &var, CELL_LOC loc)
 {
   if(mesh->StaggerGrids && (var.getLocation() != loc)) {
     
@@ -63,7 +63,7 @@ const Field3D interp_to(const Field3D &var, CELL_LOC loc)
     result = var; // NOTE: This is just for boundaries. FIX!
 
     result.allocate();
-    BoutReal ***d = result.getData();
+    FieldReal ***d = result.getData();
     
     if((var.getLocation() == CELL_CENTRE) || (loc == CELL_CENTRE)) {
       // Going between centred and shifted
@@ -77,29 +77,35 @@ const Field3D interp_to(const Field3D &var, CELL_LOC loc)
 
       switch(dir) {
       case CELL_XLOW: {
-	start_index(&bx, RGN_NOX);
-	do {
+	const Region &rgn = getRegion(RGN_NOX);
+	#pragma omp parallel for private(bx, s)
+	for(int i=0;i<rgn.size3D();i++) {
+	  rgn.index3(i, bx);
 	  var.setXStencil(s, bx, loc);
 	  d[bx.jx][bx.jy][bx.jz] = interp(s);
-	}while(next_index3(&bx));
+	}
 	break;
 	// Need to communicate in X
       }
       case CELL_YLOW: {
-	start_index(&bx, RGN_NOY);
-	do {
+	const Region &rgn = getRegion(RGN_NOY);
+	#pragma omp parallel for private(bx, s)
+	for(int i=0;i<rgn.size3D();i++) {
+	  rgn.index3(i, bx);
 	  var.setYStencil(s, bx, loc);
 	  d[bx.jx][bx.jy][bx.jz] = interp(s);
-	}while(next_index3(&bx));
+	}
 	break;
 	// Need to communicate in Y
       }
       case CELL_ZLOW: {
-	start_index(&bx, RGN_NOZ);
-	do {
+	const Region &rgn = getRegion(RGN_NOZ);
+	#pragma omp parallel for private(bx, s)
+	for(int i=0;i<rgn.size3D();i++) {
+	  rgn.index3(i, bx);
 	  var.setZStencil(s, bx, loc);
 	  d[bx.jx][bx.jy][bx.jz] = interp(s);
-	}while(next_index3(&bx));
+	}
 	break;
       }
       default: {
@@ -181,7 +187,7 @@ BoutReal lagrange_4pt(BoutReal v[], BoutReal offset)
   return lagrange_4pt(v[0], v[1], v[2], v[3], offset);
 }
 
-const Field3D interpolate(const Field3D &var, const Field3D &delta_x, const Field3D &delta_z)
+Field3D interpolate(const Field3D &var, const Field3D &delta_x, const Field3D &delta_z)
 {
   Field3D result;
 
@@ -193,7 +199,7 @@ const Field3D interpolate(const Field3D &var, const Field3D &delta_x, const Fiel
   result.allocate();
 
   // Get the pointers to the data, to make things a bit quicker
-  BoutReal ***de_x, ***de_z, ***f_data, ***r_data;
+  FieldReal ***de_x, ***de_z, ***f_data, ***r_data;
 
   de_x = delta_x.getData();
   de_z = delta_z.getData();
@@ -284,12 +290,12 @@ const Field3D interpolate(const Field3D &var, const Field3D &delta_x, const Fiel
   return result;
 }
 
-const Field3D interpolate(const Field2D &f, const Field3D &delta_x, const Field3D &delta_z)
+Field3D interpolate(const Field2D &f, const Field3D &delta_x, const Field3D &delta_z)
 {
   return interpolate(f, delta_x);
 }
 
-const Field3D interpolate(const Field2D &f, const Field3D &delta_x)
+Field3D interpolate(const Field2D &f, const Field3D &delta_x)
 {
   Field3D result;
 
@@ -297,7 +303,7 @@ const Field3D interpolate(const Field2D &f, const Field3D &delta_x)
 
   // Get the pointers to the data, to make things a bit quicker
   BoutReal **f_data;
-  BoutReal ***de_x, ***r_data;
+  FieldReal ***de_x, ***r_data;
 
   de_x = delta_x.getData();
   f_data = f.getData();
@@ -136,6 +136,13 @@ int QuiltMesh::load()
   }
 }
 
+MPI_Comm QuiltMesh::getXcomm()
+{
+  // Quilt regions are not arranged in rows of processors in X, so
+  // there is no communicator for the X-parallel Laplacian solvers
+  throw BoutException("QuiltMesh doesn't support X communicators\n");
+}
+
 const vector<int> QuiltMesh::readInts(const string &name, int n)
 {
   vector<int> result;
@@ -33,13 +33,13 @@
 #include <invert_laplace.hxx>
 
 /// Approximate G(f) = f + rho^2*Delp2(f) using Taylor expansion
-const Field3D gyroTaylor0(const Field3D &f, const Field3D &rho)
+Field3D gyroTaylor0(const Field3D &f, const Field3D &rho)
 {
   return f + rho^2 * Delp2(f);
 }
 
 /// Pade approximation G_0 = (1 - rho^2*Delp2)g = f
-const Field3D gyroPade0(const Field3D &f, BoutReal rho, int flags)
+Field3D gyroPade0(const Field3D &f, BoutReal rho, int flags)
 {
   /// Have to use Z average of rho for efficient inversion
   
@@ -51,7 +51,7 @@ const Field3D gyroPade0(const Field3D &f, BoutReal rho, int flags)
 }
 
 /// Pade approximation G_0 = (1 - rho^2*Delp2)g = f
-const Field3D gyroPade0(const Field3D &f, const Field2D &rho, int flags)
+Field3D gyroPade0(const Field3D &f, const Field2D &rho, int flags)
 {
   /// Have to use Z average of rho for efficient inversion
   
@@ -63,14 +63,14 @@ const Field3D gyroPade0(const Field3D &f, const Field2D &rho, int flags)
 }
 
 /// Pade approximation G_0 = (1 - rho^2*Delp2)g = f
-const Field3D gyroPade0(const Field3D &f, const Field3D &rho, int flags)
+Field3D gyroPade0(const Field3D &f, const Field3D &rho, int flags)
 {
   /// Have to use Z average of rho for efficient inversion
   return gyroPade0(f, rho.DC(), flags);
 }
 
 /// Pade approximation G_1 = (1 - 0.5*rho^2*Delp2)g = f
-const Field3D gyroPade1(const Field3D &f, BoutReal rho, int flags)
+Field3D gyroPade1(const Field3D &f, BoutReal rho, int flags)
 {
   Field2D a = 1.0;
   Field2D d = -0.5*rho*rho;
@@ -80,7 +80,7 @@ const Field3D gyroPade1(const Field3D &f, BoutReal rho, int flags)
 }
 
 /// Pade approximation G_1 = (1 - 0.5*rho^2*Delp2)g = f
-const Field3D gyroPade1(const Field3D &f, const Field2D &rho, int flags)
+Field3D gyroPade1(const Field3D &f, const Field2D &rho, int flags)
 {
   Field2D a = 1.0;
   Field2D d = -0.5*rho*rho;
@@ -90,14 +90,14 @@ const Field3D gyroPade1(const Field3D &f, const Field2D &rho, int flags)
 }
 
 /// Pade approximation G_1 = (1 - 0.5*rho^2*Delp2)g = f
-const Field3D gyroPade1(const Field3D &f, const Field3D &rho, int flags)
+Field3D gyroPade1(const Field3D &f, const Field3D &rho, int flags)
 {
   /// Have to use Z average of rho for efficient inversion
   return gyroPade1(f, rho.DC(), flags);
 }
 
 /// Pade approximation G_2 = (1 - 0.5*rho^2*Delp2)g = f
-const Field3D gyroPade2(const Field3D &f, BoutReal rho, int flags)
+Field3D gyroPade2(const Field3D &f, BoutReal rho, int flags)
 {
   Field3D result = gyroPade1(gyroPade1(f, rho, flags), rho, flags);
   mesh->communicate(result);
@@ -107,7 +107,7 @@ const Field3D gyroPade2(const Field3D &f, BoutReal rho, int flags)
 }
 
 /// Pade approximation G_2 = (1 - 0.5*rho^2*Delp2)g = f
-const Field3D gyroPade2(const Field3D &f, const Field2D &rho, int flags)
+Field3D gyroPade2(const Field3D &f, const Field2D &rho, int flags)
 {
   Field3D result = gyroPade1(gyroPade1(f, rho, flags), rho, flags);
   mesh->communicate(result);
@@ -117,7 +117,7 @@ const Field3D gyroPade2(const Field3D &f, const Field2D &rho, int flags)
 }
 
 /// Pade approximation G_2 = (1 - 0.5*rho^2*Delp2)g = f
-const Field3D gyroPade2(const Field3D &f, const Field3D &rho, int flags)
+Field3D gyroPade2(const Field3D &f, const Field3D &rho, int flags)
 {
   /// Have to use Z average of rho for efficient inversion
   return gyroPade2(f, rho.DC(), flags);
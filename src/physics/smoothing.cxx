@@ -34,7 +34,7 @@
 #include <bout_types.hxx>
 
 // Smooth using simple 1-2-1 filter
-const Field3D smooth_x(const Field3D &f, bool BoutRealspace)
+Field3D smooth_x(const Field3D &f, bool BoutRealspace)
 {
   Field3D fs, result;
 
@@ -70,7 +70,7 @@ const Field3D smooth_x(const Field3D &f, bool BoutRealspace)
 }
 
 
-const Field3D smooth_y(const Field3D &f)
+Field3D smooth_y(const Field3D &f)
 {
   Field3D result;
 
@@ -139,7 +139,7 @@ void nl_filter(rvec &f, BoutReal w)
   }
 }
 
-const Field3D nl_filter_x(const Field3D &f, BoutReal w)
+Field3D nl_filter_x(const Field3D &f, BoutReal w)
 {
 #ifdef CHECK
   msg_stack.push("nl_filter_x( Field3D )");
@@ -165,7 +165,7 @@ const Field3D nl_filter_x(const Field3D &f, BoutReal w)
   return result;
 }
 
-const Field3D nl_filter_y(const Field3D &fs, BoutReal w)
+Field3D nl_filter_y(const Field3D &fs, BoutReal w)
 {
 #ifdef CHECK
   msg_stack.push("nl_filter_x( Field3D )");
@@ -187,7 +187,7 @@ const Field3D nl_filter_y(const Field3D &fs, BoutReal w)
   return result;
 }
 
-const Field3D nl_filter_z(const Field3D &fs, BoutReal w)
+Field3D nl_filter_z(const Field3D &fs, BoutReal w)
 {
 #ifdef CHECK
   msg_stack.push("nl_filter_x( Field3D )");
@@ -209,7 +209,7 @@ const Field3D nl_filter_z(const Field3D &fs, BoutReal w)
   return result;
 }
 
-const Field3D nl_filter(const Field3D &f, BoutReal w)
+Field3D nl_filter(const Field3D &f, BoutReal w)
 {
   Field3D result;
   /// Perform filtering in Z, Y then X
@@ -74,7 +74,7 @@ const Field2D source_expx2(const Field2D &f,BoutReal swidth,BoutReal slength)
 }
 
 // create radial buffer zones to set jpar zero near radial boundaries
-const Field3D sink_tanhx(const Field2D &f0, const Field3D &f,BoutReal swidth,BoutReal slength, bool BoutRealspace)
+Field3D sink_tanhx(const Field2D &f0, const Field3D &f,BoutReal swidth,BoutReal slength, bool BoutRealspace)
 //const Field3D sink_tanhx(const Field2D &f0, const Field3D &f, bool BoutRealspace)
 {
   Field3D fs, result;
@@ -111,7 +111,7 @@ const Field3D sink_tanhx(const Field2D &f0, const Field3D &f,BoutReal swidth,Bou
 }
 
 // create radial buffer zones to set jpar zero near radial boundaries
-const Field3D mask_x(const Field3D &f, bool BoutRealspace)
+Field3D mask_x(const Field3D &f, bool BoutRealspace)
 {
   Field3D fs, result;
 
@@ -145,7 +145,7 @@ const Field3D mask_x(const Field3D &f, bool BoutRealspace)
 }
 
 // create radial buffer zones to set jpar zero near radial boundaries
-const Field3D sink_tanhxl(const Field2D &f0, const Field3D &f,BoutReal swidth,BoutReal slength, bool BoutRealspace)
+Field3D sink_tanhxl(const Field2D &f0, const Field3D &f,BoutReal swidth,BoutReal slength, bool BoutRealspace)
 {
   Field3D fs, result;
   Field2D fs0;
@@ -183,7 +183,7 @@ const Field3D sink_tanhxl(const Field2D &f0, const Field3D &f,BoutReal swidth,Bo
 }
 
 // create radial buffer zones to set jpar zero near radial boundaries
-const Field3D sink_tanhxr(const Field2D &f0, const Field3D &f,BoutReal swidth,BoutReal slength, bool BoutRealspace)
+Field3D sink_tanhxr(const Field2D &f0, const Field3D &f,BoutReal swidth,BoutReal slength, bool BoutRealspace)
 {
   Field3D fs, result;
   Field2D fs0;
@@ -220,7 +220,7 @@ const Field3D sink_tanhxr(const Field2D &f0, const Field3D &f,BoutReal swidth,Bo
 }
 
 // create radial buffer zones to damp Psi to zero near radial boundaries
-const Field3D buff_x(const Field3D &f, bool BoutRealspace)
+Field3D buff_x(const Field3D &f, bool BoutRealspace)
 {
   Field3D fs, result;
 
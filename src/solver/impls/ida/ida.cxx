@@ -378,7 +378,8 @@ void IdaSolver::pre(BoutReal t, BoutReal cj, BoutReal delta, BoutReal *udata, Bo
 /// Perform an operation at a given (jx,jy) location, moving data between BOUT++ and CVODE
 void IdaSolver::loop_vars_op(int jx, int jy, BoutReal *udata, int &p, SOLVER_VAR_OP op)
 {
-  BoutReal **d2d, ***d3d;
+  BoutReal **d2d;
+  FieldReal ***d3d;
   int i;
   int jz;
  
@@ -606,7 +607,7 @@ int IdaSolver::save_vars(BoutReal *udata)
       return(1);
 
   for(i=0;i<f3d.size();i++)
-    if(f3d[i].var->getData() == (BoutReal***) NULL)
+    if(f3d[i].var->getData() == (FieldReal***) NULL)
       return(1);
   
   // Make sure vectors in correct basis
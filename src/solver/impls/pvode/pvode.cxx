@@ -365,7 +365,8 @@ void PvodeSolver::gloc(int N, BoutReal t, BoutReal *udata, BoutReal *dudata)
 /// Perform an operation at a given (jx,jy) location, moving data between BOUT++ and CVODE
 void PvodeSolver::loop_vars_op(int jx, int jy, BoutReal *udata, int &p, SOLVER_VAR_OP op)
 {
-  BoutReal **d2d, ***d3d;
+  BoutReal **d2d;
+  FieldReal ***d3d;
   unsigned int i;
   int jz;
 
@@ -528,7 +529,7 @@ int PvodeSolver::save_vars(BoutReal *udata)
       return(1);
 
   for(i=0;i<f3d.size();i++)
-    if(f3d[i].var->getData() == (BoutReal***) NULL)
+    if(f3d[i].var->getData() == (FieldReal***) NULL)
       return(1);
   
   // Make sure vectors in correct basis
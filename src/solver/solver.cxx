@@ -26,6 +26,7 @@
 
 #include <initialprofiles.hxx>
 #include <interpolation.hxx>
+#include <deriv_cache.hxx>
 
 #include "solverfactory.hxx"
 
@@ -560,7 +561,8 @@ Solver* Solver::Create()
 /// Perform an operation at a given (jx,jy) location, moving data between BOUT++ and CVODE
 void Solver::loop_vars_op(int jx, int jy, BoutReal *udata, int &p, SOLVER_VAR_OP op)
 {
-  BoutReal **d2d, ***d3d;
+  BoutReal **d2d;
+  FieldReal ***d3d;
   int i;
   int jz;
  
@@ -755,7 +757,7 @@ int Solver::save_vars(BoutReal *udata)
       return(1);
 
   for(i=0;i<f3d.size();i++)
-    if(f3d[i].var->getData() == (BoutReal***) NULL)
+    if(f3d[i].var->getData() == (FieldReal***) NULL)
       return(1);
   
   // Make sure vectors in correct basis
@@ -894,7 +896,10 @@ int Solver::run_diffusive(BoutReal t)
 
 int Solver::run_func(BoutReal t, rhsfunc f)
 {
+  // Cached derivatives are only valid within one evaluation
+  deriv_cache_clear();
   int status = (*f)(t);
+  deriv_cache_clear();
 
   // Make sure vectors in correct basis
   for(int i=0;i<v2d.size();i++) {
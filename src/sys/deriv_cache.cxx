@@ -0,0 +1,118 @@
+/**************************************************************************
+ * Cache of derivative results within one RHS evaluation
+ *
+ **************************************************************************
+ * Copyright 2010 B.D.Dudson, S.Farley, M.V.Umansky, X.Q.Xu
+ *
+ * Contact: Ben Dudson, bd512@york.ac.uk
+ *
+ * This file is part of BOUT++.
+ *
+ * BOUT++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BOUT++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BOUT++.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **************************************************************************/
+
+#include <globals.hxx>
+#include <deriv_cache.hxx>
+#include <options.hxx>
+
+#include <vector>
+using std::vector;
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/// One cached result
+struct DerivCacheEntry {
+  DerivCacheOp op;
+  unsigned long version;
+  CELL_LOC inloc, outloc;
+  int method;
+  BoutReal param;
+
+  Field3D input;  ///< Keeps the input data from being changed in place
+  Field3D result;
+};
+
+static bool cache_enabled = false;
+static vector<DerivCacheEntry*> cache;
+
+/// Most results kept. Stops a long RHS holding on to too much memory
+static const int cache_max = 32;
+
+/// The cache is shared, so only used outside parallel regions
+static inline bool cache_usable()
+{
+#ifdef _OPENMP
+  if(omp_in_parallel())
+    return false;
+#endif
+  return cache_enabled;
+}
+
+void deriv_cache_init()
+{
+  Options *options = Options::getRoot();
+  options->get("deriv_cache", cache_enabled, false);
+
+  if(cache_enabled)
+    output.write("\tCaching derivatives within each RHS evaluation\n");
+}
+
+bool deriv_cache_get(DerivCacheOp op, const Field3D &f, CELL_LOC outloc,
+                     int method, BoutReal param, Field3D &result)
+{
+  if(!cache_usable() || !f.isAllocated())
+    return false;
+
+  unsigned long version = f.version();
+  CELL_LOC inloc = f.getLocation();
+
+  for(vector<DerivCacheEntry*>::iterator it = cache.begin(); it != cache.end(); it++) {
+    DerivCacheEntry *e = *it;
+    if((e->version == version) && (e->op == op) && (e->method == method) &&
+       (e->param == param) && (e->inloc == inloc) && (e->outloc == outloc)) {
+      result = e->result;
+      return true;
+    }
+  }
+  return false;
+}
+
+void deriv_cache_put(DerivCacheOp op, const Field3D &f, CELL_LOC outloc,
+                     int method, BoutReal param, const Field3D &result)
+{
+  if(!cache_usable() || !f.isAllocated() || ((int) cache.size() >= cache_max))
+    return;
+
+  DerivCacheEntry *e = new DerivCacheEntry;
+  e->op = op;
+  e->version = f.version();
+  e->inloc = f.getLocation();
+  e->outloc = outloc;
+  e->method = method;
+  e->param = param;
+  e->input = f;
+  e->result = result;
+
+  cache.push_back(e);
+}
+
+void deriv_cache_clear()
+{
+  for(vector<DerivCacheEntry*>::iterator it = cache.begin(); it != cache.end(); it++)
+    delete *it;
+  cache.clear();
+}
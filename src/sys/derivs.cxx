@@ -44,6 +44,8 @@
 #include <utils.hxx>
 #include <fft.hxx>
 #include <interpolation.hxx>
+#include <boutexception.hxx>
+#include <deriv_cache.hxx>
 
 #include <math.h>
 #include <string.h>
@@ -53,13 +55,19 @@
 #include <omp.h>
 #endif
 
-typedef BoutReal (*deriv_func)(stencil &); // f
-typedef BoutReal (*upwind_func)(stencil &, stencil &); // v, f
+
+/// Values of a stencil, without indices. Passed to the differencing methods
+struct sval {
+  BoutReal mm, m, c, p, pp;
+};
 
 /*******************************************************************************
  * Basic derivative methods.
  * All expect to have an input grid cell at the same location as the output
  * Hence convert cell centred values -> centred values, or left -> left
+ *
+ * Each method is a struct with a static apply() function, so that it
+ * can be inlined into the whole-field kernels further down.
  *******************************************************************************/
 
 const BoutReal WENO_SMALL = 1.0e-8; // Small number for WENO schemes
@@ -67,71 +75,136 @@ const BoutReal WENO_SMALL = 1.0e-8; // Small number for WENO schemes
 ////////////////////// FIRST DERIVATIVES /////////////////////
 
 /// central, 2nd order
-BoutReal DDX_C2(stencil &f) {
-  return 0.5*(f.p - f.m);
-}
+struct DDX_C2 {
+  static inline BoutReal apply(const sval &f) {
+    return 0.5*(f.p - f.m);
+  }
+};
 
 /// central, 4th order
-BoutReal DDX_C4(stencil &f) {
-  return (8.*f.p - 8.*f.m + f.mm - f.pp)/12.;
-}
+struct DDX_C4 {
+  static inline BoutReal apply(const sval &f) {
+    return (8.*f.p - 8.*f.m + f.mm - f.pp)/12.;
+  }
+};
 
 /// Central WENO method, 2nd order (reverts to 1st order near shocks)
-BoutReal DDX_CWENO2(stencil &f) {
-  BoutReal isl, isr, isc; // Smoothness indicators
-  BoutReal al, ar, ac, sa; // Un-normalised weights
-  BoutReal dl, dr, dc; // Derivatives using different stencils
-  
-  dc = 0.5*(f.p - f.m);
-  dl = f.c - f.m;
-  dr = f.p - f.c;
-  
-  isl = SQ(dl);
-  isr = SQ(dr);
-  isc = (13./3.)*SQ(f.p - 2.*f.c + f.m) + 0.25*SQ(f.p-f.m);
-  
-  al = 0.25/SQ(WENO_SMALL + isl);
-  ar = 0.25/SQ(WENO_SMALL + isr);
-  ac = 0.5/SQ(WENO_SMALL + isc);
-  sa = al + ar + ac;
+struct DDX_CWENO2 {
+  static inline BoutReal apply(const sval &f) {
+    BoutReal isl, isr, isc; // Smoothness indicators
+    BoutReal al, ar, ac, sa; // Un-normalised weights
+    BoutReal dl, dr, dc; // Derivatives using different stencils
+    
+    dc = 0.5*(f.p - f.m);
+    dl = f.c - f.m;
+    dr = f.p - f.c;
+    
+    isl = SQ(dl);
+    isr = SQ(dr);
+    isc = (13./3.)*SQ(f.p - 2.*f.c + f.m) + 0.25*SQ(f.p-f.m);
+    
+    al = 0.25/SQ(WENO_SMALL + isl);
+    ar = 0.25/SQ(WENO_SMALL + isr);
+    ac = 0.5/SQ(WENO_SMALL + isc);
+    sa = al + ar + ac;
 
-  return (al*dl + ar*dr + ac*dc)/sa;
-}
+    return (al*dl + ar*dr + ac*dc)/sa;
+  }
+};
 
 ///////////////////// SECOND DERIVATIVES ////////////////////
 
 /// Second derivative: Central, 2nd order
-BoutReal D2DX2_C2(stencil &f) {
-  return f.p + f.m - 2.*f.c;
-}
+struct D2DX2_C2 {
+  static inline BoutReal apply(const sval &f) {
+    return f.p + f.m - 2.*f.c;
+  }
+};
 
 /// Second derivative: Central, 4th order
-BoutReal D2DX2_C4(stencil &f) {
-  return (-f.pp + 16.*f.p - 30.*f.c + 16.*f.m - f.mm)/12.;
-}
+struct D2DX2_C4 {
+  static inline BoutReal apply(const sval &f) {
+    return (-f.pp + 16.*f.p - 30.*f.c + 16.*f.m - f.mm)/12.;
+  }
+};
+
+///////////////////// COMPACT (PADE) SCHEMES ////////////////////
+/*
+ * Implicit schemes of the form
+ *
+ *   alpha*f'[i-1] + f'[i] + alpha*f'[i+1] = apply(f around i)
+ *
+ * solved along whole lines by compactKernel below. The explicit
+ * Closure is used at the ends of lines in X and Y, so only the
+ * guard cells are needed and lines don't cross processors.
+ */
+
+/// First derivative: Compact, 4th order
+struct DDX_P4 {
+  typedef DDX_C4 Closure;
+  static inline BoutReal alpha() { return 0.25; }
+  static inline BoutReal apply(const sval &f) {
+    return 0.75*(f.p - f.m);
+  }
+};
+
+/// First derivative: Compact, 6th order
+struct DDX_P6 {
+  typedef DDX_C4 Closure;
+  static inline BoutReal alpha() { return 1./3.; }
+  static inline BoutReal apply(const sval &f) {
+    return (7./9.)*(f.p - f.m) + (1./36.)*(f.pp - f.mm);
+  }
+};
+
+/// Second derivative: Compact, 4th order
+struct D2DX2_P4 {
+  typedef D2DX2_C4 Closure;
+  static inline BoutReal alpha() { return 0.1; }
+  static inline BoutReal apply(const sval &f) {
+    return 1.2*(f.p + f.m - 2.*f.c);
+  }
+};
+
+/// Second derivative: Compact, 6th order
+struct D2DX2_P6 {
+  typedef D2DX2_C4 Closure;
+  static inline BoutReal alpha() { return 2./11.; }
+  static inline BoutReal apply(const sval &f) {
+    return (12./11.)*(f.p + f.m - 2.*f.c) + (3./44.)*(f.pp + f.mm - 2.*f.c);
+  }
+};
 
 //////////////////////// UPWIND METHODS ///////////////////////
 
 /// Upwinding: Central, 2nd order
-BoutReal VDDX_C2(stencil &v, stencil &f) {
-  return v.c*0.5*(f.p - f.m);
-}
+struct VDDX_C2 {
+  static inline BoutReal apply(const sval &v, const sval &f) {
+    return v.c*0.5*(f.p - f.m);
+  }
+};
 
 /// Upwinding: Central, 4th order
-BoutReal VDDX_C4(stencil &v, stencil &f) {
-  return v.c*(8.*f.p - 8.*f.m + f.mm - f.pp)/12.;
-}
+struct VDDX_C4 {
+  static inline BoutReal apply(const sval &v, const sval &f) {
+    return v.c*(8.*f.p - 8.*f.m + f.mm - f.pp)/12.;
+  }
+};
 
 /// upwind, 1st order
-BoutReal VDDX_U1(stencil &v, stencil &f) {
-  return v.c>=0.0 ? v.c*(f.c - f.m): v.c*(f.p - f.c);
-}
+struct VDDX_U1 {
+  static inline BoutReal apply(const sval &v, const sval &f) {
+    return v.c>=0.0 ? v.c*(f.c - f.m): v.c*(f.p - f.c);
+  }
+};
 
 /// upwind, 4th order
-BoutReal VDDX_U4(stencil &v, stencil &f) {
-  return v.c >= 0.0 ? v.c*(4.*f.p - 12.*f.m + 2.*f.mm + 6.*f.c)/12.
-    : v.c*(-4.*f.m + 12.*f.p - 2.*f.pp - 6.*f.c)/12.;
-}
+struct VDDX_U4 {
+  static inline BoutReal apply(const sval &v, const sval &f) {
+    return v.c >= 0.0 ? v.c*(4.*f.p - 12.*f.m + 2.*f.mm + 6.*f.c)/12.
+      : v.c*(-4.*f.m + 12.*f.p - 2.*f.pp - 6.*f.c)/12.;
+  }
+};
 
 /// Van Leer limiter. Used in TVD code
 BoutReal VANLEER(BoutReal r) {
@@ -180,104 +253,117 @@ BoutReal VDDX_TVD(BoutReal vc, BoutReal vm, BoutReal vp, BoutReal fc, BoutReal f
 }
 
 /// 3rd-order WENO scheme
-BoutReal VDDX_WENO3(stencil &v, stencil &f) {
-  BoutReal deriv, w, r;
+struct VDDX_WENO3 {
+  static inline BoutReal apply(const sval &v, const sval &f) {
+    BoutReal deriv, w, r;
 
-  if(v.c > 0.0) {
-    // Left-biased stencil
+    if(v.c > 0.0) {
+      // Left-biased stencil
     
-    r = (WENO_SMALL + SQ(f.c - 2.0*f.m + f.mm)) / (WENO_SMALL + SQ(f.p - 2.0*f.c + f.m));
-    w = 1.0 / (1.0 + 2.0*r*r);
+      r = (WENO_SMALL + SQ(f.c - 2.0*f.m + f.mm)) / (WENO_SMALL + SQ(f.p - 2.0*f.c + f.m));
+      w = 1.0 / (1.0 + 2.0*r*r);
 
-    deriv = 0.5*(f.p - f.m) - 0.5*w*(-f.mm + 3.*f.m - 3.*f.c + f.p);
+      deriv = 0.5*(f.p - f.m) - 0.5*w*(-f.mm + 3.*f.m - 3.*f.c + f.p);
     
-  }else {
-    // Right-biased
+    }else {
+      // Right-biased
     
-    r = (WENO_SMALL + SQ(f.pp - 2.0*f.p + f.c)) / (WENO_SMALL + SQ(f.p - 2.0*f.c + f.m));
-    w = 1.0 / (1.0 + 2.0*r*r);
+      r = (WENO_SMALL + SQ(f.pp - 2.0*f.p + f.c)) / (WENO_SMALL + SQ(f.p - 2.0*f.c + f.m));
+      w = 1.0 / (1.0 + 2.0*r*r);
     
-    deriv = 0.5*(f.p - f.m) - 0.5*w*( -f.m + 3.*f.c - 3.*f.p + f.pp );
-  }
+      deriv = 0.5*(f.p - f.m) - 0.5*w*( -f.m + 3.*f.c - 3.*f.p + f.pp );
+    }
 
-  return v.c*deriv;
-}
+    return v.c*deriv;
+  }
+};
 
 /// 3rd-order CWENO. Uses the upwinding code and split flux
-BoutReal DDX_CWENO3(stencil &f) {
-  BoutReal a, ma = fabs(f.c);
-  // Split flux
-  a = fabs(f.m); if(a > ma) ma = a;
-  a = fabs(f.p); if(a > ma) ma = a;
-  a = fabs(f.mm); if(a > ma) ma = a;
-  a = fabs(f.pp); if(a > ma) ma = a;
+struct DDX_CWENO3 {
+  static inline BoutReal apply(const sval &f) {
+    BoutReal a, ma = fabs(f.c);
+    // Split flux
+    a = fabs(f.m); if(a > ma) ma = a;
+    a = fabs(f.p); if(a > ma) ma = a;
+    a = fabs(f.mm); if(a > ma) ma = a;
+    a = fabs(f.pp); if(a > ma) ma = a;
   
-  stencil sp, vp, sm, vm;
+    sval sp, vp, sm, vm;
   
-  vp.c = 0.5; vm.c = -0.5;
+    vp.mm = vp.m = vp.c = vp.p = vp.pp = 0.5;
+    vm.mm = vm.m = vm.c = vm.p = vm.pp = -0.5;
   
-  sp = f + ma;
-  sm = ma - f;
+    sp.mm = f.mm + ma; sp.m = f.m + ma; sp.c = f.c + ma; sp.p = f.p + ma; sp.pp = f.pp + ma;
+    sm.mm = ma - f.mm; sm.m = ma - f.m; sm.c = ma - f.c; sm.p = ma - f.p; sm.pp = ma - f.pp;
   
-  return VDDX_WENO3(vp, sp) + VDDX_WENO3(vm, sm);
-}
+    return VDDX_WENO3::apply(vp, sp) + VDDX_WENO3::apply(vm, sm);
+  }
+};
 
 //////////////////////// FLUX METHODS ///////////////////////
 
-BoutReal FDDX_U1(stencil &v, stencil &f) {
-  // Velocity at lower end
-  BoutReal vs = 0.5*(v.m + v.c);
-  BoutReal result = (vs >= 0.0) ? vs * f.m : vs * f.c;
-  // and at upper 
-  vs = 0.5*(v.c + v.p);
-  result -= (vs >= 0.0) ? vs * f.c : vs * f.p;
+struct FDDX_U1 {
+  static inline BoutReal apply(const sval &v, const sval &f) {
+    // Velocity at lower end
+    BoutReal vs = 0.5*(v.m + v.c);
+    BoutReal result = (vs >= 0.0) ? vs * f.m : vs * f.c;
+    // and at upper 
+    vs = 0.5*(v.c + v.p);
+    result -= (vs >= 0.0) ? vs * f.c : vs * f.p;
 
-  return result;
-}
+    return result;
+  }
+};
 
-BoutReal FDDX_C2(stencil &v, stencil &f) {
-  return 0.5*(v.p*f.p - v.m*f.m);
-}
+struct FDDX_C2 {
+  static inline BoutReal apply(const sval &v, const sval &f) {
+    return 0.5*(v.p*f.p - v.m*f.m);
+  }
+};
 
-BoutReal FDDX_C4(stencil &v, stencil &f) {
-  return (8.*v.p*f.p - 8.*v.m*f.m + v.mm*f.mm - v.pp*f.pp)/12.;
-}
+struct FDDX_C4 {
+  static inline BoutReal apply(const sval &v, const sval &f) {
+    return (8.*v.p*f.p - 8.*v.m*f.m + v.mm*f.mm - v.pp*f.pp)/12.;
+  }
+};
 
 /// Non-oscillatory, containing No free parameters and Dissipative (NND) scheme
 /// http://arxiv.org/abs/1010.4135v1
-BoutReal FDDX_NND(stencil &v, stencil &f) {
-  // f{+-} i
-  BoutReal fp = 0.5*(v.c + fabs(v.c))*f.c;
-  BoutReal fm = 0.5*(v.c - fabs(v.c))*f.c;
+struct FDDX_NND {
+  static inline BoutReal apply(const sval &v, const sval &f) {
+    // f{+-} i
+    BoutReal fp = 0.5*(v.c + fabs(v.c))*f.c;
+    BoutReal fm = 0.5*(v.c - fabs(v.c))*f.c;
   
-  // f{+-} i+1
-  BoutReal fp1 = 0.5*(v.p + fabs(v.p))*f.p;
-  BoutReal fm1 = 0.5*(v.p - fabs(v.p))*f.p;
+    // f{+-} i+1
+    BoutReal fp1 = 0.5*(v.p + fabs(v.p))*f.p;
+    BoutReal fm1 = 0.5*(v.p - fabs(v.p))*f.p;
   
-  // f{+-} i+2
-  BoutReal fm2 = 0.5*(v.pp - fabs(v.pp))*f.pp;
+    // f{+-} i+2
+    BoutReal fm2 = 0.5*(v.pp - fabs(v.pp))*f.pp;
 
-  // f{+-} i-1
-  BoutReal fp_1 = 0.5*(v.m + fabs(v.m))*f.m;
-  BoutReal fm_1 = 0.5*(v.m - fabs(v.m))*f.m;
+    // f{+-} i-1
+    BoutReal fp_1 = 0.5*(v.m + fabs(v.m))*f.m;
+    BoutReal fm_1 = 0.5*(v.m - fabs(v.m))*f.m;
   
-  // f{+-} i-2
-  BoutReal fp_2 = 0.5*(v.mm + fabs(v.mm))*f.mm;
+    // f{+-} i-2
+    BoutReal fp_2 = 0.5*(v.mm + fabs(v.mm))*f.mm;
 
-  // f^{LR} {i+1/2}
-  BoutReal flp = fp  + 0.5*MINMOD(fp1 - fp, fp - fp_1);
-  BoutReal frp = fm1 - 0.5*MINMOD(fm1 - fm, fm2 - fm1);
+    // f^{LR} {i+1/2}
+    BoutReal flp = fp  + 0.5*MINMOD(fp1 - fp, fp - fp_1);
+    BoutReal frp = fm1 - 0.5*MINMOD(fm1 - fm, fm2 - fm1);
   
-  // f^{LR} {i-1/2}
-  BoutReal flm = fp_1  + 0.5*MINMOD(fp - fp_1, fp_1 - fp_2);
-  BoutReal frm = fm - 0.5*MINMOD(fm - fm_1, fm1 - fm);
+    // f^{LR} {i-1/2}
+    BoutReal flm = fp_1  + 0.5*MINMOD(fp - fp_1, fp_1 - fp_2);
+    BoutReal frm = fm - 0.5*MINMOD(fm - fm_1, fm1 - fm);
     
-  // h{+-}
-  BoutReal hp = flp + frp;
-  BoutReal hm = flm + frm; 
+    // h{+-}
+    BoutReal hp = flp + frp;
+    BoutReal hm = flm + frm; 
   
-  return hp - hm;
-}
+    return hp - hm;
+  }
+};
 
 /*******************************************************************************
  * Staggered differencing methods
@@ -300,20 +386,26 @@ BoutReal FDDX_NND(stencil &v, stencil &f) {
 // Map Centre -> Low or Low -> Centre
 
 // Second order differencing (staggered)
-BoutReal DDX_C2_stag(stencil &f) {
-  return f.p - f.m;
-}
+struct DDX_C2_stag {
+  static inline BoutReal apply(const sval &f) {
+    return f.p - f.m;
+  }
+};
 
-BoutReal DDX_C4_stag(stencil &f) {
-  return ( 27.*(f.p - f.m) - (f.pp - f.mm) ) / 24.;
-}
+struct DDX_C4_stag {
+  static inline BoutReal apply(const sval &f) {
+    return ( 27.*(f.p - f.m) - (f.pp - f.mm) ) / 24.;
+  }
+};
 
 /////////////////////// SECOND DERIVATIVES //////////////////////
 // Map Centre -> Low or Low -> Centre
 
-BoutReal D2DX2_C4_stag(stencil &f) {
-  return ( f.pp + f.mm - f.p - f.m ) / 2.;
-}
+struct D2DX2_C4_stag {
+  static inline BoutReal apply(const sval &f) {
+    return ( f.pp + f.mm - f.p - f.m ) / 2.;
+  }
+};
 
 /////////////////////////// UPWINDING ///////////////////////////
 // Map (Low, Centre) -> Centre  or (Centre, Low) -> Low
@@ -321,18 +413,20 @@ BoutReal D2DX2_C4_stag(stencil &f) {
 //
 // v.p is v at +1/2, v.m is at -1/2
 
-BoutReal VDDX_U1_stag(stencil &v, stencil &f) {
-  // Lower cell boundary
-  BoutReal result = (v.m >= 0) ? v.m * f.m : v.m * f.c;
+struct VDDX_U1_stag {
+  static inline BoutReal apply(const sval &v, const sval &f) {
+    // Lower cell boundary
+    BoutReal result = (v.m >= 0) ? v.m * f.m : v.m * f.c;
   
-  // Upper cell boundary
-  result -= (v.p >= 0) ? v.p * f.c : v.p * f.p;
+    // Upper cell boundary
+    result -= (v.p >= 0) ? v.p * f.c : v.p * f.p;
   
-  // result is now d/dx(v*f), but want v*d/dx(f) so subtract f*d/dx(v)
-  result -= f.c*(v.p - v.m);
+    // result is now d/dx(v*f), but want v*d/dx(f) so subtract f*d/dx(v)
+    result -= f.c*(v.p - v.m);
   
-  return result;
-}
+    return result;
+  }
+};
 
 /////////////////////////// FLUX ///////////////////////////
 // Map (Low, Centre) -> Centre  or (Centre, Low) -> Low
@@ -340,16 +434,785 @@ BoutReal VDDX_U1_stag(stencil &v, stencil &f) {
 //
 // v.p is v at +1/2, v.m is at -1/2
 
-BoutReal FDDX_U1_stag(stencil &v, stencil &f) {
-  // Lower cell boundary
-  BoutReal result = (v.m >= 0) ? v.m * f.m : v.m * f.c;
+struct FDDX_U1_stag {
+  static inline BoutReal apply(const sval &v, const sval &f) {
+    // Lower cell boundary
+    BoutReal result = (v.m >= 0) ? v.m * f.m : v.m * f.c;
   
-  // Upper cell boundary
-  result -= (v.p >= 0) ? v.p * f.c : v.p * f.p;
+    // Upper cell boundary
+    result -= (v.p >= 0) ? v.p * f.c : v.p * f.p;
 
-  return result;
+    return result;
+  }
+};
+
+/*******************************************************************************
+ * Whole-field kernels
+ *
+ * For each method above, the templates below instantiate a kernel per
+ * direction which loops over the lines in Z of a region. Each stencil
+ * point is a pointer to the start of a line, read with a constant stride
+ * (staggering just swaps the pointers), so the method is inlined and the
+ * Z loop has no calls or branches on the grid.
+ *
+ * Shifted X derivatives (ShiftXderivs with ShiftOrder != 0) interpolate
+ * the X neighbours in Z. The Z offset only depends on X and Y, so whole
+ * neighbouring lines are interpolated into a buffer, then differenced
+ * the same way.
+ *******************************************************************************/
+
+enum DIFF_DIR {DIFF_DIR_X, DIFF_DIR_Y, DIFF_DIR_Z};
+
+/// Offsets of the stencil points from the centre, in the contiguous data
+struct soffset {
+  int mm, m, p, pp;
+};
+
+/// Start of each line in a stencil
+template<typename T>
+struct sline {
+  const T *mm, *m, *c, *p, *pp;
+};
+
+/// How a stencil is shifted on staggered grids
+enum STAGGER {STAGGER_NONE,  ///< Centred on the input cell
+              STAGGER_DOWN,  ///< Centre -> Low: pp = p, p = c
+              STAGGER_UP};   ///< Low -> Centre: mm = m, m = c
+
+/// Same logic as Field3D::set*Stencil
+static STAGGER staggerType(CELL_LOC location, CELL_LOC loc, int dir)
+{
+  if(!mesh->StaggerGrids || (loc == CELL_DEFAULT) || (loc == location))
+    return STAGGER_NONE;
+  
+  CELL_LOC low = (dir == DIFF_DIR_X) ? CELL_XLOW : ((dir == DIFF_DIR_Y) ? CELL_YLOW : CELL_ZLOW);
+  if((location == CELL_CENTRE) && (loc == low))
+    return STAGGER_DOWN;
+  if(location == low)
+    return STAGGER_UP;
+  return STAGGER_NONE;
 }
 
+template<typename T>
+static inline void applyStagger(sline<T> &l, STAGGER st)
+{
+  if(st == STAGGER_DOWN) {
+    l.pp = l.p;
+    l.p  = l.c;
+  }else if(st == STAGGER_UP) {
+    l.mm = l.m;
+    l.m  = l.c;
+  }
+}
+
+/// Offsets for line bx in X or Y, for data with strides sx and sy
+template<int D>
+static inline soffset lineOffsets(const bindex &bx, int sx, int sy)
+{
+  soffset o;
+  if(D == DIFF_DIR_X) {
+    o.mm = (bx.jx2m - bx.jx)*sx;
+    o.m  = (bx.jxm  - bx.jx)*sx;
+    o.p  = (bx.jxp  - bx.jx)*sx;
+    o.pp = (bx.jx2p - bx.jx)*sx;
+  }else {
+    o.mm = (bx.jy2m - bx.jy)*sy;
+    o.m  = (bx.jym  - bx.jy)*sy;
+    o.p  = (bx.jyp  - bx.jy)*sy;
+    o.pp = (bx.jy2p - bx.jy)*sy;
+  }
+  return o;
+}
+
+/// Periodic Z offsets for point jz, scaled by the Z stride zs (0 for Field2D)
+static inline soffset zOffsets(int jz, int ncz, int zs)
+{
+  soffset o;
+  o.mm = ((jz + 2*ncz - 2) % ncz - jz)*zs;
+  o.m  = ((jz + ncz - 1) % ncz - jz)*zs;
+  o.p  = ((jz + 1) % ncz - jz)*zs;
+  o.pp = ((jz + 2) % ncz - jz)*zs;
+  return o;
+}
+
+/// True if point jz is away from the ends, so Z neighbours don't wrap around
+static inline bool zInterior(int jz, int ncz)
+{
+  return (ncz > 4) && (jz >= 2) && (jz < ncz-2);
+}
+
+template<typename T>
+static inline sline<T> makeLine(const T *c, const soffset &o)
+{
+  sline<T> l;
+  l.mm = c + o.mm; l.m = c + o.m; l.c = c; l.p = c + o.p; l.pp = c + o.pp;
+  return l;
+}
+
+/// Interpolate line f in Z by zoffset grid points, as Field3D::interpZ
+static void shiftLine(FieldReal *r, const FieldReal *f, BoutReal zoffset, int order, int ncz)
+{
+  int zi = ROUND(zoffset);
+  zoffset -= (BoutReal) zi;
+  if((zoffset < 0.0) && (order > 1)) {
+    zi--;
+    zoffset += 1.0;
+  }
+  zi = ((zi % ncz) + ncz) % ncz;
+
+  // Weights for points jz-1 .. jz+2
+  BoutReal w[4] = {0., 1., 0., 0.};
+  switch(order) {
+  case 2: {
+    w[1] = 1.0 - zoffset;
+    w[2] = zoffset;
+    break;
+  }
+  case 3: {
+    w[0] = 0.5*zoffset*(zoffset-1.0);
+    w[1] = 1.0 - zoffset*zoffset;
+    w[2] = 0.5*zoffset*(zoffset + 1.0);
+    break;
+  }
+  case 4: {
+    w[0] = -zoffset*(zoffset-1.0)*(zoffset-2.0)/6.0;
+    w[1] = 0.5*(zoffset*zoffset - 1.0)*(zoffset-2.0);
+    w[2] = -0.5*zoffset*(zoffset+1.0)*(zoffset-2.0);
+    w[3] = zoffset*(zoffset*zoffset - 1.0)/6.0;
+    break;
+  }
+  }
+
+  for(int jz=0;jz<ncz;jz++) {
+    int j0 = (jz + zi) % ncz;
+    r[jz] = w[0]*f[(j0 + ncz - 1) % ncz] + w[1]*f[j0] + w[2]*f[(j0 + 1) % ncz] + w[3]*f[(j0 + 2) % ncz];
+  }
+}
+
+/// X stencil lines for bx, with the neighbours shifted in Z into buf (size 4*ncz).
+/// Uses the same points as Field3D::setXStencil
+static sline<FieldReal> shiftedXLines(const FieldReal *f, const bindex &bx, FieldReal *buf)
+{
+  int ncz = mesh->ngz-1;
+  int order = mesh->ShiftOrder;
+  
+  shiftLine(buf,       f + Field3D::index(bx.jxm, bx.jy, 0), bx.x2m_offset, order, ncz);
+  shiftLine(buf+ncz,   f + Field3D::index(bx.jxm, bx.jy, 0), bx.xm_offset,  order, ncz);
+  shiftLine(buf+2*ncz, f + Field3D::index(bx.jxp, bx.jy, 0), bx.xp_offset,  order, ncz);
+  shiftLine(buf+3*ncz, f + Field3D::index(bx.jxp, bx.jy, 0), bx.x2p_offset, order, ncz);
+
+  sline<FieldReal> l;
+  l.mm = buf; l.m = buf+ncz; l.c = f + Field3D::index(bx.jx, bx.jy, 0); l.p = buf+2*ncz; l.pp = buf+3*ncz;
+  return l;
+}
+
+/// r[i] = S(f around i) / h for n points of a line
+template<typename S>
+static inline void derivLine(FieldReal *r, const sline<FieldReal> &f, int n, BoutReal h)
+{
+  for(int i=0;i<n;i++) {
+    sval s;
+    s.mm = f.mm[i]; s.m = f.m[i]; s.c = f.c[i]; s.p = f.p[i]; s.pp = f.pp[i];
+    r[i] = S::apply(s) / h;
+  }
+}
+
+/// As derivLine, for upwind and flux methods. VS and FS are the Z strides
+/// of v and f, 0 for a Field2D which is constant along the line
+template<typename S, int VS, int FS, typename VT, typename FT>
+static inline void upwindLine(FieldReal *r, const sline<VT> &v, const sline<FT> &f, int n, BoutReal h)
+{
+  for(int i=0;i<n;i++) {
+    sval vs, fs;
+    vs.mm = v.mm[i*VS]; vs.m = v.m[i*VS]; vs.c = v.c[i*VS]; vs.p = v.p[i*VS]; vs.pp = v.pp[i*VS];
+    fs.mm = f.mm[i*FS]; fs.m = f.m[i*FS]; fs.c = f.c[i*FS]; fs.p = f.p[i*FS]; fs.pp = f.pp[i*FS];
+    r[i] = S::apply(vs, fs) / h;
+  }
+}
+
+/// True if X derivatives need neighbours interpolated in Z
+static inline bool shiftedX(int dir)
+{
+  return (dir == DIFF_DIR_X) && mesh->ShiftXderivs && (mesh->ShiftOrder != 0);
+}
+
+/// r = S(f) / dz for a periodic line of ncz points in Z
+template<typename S>
+static void derivZLine(FieldReal *r, const FieldReal *f, int ncz, BoutReal dz, STAGGER st)
+{
+  if(ncz > 4) {
+    soffset o = {-2, -1, 1, 2};
+    sline<FieldReal> l = makeLine(f+2, o);
+    applyStagger(l, st);
+    derivLine<S>(r+2, l, ncz-4, dz);
+  }
+  for(int jz=0;jz<ncz;jz++) {
+    if(zInterior(jz, ncz))
+      continue;
+    sline<FieldReal> l = makeLine(f+jz, zOffsets(jz, ncz, 1));
+    applyStagger(l, st);
+    derivLine<S>(r+jz, l, 1, dz);
+  }
+}
+
+/// Single argument kernel for Field3D. dd is the grid spacing in X or Y, dz in Z
+template<typename S, int D>
+void derivKernel(const Field3D &var, CELL_LOC loc, REGION region, BoutReal **dd, BoutReal dz, Field3D &result)
+{
+  const Region &rgn = getRegion(region);
+  int ncz = mesh->ngz-1;
+
+  result.allocate();
+  FieldReal *r = result.getRaw();
+  const FieldReal *f = var.readRaw();
+#ifdef CHECK
+  if(f == NULL)
+    throw BoutException("Differencing empty Field3D\n");
+#endif
+  STAGGER st = staggerType(var.getLocation(), loc, D);
+  int sx = Field3D::index(1,0,0), sy = Field3D::index(0,1,0);
+  bool shift = shiftedX(D);
+
+  #pragma omp parallel
+  {
+    FieldReal *buf = shift ? new FieldReal[4*ncz] : NULL;
+    
+    #pragma omp for schedule(static)
+    for(int i=0;i<rgn.size();i++) {
+      const bindex &bx = rgn[i];
+      int c = Field3D::index(bx.jx, bx.jy, 0);
+      
+      if(D != DIFF_DIR_Z) {
+        sline<FieldReal> l;
+        if(shift) {
+          l = shiftedXLines(f, bx, buf);
+        }else
+          l = makeLine(f+c, lineOffsets<D>(bx, sx, sy));
+        applyStagger(l, st);
+        derivLine<S>(r+c, l, ncz, dd[bx.jx][bx.jy]);
+      }else
+        derivZLine<S>(r+c, f+c, ncz, dz, st);
+    }
+    
+    if(buf != NULL)
+      delete[] buf;
+  }
+}
+
+/// Single argument kernel for Field2D, in X or Y
+template<typename S, int D>
+void derivKernel2D(const Field2D &var, REGION region, BoutReal **dd, Field2D &result)
+{
+  const Region &rgn = getRegion(region);
+
+  result.allocate();
+  BoutReal **r = result.getData();
+  const BoutReal *f = var.getData()[0];
+  int sx = mesh->ngy;
+
+  #pragma omp parallel for
+  for(int i=0;i<rgn.size();i++) {
+    const bindex &bx = rgn[i];
+    int c = bx.jx*sx + bx.jy;
+    soffset o = lineOffsets<D>(bx, sx, 1);
+    sval s;
+    s.mm = f[c+o.mm]; s.m = f[c+o.m]; s.c = f[c]; s.p = f[c+o.p]; s.pp = f[c+o.pp];
+    r[bx.jx][bx.jy] = S::apply(s) / dd[bx.jx][bx.jy];
+  }
+}
+
+/// Thomas algorithm for the constant coefficient systems of the compact schemes
+///   alpha*x[i-1] + x[i] + alpha*x[i+1] = d[i]
+/// Non-periodic lines have x = d at both ends, for the explicit closures.
+/// Periodic lines are solved with the Sherman-Morrison formula, which
+/// needs at least 3 points.
+/// The elimination only depends on alpha and n, so is done once for all lines
+class CompactSolver {
+ public:
+  CompactSolver(BoutReal alpha, int n, bool periodic) : alpha(alpha), n(n), periodic(periodic),
+                                                       am(n), cp(n), inv(n) {
+    if(periodic && (n < 3))
+      throw BoutException("Compact differencing of periodic lines needs at least 3 points (n = %d)\n", n);
+    
+    vector<BoutReal> b(n, 1.0);
+    for(int i=0;i<n;i++)
+      am[i] = cp[i] = alpha;
+    if(periodic) {
+      // Tridiagonal part, with the corners removed
+      b[0] = 2.0;
+      b[n-1] = 1.0 + alpha*alpha;
+    }else {
+      am[0] = cp[0] = am[n-1] = 0.0;
+    }
+    am[0] = 0.0;
+    cp[n-1] = 0.0;
+    
+    for(int i=0;i<n;i++) {
+      inv[i] = 1.0 / (b[i] - ((i > 0) ? am[i]*cp[i-1] : 0.0));
+      cp[i] *= inv[i];
+    }
+    
+    if(periodic) {
+      // Correction vector
+      z.resize(n, 0.0);
+      z[0] = -1.0;
+      z[n-1] = alpha;
+      eliminate(&z[0], 1, 1);
+      zfact = 1.0 / (1.0 + z[0] - alpha*z[n-1]);
+    }
+  }
+  
+  /// Solve m lines in place. Point i of line j is d[i*stride + j]
+  template<typename T>
+  void solve(T *d, int stride, int m) const {
+    eliminate(d, stride, m);
+    if(periodic) {
+      for(int j=0;j<m;j++) {
+        BoutReal fact = (d[j] - alpha*d[(n-1)*stride + j]) * zfact;
+        for(int i=0;i<n;i++)
+          d[i*stride + j] -= fact*z[i];
+      }
+    }
+  }
+  
+ private:
+  BoutReal alpha;
+  int n;
+  bool periodic;
+  vector<BoutReal> am, cp, inv, z;
+  BoutReal zfact;
+  
+  template<typename T>
+  void eliminate(T *d, int stride, int m) const {
+    for(int j=0;j<m;j++)
+      d[j] *= inv[0];
+    for(int i=1;i<n;i++) {
+      T *di = d + i*stride;
+      const T *dm = di - stride;
+      BoutReal a = am[i], b = inv[i];
+      for(int j=0;j<m;j++)
+        di[j] = (di[j] - a*dm[j])*b;
+    }
+    for(int i=n-2;i>=0;i--) {
+      T *di = d + i*stride;
+      const T *dp = di + stride;
+      BoutReal c = cp[i];
+      for(int j=0;j<m;j++)
+        di[j] -= c*dp[j];
+    }
+  }
+};
+
+/// Compact scheme S for Field3D. Lines in X or Y are the points of the region
+/// in that direction, and are solved together for all Z points
+template<typename S, int D>
+void compactKernel(const Field3D &var, CELL_LOC loc, REGION region, BoutReal **dd, BoutReal dz, Field3D &result)
+{
+  const Region &rgn = getRegion(region);
+  int ncz = mesh->ngz-1;
+
+  result.allocate();
+  FieldReal *r = result.getRaw();
+  const FieldReal *f = var.readRaw();
+#ifdef CHECK
+  if(f == NULL)
+    throw BoutException("Differencing empty Field3D\n");
+#endif
+  if(shiftedX(D))
+    throw BoutException("Compact differencing in X needs ShiftOrder = 0\n");
+  
+  if((D == DIFF_DIR_Z) && (ncz < 3)) {
+    // Too few points for the periodic solver, so use the explicit scheme
+    #pragma omp parallel for schedule(static)
+    for(int i=0;i<rgn.size();i++) {
+      int c = Field3D::index(rgn[i].jx, rgn[i].jy, 0);
+      derivZLine<typename S::Closure>(r+c, f+c, ncz, dz, STAGGER_NONE);
+    }
+    return;
+  }
+  
+  if(D == DIFF_DIR_Z) {
+    CompactSolver solver(S::alpha(), ncz, true);
+    
+    #pragma omp parallel for schedule(static)
+    for(int i=0;i<rgn.size();i++) {
+      int c = Field3D::index(rgn[i].jx, rgn[i].jy, 0);
+      derivZLine<S>(r+c, f+c, ncz, 1.0, STAGGER_NONE);
+      solver.solve(r+c, 1, 1);
+      for(int jz=0;jz<ncz;jz++)
+        r[c+jz] /= dz;
+    }
+    return;
+  }
+  
+  // Region is a rectangle, Y index fastest
+  int xs = rgn[0].jx, ys = rgn[0].jy;
+  int ny = rgn[rgn.size()-1].jy - ys + 1;
+  int nx = rgn.size() / ny;
+  
+  int n = (D == DIFF_DIR_X) ? nx : ny;      // Length of each line
+  int nlines = (D == DIFF_DIR_X) ? ny : nx;
+  int sx = Field3D::index(1,0,0), sy = Field3D::index(0,1,0);
+  int stride = (D == DIFF_DIR_X) ? sx : sy;
+  
+  CompactSolver solver(S::alpha(), n, false);
+  
+  #pragma omp parallel for schedule(static)
+  for(int l=0;l<nlines;l++) {
+    // Right hand side. Explicit scheme at the ends
+    for(int i=0;i<n;i++) {
+      const bindex &bx = (D == DIFF_DIR_X) ? rgn[i*ny + l] : rgn[l*ny + i];
+      int c = Field3D::index(bx.jx, bx.jy, 0);
+      sline<FieldReal> fl = makeLine(f+c, lineOffsets<D>(bx, sx, sy));
+      if((i == 0) || (i == n-1)) {
+        derivLine<typename S::Closure>(r+c, fl, ncz, 1.0);
+      }else
+        derivLine<S>(r+c, fl, ncz, 1.0);
+    }
+    
+    int jx = (D == DIFF_DIR_X) ? xs : xs + l;
+    int jy = (D == DIFF_DIR_X) ? ys + l : ys;
+    FieldReal *rl = r + Field3D::index(jx, jy, 0);
+    solver.solve(rl, stride, ncz);
+    
+    for(int i=0;i<n;i++) {
+      FieldReal *ri = rl + i*stride;
+      BoutReal h = (D == DIFF_DIR_X) ? dd[jx+i][jy] : dd[jx][jy+i];
+      for(int jz=0;jz<ncz;jz++)
+        ri[jz] /= h;
+    }
+  }
+}
+
+/// Compact scheme S for Field2D, in X or Y
+template<typename S, int D>
+void compactKernel2D(const Field2D &var, REGION region, BoutReal **dd, Field2D &result)
+{
+  const Region &rgn = getRegion(region);
+
+  result.allocate();
+  BoutReal **r = result.getData();
+  const BoutReal *f = var.getData()[0];
+  int sx = mesh->ngy;
+  
+  int xs = rgn[0].jx, ys = rgn[0].jy;
+  int ny = rgn[rgn.size()-1].jy - ys + 1;
+  int nx = rgn.size() / ny;
+  
+  int n = (D == DIFF_DIR_X) ? nx : ny;
+  int nlines = (D == DIFF_DIR_X) ? ny : nx;
+  int stride = (D == DIFF_DIR_X) ? sx : 1;
+  
+  CompactSolver solver(S::alpha(), n, false);
+  
+  #pragma omp parallel for schedule(static)
+  for(int l=0;l<nlines;l++) {
+    for(int i=0;i<n;i++) {
+      const bindex &bx = (D == DIFF_DIR_X) ? rgn[i*ny + l] : rgn[l*ny + i];
+      int c = bx.jx*sx + bx.jy;
+      soffset o = lineOffsets<D>(bx, sx, 1);
+      sval s;
+      s.mm = f[c+o.mm]; s.m = f[c+o.m]; s.c = f[c]; s.p = f[c+o.p]; s.pp = f[c+o.pp];
+      if((i == 0) || (i == n-1)) {
+        r[bx.jx][bx.jy] = S::Closure::apply(s);
+      }else
+        r[bx.jx][bx.jy] = S::apply(s);
+    }
+    
+    int jx = (D == DIFF_DIR_X) ? xs : xs + l;
+    int jy = (D == DIFF_DIR_X) ? ys + l : ys;
+    solver.solve(&r[jx][jy], stride, 1);
+    
+    for(int i=0;i<n;i++) {
+      if(D == DIFF_DIR_X) {
+        r[jx+i][jy] /= dd[jx+i][jy];
+      }else
+        r[jx][jy+i] /= dd[jx][jy+i];
+    }
+  }
+}
+
+/// Set for methods which are linear in the stencil values, so can be
+/// applied to the real and imaginary parts of Z spectra separately
+template<typename S>
+struct IsLinear { enum { value = 0 }; };
+
+template<> struct IsLinear<DDX_C2>        { enum { value = 1 }; };
+template<> struct IsLinear<DDX_C4>        { enum { value = 1 }; };
+template<> struct IsLinear<D2DX2_C2>      { enum { value = 1 }; };
+template<> struct IsLinear<D2DX2_C4>      { enum { value = 1 }; };
+template<> struct IsLinear<DDX_C2_stag>   { enum { value = 1 }; };
+template<> struct IsLinear<DDX_C4_stag>   { enum { value = 1 }; };
+template<> struct IsLinear<D2DX2_C4_stag> { enum { value = 1 }; };
+
+/// As derivLine, for a line of Z spectra
+template<typename S>
+static inline void spectralLine(dcomplex *r, const sline<dcomplex> &f, int n, BoutReal h)
+{
+  for(int i=0;i<n;i++) {
+    sval re, im;
+    re.mm = f.mm[i].Real(); re.m = f.m[i].Real(); re.c = f.c[i].Real(); re.p = f.p[i].Real(); re.pp = f.pp[i].Real();
+    im.mm = f.mm[i].Imag(); im.m = f.m[i].Imag(); im.c = f.c[i].Imag(); im.p = f.p[i].Imag(); im.pp = f.pp[i].Imag();
+    r[i] = dcomplex(S::apply(re) / h, S::apply(im) / h);
+  }
+}
+
+/// X derivative with ShiftXderivs and ShiftOrder == 0, for linear methods.
+/// Shifting into BoutReal space, differencing and shifting back are all
+/// done on the Z spectra, so only one forward and one reverse FFT of the
+/// field are needed rather than three shifts. Lines outside the region are 0
+template<typename S>
+void spectralXKernel(const Field3D &var, CELL_LOC loc, REGION region, BoutReal **dd, BoutReal dz, Field3D &result)
+{
+  const Region &rgn = getRegion(region);
+  int ncz = mesh->ngz-1;
+  int nk = ncz/2 + 1;
+  int nlines = mesh->ngx*mesh->ngy;
+
+  const FieldReal *f = var.readRaw();
+#ifdef CHECK
+  if(f == NULL)
+    throw BoutException("Differencing empty Field3D\n");
+#endif
+  STAGGER st = staggerType(var.getLocation(), loc, DIFF_DIR_X);
+
+  // Spectra of all lines, indexed by (jx*ngy + jy)*nk + jz.
+  // Allocated for each call, since this may be called by several threads
+  dcomplex *ft = new dcomplex[nlines*nk];
+  dcomplex *dft = new dcomplex[nlines*nk];
+
+  const dcomplex *phase = zshift_phases();
+  rfft_many(f, ncz, nlines, mesh->ngz, ft);
+  
+  // Shift into BoutReal space
+  #pragma omp parallel for
+  for(int i=0;i<nlines;i++) {
+    dcomplex *fl = ft + i*nk;
+    for(int jz=0;jz<nk;jz++)
+      fl[jz] *= phase[i*nk + jz];
+    if(ncz % 2 == 0)
+      fl[nk-1] = fl[nk-1].Real(); // Nyquist mode, as seen by irfft
+    for(int jz=0;jz<nk;jz++)
+      dft[i*nk + jz] = 0.0;
+  }
+
+  int sx = mesh->ngy*nk;
+  #pragma omp parallel for schedule(static)
+  for(int i=0;i<rgn.size();i++) {
+    const bindex &bx = rgn[i];
+    int c = bx.jx*sx + bx.jy*nk;
+    
+    sline<dcomplex> l = makeLine((const dcomplex*) ft+c, lineOffsets<DIFF_DIR_X>(bx, sx, nk));
+    applyStagger(l, st);
+    spectralLine<S>(dft+c, l, nk, dd[bx.jx][bx.jy]);
+    
+    // Shift back
+    for(int jz=0;jz<nk;jz++)
+      dft[c + jz] *= conj(phase[c + jz]);
+  }
+
+  result.allocate();
+  FieldReal *r = result.getRaw();
+  irfft_many(dft, ncz, nlines, r, mesh->ngz);
+  for(int i=0;i<nlines;i++)
+    r[i*mesh->ngz + ncz] = r[i*mesh->ngz];
+
+  delete[] ft;
+  delete[] dft;
+}
+
+/// Stencil lines for an argument of an upwind/flux kernel. buf is only
+/// used for shifted X derivatives of a Field3D
+template<int D, int S, typename T>
+static inline sline<T> argLines(const T *f, int sx, int sy, const bindex &bx, bool shift, FieldReal *buf)
+{
+  return makeLine(f + bx.jx*sx + bx.jy*sy, lineOffsets<D>(bx, sx, sy));
+}
+
+template<int D, int S>
+static inline sline<FieldReal> argLines(const FieldReal *f, int sx, int sy, const bindex &bx, bool shift, FieldReal *buf)
+{
+  if(S && shift)
+    return shiftedXLines(f, bx, buf);
+  return makeLine(f + bx.jx*sx + bx.jy*sy, lineOffsets<D>(bx, sx, sy));
+}
+
+/// Upwind/flux kernel for any combination of Field3D and Field2D arguments.
+/// VS and FS are 1 for a Field3D, 0 for a Field2D
+template<typename S, int D, int VS, int FS, typename VT, typename FT>
+static void upwindLines(const VT *v, int vsx, int vsy, STAGGER vst,
+                        const FT *f, int fsx, int fsy,
+                        const Region &rgn, BoutReal **dd, BoutReal dz, FieldReal *r)
+{
+  int ncz = mesh->ngz-1;
+  bool shift = shiftedX(D);
+
+  #pragma omp parallel
+  {
+    FieldReal *vbuf = (shift && VS) ? new FieldReal[4*ncz] : NULL;
+    FieldReal *fbuf = (shift && FS) ? new FieldReal[4*ncz] : NULL;
+    
+    #pragma omp for schedule(static)
+    for(int i=0;i<rgn.size();i++) {
+      const bindex &bx = rgn[i];
+      FieldReal *rl = r + Field3D::index(bx.jx, bx.jy, 0);
+      
+      if(D != DIFF_DIR_Z) {
+        sline<VT> vl = argLines<D, VS>(v, vsx, vsy, bx, shift, vbuf);
+        applyStagger(vl, vst);
+        sline<FT> fl = argLines<D, FS>(f, fsx, fsy, bx, shift, fbuf);
+        upwindLine<S, VS, FS>(rl, vl, fl, ncz, dd[bx.jx][bx.jy]);
+      }else {
+        const VT *vc = v + bx.jx*vsx + bx.jy*vsy;
+        const FT *fc = f + bx.jx*fsx + bx.jy*fsy;
+        if(ncz > 4) {
+          soffset vo = {-2*VS, -VS, VS, 2*VS};
+          sline<VT> vl = makeLine(vc+2*VS, vo);
+          applyStagger(vl, vst);
+          soffset fo = {-2*FS, -FS, FS, 2*FS};
+          upwindLine<S, VS, FS>(rl+2, vl, makeLine(fc+2*FS, fo), ncz-4, dz);
+        }
+        for(int jz=0;jz<ncz;jz++) {
+          if(zInterior(jz, ncz))
+            continue;
+          sline<VT> vl = makeLine(vc+jz*VS, zOffsets(jz, ncz, VS));
+          applyStagger(vl, vst);
+          upwindLine<S, VS, FS>(rl+jz, vl, makeLine(fc+jz*FS, zOffsets(jz, ncz, FS)), 1, dz);
+        }
+      }
+    }
+    
+    if(vbuf != NULL)
+      delete[] vbuf;
+    if(fbuf != NULL)
+      delete[] fbuf;
+  }
+}
+
+template<typename S, int D>
+void upwindKernel(const Field &v, const Field &f, CELL_LOC loc, REGION region, BoutReal **dd, BoutReal dz, Field3D &result)
+{
+  const Region &rgn = getRegion(region);
+
+  result.allocate();
+  FieldReal *r = result.getRaw();
+
+  const Field3D *v3 = dynamic_cast<const Field3D*>(&v);
+  const Field3D *f3 = dynamic_cast<const Field3D*>(&f);
+  const Field2D *v2 = dynamic_cast<const Field2D*>(&v);
+  const Field2D *f2 = dynamic_cast<const Field2D*>(&f);
+  if(((v3 == NULL) && (v2 == NULL)) || ((f3 == NULL) && (f2 == NULL)))
+    throw BoutException("Upwinding: arguments must be Field3D or Field2D\n");
+
+  int sx3 = Field3D::index(1,0,0), sy3 = Field3D::index(0,1,0);
+  int sx2 = mesh->ngy;
+  
+  if(v3 != NULL) {
+    STAGGER vst = staggerType(v3->getLocation(), loc, D);
+    if(f3 != NULL) {
+      upwindLines<S, D, 1, 1>(v3->readRaw(), sx3, sy3, vst, f3->readRaw(), sx3, sy3, rgn, dd, dz, r);
+    }else
+      upwindLines<S, D, 1, 0>(v3->readRaw(), sx3, sy3, vst, f2->getData()[0], sx2, 1, rgn, dd, dz, r);
+  }else {
+    if(f3 != NULL) {
+      upwindLines<S, D, 0, 1>(v2->getData()[0], sx2, 1, STAGGER_NONE, f3->readRaw(), sx3, sy3, rgn, dd, dz, r);
+    }else
+      upwindLines<S, D, 0, 0>(v2->getData()[0], sx2, 1, STAGGER_NONE, f2->getData()[0], sx2, 1, rgn, dd, dz, r);
+  }
+}
+
+/// Upwind/flux kernel for Field2D. In Z, all stencil values are the centre value
+template<typename S, int D>
+void upwindKernel2D(const Field2D &v, const Field2D &f, REGION region, BoutReal **dd, BoutReal dz, Field2D &result)
+{
+  const Region &rgn = getRegion(region);
+
+  result.allocate();
+  BoutReal **r = result.getData();
+  const BoutReal *vd = v.getData()[0];
+  const BoutReal *fd = f.getData()[0];
+  int sx = mesh->ngy;
+
+  #pragma omp parallel for
+  for(int i=0;i<rgn.size();i++) {
+    const bindex &bx = rgn[i];
+    int c = bx.jx*sx + bx.jy;
+    soffset o = {0, 0, 0, 0};
+    if(D != DIFF_DIR_Z)
+      o = lineOffsets<D>(bx, sx, 1);
+    sval vs, fs;
+    vs.mm = vd[c+o.mm]; vs.m = vd[c+o.m]; vs.c = vd[c]; vs.p = vd[c+o.p]; vs.pp = vd[c+o.pp];
+    fs.mm = fd[c+o.mm]; fs.m = fd[c+o.m]; fs.c = fd[c]; fs.p = fd[c+o.p]; fs.pp = fd[c+o.pp];
+    r[bx.jx][bx.jy] = S::apply(vs, fs) / ((D == DIFF_DIR_Z) ? dz : dd[bx.jx][bx.jy]);
+  }
+}
+
+typedef void (*deriv_kernel)(const Field3D &var, CELL_LOC loc, REGION region, BoutReal **dd, BoutReal dz, Field3D &result);
+typedef void (*deriv_kernel2d)(const Field2D &var, REGION region, BoutReal **dd, Field2D &result);
+typedef void (*upwind_kernel)(const Field &v, const Field &f, CELL_LOC loc, REGION region, BoutReal **dd, BoutReal dz, Field3D &result);
+typedef void (*upwind_kernel2d)(const Field2D &v, const Field2D &f, REGION region, BoutReal **dd, BoutReal dz, Field2D &result);
+
+typedef void (*deriv_line)(FieldReal *r, const sline<FieldReal> &f, int n, BoutReal h);
+typedef void (*deriv_zline)(FieldReal *r, const FieldReal *f, int ncz, BoutReal dz, STAGGER st);
+
+/// Kernels for a single-argument method, indexed by DIFF_DIR
+struct DerivKernels {
+  deriv_kernel f3d[3];
+  deriv_kernel2d f2d[2];
+  deriv_kernel fshiftx; ///< Fused shifted X derivative (spectralXKernel). NULL if not linear
+  deriv_line line;   ///< One line in X or Y, for fused operators. NULL for compact schemes
+  deriv_zline zline; ///< One line in Z. NULL for compact schemes
+};
+
+/// Kernels for an upwind or flux method, indexed by DIFF_DIR
+struct UpwindKernels {
+  upwind_kernel f3d[3];
+  upwind_kernel2d f2d[3];
+};
+
+template<typename S>
+struct DerivMethod {
+  static const DerivKernels kernels;
+};
+
+template<typename S>
+const DerivKernels DerivMethod<S>::kernels = {
+  {derivKernel<S, DIFF_DIR_X>, derivKernel<S, DIFF_DIR_Y>, derivKernel<S, DIFF_DIR_Z>},
+  {derivKernel2D<S, DIFF_DIR_X>, derivKernel2D<S, DIFF_DIR_Y>},
+  IsLinear<S>::value ? spectralXKernel<S> : (deriv_kernel) NULL,
+  derivLine<S>,
+  derivZLine<S>
+};
+
+/// Compact schemes solve whole lines, so can't be used in fused operators
+template<typename S>
+struct CompactMethod {
+  static const DerivKernels kernels;
+};
+
+template<typename S>
+const DerivKernels CompactMethod<S>::kernels = {
+  {compactKernel<S, DIFF_DIR_X>, compactKernel<S, DIFF_DIR_Y>, compactKernel<S, DIFF_DIR_Z>},
+  {compactKernel2D<S, DIFF_DIR_X>, compactKernel2D<S, DIFF_DIR_Y>},
+  NULL, NULL, NULL
+};
+
+template<typename S>
+struct UpwindMethod {
+  static const UpwindKernels kernels;
+};
+
+template<typename S>
+const UpwindKernels UpwindMethod<S>::kernels = {
+  {upwindKernel<S, DIFF_DIR_X>, upwindKernel<S, DIFF_DIR_Y>, upwindKernel<S, DIFF_DIR_Z>},
+  {upwindKernel2D<S, DIFF_DIR_X>, upwindKernel2D<S, DIFF_DIR_Y>, upwindKernel2D<S, DIFF_DIR_Z>}
+};
+
+/// A differencing method, selected at run time. NULL for FFT
+typedef const DerivKernels* deriv_func;
+/// An upwinding or flux method. NULL for split flux
+typedef const UpwindKernels* upwind_func;
+
 /*******************************************************************************
  * Lookup tables of functions. Map between names, codes and functions
  *******************************************************************************/
@@ -357,8 +1220,8 @@ BoutReal FDDX_U1_stag(stencil &v, stencil &f) {
 /// Translate between DIFF_METHOD codes, and functions
 struct DiffLookup {
   DIFF_METHOD method;
-  deriv_func func;     // Single-argument differencing function
-  upwind_func up_func; // Upwinding function
+  deriv_func func;     // Single-argument differencing kernels
+  upwind_func up_func; // Upwinding kernels
 };
 
 /// Translate between short names, long names and DIFF_METHOD codes
@@ -378,54 +1241,60 @@ static DiffNameLookup DiffNameTable[] = { {DIFF_U1, "U1", "First order upwinding
 					  {DIFF_FFT, "FFT", "FFT"},
                                           {DIFF_NND, "NND", "NND"},
                                           {DIFF_SPLIT, "SPLIT", "Split into upwind and central"},
+                                          {DIFF_P4, "P4", "Fourth order compact (Pade)"},
+                                          {DIFF_P6, "P6", "Sixth order compact (Pade)"},
 					  {DIFF_DEFAULT}}; // Use to terminate the list
 
 /// First derivative lookup table
-static DiffLookup FirstDerivTable[] = { {DIFF_C2, DDX_C2,     NULL},
-					{DIFF_W2, DDX_CWENO2, NULL},
-					{DIFF_W3, DDX_CWENO3, NULL},
-					{DIFF_C4, DDX_C4,     NULL},
+static DiffLookup FirstDerivTable[] = { {DIFF_C2, &DerivMethod<DDX_C2>::kernels,     NULL},
+					{DIFF_W2, &DerivMethod<DDX_CWENO2>::kernels, NULL},
+					{DIFF_W3, &DerivMethod<DDX_CWENO3>::kernels, NULL},
+					{DIFF_C4, &DerivMethod<DDX_C4>::kernels,     NULL},
+					{DIFF_P4, &CompactMethod<DDX_P4>::kernels,   NULL},
+					{DIFF_P6, &CompactMethod<DDX_P6>::kernels,   NULL},
 					{DIFF_FFT, NULL,      NULL},
 					{DIFF_DEFAULT}};
 
 /// Second derivative lookup table
-static DiffLookup SecondDerivTable[] = { {DIFF_C2, D2DX2_C2, NULL},
-					{DIFF_C4, D2DX2_C4, NULL},
+static DiffLookup SecondDerivTable[] = { {DIFF_C2, &DerivMethod<D2DX2_C2>::kernels, NULL},
+					{DIFF_C4, &DerivMethod<D2DX2_C4>::kernels, NULL},
+					{DIFF_P4, &CompactMethod<D2DX2_P4>::kernels, NULL},
+					{DIFF_P6, &CompactMethod<D2DX2_P6>::kernels, NULL},
 					{DIFF_FFT, NULL,    NULL},
 					{DIFF_DEFAULT}};
 
 /// Upwinding functions lookup table
-static DiffLookup UpwindTable[] = { {DIFF_U1, NULL, VDDX_U1},
-				    {DIFF_C2, NULL, VDDX_C2},
-				    {DIFF_U4, NULL, VDDX_U4},
-				    {DIFF_W3, NULL, VDDX_WENO3},
-				    {DIFF_C4, NULL, VDDX_C4},
+static DiffLookup UpwindTable[] = { {DIFF_U1, NULL, &UpwindMethod<VDDX_U1>::kernels},
+				    {DIFF_C2, NULL, &UpwindMethod<VDDX_C2>::kernels},
+				    {DIFF_U4, NULL, &UpwindMethod<VDDX_U4>::kernels},
+				    {DIFF_W3, NULL, &UpwindMethod<VDDX_WENO3>::kernels},
+				    {DIFF_C4, NULL, &UpwindMethod<VDDX_C4>::kernels},
 				    {DIFF_DEFAULT}};
 
 /// Flux functions lookup table
 static DiffLookup FluxTable[] = { {DIFF_SPLIT, NULL, NULL},
-                                  {DIFF_U1, NULL, FDDX_U1},
-                                  {DIFF_C2, NULL, FDDX_C2},
-                                  {DIFF_C4, NULL, FDDX_C4},
-                                  {DIFF_NND, NULL, FDDX_NND},
+                                  {DIFF_U1, NULL, &UpwindMethod<FDDX_U1>::kernels},
+                                  {DIFF_C2, NULL, &UpwindMethod<FDDX_C2>::kernels},
+                                  {DIFF_C4, NULL, &UpwindMethod<FDDX_C4>::kernels},
+                                  {DIFF_NND, NULL, &UpwindMethod<FDDX_NND>::kernels},
                                   {DIFF_DEFAULT}};
 
 /// First staggered derivative lookup
-static DiffLookup FirstStagDerivTable[] = { {DIFF_C2, DDX_C2_stag, NULL}, 
-					    {DIFF_C4, DDX_C4_stag, NULL},
+static DiffLookup FirstStagDerivTable[] = { {DIFF_C2, &DerivMethod<DDX_C2_stag>::kernels, NULL}, 
+					    {DIFF_C4, &DerivMethod<DDX_C4_stag>::kernels, NULL},
 					    {DIFF_DEFAULT}};
 
 /// Second staggered derivative lookup
-static DiffLookup SecondStagDerivTable[] = { {DIFF_C4, D2DX2_C4_stag, NULL},
+static DiffLookup SecondStagDerivTable[] = { {DIFF_C4, &DerivMethod<D2DX2_C4_stag>::kernels, NULL},
 					     {DIFF_DEFAULT}};
 
 /// Upwinding staggered lookup
-static DiffLookup UpwindStagTable[] = { {DIFF_U1, NULL, VDDX_U1_stag},
+static DiffLookup UpwindStagTable[] = { {DIFF_U1, NULL, &UpwindMethod<VDDX_U1_stag>::kernels},
 					{DIFF_DEFAULT} };
 
 /// Flux staggered lookup
 static DiffLookup FluxStagTable[] = { {DIFF_SPLIT, NULL, NULL},
-                                      {DIFF_U1, NULL, FDDX_U1_stag},
+                                      {DIFF_U1, NULL, &UpwindMethod<FDDX_U1_stag>::kernels},
                                       {DIFF_DEFAULT}};
 
 /*******************************************************************************
@@ -641,6 +1510,8 @@ int derivs_init() {
               fD2DZ2, sfD2DZ2,
               fVDDZ, sfVDDZ,
               fFDDZ, sfFDDZ);
+
+  deriv_cache_init();
   
 #ifdef CHECK
   msg_stack.pop();
@@ -662,124 +1533,35 @@ int derivs_init() {
 const Field2D applyXdiff(const Field2D &var, deriv_func func, const Field2D &dd, CELL_LOC loc = CELL_DEFAULT)
 {
   Field2D result;
-  result.allocate(); // Make sure data allocated
-
-  bindex bx;
-
-  BoutReal **r = result.getData();
-
-  start_index(&bx, RGN_NOX);
-#ifdef _OPENMP
-  // Parallel version. Needs another variable for each thread
-  
-  bindex bxstart = bx; // Copy to avoid race condition on first index
-  bool workToDoGlobal; // Shared loop control
-  #pragma omp parallel
-  {
-    bindex bxlocal; // Index for each thread
-    stencil s;
-    bool workToDo;  // Does this thread have work to do?
-    
-    #pragma omp single
-    {
-      // First index done once
-      var.setXStencil(s, bxstart, loc);
-      r[bxstart.jx][bxstart.jy] = func(s) / dd[bxstart.jx][bxstart.jy];
-    }
-    
-    do {
-      #pragma omp critical
-      {
-        // Get the next index
-        workToDo = next_index2(&bx);
-        bxlocal = bx; // Make a local copy
-        workToDoGlobal = workToDo;
-      }
-      if(workToDo) { // Here workToDo could be different to workToDoGlobal
-        var.setXStencil(s, bxlocal, loc);
-        r[bxlocal.jx][bxlocal.jy] = func(s) / dd[bxlocal.jx][bxlocal.jy];
-      }
-    }while(workToDoGlobal);
-  }
-#else
-  // Serial version
-  
-  stencil s;
-  do {
-    var.setXStencil(s, bx, loc);
-    r[bx.jx][bx.jy] = func(s) / dd[bx.jx][bx.jy];
-  }while(next_index2(&bx));
-#endif // _OPENMP
+  func->f2d[DIFF_DIR_X](var, RGN_NOX, dd.getData(), result);
 
 #ifdef CHECK
   // Mark boundaries as invalid
   result.bndry_xin = result.bndry_xout = result.bndry_yup = result.bndry_ydown = false;
 #endif
-
-  return result;
-}
-
-const Field3D applyXdiff(const Field3D &var, deriv_func func, const Field2D &dd, CELL_LOC loc = CELL_DEFAULT)
-{
-  Field3D result;
-  result.allocate(); // Make sure data allocated
-
-  Field3D vs = var;
-  if(mesh->ShiftXderivs && (mesh->ShiftOrder == 0)) {
-    // Shift in Z using FFT
-    vs = var.shiftZ(true); // Shift into BoutReal space
-  }
-  
-  bindex bx;
-  BoutReal ***r = result.getData();
-  
-  start_index(&bx, RGN_NOX);
-#ifdef _OPENMP
-  bindex bxstart = bx; // Copy to avoid race condition on first index
-  bool workToDoGlobal; // Shared loop control
-  #pragma omp parallel
-  {
-    bindex bxlocal; // Index for each thread
-    stencil s;
-    bool workToDo;  // Does this thread have work to do?
-    
-    #pragma omp single
-    {
-      // First index done by single thread
-      for(bxstart.jz=0;bxstart.jz<mesh->ngz-1;bxstart.jz++) {
-        vs.setXStencil(s, bxstart, loc);
-        r[bxstart.jx][bxstart.jy][bxstart.jz] = func(s) / dd[bxstart.jx][bxstart.jy];
-      }
+
+  return result;
+}
+
+Field3D applyXdiff(const Field3D &var, deriv_func func, const Field2D &dd, CELL_LOC loc = CELL_DEFAULT)
+{
+  Field3D result;
+
+  if(mesh->ShiftXderivs && (mesh->ShiftOrder == 0) && (func->fshiftx != NULL)) {
+    // Shift, differentiate and shift back in spectral space
+    func->fshiftx(var, loc, RGN_NOX, dd.getData(), 0., result);
+  }else {
+    Field3D vs = var;
+    if(mesh->ShiftXderivs && (mesh->ShiftOrder == 0)) {
+      // Shift in Z using FFT
+      vs = var.shiftZ(true); // Shift into BoutReal space
     }
     
-    do {
-      #pragma omp critical
-      {
-        // Get the next index
-        workToDo = next_index2(&bx); // Only in 2D
-        bxlocal = bx; // Make a local copy
-        workToDoGlobal = workToDo;
-      }
-      if(workToDo) { // Here workToDo could be different to workToDoGlobal
-        for(bxlocal.jz=0;bxlocal.jz<mesh->ngz-1;bxlocal.jz++) {
-          vs.setXStencil(s, bxlocal, loc);
-          r[bxlocal.jx][bxlocal.jy][bxlocal.jz] = func(s) / dd[bxlocal.jx][bxlocal.jy];
-        }
-      }
-    }while(workToDoGlobal);
+    func->f3d[DIFF_DIR_X](vs, loc, RGN_NOX, dd.getData(), 0., result);
+    
+    if(mesh->ShiftXderivs && (mesh->ShiftOrder == 0))
+      result = result.shiftZ(false); // Shift back
   }
-#else
-  stencil s;
-  do {
-    for(bx.jz=0;bx.jz<mesh->ngz-1;bx.jz++) {
-      vs.setXStencil(s, bx, loc);
-      r[bx.jx][bx.jy][bx.jz] = func(s) / dd[bx.jx][bx.jy];
-    }
-  }while(next_index2(&bx));
-#endif  
-
-  if(mesh->ShiftXderivs && (mesh->ShiftOrder == 0))
-    result = result.shiftZ(false); // Shift back
 
 #ifdef CHECK
   // Mark boundaries as invalid
@@ -794,49 +1576,7 @@ const Field3D applyXdiff(const Field3D &var, deriv_func func, const Field2D &dd,
 const Field2D applyYdiff(const Field2D &var, deriv_func func, const Field2D &dd, CELL_LOC loc = CELL_DEFAULT)
 {
   Field2D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal **r = result.getData();
-  
-  bindex bx;
-  
-  start_index(&bx, RGN_NOBNDRY);
-#ifdef _OPENMP
-  bindex bxstart = bx; // Copy to avoid race condition on first index
-  bool workToDoGlobal; // Shared loop control
-  #pragma omp parallel
-  {
-    bindex bxlocal; // Index for each thread
-    stencil s;
-    bool workToDo;  // Does this thread have work to do?
-    
-    #pragma omp single
-    {
-      // First index done once
-      var.setYStencil(s, bxstart, loc);
-      r[bxstart.jx][bxstart.jy] = func(s) / dd[bxstart.jx][bxstart.jy];
-    }
-    
-    do {
-      #pragma omp critical
-      {
-        // Get the next index
-        workToDo = next_index2(&bx);
-        bxlocal = bx; // Make a local copy
-        workToDoGlobal = workToDo;
-      }
-      if(workToDo) { // Here workToDo could be different to workToDoGlobal
-        var.setYStencil(s, bxlocal, loc);
-        r[bxlocal.jx][bxlocal.jy] = func(s) / dd[bxlocal.jx][bxlocal.jy];
-      }
-    }while(workToDoGlobal);
-  }
-#else
-  stencil s;
-  do{
-    var.setYStencil(s, bx, loc);
-    r[bx.jx][bx.jy] = func(s) / dd[bx.jx][bx.jy];
-  }while(next_index2(&bx));
-#endif  
+  func->f2d[DIFF_DIR_Y](var, RGN_NOBNDRY, dd.getData(), result);
 
 #ifdef CHECK
   // Mark boundaries as invalid
@@ -846,60 +1586,10 @@ const Field2D applyYdiff(const Field2D &var, deriv_func func, const Field2D &dd,
   return result;
 }
 
-const Field3D applyYdiff(const Field3D &var, deriv_func func, const Field2D &dd, CELL_LOC loc = CELL_DEFAULT)
+Field3D applyYdiff(const Field3D &var, deriv_func func, const Field2D &dd, CELL_LOC loc = CELL_DEFAULT)
 {
   Field3D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal ***r = result.getData();
-  
-  bindex bx;
-  
-  start_index(&bx, RGN_NOBNDRY);
-  
-#ifdef _OPENMP
-  // Parallel version
-  bindex bxstart = bx; // Copy to avoid race condition on first index
-  bool workToDoGlobal; // Shared loop control
-  #pragma omp parallel
-  {
-    bindex bxlocal; // Index for each thread
-    stencil s;
-    bool workToDo;  // Does this thread have work to do?
-    
-    #pragma omp single
-    {
-      // First index done by single thread
-      for(bxstart.jz=0;bxstart.jz<mesh->ngz-1;bxstart.jz++) {
-        var.setYStencil(s, bxstart, loc);
-        r[bxstart.jx][bxstart.jy][bxstart.jz] = func(s) / dd[bxstart.jx][bxstart.jy];
-      }
-    }
-    
-    do {
-      #pragma omp critical
-      {
-        // Get the next index
-        workToDo = next_index2(&bx); // Only in 2D
-        bxlocal = bx; // Make a local copy
-        workToDoGlobal = workToDo;
-      }
-      if(workToDo) { // Here workToDo could be different to workToDoGlobal
-        for(bxlocal.jz=0;bxlocal.jz<mesh->ngz-1;bxlocal.jz++) {
-          var.setYStencil(s, bxlocal, loc);
-          r[bxlocal.jx][bxlocal.jy][bxlocal.jz] = func(s) / dd[bxlocal.jx][bxlocal.jy];
-        }
-      }
-    }while(workToDoGlobal);
-  }
-#else 
-  stencil s;
-  do {
-    for(bx.jz=0;bx.jz<mesh->ngz-1;bx.jz++) {
-      var.setYStencil(s, bx, loc);
-      r[bx.jx][bx.jy][bx.jz] = func(s) / dd[bx.jx][bx.jy];
-    }
-  }while(next_index2(&bx));
-#endif
+  func->f3d[DIFF_DIR_Y](var, loc, RGN_NOBNDRY, dd.getData(), 0., result);
 
 #ifdef CHECK
   // Mark boundaries as invalid
@@ -911,58 +1601,10 @@ const Field3D applyYdiff(const Field3D &var, deriv_func func, const Field2D &dd,
 
 // Z derivative
 
-const Field3D applyZdiff(const Field3D &var, deriv_func func, BoutReal dd, CELL_LOC loc = CELL_DEFAULT)
+Field3D applyZdiff(const Field3D &var, deriv_func func, BoutReal dd, CELL_LOC loc = CELL_DEFAULT)
 {
   Field3D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal ***r = result.getData();
-  
-  bindex bx;
-
-  start_index(&bx, RGN_NOZ);
-#ifdef _OPENMP
-  // Parallel version
-  bindex bxstart = bx; // Copy to avoid race condition on first index
-  bool workToDoGlobal; // Shared loop control
-  #pragma omp parallel
-  {
-    bindex bxlocal; // Index for each thread
-    stencil s;
-    bool workToDo;  // Does this thread have work to do?
-    
-    #pragma omp single
-    {
-      // First index done by single thread
-      for(bxstart.jz=0;bxstart.jz<mesh->ngz-1;bxstart.jz++) {
-        var.setZStencil(s, bxstart, loc);
-        r[bxstart.jx][bxstart.jy][bxstart.jz] = func(s) / dd;
-      }
-    }
-    
-    do {
-      #pragma omp critical
-      {
-        // Get the next index
-        workToDo = next_index2(&bx); // Only in 2D
-        bxlocal = bx; // Make a local copy
-        workToDoGlobal = workToDo;
-      }
-      if(workToDo) { // Here workToDo could be different to workToDoGlobal
-        for(bxlocal.jz=0;bxlocal.jz<mesh->ngz-1;bxlocal.jz++) {
-          var.setZStencil(s, bxlocal, loc);
-          r[bxlocal.jx][bxlocal.jy][bxlocal.jz] = func(s) / dd;
-        }
-      }
-    }while(workToDoGlobal);
-  }
-#else
-  stencil s;
-  do {
-    var.setZStencil(s, bx, loc);
-    r[bx.jx][bx.jy][bx.jz] = func(s) / dd;
-  }while(next_index3(&bx));
-#endif
-
+  func->f3d[DIFF_DIR_Z](var, loc, RGN_NOZ, NULL, dd, result);
   return result;
 }
 
@@ -972,7 +1614,7 @@ const Field3D applyZdiff(const Field3D &var, deriv_func func, BoutReal dd, CELL_
 
 ////////////// X DERIVATIVE /////////////////
 
-const Field3D DDX(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
+static Field3D calcDDX(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
 {
   deriv_func func = fDDX; // Set to default function
   DiffLookup *table = FirstDerivTable;
@@ -1034,12 +1676,25 @@ const Field3D DDX(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
   return result;
 }
 
-const Field3D DDX(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D DDX(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
+{
+  // Result depends on whether the integrated shear is included
+  BoutReal shear = (mesh->ShiftXderivs && mesh->IncIntShear) ? 1. : 0.;
+
+  Field3D result;
+  if(!deriv_cache_get(DCACHE_DDX, f, outloc, method, shear, result)) {
+    result = calcDDX(f, outloc, method);
+    deriv_cache_put(DCACHE_DDX, f, outloc, method, shear, result);
+  }
+  return result;
+}
+
+Field3D DDX(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
 {
   return DDX(f, outloc, method);
 }
 
-const Field3D DDX(const Field3D &f, DIFF_METHOD method)
+Field3D DDX(const Field3D &f, DIFF_METHOD method)
 {
   return DDX(f, CELL_DEFAULT, method);
 }
@@ -1051,7 +1706,7 @@ const Field2D DDX(const Field2D &f)
 
 ////////////// Y DERIVATIVE /////////////////
 
-const Field3D DDY(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
+static Field3D calcDDY(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
 {
   deriv_func func = fDDY; // Set to default function
   DiffLookup *table = FirstDerivTable;
@@ -1111,12 +1766,22 @@ const Field3D DDY(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
   return interp_to(result, outloc); // Interpolate if necessary
 }
 
-const Field3D DDY(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D DDY(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
+{
+  Field3D result;
+  if(!deriv_cache_get(DCACHE_DDY, f, outloc, method, 0., result)) {
+    result = calcDDY(f, outloc, method);
+    deriv_cache_put(DCACHE_DDY, f, outloc, method, 0., result);
+  }
+  return result;
+}
+
+Field3D DDY(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
 {
   return DDY(f, outloc, method);
 }
 
-const Field3D DDY(const Field3D &f, DIFF_METHOD method)
+Field3D DDY(const Field3D &f, DIFF_METHOD method)
 {
   return DDY(f, CELL_DEFAULT, method);
 }
@@ -1128,7 +1793,7 @@ const Field2D DDY(const Field2D &f)
 
 ////////////// Z DERIVATIVE /////////////////
 
-const Field3D DDZ(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method, bool inc_xbndry)
+static Field3D calcDDZ(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method, bool inc_xbndry)
 {
   deriv_func func = fDDZ; // Set to default function
   DiffLookup *table = FirstDerivTable;
@@ -1198,58 +1863,40 @@ const Field3D DDZ(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method, bool in
     }
     
     int ncz = mesh->ngz-1;
+    int nk = ncz/2 + 1;
     
-#ifndef _OPENMP
-    static dcomplex *cv = (dcomplex*) NULL;
-#else
-    static dcomplex *globalcv = (dcomplex*) NULL;
-#endif
-
-    #pragma omp parallel
-    {
-#ifndef _OPENMP
-      // Serial, so can have a single static array
-      if(cv == (dcomplex*) NULL)
-        cv = new dcomplex[ncz/2 + 1];
-#else
-      // Parallel, so allocate a separate array for each thread
-      
-      int th_id = omp_get_thread_num(); // thread ID
-      if(globalcv == (dcomplex*) NULL) {
-        if(th_id == 0) {
-          // Allocate memory in thread zero
-          int n_th = omp_get_num_threads();
-          globalcv = new dcomplex[n_th*(ncz/2 + 1)];
-        }
-        // Wait for memory to be allocated
-        #pragma omp barrier
-      }
+    // Multiplier for each mode. Work arrays are per call, since this
+    // may be called from several threads, and ngz may change
+    vector<dcomplex> mult(nk);
+    for(int jz=0;jz<nk;jz++) {
+      BoutReal kwave=jz*2.0*PI/mesh->zlength; // wave number is 1/[rad]
       
-      dcomplex *cv = globalcv + th_id*(ncz/2 + 1); // Separate array for each thread
-#endif
-      #pragma omp for
-      for(int jx=xge;jx<xlt;jx++) {
-        for(int jy=0;jy<mesh->ngy;jy++) {
-          
-          rfft(f[jx][jy], ncz, cv); // Forward FFT
-          
-          for(int jz=0;jz<=ncz/2;jz++) {
-            BoutReal kwave=jz*2.0*PI/mesh->zlength; // wave number is 1/[rad]
-            
-            BoutReal flt;
-            if (jz>0.4*ncz) flt=1e-10; else flt=1.0;
-            cv[jz] *= dcomplex(0.0, kwave) * flt;
-            if(mesh->StaggerGrids)
-              cv[jz] *= exp(Im * (shift * kwave * mesh->dz));
-          }
-          
-          irfft(cv, ncz, result[jx][jy]); // Reverse FFT
-          
-          result[jx][jy][ncz] = result[jx][jy][0];
-        }
-      }
+      BoutReal flt;
+      if (jz>0.4*ncz) flt=1e-10; else flt=1.0;
+      mult[jz] = dcomplex(0.0, kwave) * flt;
+      if(mesh->StaggerGrids)
+        mult[jz] *= exp(Im * (shift * kwave * mesh->dz));
     }
     
+    // Lines in X are contiguous, so transform them all at once
+    int nlines = (xlt - xge)*mesh->ngy;
+    vector<dcomplex> cvbuf(nlines*nk);
+    dcomplex *cv = &cvbuf[0];
+    
+    int start = Field3D::index(xge, 0, 0);
+    rfft_many(f.readRaw() + start, ncz, nlines, mesh->ngz, cv); // Forward FFT
+    
+    #pragma omp parallel for
+    for(int i=0;i<nlines;i++)
+      for(int jz=0;jz<nk;jz++)
+        cv[i*nk + jz] *= mult[jz];
+    
+    FieldReal *r = result.getRaw() + start;
+    irfft_many(cv, ncz, nlines, r, mesh->ngz); // Reverse FFT
+    
+    for(int i=0;i<nlines;i++)
+      r[i*mesh->ngz + ncz] = r[i*mesh->ngz];
+    
 #ifdef CHECK
     // Mark boundaries as invalid
     result.bndry_xin = result.bndry_xout = result.bndry_yup = result.bndry_ydown = false;
@@ -1265,17 +1912,29 @@ const Field3D DDZ(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method, bool in
   return interp_to(result, outloc);
 }
 
-const Field3D DDZ(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc, bool inc_xbndry)
+Field3D DDZ(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method, bool inc_xbndry)
+{
+  BoutReal xbndry = inc_xbndry ? 1. : 0.;
+
+  Field3D result;
+  if(!deriv_cache_get(DCACHE_DDZ, f, outloc, method, xbndry, result)) {
+    result = calcDDZ(f, outloc, method, inc_xbndry);
+    deriv_cache_put(DCACHE_DDZ, f, outloc, method, xbndry, result);
+  }
+  return result;
+}
+
+Field3D DDZ(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc, bool inc_xbndry)
 {
   return DDZ(f, outloc, method, inc_xbndry);
 }
 
-const Field3D DDZ(const Field3D &f, DIFF_METHOD method, bool inc_xbndry)
+Field3D DDZ(const Field3D &f, DIFF_METHOD method, bool inc_xbndry)
 {
   return DDZ(f, CELL_DEFAULT, method, inc_xbndry);
 }
 
-const Field3D DDZ(const Field3D &f, bool inc_xbndry)
+Field3D DDZ(const Field3D &f, bool inc_xbndry)
 {
   return DDZ(f, CELL_DEFAULT, DIFF_DEFAULT, inc_xbndry);
 }
@@ -1324,7 +1983,7 @@ const Vector2D DDZ(const Vector2D &v)
 
 ////////////// X DERIVATIVE /////////////////
 
-const Field3D D2DX2(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
+Field3D D2DX2(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
 {
   deriv_func func = fD2DX2; // Set to default function
   DiffLookup *table = SecondDerivTable;
@@ -1397,7 +2056,7 @@ const Field3D D2DX2(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
   return result;
 }
 
-const Field3D D2DX2(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D D2DX2(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
 {
   return D2DX2(f, outloc, method);
 }
@@ -1418,7 +2077,7 @@ const Field2D D2DX2(const Field2D &f)
 
 ////////////// Y DERIVATIVE /////////////////
 
-const Field3D D2DY2(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
+Field3D D2DY2(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
 {
   deriv_func func = fD2DY2; // Set to default function
   DiffLookup *table = SecondDerivTable;
@@ -1478,7 +2137,7 @@ const Field3D D2DY2(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
   return interp_to(result, outloc);
 }
 
-const Field3D D2DY2(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D D2DY2(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
 {
   return D2DY2(f, outloc, method);
 }
@@ -1499,7 +2158,7 @@ const Field2D D2DY2(const Field2D &f)
 
 ////////////// Z DERIVATIVE /////////////////
 
-const Field3D D2DZ2(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
+Field3D D2DZ2(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
 {
   deriv_func func = fD2DZ2; // Set to default function
   DiffLookup *table = SecondDerivTable;
@@ -1563,58 +2222,42 @@ const Field3D D2DZ2(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
     result.allocate(); // Make sure data allocated
 
     int ncz = mesh->ngz-1;
+    int nk = ncz/2 + 1;
     
-#ifndef _OPENMP
-    static dcomplex *cv = (dcomplex*) NULL;
-#else
-    static dcomplex *globalcv = (dcomplex*) NULL;
-#endif
-    
-    #pragma omp parallel
-    {
-#ifndef _OPENMP
-      // Serial, so can have a single static array
-      if(cv == (dcomplex*) NULL)
-        cv = new dcomplex[ncz/2 + 1];
-#else
-      // Parallel, so allocate a separate array for each thread
+    // Multiplier for each mode. Work arrays are per call, since this
+    // may be called from several threads, and ngz may change
+    vector<dcomplex> mult(nk);
+    for(int jz=0;jz<nk;jz++) {
+      BoutReal kwave=jz*2.0*PI/mesh->zlength; // wave number is 1/[rad]
       
-      int th_id = omp_get_thread_num(); // thread ID
-      if(globalcv == (dcomplex*) NULL) {
-        if(th_id == 0) {
-          // Allocate memory in thread zero
-          int n_th = omp_get_num_threads();
-          globalcv = new dcomplex[n_th*(ncz/2 + 1)];
-        }
-        // Wait for memory to be allocated
-        #pragma omp barrier
-      }
-      dcomplex *cv = globalcv + th_id*(ncz/2 + 1); // Separate array for each thread
-#endif
-      #pragma omp for
-      for(int jx=mesh->xstart;jx<=mesh->xend;jx++) {
-        for(int jy=mesh->ystart;jy<=mesh->yend;jy++) {
-          
-          rfft(f[jx][jy], ncz, cv); // Forward FFT
-	
-          for(int jz=0;jz<=ncz/2;jz++) {
-            BoutReal kwave=jz*2.0*PI/mesh->zlength; // wave number is 1/[rad]
-            
-            BoutReal flt;
-            if (jz>0.4*ncz) flt=1e-10; else flt=1.0;
-
-            cv[jz] *= -SQ(kwave) * flt;
-            if(mesh->StaggerGrids)
-              cv[jz] *= exp(Im * (shift * kwave * mesh->dz));
-          }
-
-          irfft(cv, ncz, result[jx][jy]); // Reverse FFT
-	
-          result[jx][jy][ncz] = result[jx][jy][0];
-        }
-      }
-    } // End of parallel section
-
+      BoutReal flt;
+      if (jz>0.4*ncz) flt=1e-10; else flt=1.0;
+      
+      mult[jz] = -SQ(kwave) * flt;
+      if(mesh->StaggerGrids)
+        mult[jz] *= exp(Im * (shift * kwave * mesh->dz));
+    }
+    
+    // Transform all lines from (xstart, ystart) to (xend, yend) at once. 
+    // This includes Y guard cells for X in between, which aren't needed
+    int start = Field3D::index(mesh->xstart, mesh->ystart, 0);
+    int nlines = (mesh->xend - mesh->xstart)*mesh->ngy + (mesh->yend - mesh->ystart) + 1;
+    vector<dcomplex> cvbuf(nlines*nk);
+    dcomplex *cv = &cvbuf[0];
+    
+    rfft_many(f.readRaw() + start, ncz, nlines, mesh->ngz, cv); // Forward FFT
+    
+    #pragma omp parallel for
+    for(int i=0;i<nlines;i++)
+      for(int jz=0;jz<nk;jz++)
+        cv[i*nk + jz] *= mult[jz];
+    
+    FieldReal *r = result.getRaw() + start;
+    irfft_many(cv, ncz, nlines, r, mesh->ngz); // Reverse FFT
+    
+    for(int i=0;i<nlines;i++)
+      r[i*mesh->ngz + ncz] = r[i*mesh->ngz];
+    
 #ifdef CHECK
     // Mark boundaries as invalid
     result.bndry_xin = result.bndry_xout = result.bndry_yup = result.bndry_ydown = false;
@@ -1631,7 +2274,7 @@ const Field3D D2DZ2(const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
   return interp_to(result, outloc);
 }
 
-const Field3D D2DZ2(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D D2DZ2(const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
 {
   return D2DZ2(f, outloc, method);
 }
@@ -1648,14 +2291,176 @@ const Field2D D2DZ2(const Field2D &f)
  * Mixed derivatives
  *******************************************************************************/
 
+/// Can X and Z derivatives of f be done line by line, without shifting?
+static bool fusedXZ()
+{
+  if((fDDX == NULL) || (fDDZ == NULL))
+    return false; // FFT
+  if((fDDX->line == NULL) || (fDDZ->zline == NULL))
+    return false; // Compact
+  if(mesh->ShiftXderivs)
+    return false;
+  return true;
+}
+
+/// Point i of region rgn, counting with X fastest. Regions are stored
+/// with Y fastest, but neighbouring X points share Z derivative lines
+static inline const bindex& xFastest(const Region &rgn, int i)
+{
+  int ny = mesh->yend - mesh->ystart + 1;
+  int nx = rgn.size() / ny;
+  return rgn[(i % nx)*ny + i / nx];
+}
+
+/// Z derivative lines of the X neighbours of bx. Each is computed into
+/// zbuf (ngx lines) unless it is already there for this Y index (in zy).
+/// Points should be visited in xFastest order, so only one new line is
+/// needed for each point
+static sline<FieldReal> zDerivXLines(const FieldReal *f, const bindex &bx, BoutReal dz,
+                                     FieldReal *zbuf, int *zy)
+{
+  int ncz = mesh->ngz-1;
+  int jx[5] = {bx.jx2m, bx.jxm, bx.jx, bx.jxp, bx.jx2p};
+  for(int i=0;i<5;i++) {
+    if(zy[jx[i]] != bx.jy) {
+      fDDZ->zline(zbuf + jx[i]*ncz, f + Field3D::index(jx[i], bx.jy, 0), ncz, dz, STAGGER_NONE);
+      zy[jx[i]] = bx.jy;
+    }
+  }
+  
+  sline<FieldReal> l;
+  l.mm = zbuf + bx.jx2m*ncz; l.m = zbuf + bx.jxm*ncz; l.c = zbuf + bx.jx*ncz;
+  l.p = zbuf + bx.jxp*ncz; l.pp = zbuf + bx.jx2p*ncz;
+  return l;
+}
+
 /// X-Z mixed derivative
-const Field3D D2DXDZ(const Field3D &f)
+Field3D D2DXDZ(const Field3D &f)
+{
+  Field3D result;
+  
+  if(!fusedXZ()) {
+    // Take derivative in Z, including in X boundaries. Then take derivative in X
+    // Maybe should average results of DDX(DDZ) and DDZ(DDX)?
+    result = DDX(DDZ(f, true));
+    return result;
+  }
+  
+  // Same as DDX(DDZ(f)), but Z derivatives are only kept for the lines
+  // needed, so there's no intermediate field
+  
+  const Region &rgn = getRegion(RGN_NOX);
+  int ncz = mesh->ngz-1;
+  const FieldReal *fd = f.readRaw();
+#ifdef CHECK
+  if(fd == NULL)
+    throw BoutException("D2DXDZ: Empty Field3D\n");
+#endif
+  
+  result.allocate();
+  FieldReal *r = result.getRaw();
+  
+  #pragma omp parallel
+  {
+    FieldReal *zbuf = new FieldReal[mesh->ngx*ncz];
+    int *zy = new int[mesh->ngx];
+    for(int i=0;i<mesh->ngx;i++)
+      zy[i] = -1;
+    
+    #pragma omp for schedule(static)
+    for(int i=0;i<rgn.size();i++) {
+      const bindex &bx = xFastest(rgn, i);
+      sline<FieldReal> lz = zDerivXLines(fd, bx, mesh->dz, zbuf, zy);
+      fDDX->line(r + Field3D::index(bx.jx, bx.jy, 0), lz, ncz, mesh->dx[bx.jx][bx.jy]);
+    }
+    
+    delete[] zbuf;
+    delete[] zy;
+  }
+  
+  result.setLocation(f.getLocation());
+  
+#ifdef CHECK
+  result.bndry_xin = result.bndry_xout = result.bndry_yup = result.bndry_ydown = false;
+#endif
+  
+  return result;
+}
+
+Field3D Delp2_FD(const Field3D &f)
 {
+  if(!fusedXZ() || (fD2DX2 == NULL) || (fD2DZ2 == NULL) ||
+     (fD2DX2->line == NULL) || (fD2DZ2->zline == NULL) ||
+     (mesh->StaggerGrids && (f.getLocation() != CELL_CENTRE))) {
+    return mesh->G1*DDX(f) + mesh->G3*DDZ(f) + mesh->g11*D2DX2(f) + mesh->g33*D2DZ2(f) + 2.0*mesh->g13*D2DXDZ(f);
+  }
+  
+#ifdef CHECK
+  int msg_pos = msg_stack.push("Delp2_FD( Field3D )");
+#endif
+
+  const Region &rgn = getRegion(RGN_NOX);
+  int ncz = mesh->ngz-1;
+  const FieldReal *fd = f.readRaw();
+#ifdef CHECK
+  if(fd == NULL)
+    throw BoutException("Delp2_FD: Empty Field3D\n");
+#endif
+  int sx = Field3D::index(1,0,0), sy = Field3D::index(0,1,0);
+  BoutReal dz = mesh->dz;
+  
   Field3D result;
+  result.allocate();
+  FieldReal *r = result.getRaw();
   
-  // Take derivative in Z, including in X boundaries. Then take derivative in X
-  // Maybe should average results of DDX(DDZ) and DDZ(DDX)?
-  result = DDX(DDZ(f, true));
+  #pragma omp parallel
+  {
+    FieldReal *zbuf = new FieldReal[mesh->ngx*ncz];
+    int *zy = new int[mesh->ngx];
+    for(int i=0;i<mesh->ngx;i++)
+      zy[i] = -1;
+    
+    // One line of each term
+    FieldReal *dx1 = new FieldReal[4*ncz];
+    FieldReal *dx2 = dx1 + ncz, *dz2 = dx1 + 2*ncz, *dxz = dx1 + 3*ncz;
+    
+    #pragma omp for schedule(static)
+    for(int i=0;i<rgn.size();i++) {
+      const bindex &bx = xFastest(rgn, i);
+      int jx = bx.jx, jy = bx.jy;
+      int c = Field3D::index(jx, jy, 0);
+      BoutReal dx = mesh->dx[jx][jy];
+      
+      sline<FieldReal> lf = makeLine(fd+c, lineOffsets<DIFF_DIR_X>(bx, sx, sy));
+      fDDX->line(dx1, lf, ncz, dx);
+      fD2DX2->line(dx2, lf, ncz, dx*dx);
+      if(non_uniform) {
+        for(int jz=0;jz<ncz;jz++)
+          dx2[jz] += mesh->d1_dx[jx][jy]*dx1[jz];
+      }
+      fD2DZ2->zline(dz2, fd+c, ncz, SQ(dz), STAGGER_NONE);
+      
+      sline<FieldReal> lz = zDerivXLines(fd, bx, dz, zbuf, zy);
+      fDDX->line(dxz, lz, ncz, dx);
+      const FieldReal *dz1 = lz.c;
+      
+      BoutReal G1 = mesh->G1[jx][jy], G3 = mesh->G3[jx][jy];
+      BoutReal g11 = mesh->g11[jx][jy], g33 = mesh->g33[jx][jy], g13 = 2.0*mesh->g13[jx][jy];
+      for(int jz=0;jz<ncz;jz++)
+        r[c+jz] = G1*dx1[jz] + G3*dz1[jz] + g11*dx2[jz] + g33*dz2[jz] + g13*dxz[jz];
+    }
+    
+    delete[] zbuf;
+    delete[] zy;
+    delete[] dx1;
+  }
+
+  result.setLocation(f.getLocation());
+
+#ifdef CHECK
+  result.bndry_xin = result.bndry_xout = result.bndry_yup = result.bndry_ydown = false;
+  msg_stack.pop(msg_pos);
+#endif
   
   return result;
 }
@@ -1679,18 +2484,7 @@ const Field2D VDDX(const Field2D &v, const Field2D &f, CELL_LOC outloc, DIFF_MET
   }
 
   Field2D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal **d = result.getData();
-
-  bindex bx;
-  stencil vs, fs;
-  start_index(&bx);
-  do {
-    f.setXStencil(fs, bx);
-    v.setXStencil(vs, bx);
-    
-    d[bx.jx][bx.jy] = func(vs, fs) / mesh->dx[bx.jx][bx.jy];
-  }while(next_index2(&bx));
+  func->f2d[DIFF_DIR_X](v, f, RGN_NOBNDRY, mesh->dx.getData(), 0., result);
 
 #ifdef CHECK
   // Mark boundaries as invalid
@@ -1706,7 +2500,7 @@ const Field2D VDDX(const Field2D &v, const Field2D &f, DIFF_METHOD method)
 }
 
 /// General version for 2 or 3-D objects
-const Field3D VDDX(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD method)
+Field3D VDDX(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD method)
 {
   upwind_func func = fVDDX;
   DiffLookup *table = UpwindTable;
@@ -1760,61 +2554,7 @@ const Field3D VDDX(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD
   }
   
   Field3D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal ***d = result.getData();
-
-  bindex bx;
-  
-  start_index(&bx);
-#ifdef _OPENMP
-  // Parallel version
-  
-  bindex bxstart = bx; // Copy to avoid race condition on first index
-  bool workToDoGlobal; // Shared loop control
-  #pragma omp parallel
-  {
-    bindex bxlocal; // Index for each thread
-    stencil vval, fval;
-    bool workToDo;  // Does this thread have work to do?
-    #pragma omp single
-    {
-      // First index done by a single thread
-      for(bxstart.jz=0;bxstart.jz<mesh->ngz-1;bxstart.jz++) {
-        vp->setXStencil(vval, bxstart, diffloc);
-        fp->setXStencil(fval, bxstart); // Location is always the same as input
-    
-        d[bxstart.jx][bxstart.jy][bxstart.jz] = func(vval, fval) / mesh->dx[bxstart.jx][bxstart.jy];
-      }
-    }
-    
-    do {
-      #pragma omp critical
-      {
-        // Get the next index
-        workToDo = next_index2(&bx);
-        bxlocal = bx; // Make a local copy
-        workToDoGlobal = workToDo;
-      }
-      if(workToDo) { // Here workToDo could be different to workToDoGlobal
-        for(bxlocal.jz=0;bxlocal.jz<mesh->ngz-1;bxlocal.jz++) {
-          vp->setXStencil(vval, bxlocal, diffloc);
-          fp->setXStencil(fval, bxlocal); // Location is always the same as input
-    
-          d[bxlocal.jx][bxlocal.jy][bxlocal.jz] = func(vval, fval) / mesh->dx[bxlocal.jx][bxlocal.jy];
-        }
-      }
-    }while(workToDoGlobal);
-  }
-#else
-  // Serial version
-  stencil vval, fval;
-  do {
-    vp->setXStencil(vval, bx, diffloc);
-    fp->setXStencil(fval, bx); // Location is always the same as input
-    
-    d[bx.jx][bx.jy][bx.jz] = func(vval, fval) / mesh->dx[bx.jx][bx.jy];
-  }while(next_index3(&bx));
-#endif
+  func->f3d[DIFF_DIR_X](*vp, *fp, diffloc, RGN_NOBNDRY, mesh->dx.getData(), 0., result);
   
   if(mesh->ShiftXderivs && (mesh->ShiftOrder == 0))
     result = result.shiftZ(false); // Shift back
@@ -1833,7 +2573,7 @@ const Field3D VDDX(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD
   return interp_to(result, outloc);
 }
 
-const Field3D VDDX(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D VDDX(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc)
 {
   return VDDX(v, f, outloc, method);
 }
@@ -1884,19 +2624,8 @@ const Field2D VDDY(const Field2D &v, const Field2D &f, CELL_LOC outloc, DIFF_MET
     func = lookupUpwindFunc(table, method);
   }
 
-  bindex bx;
-  stencil fval, vval;
-  
   Field2D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal **d = result.getData();
-
-  start_index(&bx);
-  do {
-    f.setYStencil(fval, bx);
-    v.setYStencil(vval, bx, diffloc);
-    d[bx.jx][bx.jy] = func(vval,fval)/mesh->dy[bx.jx][bx.jy];
-  }while(next_index2(&bx));
+  func->f2d[DIFF_DIR_Y](v, f, RGN_NOBNDRY, mesh->dy.getData(), 0., result);
 
   result.setLocation(inloc);
   
@@ -1914,7 +2643,7 @@ const Field2D VDDY(const Field2D &v, const Field2D &f, DIFF_METHOD method)
 }
 
 // general case
-const Field3D VDDY(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD method)
+Field3D VDDY(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD method)
 {
   upwind_func func = fVDDY;
   DiffLookup *table = UpwindTable;
@@ -1957,63 +2686,8 @@ const Field3D VDDY(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD
     func = lookupUpwindFunc(table, method);
   }
   
-  bindex bx;
-  
   Field3D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal ***d = result.getData();
-
-  start_index(&bx);
-#ifdef _OPENMP
-  // Parallel version
-  
-  bindex bxstart = bx; // Copy to avoid race condition on first index
-  bool workToDoGlobal; // Shared loop control
-
-  #pragma omp parallel
-  {
-    bindex bxlocal; // Index for each thread
-    stencil vval, fval;
-    bool workToDo;  // Does this thread have work to do?
-    #pragma omp single
-    {
-      // First index done by a single thread
-      for(bxstart.jz=0;bxstart.jz<mesh->ngz-1;bxstart.jz++) {
-        v.setYStencil(vval, bxstart, diffloc);
-        f.setYStencil(fval, bxstart);
-    
-        d[bxstart.jx][bxstart.jy][bxstart.jz] = func(vval, fval)/mesh->dy[bxstart.jx][bxstart.jy];
-      }
-    }
-    
-    do {
-      #pragma omp critical
-      {
-        // Get the next index
-        workToDo = next_index2(&bx);
-        bxlocal = bx; // Make a local copy
-        workToDoGlobal = workToDo;
-      }
-      if(workToDo) { // Here workToDo could be different to workToDoGlobal
-        for(bxlocal.jz=0;bxlocal.jz<mesh->ngz-1;bxlocal.jz++) {
-          v.setYStencil(vval, bxlocal, diffloc);
-          f.setYStencil(fval, bxlocal);
-    
-          d[bxlocal.jx][bxlocal.jy][bxlocal.jz] = func(vval, fval)/mesh->dy[bxlocal.jx][bxlocal.jy];
-        }
-      }
-    }while(workToDoGlobal);
-  }
-#else
-  // Serial version
-  stencil vval, fval;
-  do {
-    v.setYStencil(vval, bx, diffloc);
-    f.setYStencil(fval, bx);
-    
-    d[bx.jx][bx.jy][bx.jz] = func(vval, fval)/mesh->dy[bx.jx][bx.jy];
-  }while(next_index3(&bx));
-#endif
+  func->f3d[DIFF_DIR_Y](v, f, diffloc, RGN_NOBNDRY, mesh->dy.getData(), 0., result);
   
   result.setLocation(inloc);
 
@@ -2025,7 +2699,7 @@ const Field3D VDDY(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD
   return interp_to(result, outloc);
 }
 
-const Field3D VDDY(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D VDDY(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc)
 {
   return VDDY(v, f, outloc, method);
 }
@@ -2049,7 +2723,7 @@ const Field2D VDDZ(const Field3D &v, const Field2D &f)
 }
 
 // general case
-const Field3D VDDZ(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD method)
+Field3D VDDZ(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD method)
 {
   upwind_func func = fVDDZ;
   DiffLookup *table = UpwindTable;
@@ -2092,63 +2766,8 @@ const Field3D VDDZ(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD
     func = lookupUpwindFunc(table, method);
   }
 
-  bindex bx;
-  
-  
   Field3D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal ***d = result.getData();
-  
-  start_index(&bx);
-#ifdef _OPENMP
-  // Parallel version
-
-  bindex bxstart = bx; // Copy to avoid race condition on first index
-  bool workToDoGlobal; // Shared loop control
-  
-  #pragma omp parallel
-  {
-    bindex bxlocal; // Index for each thread
-    stencil vval, fval;
-    bool workToDo;  // Does this thread have work to do?
-    #pragma omp single
-    {
-      // First index done by a single thread
-      for(bxstart.jz=0;bxstart.jz<mesh->ngz-1;bxstart.jz++) {
-        v.setZStencil(vval, bxstart, diffloc);
-        f.setZStencil(fval, bxstart);
-    
-        d[bxstart.jx][bxstart.jy][bxstart.jz] = func(vval, fval)/mesh->dz;
-      }
-    }
-    
-    do {
-      #pragma omp critical
-      {
-        // Get the next index
-        workToDo = next_index2(&bx);
-        bxlocal = bx; // Make a local copy
-        workToDoGlobal = workToDo;
-      }
-      if(workToDo) { // Here workToDo could be different to workToDoGlobal
-        for(bxlocal.jz=0;bxlocal.jz<mesh->ngz-1;bxlocal.jz++) {
-          v.setZStencil(vval, bxlocal, diffloc);
-          f.setZStencil(fval, bxlocal);
-    
-          d[bxlocal.jx][bxlocal.jy][bxlocal.jz] = func(vval, fval)/mesh->dz;
-        }
-      }
-    }while(workToDoGlobal);
-  }
-#else 
-  stencil vval, fval;
-  do {
-    v.setZStencil(vval, bx, diffloc);
-    f.setZStencil(fval, bx);
-    
-    d[bx.jx][bx.jy][bx.jz] = func(vval, fval)/mesh->dz;
-  }while(next_index3(&bx));
-#endif
+  func->f3d[DIFF_DIR_Z](v, f, diffloc, RGN_NOBNDRY, NULL, mesh->dz, result);
 
   result.setLocation(inloc);
 
@@ -2160,7 +2779,7 @@ const Field3D VDDZ(const Field &v, const Field &f, CELL_LOC outloc, DIFF_METHOD
   return interp_to(result, outloc);
 }
 
-const Field3D VDDZ(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D VDDZ(const Field &v, const Field &f, DIFF_METHOD method, CELL_LOC outloc)
 {
   return VDDZ(v, f, outloc, method);
 }
@@ -2193,18 +2812,7 @@ const Field2D FDDX(const Field2D &v, const Field2D &f, DIFF_METHOD method, CELL_
     func = lookupUpwindFunc(FluxTable, method);
   }
   Field2D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal **d = result.getData();
-
-  bindex bx;
-  stencil vs, fs;
-  start_index(&bx);
-  do {
-    f.setXStencil(fs, bx);
-    v.setXStencil(vs, bx);
-    
-    d[bx.jx][bx.jy] = func(vs, fs) / mesh->dx[bx.jx][bx.jy];
-  }while(next_index2(&bx));
+  func->f2d[DIFF_DIR_X](v, f, RGN_NOBNDRY, mesh->dx.getData(), 0., result);
 
 #ifdef CHECK
   // Mark boundaries as invalid
@@ -2214,17 +2822,17 @@ const Field2D FDDX(const Field2D &v, const Field2D &f, DIFF_METHOD method, CELL_
   return result;
 }
 
-const Field3D FDDX(const Field3D &v, const Field3D &f)
+Field3D FDDX(const Field3D &v, const Field3D &f)
 {
   return FDDX(v, f, DIFF_DEFAULT, CELL_DEFAULT);
 }
 
-const Field3D FDDX(const Field3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
+Field3D FDDX(const Field3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
 {
   return FDDX(v, f, method, outloc);
 }
 
-const Field3D FDDX(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D FDDX(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
 {
   if( (method == DIFF_SPLIT) || ((method == DIFF_DEFAULT) && (fFDDX == NULL)) ) {
     // Split into an upwind and a central differencing part
@@ -2284,19 +2892,7 @@ const Field3D FDDX(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_
   }
   
   Field3D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal ***d = result.getData();
-
-  bindex bx;
-  stencil vval, fval;
-  
-  start_index(&bx);
-  do {
-    vp->setXStencil(vval, bx, diffloc);
-    fp->setXStencil(fval, bx); // Location is always the same as input
-    
-    d[bx.jx][bx.jy][bx.jz] = func(vval, fval) / mesh->dx[bx.jx][bx.jy];
-  }while(next_index3(&bx));
+  func->f3d[DIFF_DIR_X](*vp, *fp, diffloc, RGN_NOBNDRY, mesh->dx.getData(), 0., result);
   
   if(mesh->ShiftXderivs && (mesh->ShiftOrder == 0))
     result = result.shiftZ(false); // Shift back
@@ -2341,18 +2937,7 @@ const Field2D FDDY(const Field2D &v, const Field2D &f, DIFF_METHOD method, CELL_
     func = lookupUpwindFunc(FluxTable, method);
   }
   Field2D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal **d = result.getData();
-
-  bindex bx;
-  stencil vs, fs;
-  start_index(&bx);
-  do {
-    f.setYStencil(fs, bx);
-    v.setYStencil(vs, bx);
-    
-    d[bx.jx][bx.jy] = func(vs, fs) / mesh->dy[bx.jx][bx.jy];
-  }while(next_index2(&bx));
+  func->f2d[DIFF_DIR_Y](v, f, RGN_NOBNDRY, mesh->dy.getData(), 0., result);
 
 #ifdef CHECK
   // Mark boundaries as invalid
@@ -2362,17 +2947,17 @@ const Field2D FDDY(const Field2D &v, const Field2D &f, DIFF_METHOD method, CELL_
   return result;
 }
 
-const Field3D FDDY(const Field3D &v, const Field3D &f)
+Field3D FDDY(const Field3D &v, const Field3D &f)
 {
   return FDDY(v, f, DIFF_DEFAULT, CELL_DEFAULT);
 }
 
-const Field3D FDDY(const Field3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
+Field3D FDDY(const Field3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
 {
   return FDDY(v, f, method, outloc);
 }
 
-const Field3D FDDY(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D FDDY(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
 {
   if( (method == DIFF_SPLIT) || ((method == DIFF_DEFAULT) && (fFDDY == NULL)) ) {
     // Split into an upwind and a central differencing part
@@ -2421,19 +3006,7 @@ const Field3D FDDY(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_
   }
   
   Field3D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal ***d = result.getData();
-
-  bindex bx;
-  stencil vval, fval;
-  
-  start_index(&bx);
-  do {
-    v.setYStencil(vval, bx, diffloc);
-    f.setYStencil(fval, bx); // Location is always the same as input
-    
-    d[bx.jx][bx.jy][bx.jz] = func(vval, fval) / mesh->dy[bx.jx][bx.jy];
-  }while(next_index3(&bx));
+  func->f3d[DIFF_DIR_Y](v, f, diffloc, RGN_NOBNDRY, mesh->dy.getData(), 0., result);
   
   result.setLocation(inloc);
 
@@ -2471,18 +3044,7 @@ const Field2D FDDZ(const Field2D &v, const Field2D &f, DIFF_METHOD method, CELL_
     func = lookupUpwindFunc(FluxTable, method);
   }
   Field2D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal **d = result.getData();
-
-  bindex bx;
-  stencil vs, fs;
-  start_index(&bx);
-  do {
-    f.setZStencil(fs, bx);
-    v.setZStencil(vs, bx);
-    
-    d[bx.jx][bx.jy] = func(vs, fs) / mesh->dz;
-  }while(next_index2(&bx));
+  func->f2d[DIFF_DIR_Z](v, f, RGN_NOBNDRY, NULL, mesh->dz, result);
 
 #ifdef CHECK
   // Mark boundaries as invalid
@@ -2492,17 +3054,17 @@ const Field2D FDDZ(const Field2D &v, const Field2D &f, DIFF_METHOD method, CELL_
   return result;
 }
 
-const Field3D FDDZ(const Field3D &v, const Field3D &f)
+Field3D FDDZ(const Field3D &v, const Field3D &f)
 {
   return FDDZ(v, f, DIFF_DEFAULT, CELL_DEFAULT);
 }
 
-const Field3D FDDZ(const Field3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
+Field3D FDDZ(const Field3D &v, const Field3D &f, CELL_LOC outloc, DIFF_METHOD method)
 {
   return FDDZ(v, f, method, outloc);
 }
 
-const Field3D FDDZ(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
+Field3D FDDZ(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_LOC outloc)
 {
   if( (method == DIFF_SPLIT) || ((method == DIFF_DEFAULT) && (fFDDZ == NULL)) ) {
     // Split into an upwind and a central differencing part
@@ -2552,19 +3114,7 @@ const Field3D FDDZ(const Field3D &v, const Field3D &f, DIFF_METHOD method, CELL_
   }
   
   Field3D result;
-  result.allocate(); // Make sure data allocated
-  BoutReal ***d = result.getData();
-
-  bindex bx;
-  stencil vval, fval;
-  
-  start_index(&bx);
-  do {
-    v.setZStencil(vval, bx, diffloc);
-    f.setZStencil(fval, bx); // Location is always the same as input
-    
-    d[bx.jx][bx.jy][bx.jz] = func(vval, fval) / mesh->dz;
-  }while(next_index3(&bx));
+  func->f3d[DIFF_DIR_Z](v, f, diffloc, RGN_NOBNDRY, NULL, mesh->dz, result);
   
   result.setLocation(inloc);
 
@@ -29,6 +29,22 @@
 #include <string.h>
 #include <stdarg.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/// The stack is shared, so only the thread outside parallel regions
+/// records messages. Operators called from inside an OpenMP region
+/// (e.g. on per-thread slices) don't appear in the back trace
+static inline bool stack_usable()
+{
+#ifdef _OPENMP
+  if(omp_in_parallel())
+    return false;
+#endif
+  return true;
+}
+
 MsgStack::MsgStack()
 {
   nmsg = 0;
@@ -46,6 +62,9 @@ int MsgStack::push(const char *s, ...)
   va_list ap;  // List of arguments
   msg_item_t *m;
 
+  if(!stack_usable())
+    return 0;
+
   if(size > nmsg) {
     m = &msg[nmsg];
   }else {
@@ -96,7 +115,7 @@ void MsgStack::pop()
 {
 #if CHECK > 1
   
-  if(nmsg <= 0)
+  if((nmsg <= 0) || !stack_usable())
     return;
   
   //output.write("Popping %d\n", nmsg);
@@ -108,6 +127,9 @@ void MsgStack::pop()
 void MsgStack::pop(int id)
 {
 #if CHECK > 1
+  if(!stack_usable())
+    return;
+  
   if(id < 0)
     id = 0;
 
@@ -0,0 +1,323 @@
+/**************************************************************************
+ * Fused reductions over fields
+ *
+ **************************************************************************
+ * Copyright 2010 B.D.Dudson, S.Farley, M.V.Umansky, X.Q.Xu
+ *
+ * Contact: Ben Dudson, bd512@york.ac.uk
+ *
+ * This file is part of BOUT++.
+ *
+ * BOUT++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BOUT++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BOUT++.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **************************************************************************/
+
+#include <globals.hxx>
+#include <reduce.hxx>
+#include <boutcomm.hxx>
+#include <boutexception.hxx>
+
+#include <cmath>
+
+Reduction::Reduction(bool allpe) : allpe(allpe), started(false), done(false)
+{
+  request = MPI_REQUEST_NULL;
+  op = MPI_OP_NULL;
+  record = MPI_DATATYPE_NULL;
+}
+
+Reduction::~Reduction()
+{
+  if(started && !done)
+    wait(); // Don't leave a collective using our buffers
+}
+
+int Reduction::min(const Field3D &f)    { return add(REDUCE_MIN, &f, NULL); }
+int Reduction::max(const Field3D &f)    { return add(REDUCE_MAX, &f, NULL); }
+int Reduction::sum(const Field3D &f)    { return add(REDUCE_SUM, &f, NULL); }
+int Reduction::norm(const Field3D &f)   { return add(REDUCE_NORM, &f, NULL); }
+int Reduction::finite(const Field3D &f) { return add(REDUCE_FINITE, &f, NULL); }
+
+int Reduction::min(const Field2D &f)    { return add(REDUCE_MIN, NULL, &f); }
+int Reduction::max(const Field2D &f)    { return add(REDUCE_MAX, NULL, &f); }
+int Reduction::sum(const Field2D &f)    { return add(REDUCE_SUM, NULL, &f); }
+int Reduction::norm(const Field2D &f)   { return add(REDUCE_NORM, NULL, &f); }
+int Reduction::finite(const Field2D &f) { return add(REDUCE_FINITE, NULL, &f); }
+
+int Reduction::add(ReduceType type, const Field3D *f3d, const Field2D *f2d)
+{
+  if(started)
+    throw BoutException("Reduction: Can't add reductions after start()\n");
+
+  Item it;
+  it.type = type;
+  it.f3d = f3d;
+  it.f2d = f2d;
+  it.field = it.slot = -1;
+  items.push_back(it);
+  return items.size()-1;
+}
+
+void Reduction::run()
+{
+  start();
+  wait();
+}
+
+void Reduction::start()
+{
+#ifdef CHECK
+  msg_stack.push("Reduction::start()");
+#endif
+
+  if(started)
+    throw BoutException("Reduction: start() called twice\n");
+
+  int n = items.size();
+
+  // Find the distinct fields, so each is only swept once.
+  // 3D fields are numbered first, then 2D fields
+  vector<const Field3D*> f3list;
+  vector<const Field2D*> f2list;
+  for(int i=0;i<n;i++) {
+    Item &it = items[i];
+    if(it.f3d == NULL)
+      continue;
+    int j;
+    for(j=0;j<(int) f3list.size();j++)
+      if(f3list[j] == it.f3d)
+        break;
+    if(j == (int) f3list.size())
+      f3list.push_back(it.f3d);
+    it.field = j;
+  }
+  int n3 = f3list.size();
+  for(int i=0;i<n;i++) {
+    Item &it = items[i];
+    if(it.f2d == NULL)
+      continue;
+    int j;
+    for(j=0;j<(int) f2list.size();j++)
+      if(f2list[j] == it.f2d)
+        break;
+    if(j == (int) f2list.size())
+      f2list.push_back(it.f2d);
+    it.field = n3 + j;
+  }
+
+  vector<FieldResult> local(n3 + f2list.size());
+  for(int j=0;j<n3;j++)
+    reduceField(*f3list[j], local[j]);
+  for(int j=0;j<(int) f2list.size();j++)
+    reduceField(*f2list[j], local[n3+j]);
+
+  // Pack into a buffer. First element is the number of values to be
+  // combined with max; the rest are summed. min is packed as max(-f),
+  // and finite as max(0 if finite, 1 if not)
+  int nmax = 0;
+  for(int i=0;i<n;i++)
+    if((items[i].type != REDUCE_SUM) && (items[i].type != REDUCE_NORM))
+      items[i].slot = 1 + nmax++;
+  int nsum = 0;
+  for(int i=0;i<n;i++)
+    if((items[i].type == REDUCE_SUM) || (items[i].type == REDUCE_NORM))
+      items[i].slot = 1 + nmax + nsum++;
+
+  sendbuf.resize(1 + n);
+  recvbuf.resize(1 + n);
+  sendbuf[0] = (BoutReal) nmax;
+  for(int i=0;i<n;i++) {
+    const FieldResult &r = local[items[i].field];
+    BoutReal val = 0.;
+    switch(items[i].type) {
+    case REDUCE_MIN:    val = -r.min; break;
+    case REDUCE_MAX:    val = r.max; break;
+    case REDUCE_SUM:    val = r.sum; break;
+    case REDUCE_NORM:   val = r.sumsq; break;
+    case REDUCE_FINITE: val = r.finite ? 0. : 1.; break;
+    }
+    sendbuf[items[i].slot] = val;
+  }
+
+  started = true;
+  done = false;
+
+  if(allpe && (n > 0)) {
+    // The whole buffer is one element of a contiguous type. MPI can
+    // split a reduction into pieces, but not inside an element, so
+    // reduceOp always sees the nmax header with its values
+    MPI_Type_contiguous(1+n, MPI_DOUBLE, &record);
+    MPI_Type_commit(&record);
+    MPI_Op_create(reduceOp, 1, &op);
+
+#if MPI_VERSION >= 3
+    MPI_Iallreduce(&sendbuf[0], &recvbuf[0], 1, record, op, BoutComm::get(), &request);
+#else
+    MPI_Allreduce(&sendbuf[0], &recvbuf[0], 1, record, op, BoutComm::get());
+#endif
+  }else
+    recvbuf = sendbuf;
+
+#ifdef CHECK
+  msg_stack.pop();
+#endif
+}
+
+void Reduction::wait()
+{
+  if(!started)
+    throw BoutException("Reduction: wait() called before start()\n");
+  if(done)
+    return;
+
+#if MPI_VERSION >= 3
+  if(request != MPI_REQUEST_NULL)
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+#endif
+  if(op != MPI_OP_NULL)
+    MPI_Op_free(&op);
+  if(record != MPI_DATATYPE_NULL)
+    MPI_Type_free(&record);
+
+  int n = items.size();
+  result.resize(n);
+  for(int i=0;i<n;i++) {
+    BoutReal val = recvbuf[items[i].slot];
+    switch(items[i].type) {
+    case REDUCE_MIN:    val = -val; break;
+    case REDUCE_NORM:   val = sqrt(val); break;
+    case REDUCE_FINITE: val = (val > 0.5) ? 0. : 1.; break;
+    default: break;
+    }
+    result[i] = val;
+  }
+  done = true;
+}
+
+BoutReal Reduction::operator[](int i) const
+{
+#ifdef CHECK
+  if(!done)
+    throw BoutException("Reduction: Result requested before wait() or run()\n");
+  if((i < 0) || (i >= (int) result.size()))
+    throw BoutException("Reduction: Index %d out of range\n", i);
+#endif
+  return result[i];
+}
+
+void Reduction::clear()
+{
+  if(started && !done)
+    wait();
+  items.clear();
+  result.clear();
+  started = done = false;
+}
+
+///////////////////////////////////////////////////////////////////
+
+void Reduction::reduceField(const Field3D &f, FieldResult &r)
+{
+#ifdef CHECK
+  if(f.block == NULL)
+    throw BoutException("Reduction: Field3D has no data\n");
+#endif
+  const FieldReal *d = f.block->raw;
+  int nz = mesh->ngz;
+
+  BoutReal mn = d[0], mx = d[0], sum = 0., sumsq = 0.;
+  int nbad = 0;
+
+  #pragma omp parallel for reduction(min:mn) reduction(max:mx) reduction(+:sum,sumsq,nbad)
+  for(int jx=0;jx<mesh->ngx;jx++) {
+    bool inx = (jx >= mesh->xstart) && (jx <= mesh->xend);
+    for(int jy=0;jy<mesh->ngy;jy++) {
+      bool interior = inx && (jy >= mesh->ystart) && (jy <= mesh->yend);
+      const FieldReal *dp = d + (jx*mesh->ngy + jy)*nz;
+      for(int jz=0;jz<nz;jz++) {
+        BoutReal val = dp[jz];
+        if(val < mn)
+          mn = val;
+        if(val > mx)
+          mx = val;
+        if(jz < nz-1) {
+          if(!::finite(val))
+            nbad++;
+          if(interior) {
+            sum += val;
+            sumsq += val*val;
+          }
+        }
+      }
+    }
+  }
+
+  r.min = mn; r.max = mx;
+  r.sum = sum; r.sumsq = sumsq;
+  r.finite = (nbad == 0);
+}
+
+void Reduction::reduceField(const Field2D &f, FieldResult &r)
+{
+  BoutReal **d = f.getData();
+#ifdef CHECK
+  if(d == (BoutReal**) NULL)
+    throw BoutException("Reduction: Field2D has no data\n");
+#endif
+
+  BoutReal mn = d[0][0], mx = d[0][0], sum = 0., sumsq = 0.;
+  int nbad = 0;
+
+  #pragma omp parallel for reduction(min:mn) reduction(max:mx) reduction(+:sum,sumsq,nbad)
+  for(int jx=0;jx<mesh->ngx;jx++) {
+    bool inx = (jx >= mesh->xstart) && (jx <= mesh->xend);
+    for(int jy=0;jy<mesh->ngy;jy++) {
+      BoutReal val = d[jx][jy];
+      if(val < mn)
+        mn = val;
+      if(val > mx)
+        mx = val;
+      if(!::finite(val))
+        nbad++;
+      if(inx && (jy >= mesh->ystart) && (jy <= mesh->yend)) {
+        sum += val;
+        sumsq += val*val;
+      }
+    }
+  }
+
+  r.min = mn; r.max = mx;
+  r.sum = sum; r.sumsq = sumsq;
+  r.finite = (nbad == 0);
+}
+
+void Reduction::reduceOp(void *invec, void *inoutvec, int *len, MPI_Datatype *type)
+{
+  // Each of the len elements is a whole record, header first
+  int size;
+  MPI_Type_size(*type, &size);
+  int m = size / sizeof(BoutReal);
+
+  for(int r=0;r<*len;r++) {
+    BoutReal *in = ((BoutReal*) invec) + r*m;
+    BoutReal *inout = ((BoutReal*) inoutvec) + r*m;
+
+    int nmax = (int) in[0];
+    for(int i=1;i<=nmax;i++)
+      if(in[i] > inout[i])
+        inout[i] = in[i];
+    for(int i=nmax+1;i<m;i++)
+      inout[i] += in[i];
+  }
+}
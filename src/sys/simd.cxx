@@ -0,0 +1,692 @@
+/**************************************************************************
+ * Vectorised elementwise kernels on contiguous arrays
+ *
+ * A thin wrapper (vreal and v* functions) around the compiler intrinsics
+ * for each instruction set, and kernels written using that wrapper.
+ *
+ * exp, log, sin and cos use the Cephes rational/polynomial approximations
+ * (S.L. Moshier), which are accurate to around 1e-16 relative. Vectors
+ * containing values outside the range of these approximations
+ * (overflow, zero, negative, NaN, very large angles) are passed to the
+ * standard library, so results agree with the scalar versions.
+ * pow is done element by element with the standard library, apart
+ * from squares.
+ *
+ **************************************************************************
+ * Copyright 2010 B.D.Dudson, S.Farley, M.V.Umansky, X.Q.Xu
+ *
+ * Contact: Ben Dudson, bd512@york.ac.uk
+ *
+ * This file is part of BOUT++.
+ *
+ * BOUT++ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BOUT++ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with BOUT++.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **************************************************************************/
+
+#include <simd.hxx>
+
+#include <math.h>
+#include <float.h>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/// Number of elements handled by each OpenMP work item
+#define SIMD_CHUNK 1024
+
+/**************************************************************************
+ * Wrapper around intrinsics
+ **************************************************************************/
+
+#if defined(__AVX512F__)
+
+#define VWIDTH 8
+#define VNAME "avx512"
+typedef __m512d vreal;
+
+static inline vreal vload(const BoutReal *p) { return _mm512_loadu_pd(p); }
+static inline void vstore(BoutReal *p, vreal v) { _mm512_storeu_pd(p, v); }
+static inline vreal vset(BoutReal x) { return _mm512_set1_pd(x); }
+static inline vreal vadd(vreal a, vreal b) { return _mm512_add_pd(a, b); }
+static inline vreal vsub(vreal a, vreal b) { return _mm512_sub_pd(a, b); }
+static inline vreal vmul(vreal a, vreal b) { return _mm512_mul_pd(a, b); }
+static inline vreal vdiv(vreal a, vreal b) { return _mm512_div_pd(a, b); }
+static inline vreal vsqrt(vreal a) { return _mm512_sqrt_pd(a); }
+static inline vreal vabs(vreal a) { return _mm512_abs_pd(a); }
+static inline vreal vround(vreal a) {
+  return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+/// a * 2^n, n integer valued
+static inline vreal vldexp(vreal a, vreal n) { return _mm512_scalef_pd(a, n); }
+/// Mantissa in [0.5,1) and exponent of positive normal numbers
+static inline vreal vfrexp(vreal a, vreal &e) {
+  e = vadd(_mm512_getexp_pd(a), vset(1.0));
+  return _mm512_getmant_pd(a, _MM_MANT_NORM_p5_1, _MM_MANT_SIGN_src);
+}
+/// (a < b) ? t : f
+static inline vreal vselect_lt(vreal a, vreal b, vreal t, vreal f) {
+  return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, b, _CMP_LT_OQ), f, t);
+}
+/// True if any element is outside [lo, hi] or NaN
+static inline bool vany_outside(vreal a, BoutReal lo, BoutReal hi) {
+  return (_mm512_cmp_pd_mask(a, vset(lo), _CMP_NGE_UQ) |
+          _mm512_cmp_pd_mask(a, vset(hi), _CMP_NLE_UQ)) != 0;
+}
+
+#elif defined(__AVX2__)
+
+#define VWIDTH 4
+#define VNAME "avx2"
+typedef __m256d vreal;
+
+static inline vreal vload(const BoutReal *p) { return _mm256_loadu_pd(p); }
+static inline void vstore(BoutReal *p, vreal v) { _mm256_storeu_pd(p, v); }
+static inline vreal vset(BoutReal x) { return _mm256_set1_pd(x); }
+static inline vreal vadd(vreal a, vreal b) { return _mm256_add_pd(a, b); }
+static inline vreal vsub(vreal a, vreal b) { return _mm256_sub_pd(a, b); }
+static inline vreal vmul(vreal a, vreal b) { return _mm256_mul_pd(a, b); }
+static inline vreal vdiv(vreal a, vreal b) { return _mm256_div_pd(a, b); }
+static inline vreal vsqrt(vreal a) { return _mm256_sqrt_pd(a); }
+static inline vreal vabs(vreal a) { return _mm256_andnot_pd(vset(-0.0), a); }
+static inline vreal vround(vreal a) {
+  return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+static inline vreal vldexp(vreal a, vreal n) {
+  __m256i k = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+  k = _mm256_slli_epi64(_mm256_add_epi64(k, _mm256_set1_epi64x(1023)), 52);
+  return vmul(a, _mm256_castsi256_pd(k));
+}
+static inline vreal vfrexp(vreal a, vreal &e) {
+  __m256i bits = _mm256_castpd_si256(a);
+  // Exponent bits converted to double using 2^52 trick
+  __m256i ebits = _mm256_or_si256(_mm256_srli_epi64(bits, 52),
+                                  _mm256_set1_epi64x(0x4330000000000000LL));
+  e = vsub(_mm256_castsi256_pd(ebits), vset(4503599627370496.0 + 1022.0));
+  bits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000fffffffffffffLL)),
+                         _mm256_set1_epi64x(0x3fe0000000000000LL));
+  return _mm256_castsi256_pd(bits);
+}
+static inline vreal vselect_lt(vreal a, vreal b, vreal t, vreal f) {
+  return _mm256_blendv_pd(f, t, _mm256_cmp_pd(a, b, _CMP_LT_OQ));
+}
+static inline bool vany_outside(vreal a, BoutReal lo, BoutReal hi) {
+  return _mm256_movemask_pd(_mm256_or_pd(_mm256_cmp_pd(a, vset(lo), _CMP_NGE_UQ),
+                                         _mm256_cmp_pd(a, vset(hi), _CMP_NLE_UQ))) != 0;
+}
+
+#elif defined(__SSE2__)
+
+#define VWIDTH 2
+#define VNAME "sse2"
+typedef __m128d vreal;
+
+static inline vreal vload(const BoutReal *p) { return _mm_loadu_pd(p); }
+static inline void vstore(BoutReal *p, vreal v) { _mm_storeu_pd(p, v); }
+static inline vreal vset(BoutReal x) { return _mm_set1_pd(x); }
+static inline vreal vadd(vreal a, vreal b) { return _mm_add_pd(a, b); }
+static inline vreal vsub(vreal a, vreal b) { return _mm_sub_pd(a, b); }
+static inline vreal vmul(vreal a, vreal b) { return _mm_mul_pd(a, b); }
+static inline vreal vdiv(vreal a, vreal b) { return _mm_div_pd(a, b); }
+static inline vreal vsqrt(vreal a) { return _mm_sqrt_pd(a); }
+static inline vreal vabs(vreal a) { return _mm_andnot_pd(vset(-0.0), a); }
+/// Only valid for |a| < 2^31, which kernels ensure
+static inline vreal vround(vreal a) { return _mm_cvtepi32_pd(_mm_cvtpd_epi32(a)); }
+static inline vreal vldexp(vreal a, vreal n) {
+  __m128i k = _mm_add_epi32(_mm_cvtpd_epi32(n), _mm_set1_epi32(1023));
+  k = _mm_slli_epi64(_mm_unpacklo_epi32(k, _mm_setzero_si128()), 52);
+  return vmul(a, _mm_castsi128_pd(k));
+}
+static inline vreal vfrexp(vreal a, vreal &e) {
+  __m128i bits = _mm_castpd_si128(a);
+  __m128i ebits = _mm_or_si128(_mm_srli_epi64(bits, 52),
+                               _mm_set1_epi64x(0x4330000000000000LL));
+  e = vsub(_mm_castsi128_pd(ebits), vset(4503599627370496.0 + 1022.0));
+  bits = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi64x(0x000fffffffffffffLL)),
+                      _mm_set1_epi64x(0x3fe0000000000000LL));
+  return _mm_castsi128_pd(bits);
+}
+static inline vreal vselect_lt(vreal a, vreal b, vreal t, vreal f) {
+  vreal m = _mm_cmplt_pd(a, b);
+  return _mm_or_pd(_mm_and_pd(m, t), _mm_andnot_pd(m, f));
+}
+static inline bool vany_outside(vreal a, BoutReal lo, BoutReal hi) {
+  return _mm_movemask_pd(_mm_or_pd(_mm_cmpnge_pd(a, vset(lo)),
+                                   _mm_cmpnle_pd(a, vset(hi)))) != 0;
+}
+
+#else
+
+#define VWIDTH 1
+#define VNAME "scalar"
+typedef BoutReal vreal;
+
+static inline vreal vload(const BoutReal *p) { return *p; }
+static inline void vstore(BoutReal *p, vreal v) { *p = v; }
+static inline vreal vset(BoutReal x) { return x; }
+static inline vreal vadd(vreal a, vreal b) { return a + b; }
+static inline vreal vsub(vreal a, vreal b) { return a - b; }
+static inline vreal vmul(vreal a, vreal b) { return a * b; }
+static inline vreal vdiv(vreal a, vreal b) { return a / b; }
+static inline vreal vsqrt(vreal a) { return sqrt(a); }
+static inline vreal vabs(vreal a) { return fabs(a); }
+static inline vreal vround(vreal a) { return floor(a + 0.5); }
+static inline vreal vldexp(vreal a, vreal n) { return ldexp(a, (int) n); }
+static inline vreal vfrexp(vreal a, vreal &e) {
+  int ie;
+  a = frexp(a, &ie);
+  e = (BoutReal) ie;
+  return a;
+}
+static inline vreal vselect_lt(vreal a, vreal b, vreal t, vreal f) { return (a < b) ? t : f; }
+static inline bool vany_outside(vreal a, BoutReal lo, BoutReal hi) { return !((a >= lo) && (a <= hi)); }
+
+#endif
+
+const char* simd_name()
+{
+  return VNAME;
+}
+
+int simd_width()
+{
+  return VWIDTH;
+}
+
+/**************************************************************************
+ * Transcendental functions
+ **************************************************************************/
+
+static inline vreal vfloor(vreal a)
+{
+  vreal r = vround(a);
+  return vselect_lt(a, r, vsub(r, vset(1.0)), r);
+}
+
+/// Valid for -708 <= x <= 709
+static inline vreal vexp(vreal x)
+{
+  static const BoutReal LOG2E = 1.4426950408889634073599;
+  static const BoutReal C1 = 6.93145751953125E-1;
+  static const BoutReal C2 = 1.42860682030941723212E-6;
+
+  vreal n = vround(vmul(x, vset(LOG2E)));
+  x = vsub(x, vmul(n, vset(C1)));
+  x = vsub(x, vmul(n, vset(C2)));
+
+  vreal xx = vmul(x, x);
+  vreal px = vadd(vmul(xx, vset(1.26177193074810590878E-4)), vset(3.02994407707441961300E-2));
+  px = vmul(x, vadd(vmul(px, xx), vset(9.99999999999999999910E-1)));
+
+  vreal qx = vadd(vmul(xx, vset(3.00198505138664455042E-6)), vset(2.52448340349684104192E-3));
+  qx = vadd(vmul(qx, xx), vset(2.27265548208155028766E-1));
+  qx = vadd(vmul(qx, xx), vset(2.00000000000000000009E0));
+
+  x = vdiv(px, vsub(qx, px));
+  x = vadd(vset(1.0), vadd(x, x));
+
+  return vldexp(x, n);
+}
+
+/// Valid for positive, normal x
+static inline vreal vlog(vreal x)
+{
+  static const BoutReal SQRTH = 0.70710678118654752440;
+
+  vreal e;
+  vreal m = vfrexp(x, e);
+
+  // Shift to the range [sqrt(1/2), sqrt(2)], then subtract 1
+  e = vselect_lt(m, vset(SQRTH), vsub(e, vset(1.0)), e);
+  m = vselect_lt(m, vset(SQRTH), vsub(vadd(m, m), vset(1.0)), vsub(m, vset(1.0)));
+
+  vreal z = vmul(m, m);
+
+  vreal p = vadd(vmul(m, vset(1.01875663804580931796E-4)), vset(4.97494994976747001425E-1));
+  p = vadd(vmul(p, m), vset(4.70579119878881725854E0));
+  p = vadd(vmul(p, m), vset(1.44989225341610930846E1));
+  p = vadd(vmul(p, m), vset(1.79368678507819816313E1));
+  p = vadd(vmul(p, m), vset(7.70838733755885391666E0));
+
+  vreal q = vadd(m, vset(1.12873587189167450590E1));
+  q = vadd(vmul(q, m), vset(4.52279145837532221105E1));
+  q = vadd(vmul(q, m), vset(8.29875266912776603211E1));
+  q = vadd(vmul(q, m), vset(7.11544750618563894466E1));
+  q = vadd(vmul(q, m), vset(2.31251620126765340583E1));
+
+  vreal y = vmul(m, vdiv(vmul(z, p), q));
+  y = vsub(y, vmul(e, vset(2.121944400546905827679E-4)));
+  y = vsub(y, vmul(z, vset(0.5)));
+  z = vadd(m, y);
+  return vadd(z, vmul(e, vset(0.693359375)));
+}
+
+/// Valid for |x| <= 1e9. Returns sin(x), or cos(x) if cosine is true
+static inline vreal vsincos(vreal x, bool cosine)
+{
+  static const BoutReal FOPI = 1.27323954473516268615; // 4/pi
+  static const BoutReal DP1 = 7.85398125648498535156E-1;
+  static const BoutReal DP2 = 3.77489470793079817668E-8;
+  static const BoutReal DP3 = 2.69515142907905952645E-15;
+
+  vreal one = vset(1.0), zero = vset(0.0);
+
+  vreal sign = cosine ? one : vselect_lt(x, zero, vset(-1.0), one);
+  x = vabs(x);
+
+  // Octant j = y mod 8, rounded up to even
+  vreal y = vfloor(vmul(x, vset(FOPI)));
+  vreal j = vsub(y, vmul(vset(8.0), vfloor(vmul(y, vset(0.125)))));
+  vreal odd = vsub(j, vmul(vset(2.0), vfloor(vmul(j, vset(0.5)))));
+  j = vadd(j, odd);
+  y = vadd(y, odd);
+  j = vsub(j, vmul(vset(8.0), vfloor(vmul(j, vset(0.125)))));
+
+  // if(j > 3) { sign = -sign; j -= 4; }
+  sign = vselect_lt(vset(3.5), j, vsub(zero, sign), sign);
+  j = vselect_lt(vset(3.5), j, vsub(j, vset(4.0)), j);
+  if(cosine) {
+    // if(j > 1) sign = -sign
+    sign = vselect_lt(vset(1.5), j, vsub(zero, sign), sign);
+  }
+
+  vreal z = vsub(vsub(vsub(x, vmul(y, vset(DP1))), vmul(y, vset(DP2))), vmul(y, vset(DP3)));
+  vreal zz = vmul(z, z);
+
+  vreal ps = vadd(vmul(zz, vset(1.58962301576546568060E-10)), vset(-2.50507477628578072866E-8));
+  ps = vadd(vmul(ps, zz), vset(2.75573136213857245213E-6));
+  ps = vadd(vmul(ps, zz), vset(-1.98412698295895385996E-4));
+  ps = vadd(vmul(ps, zz), vset(8.33333333332211858878E-3));
+  ps = vadd(vmul(ps, zz), vset(-1.66666666666666307295E-1));
+  ps = vadd(z, vmul(z, vmul(zz, ps)));
+
+  vreal pc = vadd(vmul(zz, vset(-1.13585365213876817300E-11)), vset(2.08757008419747316778E-9));
+  pc = vadd(vmul(pc, zz), vset(-2.75573141792967388112E-7));
+  pc = vadd(vmul(pc, zz), vset(2.48015872888517045348E-5));
+  pc = vadd(vmul(pc, zz), vset(-1.38888888888730564116E-3));
+  pc = vadd(vmul(pc, zz), vset(4.16666666666665929218E-2));
+  pc = vadd(vsub(one, vmul(zz, vset(0.5))), vmul(vmul(zz, zz), pc));
+
+  // j is now 0 or 2
+  if(cosine) {
+    y = vselect_lt(j, one, pc, ps);
+  }else
+    y = vselect_lt(j, one, ps, pc);
+
+  return vmul(sign, y);
+}
+
+/**************************************************************************
+ * Kernels
+ **************************************************************************/
+
+/// Loop over chunks in parallel, then vectors within each chunk, then
+/// the remainder. Kernel has members vec(i), which does the VWIDTH
+/// elements starting at i, and scalar(i) which does element i
+template<class Kernel>
+static inline void simd_loop(const Kernel &k, int n)
+{
+  int nchunks = (n + SIMD_CHUNK - 1) / SIMD_CHUNK;
+  #pragma omp parallel for
+  for(int c=0;c<nchunks;c++) {
+    int i = c*SIMD_CHUNK;
+    int end = (i + SIMD_CHUNK < n) ? i + SIMD_CHUNK : n;
+    for(;i+VWIDTH<=end;i+=VWIDTH)
+      k.vec(i);
+    for(;i<end;i++)
+      k.scalar(i);
+  }
+}
+
+/// r = Op(a, b) for arrays a and b
+template<class Op>
+struct BinaryKernel {
+  BinaryKernel(BoutReal *r, const BoutReal *a, const BoutReal *b) : r(r), a(a), b(b) {}
+  void vec(int i) const { vstore(r+i, Op::vec(vload(a+i), vload(b+i))); }
+  void scalar(int i) const { r[i] = Op::scalar(a[i], b[i]); }
+  BoutReal *r;
+  const BoutReal *a, *b;
+};
+
+/// r = Op(a, b) for array a and scalar b
+template<class Op>
+struct ScalarKernel {
+  ScalarKernel(BoutReal *r, const BoutReal *a, BoutReal b) : r(r), a(a), b(b), vb(vset(b)) {}
+  void vec(int i) const { vstore(r+i, Op::vec(vload(a+i), vb)); }
+  void scalar(int i) const { r[i] = Op::scalar(a[i], b); }
+  BoutReal *r;
+  const BoutReal *a;
+  BoutReal b;
+  vreal vb;
+};
+
+/// r = Op(a)
+template<class Op>
+struct UnaryKernel {
+  UnaryKernel(BoutReal *r, const BoutReal *a) : r(r), a(a) {}
+  void vec(int i) const { vstore(r+i, Op::vec(vload(a+i))); }
+  void scalar(int i) const { r[i] = Op::scalar(a[i]); }
+  BoutReal *r;
+  const BoutReal *a;
+};
+
+struct AddOp {
+  static inline vreal vec(vreal a, vreal b) { return vadd(a, b); }
+  static inline BoutReal scalar(BoutReal a, BoutReal b) { return a + b; }
+};
+
+struct SubOp {
+  static inline vreal vec(vreal a, vreal b) { return vsub(a, b); }
+  static inline BoutReal scalar(BoutReal a, BoutReal b) { return a - b; }
+};
+
+struct MulOp {
+  static inline vreal vec(vreal a, vreal b) { return vmul(a, b); }
+  static inline BoutReal scalar(BoutReal a, BoutReal b) { return a * b; }
+};
+
+struct DivOp {
+  static inline vreal vec(vreal a, vreal b) { return vdiv(a, b); }
+  static inline BoutReal scalar(BoutReal a, BoutReal b) { return a / b; }
+};
+
+/// Element by element pow(), so negative and zero bases are handled
+/// exactly as the scalar operators do
+struct PowOp {
+  static inline vreal vec(vreal a, vreal b) {
+    BoutReal x[VWIDTH], y[VWIDTH];
+    vstore(x, a);
+    vstore(y, b);
+    for(int k=0;k<VWIDTH;k++)
+      x[k] = pow(x[k], y[k]);
+    return vload(x);
+  }
+  static inline BoutReal scalar(BoutReal a, BoutReal b) { return pow(a, b); }
+};
+
+struct SquareOp {
+  static inline vreal vec(vreal a) { return vmul(a, a); }
+  static inline BoutReal scalar(BoutReal a) { return a * a; }
+};
+
+struct SqrtOp {
+  static inline vreal vec(vreal a) { return vsqrt(a); }
+  static inline BoutReal scalar(BoutReal a) { return sqrt(a); }
+};
+
+struct AbsOp {
+  static inline vreal vec(vreal a) { return vabs(a); }
+  static inline BoutReal scalar(BoutReal a) { return fabs(a); }
+};
+
+/// Apply the standard library function to each element, for vectors
+/// outside the range of the approximations
+static inline vreal vfallback(vreal a, BoutReal (*func)(BoutReal))
+{
+  BoutReal x[VWIDTH];
+  vstore(x, a);
+  for(int k=0;k<VWIDTH;k++)
+    x[k] = func(x[k]);
+  return vload(x);
+}
+
+struct ExpOp {
+  static inline vreal vec(vreal a) {
+    if(vany_outside(a, -708.0, 709.0))
+      return vfallback(a, exp);
+    return vexp(a);
+  }
+  static inline BoutReal scalar(BoutReal a) { return exp(a); }
+};
+
+struct LogOp {
+  static inline vreal vec(vreal a) {
+    if(vany_outside(a, DBL_MIN, DBL_MAX))
+      return vfallback(a, log);
+    return vlog(a);
+  }
+  static inline BoutReal scalar(BoutReal a) { return log(a); }
+};
+
+struct SinOp {
+  static inline vreal vec(vreal a) {
+    if(vany_outside(a, -1.0e9, 1.0e9))
+      return vfallback(a, sin);
+    return vsincos(a, false);
+  }
+  static inline BoutReal scalar(BoutReal a) { return sin(a); }
+};
+
+struct CosOp {
+  static inline vreal vec(vreal a) {
+    if(vany_outside(a, -1.0e9, 1.0e9))
+      return vfallback(a, cos);
+    return vsincos(a, true);
+  }
+  static inline BoutReal scalar(BoutReal a) { return cos(a); }
+};
+
+void simd_add(BoutReal *r, const BoutReal *a, const BoutReal *b, int n)
+{
+  simd_loop(BinaryKernel<AddOp>(r, a, b), n);
+}
+
+void simd_sub(BoutReal *r, const BoutReal *a, const BoutReal *b, int n)
+{
+  simd_loop(BinaryKernel<SubOp>(r, a, b), n);
+}
+
+void simd_mul(BoutReal *r, const BoutReal *a, const BoutReal *b, int n)
+{
+  simd_loop(BinaryKernel<MulOp>(r, a, b), n);
+}
+
+void simd_div(BoutReal *r, const BoutReal *a, const BoutReal *b, int n)
+{
+  simd_loop(BinaryKernel<DivOp>(r, a, b), n);
+}
+
+void simd_pow(BoutReal *r, const BoutReal *a, const BoutReal *b, int n)
+{
+  simd_loop(BinaryKernel<PowOp>(r, a, b), n);
+}
+
+void simd_add(BoutReal *r, const BoutReal *a, BoutReal b, int n)
+{
+  simd_loop(ScalarKernel<AddOp>(r, a, b), n);
+}
+
+void simd_sub(BoutReal *r, const BoutReal *a, BoutReal b, int n)
+{
+  simd_loop(ScalarKernel<SubOp>(r, a, b), n);
+}
+
+void simd_mul(BoutReal *r, const BoutReal *a, BoutReal b, int n)
+{
+  simd_loop(ScalarKernel<MulOp>(r, a, b), n);
+}
+
+void simd_div(BoutReal *r, const BoutReal *a, BoutReal b, int n)
+{
+  simd_loop(ScalarKernel<DivOp>(r, a, b), n);
+}
+
+void simd_pow(BoutReal *r, const BoutReal *a, BoutReal b, int n)
+{
+  if(b == 2.0) {
+    // Exact, and the most common exponent
+    simd_loop(UnaryKernel<SquareOp>(r, a), n);
+    return;
+  }
+  simd_loop(ScalarKernel<PowOp>(r, a, b), n);
+}
+
+void simd_sqrt(BoutReal *r, const BoutReal *a, int n)
+{
+  simd_loop(UnaryKernel<SqrtOp>(r, a), n);
+}
+
+void simd_abs(BoutReal *r, const BoutReal *a, int n)
+{
+  simd_loop(UnaryKernel<AbsOp>(r, a), n);
+}
+
+void simd_exp(BoutReal *r, const BoutReal *a, int n)
+{
+  simd_loop(UnaryKernel<ExpOp>(r, a), n);
+}
+
+void simd_log(BoutReal *r, const BoutReal *a, int n)
+{
+  simd_loop(UnaryKernel<LogOp>(r, a), n);
+}
+
+void simd_sin(BoutReal *r, const BoutReal *a, int n)
+{
+  simd_loop(UnaryKernel<SinOp>(r, a), n);
+}
+
+void simd_cos(BoutReal *r, const BoutReal *a, int n)
+{
+  simd_loop(UnaryKernel<CosOp>(r, a), n);
+}
+
+/**************************************************************************
+ * Arakawa bracket
+ **************************************************************************/
+
+void simd_arakawa(BoutReal *r, const BoutReal *fm, const BoutReal *fc, const BoutReal *fp,
+                  const BoutReal *gm, const BoutReal *gc, const BoutReal *gp,
+                  int n, BoutReal scale)
+{
+  vreal vs = vset(scale);
+  for(int i=0;i<n;i+=VWIDTH) {
+    // f and g at (x offset, z offset). Point i is at row[i+1]
+    vreal fmm = vload(fm+i), fm0 = vload(fm+i+1), fmp = vload(fm+i+2);
+    vreal f0m = vload(fc+i),                     f0p = vload(fc+i+2);
+    vreal fpm = vload(fp+i), fp0 = vload(fp+i+1), fpp = vload(fp+i+2);
+    
+    vreal gmm = vload(gm+i), gm0 = vload(gm+i+1), gmp = vload(gm+i+2);
+    vreal g0m = vload(gc+i),                     g0p = vload(gc+i+2);
+    vreal gpm = vload(gp+i), gp0 = vload(gp+i+1), gpp = vload(gp+i+2);
+    
+    // J++
+    vreal j = vsub(vmul(vsub(f0p, f0m), vsub(gp0, gm0)),
+                   vmul(vsub(fp0, fm0), vsub(g0p, g0m)));
+    // J+x
+    j = vadd(j, vsub(vmul(gp0, vsub(fpp, fpm)), vmul(gm0, vsub(fmp, fmm))));
+    j = vadd(j, vsub(vmul(g0m, vsub(fpm, fmm)), vmul(g0p, vsub(fpp, fmp))));
+    // Jx+
+    j = vadd(j, vsub(vmul(gpp, vsub(f0p, fp0)), vmul(gmm, vsub(fm0, f0m))));
+    j = vadd(j, vsub(vmul(gpm, vsub(fp0, f0m)), vmul(gmp, vsub(f0p, fm0))));
+    
+    vstore(r+i, vmul(j, vs));
+  }
+}
+
+#ifdef BOUT_FIELD_FLOAT
+/**************************************************************************
+ * Single precision storage
+ *
+ * Values are converted to BoutReal, operated on, and rounded once
+ * when stored. Simple loops, left to the compiler to vectorise
+ **************************************************************************/
+
+#define FLOAT_LOOP(op)                          \
+  _Pragma("omp parallel for")                   \
+  for(int i=0;i<n;i++) {                        \
+    op;                                         \
+  }
+
+void simd_add(float *r, const float *a, const float *b, int n)
+{
+  FLOAT_LOOP(r[i] = (float) ((BoutReal) a[i] + (BoutReal) b[i]));
+}
+
+void simd_sub(float *r, const float *a, const float *b, int n)
+{
+  FLOAT_LOOP(r[i] = (float) ((BoutReal) a[i] - (BoutReal) b[i]));
+}
+
+void simd_mul(float *r, const float *a, const float *b, int n)
+{
+  FLOAT_LOOP(r[i] = (float) ((BoutReal) a[i] * (BoutReal) b[i]));
+}
+
+void simd_div(float *r, const float *a, const float *b, int n)
+{
+  FLOAT_LOOP(r[i] = (float) ((BoutReal) a[i] / (BoutReal) b[i]));
+}
+
+void simd_pow(float *r, const float *a, const float *b, int n)
+{
+  FLOAT_LOOP(r[i] = (float) pow((BoutReal) a[i], (BoutReal) b[i]));
+}
+
+void simd_add(float *r, const float *a, BoutReal b, int n)
+{
+  FLOAT_LOOP(r[i] = (float) ((BoutReal) a[i] + b));
+}
+
+void simd_sub(float *r, const float *a, BoutReal b, int n)
+{
+  FLOAT_LOOP(r[i] = (float) ((BoutReal) a[i] - b));
+}
+
+void simd_mul(float *r, const float *a, BoutReal b, int n)
+{
+  FLOAT_LOOP(r[i] = (float) ((BoutReal) a[i] * b));
+}
+
+void simd_div(float *r, const float *a, BoutReal b, int n)
+{
+  FLOAT_LOOP(r[i] = (float) ((BoutReal) a[i] / b));
+}
+
+void simd_pow(float *r, const float *a, BoutReal b, int n)
+{
+  FLOAT_LOOP(r[i] = (float) pow((BoutReal) a[i], b));
+}
+
+void simd_sqrt(float *r, const float *a, int n)
+{
+  FLOAT_LOOP(r[i] = (float) sqrt((BoutReal) a[i]));
+}
+
+void simd_abs(float *r, const float *a, int n)
+{
+  FLOAT_LOOP(r[i] = fabsf(a[i]));
+}
+
+void simd_exp(float *r, const float *a, int n)
+{
+  FLOAT_LOOP(r[i] = (float) exp((BoutReal) a[i]));
+}
+
+void simd_log(float *r, const float *a, int n)
+{
+  FLOAT_LOOP(r[i] = (float) log((BoutReal) a[i]));
+}
+
+void simd_sin(float *r, const float *a, int n)
+{
+  FLOAT_LOOP(r[i] = (float) sin((BoutReal) a[i]));
+}
+
+void simd_cos(float *r, const float *a, int n)
+{
+  FLOAT_LOOP(r[i] = (float) cos((BoutReal) a[i]));
+}
+
+#endif // BOUT_FIELD_FLOAT
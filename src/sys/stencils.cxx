@@ -879,3 +879,53 @@ int next_indexperp(bindex *bx)
   return(1);
 }
 
+
+/**************************************************************************
+ * Precomputed regions
+ **************************************************************************/
+
+Region::Region(REGION rgn) : region(rgn)
+{
+  bindex bx;
+  start_index(&bx, rgn);
+  do {
+    ind.push_back(bx);
+  }while(next_index2(&bx));
+  
+  // Z neighbours, periodic
+  ncz = mesh->ngz-1;
+  zp.resize(ncz); zm.resize(ncz); z2p.resize(ncz); z2m.resize(ncz);
+  for(int jz=0;jz<ncz;jz++) {
+    zp[jz]  = (jz+1)%ncz;
+    zm[jz]  = (jz+ncz-1)%ncz;
+    z2p[jz] = (jz+2)%ncz;
+    z2m[jz] = (jz+ncz-2)%ncz;
+  }
+}
+
+static Region* region_list[RGN_NOZ+1] = {NULL, NULL, NULL, NULL, NULL};
+
+const Region& getRegion(REGION rgn)
+{
+  #pragma omp flush
+  Region *r = region_list[rgn];
+  if(r == NULL) {
+    // First use. May be called from inside a parallel region
+    #pragma omp critical(region_init)
+    {
+      if(region_list[rgn] == NULL)
+        region_list[rgn] = new Region(rgn);
+      r = region_list[rgn];
+    }
+  }
+  return *r;
+}
+
+void free_regions()
+{
+  for(int i=0;i<=RGN_NOZ;i++) {
+    if(region_list[i] != NULL)
+      delete region_list[i];
+    region_list[i] = NULL;
+  }
+}
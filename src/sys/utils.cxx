@@ -139,6 +139,82 @@ void free_r3tensor(BoutReal ***m)
   free(m);
 }
 
+/// Allocate a block of BoutReals aligned to BOUT_ALIGNMENT bytes
+BoutReal *aligned_rvector(int size)
+{
+  void *ptr;
+  if(posix_memalign(&ptr, BOUT_ALIGNMENT, sizeof(BoutReal)*size) != 0) {
+    printf("Error: could not allocate aligned memory:%d\n", size);
+    exit(1);
+  }
+  return (BoutReal*) ptr;
+}
+
+void free_aligned_rvector(BoutReal *v)
+{
+  free(v);
+}
+
+/// Build a 3D pointer table over contiguous data of size nrow*ncol*ndep
+BoutReal ***r3view(BoutReal *data, int nrow, int ncol, int ndep)
+{
+  BoutReal ***t = (BoutReal ***) malloc((size_t)(nrow*sizeof(BoutReal**)));
+  t[0] = (BoutReal **) malloc((size_t)(nrow*ncol*sizeof(BoutReal*)));
+  
+  for(int i=0;i<nrow;i++) {
+    t[i] = t[0] + i*ncol;
+    for(int j=0;j<ncol;j++)
+      t[i][j] = data + (i*ncol + j)*ndep;
+  }
+  
+  return t;
+}
+
+void free_r3view(BoutReal ***m)
+{
+  // Note: underlying data not freed
+  free(m[0]);
+  free(m);
+}
+
+#ifdef BOUT_FIELD_FLOAT
+/// Allocate a block of floats aligned to BOUT_ALIGNMENT bytes
+float *aligned_fvector(int size)
+{
+  void *ptr;
+  if(posix_memalign(&ptr, BOUT_ALIGNMENT, sizeof(float)*size) != 0) {
+    printf("Error: could not allocate aligned memory:%d\n", size);
+    exit(1);
+  }
+  return (float*) ptr;
+}
+
+void free_aligned_fvector(float *v)
+{
+  free(v);
+}
+
+float ***r3view(float *data, int nrow, int ncol, int ndep)
+{
+  float ***t = (float ***) malloc((size_t)(nrow*sizeof(float**)));
+  t[0] = (float **) malloc((size_t)(nrow*ncol*sizeof(float*)));
+  
+  for(int i=0;i<nrow;i++) {
+    t[i] = t[0] + i*ncol;
+    for(int j=0;j<ncol;j++)
+      t[i][j] = data + (i*ncol + j)*ndep;
+  }
+  
+  return t;
+}
+
+void free_r3view(float ***m)
+{
+  free(m[0]);
+  free(m);
+}
+#endif // BOUT_FIELD_FLOAT
+
 dcomplex **cmatrix(int nrow, int ncol)
 {
   dcomplex **m;